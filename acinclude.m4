@@ -257,6 +257,69 @@ AC_DEFUN([OFP_CHECK_HWLIBS],
    AM_CONDITIONAL([BUILD_HW_LIBS], [test $BUILD_HW_LIBS = yes])
    AC_SUBST(HW_LIB)])
 
+dnl Checks for --enable-native-parser and --enable-parser-crosscheck, and
+dnl whether the NetBee library is needed.
+AC_DEFUN([OFP_CHECK_PACKET_PARSER],
+  [AC_ARG_ENABLE(
+     [native-parser],
+     [AC_HELP_STRING([--disable-native-parser],
+                     [Decode packets with the NetBee library instead of
+                      the built-in packet parser])],
+     [case "${enableval}" in # (
+        yes) native_parser=yes ;; # (
+        no)  native_parser=no ;; # (
+        *) AC_MSG_ERROR([bad value ${enableval} for --enable-native-parser]) ;;
+      esac],
+     [native_parser=yes])
+   AC_ARG_ENABLE(
+     [parser-crosscheck],
+     [AC_HELP_STRING([--enable-parser-crosscheck],
+                     [Decode every packet with both the built-in parser and
+                      NetBee, and log any difference])],
+     [case "${enableval}" in # (
+        yes) parser_crosscheck=yes ;; # (
+        no)  parser_crosscheck=no ;; # (
+        *) AC_MSG_ERROR([bad value ${enableval} for --enable-parser-crosscheck]) ;;
+      esac],
+     [parser_crosscheck=no])
+   if test $native_parser = no && test $parser_crosscheck = yes; then
+     AC_MSG_ERROR([--enable-parser-crosscheck requires the native parser])
+   fi
+   if test $native_parser = yes; then
+     AC_DEFINE([NATIVE_PARSER], [1],
+               [Define to 1 to decode packets with the built-in parser.])
+   fi
+   if test $parser_crosscheck = yes; then
+     AC_DEFINE([PARSER_CROSSCHECK], [1],
+               [Define to 1 to check the built-in parser against NetBee.])
+   fi
+   if test $native_parser = no || test $parser_crosscheck = yes; then
+     USE_NBEE=yes
+     AC_CHECK_LIB([nbee], [nbGetLastError], [],
+                  [AC_MSG_ERROR([the NetBee library is required without the native parser or with parser cross-checking])])
+   else
+     USE_NBEE=no
+   fi
+   AM_CONDITIONAL([USE_NBEE], [test $USE_NBEE = yes])])
+
+dnl Checks whether the classifier compares keys in SSE2 lanes.
+AC_DEFUN([OFP_CHECK_CLASSIFIER_SSE2],
+  [AC_ARG_ENABLE(
+     [classifier-sse2],
+     [AC_HELP_STRING([--enable-classifier-sse2],
+                     [Mask and compare classifier keys 16 bytes at a time
+                      with SSE2, instead of a word at a time])],
+     [case "${enableval}" in # (
+        yes) classifier_sse2=yes ;; # (
+        no)  classifier_sse2=no ;; # (
+        *) AC_MSG_ERROR([bad value ${enableval} for --enable-classifier-sse2]) ;;
+      esac],
+     [classifier_sse2=no])
+   if test $classifier_sse2 = yes; then
+     AC_DEFINE([CLASSIFIER_SSE2], [1],
+               [Define to 1 to compare classifier keys in SSE2 lanes.])
+   fi])
+
 dnl Checks for net/if_packet.h.
 AC_DEFUN([OFP_CHECK_IF_PACKET],
   [AC_CHECK_HEADER([net/if_packet.h],
@@ -24,6 +24,28 @@ enum ofp_extension_commands { /* Queue configuration commands */
     OFP_EXT_QUEUE_DELETE,  /* Remove a queue */
     OFP_EXT_SET_DESC,      /* Set ofp_desc_stat->dp_desc */
 
+    /* Datapath flow cache */
+    OFP_EXT_FLOW_CACHE_STATS_REQUEST, /* Get the flow cache counters */
+    OFP_EXT_FLOW_CACHE_STATS_REPLY,
+
+    /* Flow table memory */
+    OFP_EXT_TABLE_MEMORY_REQUEST, /* Get the memory used by the flow tables */
+    OFP_EXT_TABLE_MEMORY_REPLY,
+
+    /* Flow table lookup structure */
+    OFP_EXT_TABLE_MODE,           /* Set the lookup structure of a table */
+
+    /* Bundles of flow mods */
+    OFP_EXT_BUNDLE_CONTROL,       /* Open, close, commit or discard a bundle */
+    OFP_EXT_BUNDLE_ADD,           /* Add a message to an open bundle */
+
+    /* Datapath threads */
+    OFP_EXT_STAGE_STATS_REQUEST,  /* Get the counters of the thread stages */
+    OFP_EXT_STAGE_STATS_REPLY,
+    OFP_EXT_PACKET_POOL_STATS_REQUEST, /* Get the counters of the packet
+                                          pools of the threads */
+    OFP_EXT_PACKET_POOL_STATS_REPLY,
+
     OFP_EXT_COUNT
 };
 
@@ -87,6 +109,223 @@ struct openflow_ext_set_dp_desc {
 };
 OFP_ASSERT(sizeof(struct openflow_ext_set_dp_desc) == 272);
 
+/* Body of OFP_EXT_FLOW_CACHE_STATS_REPLY. The request has no body. */
+struct openflow_ext_flow_cache_stats {
+    struct ofp_extension_header header;
+    uint32_t size;              /* Number of cache entries, 0 if disabled. */
+    uint32_t used;              /* Entries holding a valid path. */
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;         /* Valid paths replaced by another one. */
+    uint64_t invalidations;     /* Flushes due to table or port changes. */
+    uint32_t megaflow_size;     /* Maximum number of megaflows, 0 if disabled. */
+    uint32_t megaflow_used;
+    uint64_t megaflow_hits;
+    uint64_t megaflow_misses;
+    uint64_t megaflow_evictions; /* Megaflows dropped to make room. */
+    uint64_t megaflow_expired;  /* Megaflows dropped for being idle. */
+    uint64_t megaflow_stale;    /* Megaflows dropped after a table change. */
+};
+OFP_ASSERT(sizeof(struct openflow_ext_flow_cache_stats) == 104);
+
+/* Lookup structures of a flow table. */
+enum openflow_ext_table_modes {
+    OFP_EXT_TABLE_MODE_AUTO,    /* Picked by the datapath from the entries. */
+    OFP_EXT_TABLE_MODE_GENERIC, /* Tuple space search classifier. */
+    OFP_EXT_TABLE_MODE_LPM,     /* Longest prefix match on the destination
+                                   address, while the entries fit it. */
+    OFP_EXT_TABLE_MODE_EXACT    /* Hash table on the fields all entries
+                                   match exactly, while they fit it. */
+};
+
+/* Body of OFP_EXT_TABLE_MODE. */
+struct openflow_ext_table_mode {
+    struct ofp_extension_header header;
+    uint8_t  table_id;          /* Table, or OFPTT_ALL. */
+    uint8_t  mode;              /* One of OFP_EXT_TABLE_MODE_*. */
+    uint8_t  pad[6];
+};
+OFP_ASSERT(sizeof(struct openflow_ext_table_mode) == 24);
+
+/* Memory used by the entries of a flow table. */
+struct openflow_ext_table_memory {
+    uint8_t  table_id;
+    uint8_t  mode;              /* Lookup structure in use,
+                                   OFP_EXT_TABLE_MODE_*. */
+    uint8_t  pad[2];
+    uint32_t active_count;      /* Number of entries. */
+    uint32_t max_entries;       /* Maximum number of entries. */
+    uint8_t  pad2[4];
+    uint64_t memory;            /* Bytes held by the entries. */
+};
+OFP_ASSERT(sizeof(struct openflow_ext_table_memory) == 24);
+
+/* Body of OFP_EXT_TABLE_MEMORY_REPLY, followed by one
+ * openflow_ext_table_memory per table holding entries. The request has no
+ * body. */
+struct openflow_ext_table_memory_stats {
+    struct ofp_extension_header header;
+    uint64_t budget;            /* Bytes the entries of all tables may hold,
+                                   0 if unlimited. */
+    uint64_t memory;            /* Bytes held by the entries of all tables. */
+    struct openflow_ext_table_memory tables[0];
+};
+OFP_ASSERT(sizeof(struct openflow_ext_table_memory_stats) == 32);
+
+/* Bundle control operations, following the OpenFlow 1.4 bundles. Each
+ * request is answered by the matching reply, or by an error:
+ * OFPET_BAD_REQUEST/OFPBRC_EPERM for a bundle in the wrong state (an
+ * unknown or already open id, a closed bundle, too many bundles or
+ * messages), OFPBRC_BAD_TYPE for a message other than a flow mod, or the
+ * error of the first message failing at commit. */
+enum openflow_ext_bundle_ctrl_type {
+    OFP_EXT_BCT_OPEN_REQUEST,
+    OFP_EXT_BCT_OPEN_REPLY,
+    OFP_EXT_BCT_CLOSE_REQUEST,
+    OFP_EXT_BCT_CLOSE_REPLY,
+    OFP_EXT_BCT_COMMIT_REQUEST,
+    OFP_EXT_BCT_COMMIT_REPLY,
+    OFP_EXT_BCT_DISCARD_REQUEST,
+    OFP_EXT_BCT_DISCARD_REPLY
+};
+
+/* Bundle flags. Bundles are always committed in order and in one step,
+ * the flags are kept for the OpenFlow 1.4 encoding. */
+enum openflow_ext_bundle_flags {
+    OFP_EXT_BF_ATOMIC  = 1 << 0,
+    OFP_EXT_BF_ORDERED = 1 << 1
+};
+
+/* Body of OFP_EXT_BUNDLE_CONTROL. */
+struct openflow_ext_bundle_ctrl {
+    struct ofp_extension_header header;
+    uint32_t bundle_id;         /* Chosen by the controller. */
+    uint16_t type;              /* One of OFP_EXT_BCT_*. */
+    uint16_t flags;             /* Bitmap of OFP_EXT_BF_*. */
+};
+OFP_ASSERT(sizeof(struct openflow_ext_bundle_ctrl) == 24);
+
+/* Body of OFP_EXT_BUNDLE_ADD. */
+struct openflow_ext_bundle_add {
+    struct ofp_extension_header header;
+    uint32_t bundle_id;
+    uint16_t pad;
+    uint16_t flags;             /* Bitmap of OFP_EXT_BF_*. */
+    struct ofp_header message[0]; /* The message to add, with its own
+                                     header and length. */
+};
+OFP_ASSERT(sizeof(struct openflow_ext_bundle_add) == 24);
+
+/* Stages of the datapath threads. */
+enum openflow_ext_stages {
+    OFP_EXT_STAGE_RUN,          /* Workers running packets to completion. */
+    OFP_EXT_STAGE_RECEIVE,      /* Receivers parsing packets. */
+    OFP_EXT_STAGE_CLASSIFY,     /* Classifiers running the pipeline. */
+    OFP_EXT_STAGE_TRANSMIT      /* Transmitters sending packets. */
+};
+
+/* Counters of the threads of a stage. */
+struct openflow_ext_stage {
+    uint8_t  stage;             /* One of OFP_EXT_STAGE_*. */
+    uint8_t  pad[3];
+    uint32_t threads;           /* Threads running the stage. */
+    uint32_t capacity;          /* Packets the rings in front of the stage
+                                   hold, 0 for the stages receiving. */
+    uint32_t occupancy;         /* Packets waiting in these rings. */
+    uint64_t packets;           /* Packets handled by the stage. */
+    uint64_t dropped;           /* Packets the stage dropped, as the rings
+                                   of the next stage were full or the send
+                                   failed. */
+};
+OFP_ASSERT(sizeof(struct openflow_ext_stage) == 32);
+
+/* Body of OFP_EXT_STAGE_STATS_REPLY, followed by one openflow_ext_stage
+ * per stage with threads; none if the main thread does all the work. The
+ * request has no body. */
+struct openflow_ext_stage_stats {
+    struct ofp_extension_header header;
+    struct openflow_ext_stage stages[0];
+};
+OFP_ASSERT(sizeof(struct openflow_ext_stage_stats) == 16);
+
+/* Counters of the packet pool of a thread. */
+struct openflow_ext_packet_pool {
+    char     name[16];          /* Thread of the pool, null terminated. */
+    uint32_t size;              /* Packet objects the pool allocated. */
+    uint32_t free;              /* Objects ready for new packets. */
+    uint32_t high_water;        /* Most objects in use at once. */
+    uint8_t  pad[4];
+    uint64_t packets;           /* Packets created out of the pool. */
+};
+OFP_ASSERT(sizeof(struct openflow_ext_packet_pool) == 40);
+
+/* Body of OFP_EXT_PACKET_POOL_STATS_REPLY, followed by one
+ * openflow_ext_packet_pool per thread which created packets. The request has
+ * no body. */
+struct openflow_ext_packet_pool_stats {
+    struct ofp_extension_header header;
+    struct openflow_ext_packet_pool pools[0];
+};
+OFP_ASSERT(sizeof(struct openflow_ext_packet_pool_stats) == 16);
+
+/* Experimenter multipart types, in the exp_type of the
+ * ofp_experimenter_multipart_header of an OPENFLOW_VENDOR_ID request or
+ * reply. */
+enum openflow_ext_multipart_types {
+    OFP_EXT_MP_TABLE_LOOKUP_STATS  /* Lookup cost counters of the flow tables */
+};
+
+/* Buckets of the histograms of openflow_ext_table_lookup_stats. */
+#define OFP_EXT_LOOKUP_PROBE_BUCKETS 16
+#define OFP_EXT_LOOKUP_CYCLE_BUCKETS 32
+
+/* Body of an OFP_EXT_MP_TABLE_LOOKUP_STATS request. */
+struct openflow_ext_table_lookup_stats_request {
+    struct ofp_experimenter_multipart_header header;
+    uint8_t  table_id;          /* ID of table to read, or OFPTT_ALL. */
+    uint8_t  pad[7];
+};
+OFP_ASSERT(sizeof(struct openflow_ext_table_lookup_stats_request) == 16);
+
+/* Lookup cost counters of a flow table. A probe is a classifier subtable,
+ * a longest prefix match trie node or an exact match slot looked into.
+ * Bucket i of a histogram counts the values v with 2^(i-1) < v <= 2^i,
+ * bucket 0 those up to 1, and the last bucket also the values above its
+ * range. */
+struct openflow_ext_table_lookup_stats {
+    uint8_t  table_id;
+    uint8_t  mode;              /* Lookup structure in use,
+                                   OFP_EXT_TABLE_MODE_*. */
+    uint8_t  pad[6];
+    uint64_t lookups;           /* Number of lookups counted. */
+    uint64_t hits;              /* Number of lookups which found an entry. */
+    uint64_t probes;            /* Probes of all lookups. */
+    uint64_t cycles;            /* CPU cycles spent in all lookups. */
+    uint64_t probe_hits[OFP_EXT_LOOKUP_PROBE_BUCKETS]; /* Hits by the number
+                                                          of probes made. */
+    uint64_t cycles_hist[OFP_EXT_LOOKUP_CYCLE_BUCKETS]; /* Lookups by the
+                                                           cycles spent. */
+    uint64_t reorders;          /* Reorderings of the table by hits which
+                                   changed its lookup. */
+    uint64_t before_lookups;    /* Lookups between the two last
+                                   reorderings. */
+    uint64_t before_probes;     /* Probes of these lookups. */
+    uint64_t after_lookups;     /* Lookups since the last reordering. */
+    uint64_t after_probes;      /* Probes of these lookups. */
+};
+OFP_ASSERT(sizeof(struct openflow_ext_table_lookup_stats) == 464);
+
+/* Body of an OFP_EXT_MP_TABLE_LOOKUP_STATS reply, followed by one
+ * openflow_ext_table_lookup_stats for the table asked for, or for each
+ * table looked up in if OFPTT_ALL. The counters are kept only when the
+ * datapath is started with --lookup-stats; otherwise no table is in the
+ * reply. */
+struct openflow_ext_table_lookup_stats_reply {
+    struct ofp_experimenter_multipart_header header;
+    struct openflow_ext_table_lookup_stats tables[0];
+};
+OFP_ASSERT(sizeof(struct openflow_ext_table_lookup_stats_reply) == 8);
+
 #define ofq_error_string(rv) (((rv) < OFQ_ERR_COUNT) && ((rv) >= 0) ? \
     openflow_queue_error_strings[rv] : "Unknown error code")
 
@@ -53,10 +53,14 @@ lib_libopenflow_a_SOURCES = \
 	lib/process.h \
 	lib/queue.c \
 	lib/queue.h \
+	lib/rcu.c \
+	lib/rcu.h \
 	lib/random.c \
 	lib/random.h \
 	lib/rconn.c \
 	lib/rconn.h \
+	lib/ring.c \
+	lib/ring.h \
 	lib/sat-math.h \
 	lib/shash.c \
 	lib/shash.h \
@@ -74,12 +74,17 @@
 #include <linux/rtnetlink.h>
 #include <linux/if_tun.h>
 #include <linux/if_packet.h>
+#include <linux/filter.h>
 
 
 #ifdef PACKET_AUXDATA
 #   define HAVE_PACKET_AUXDATA
 #endif
 
+#ifndef PACKET_FANOUT_FLAG_IGNORE_OUTGOING
+#   define PACKET_FANOUT_FLAG_IGNORE_OUTGOING 0x4000
+#endif
+
 /* Fix for some compile issues we were experiencing when setting up openwrt
  * with the 2.4 kernel. linux/ethtool.h seems to use kernel-style inttypes,
  * which breaks in userspace.
@@ -179,6 +184,8 @@ static int af_inet_sock = -1;
 static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(5, 20);
 
 static void init_netdev(void);
+static int recv_fd(struct netdev *, int fd, struct ofpbuf *, size_t max_mtu);
+static int send_fd(struct netdev *, int fd, const struct ofpbuf *);
 static int do_open_netdev(const char *name, int ethertype, int tap_fd,
                           struct netdev **netdev_);
 static int restore_flags(struct netdev *netdev);
@@ -981,13 +988,21 @@ netdev_link_state(struct netdev *netdev)
  */
 int
 netdev_recv(struct netdev *netdev, struct ofpbuf *buffer, size_t max_mtu)
+{
+    return recv_fd(netdev, netdev->tap_fd, buffer, max_mtu);
+}
+
+/* Receives a packet of 'netdev' from 'fd', which is either the tap or
+ * network device of 'netdev' or a socket opened by netdev_fanout_open(). */
+static int
+recv_fd(struct netdev *netdev, int fd, struct ofpbuf *buffer, size_t max_mtu)
 {
 #ifdef HAVE_PACKET_AUXDATA
     /* Code from libpcap to reconstruct VLAN header */
     struct iovec    iov;
     struct cmsghdr    *cmsg;
     struct msghdr     msg;
-    struct sockaddr   from;
+    struct sockaddr_ll from;
     union {
       struct cmsghdr  cmsg;
       char    buf[CMSG_SPACE(sizeof(struct tpacket_auxdata))];
@@ -1004,6 +1019,7 @@ netdev_recv(struct netdev *netdev, struct ofpbuf *buffer, size_t max_mtu)
 #ifdef HAVE_PACKET_AUXDATA
     /* Code from libpcap to reconstruct VLAN header */
     memset(&msg, 0, sizeof(struct msghdr));
+    memset(&from, 0, sizeof from);
     memset(cmsg_buf.buf, 0, CMSG_SPACE(sizeof(struct tpacket_auxdata)));
 
     msg.msg_name    = &from;
@@ -1024,9 +1040,9 @@ netdev_recv(struct netdev *netdev, struct ofpbuf *buffer, size_t max_mtu)
 #endif
 
     /* cannot execute recvfrom over a tap device */
-    if (!strncmp(netdev->name, "tap", 3)) {
+    if (fd == netdev->tap_fd && !strncmp(netdev->name, "tap", 3)) {
         do {
-            n_bytes = read(netdev->tap_fd, ofpbuf_tail(buffer),
+            n_bytes = read(fd, ofpbuf_tail(buffer),
                            (ssize_t)ofpbuf_tailroom(buffer));
         } while (n_bytes < 0 && errno == EINTR);
     }
@@ -1034,9 +1050,9 @@ netdev_recv(struct netdev *netdev, struct ofpbuf *buffer, size_t max_mtu)
         do {
 #ifdef HAVE_PACKET_AUXDATA
             /* Code from libpcap to reconstruct VLAN header */
-            n_bytes = recvmsg(netdev->tap_fd, &msg, 0);
+            n_bytes = recvmsg(fd, &msg, 0);
 #else
-            n_bytes = recvfrom(netdev->tap_fd, ofpbuf_tail(buffer),
+            n_bytes = recvfrom(fd, ofpbuf_tail(buffer),
                                (ssize_t)ofpbuf_tailroom(buffer), 0,
                                (struct sockaddr *)&sll, &sll_len);
 #endif /* ifdef HAVE_PACKET_AUXDATA  */
@@ -1051,6 +1067,11 @@ netdev_recv(struct netdev *netdev, struct ofpbuf *buffer, size_t max_mtu)
     } else {
 
 #ifdef HAVE_PACKET_AUXDATA
+            /* Other sockets of the interface (queues, fanout sockets)
+             * see what this one sends, and the other way round. */
+            if (from.sll_pkttype == PACKET_OUTGOING) {
+                return EAGAIN;
+            }
             /* Code from libpcap to reconstruct VLAN header */
             for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
                 struct tpacket_auxdata *aux;
@@ -1140,12 +1161,19 @@ int
 netdev_send(struct netdev *netdev, const struct ofpbuf *buffer,
             uint16_t class_id)
 {
-    ssize_t n_bytes;
-
     assert(class_id <= NETDEV_MAX_QUEUES);
 
+    return send_fd(netdev, netdev->queue_fd[class_id], buffer);
+}
+
+/* Sends 'buffer' on 'fd', a socket or the tap device of 'netdev'. */
+static int
+send_fd(struct netdev *netdev, int fd, const struct ofpbuf *buffer)
+{
+    ssize_t n_bytes;
+
     do {
-        n_bytes = write(netdev->queue_fd[class_id], buffer->data, buffer->size);
+        n_bytes = write(fd, buffer->data, buffer->size);
     } while (n_bytes < 0 && errno == EINTR);
     if (n_bytes < 0) {
         /* The Linux AF_PACKET implementation never blocks waiting for room
@@ -1186,6 +1214,151 @@ netdev_send_wait(struct netdev *netdev)
     }
 }
 
+/* Opens in '*fdp' a non-blocking socket which receives from and sends on
+ * 'netdev', as a member of the PACKET_FANOUT group '*group_id' of the
+ * device: the kernel hands each packet the device receives to one member
+ * of the group only, chosen by a hash of its flow, so that the packets of
+ * a flow all go to the same socket.  Packets sent on a member of the group
+ * are not received back by the group.  If '*group_id' is 0, a new group
+ * is created and its id stored in '*group_id'.  Tap devices do not
+ * support fanout.
+ *
+ * Returns 0 if successful, otherwise a positive errno value. */
+int
+netdev_fanout_open(const struct netdev *netdev, uint16_t *group_id, int *fdp)
+{
+#ifdef PACKET_FANOUT_FLAG_UNIQUEID
+    struct sockaddr_ll sll;
+    uint32_t type, val;
+    int error;
+    int fd;
+
+    *fdp = -1;
+    if (netdev->tap_fd != netdev->netdev_fd) {
+        return EOPNOTSUPP;
+    }
+
+    fd = socket(PF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+    if (fd < 0) {
+        return errno;
+    }
+#ifdef HAVE_PACKET_AUXDATA
+    val = 1;
+    if (setsockopt(fd, SOL_PACKET, PACKET_AUXDATA, &val, sizeof val) == -1
+        && errno != ENOPROTOOPT) {
+        VLOG_ERR(LOG_MODULE, "setsockopt(PACKET_AUXDATA) on %s: %s",
+                 netdev->name, strerror(errno));
+    }
+#endif
+
+    error = set_nonblocking(fd);
+    if (error) {
+        goto error_already_set;
+    }
+
+    memset(&sll, 0, sizeof sll);
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(ETH_P_ALL);
+    sll.sll_ifindex = netdev->ifindex;
+    if (bind(fd, (struct sockaddr *) &sll, sizeof sll) < 0) {
+        VLOG_ERR(LOG_MODULE, "bind to %s failed: %s", netdev->name, strerror(errno));
+        goto error;
+    }
+
+    /* The group does not receive what is sent on the device, if the kernel
+     * supports it; otherwise recv_fd() skips these packets. */
+    type = PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG;
+    if (*group_id == 0) {
+        type |= PACKET_FANOUT_FLAG_UNIQUEID;
+    }
+    val = *group_id | ((type | PACKET_FANOUT_FLAG_IGNORE_OUTGOING) << 16);
+    if (setsockopt(fd, SOL_PACKET, PACKET_FANOUT, &val, sizeof val) < 0) {
+        val = *group_id | (type << 16);
+        if (setsockopt(fd, SOL_PACKET, PACKET_FANOUT, &val, sizeof val) < 0) {
+            VLOG_ERR(LOG_MODULE, "setsockopt(PACKET_FANOUT) on %s failed: %s",
+                     netdev->name, strerror(errno));
+            goto error;
+        }
+    }
+    if (*group_id == 0) {
+        socklen_t len = sizeof val;
+
+        if (getsockopt(fd, SOL_PACKET, PACKET_FANOUT, &val, &len) < 0) {
+            goto error;
+        }
+        *group_id = val & 0xffff;
+    }
+
+    /* Packets of all devices may have been queued before the bind(). */
+    error = drain_rcvbuf(fd);
+    if (error) {
+        goto error_already_set;
+    }
+
+    *fdp = fd;
+    return 0;
+
+ error:
+    error = errno;
+ error_already_set:
+    close(fd);
+    return error;
+#else
+    *fdp = -1;
+    return EOPNOTSUPP;
+#endif
+}
+
+/* Attempts to receive a packet of 'netdev' from 'fd', a socket opened by
+ * netdev_fanout_open(), as netdev_recv() does. */
+int
+netdev_fanout_recv(struct netdev *netdev, int fd, struct ofpbuf *buffer,
+                   size_t max_mtu)
+{
+    return recv_fd(netdev, fd, buffer, max_mtu);
+}
+
+/* Sends 'buffer' on 'netdev' through 'fd', a socket opened by
+ * netdev_fanout_open(), as netdev_send() does to the default queue. */
+int
+netdev_fanout_send(struct netdev *netdev, int fd, const struct ofpbuf *buffer)
+{
+    return send_fd(netdev, fd, buffer);
+}
+
+/* Makes the network device socket of 'netdev' discard the packets it
+ * receives if 'discard' is true, for when fanout sockets receive them
+ * instead, or receive them again if 'discard' is false.  Sending on the
+ * device is not affected.  Returns 0 if successful, otherwise a positive
+ * errno value. */
+int
+netdev_set_recv_discard(struct netdev *netdev, bool discard)
+{
+    if (netdev->tap_fd != netdev->netdev_fd) {
+        return EOPNOTSUPP;
+    }
+    if (discard) {
+        static struct sock_filter drop_all[] = {
+            { BPF_RET | BPF_K, 0, 0, 0 },
+        };
+        struct sock_fprog prog = { ARRAY_SIZE(drop_all), drop_all };
+
+        if (setsockopt(netdev->netdev_fd, SOL_SOCKET, SO_ATTACH_FILTER,
+                       &prog, sizeof prog) < 0) {
+            return errno;
+        }
+        return drain_rcvbuf(netdev->netdev_fd);
+    } else {
+        int dummy = 0;
+
+        if (setsockopt(netdev->netdev_fd, SOL_SOCKET, SO_DETACH_FILTER,
+                       &dummy, sizeof dummy) < 0) {
+            return errno;
+        }
+        return 0;
+    }
+}
+
 /* Attempts to set 'netdev''s MAC address to 'mac'.  Returns 0 if successful,
  * otherwise a positive errno value. */
 int
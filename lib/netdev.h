@@ -90,6 +90,10 @@ int netdev_link_state(struct netdev *netdev);
 int netdev_drain(struct netdev *);
 int netdev_send(struct netdev *, const struct ofpbuf *, uint16_t class_id);
 void netdev_send_wait(struct netdev *);
+int netdev_fanout_open(const struct netdev *, uint16_t *group_id, int *fdp);
+int netdev_fanout_recv(struct netdev *, int fd, struct ofpbuf *, size_t);
+int netdev_fanout_send(struct netdev *, int fd, const struct ofpbuf *);
+int netdev_set_recv_discard(struct netdev *, bool discard);
 int netdev_set_etheraddr(struct netdev *, const uint8_t mac[6]);
 const uint8_t *netdev_get_etheraddr(const struct netdev *);
 const char *netdev_get_name(const struct netdev *);
@@ -0,0 +1,201 @@
+/* Copyright (c) 2012, CPqD, Brazil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <config.h>
+#include "rcu.h"
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include "list.h"
+#include "util.h"
+
+/* Sequence number of a thread in an extended quiescent state, which grace
+ * periods do not wait for. */
+#define RCU_QUIESCENT UINT64_MAX
+
+struct rcu_thread {
+    struct list node;        /* in 'threads'. */
+    uint64_t    seq;         /* 'global_seq' when the thread last quiesced. */
+    struct list callbacks;   /* postponed callbacks, oldest first. */
+};
+
+struct rcu_callback {
+    struct list node;        /* in the rcu_thread's callbacks. */
+    void      (*function)(void *aux);
+    void       *aux;
+    uint64_t    seq;         /* grace period the callback waits for. */
+};
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct list threads = LIST_INITIALIZER(&threads); /* under 'mutex'. */
+
+/* Number of the last grace period started. */
+static uint64_t global_seq = 1;
+
+static __thread struct rcu_thread *self;
+
+/* Returns the number of the last grace period all registered threads have
+ * passed a quiescent state in. */
+static uint64_t
+min_seq(void)
+{
+    struct rcu_thread *t;
+    uint64_t min = RCU_QUIESCENT;
+
+    pthread_mutex_lock(&mutex);
+    LIST_FOR_EACH (t, struct rcu_thread, node, &threads) {
+        uint64_t seq = __atomic_load_n(&t->seq, __ATOMIC_ACQUIRE);
+
+        if (seq < min) {
+            min = seq;
+        }
+    }
+    pthread_mutex_unlock(&mutex);
+    return min;
+}
+
+static void
+set_seq(uint64_t seq)
+{
+    __atomic_store_n(&self->seq, seq, __ATOMIC_SEQ_CST);
+}
+
+static uint64_t
+current_seq(void)
+{
+    return __atomic_load_n(&global_seq, __ATOMIC_SEQ_CST);
+}
+
+/* Runs the callbacks of the calling thread whose grace period has elapsed.
+ * Callbacks may postpone further ones. */
+static void
+run_callbacks(void)
+{
+    uint64_t min = min_seq();
+
+    while (!list_is_empty(&self->callbacks)) {
+        struct rcu_callback *cb = CONTAINER_OF(list_front(&self->callbacks),
+                                               struct rcu_callback, node);
+        if (cb->seq > min) {
+            break;
+        }
+        list_remove(&cb->node);
+        cb->function(cb->aux);
+        free(cb);
+    }
+}
+
+void
+rcu_register_thread(void)
+{
+    assert(self == NULL);
+    self = xmalloc(sizeof *self);
+    self->seq = current_seq();
+    list_init(&self->callbacks);
+
+    pthread_mutex_lock(&mutex);
+    list_push_back(&threads, &self->node);
+    pthread_mutex_unlock(&mutex);
+}
+
+void
+rcu_unregister_thread(void)
+{
+    assert(self != NULL);
+    while (!list_is_empty(&self->callbacks)) {
+        rcu_synchronize();
+        run_callbacks();
+    }
+
+    pthread_mutex_lock(&mutex);
+    list_remove(&self->node);
+    pthread_mutex_unlock(&mutex);
+    free(self);
+    self = NULL;
+}
+
+void
+rcu_quiesce(void)
+{
+    set_seq(current_seq());
+    if (!list_is_empty(&self->callbacks)) {
+        run_callbacks();
+    }
+}
+
+void
+rcu_quiesce_start(void)
+{
+    set_seq(RCU_QUIESCENT);
+}
+
+void
+rcu_quiesce_end(void)
+{
+    set_seq(current_seq());
+}
+
+void
+rcu_postpone(void (*function)(void *aux), void *aux)
+{
+    struct rcu_callback *cb = xmalloc(sizeof *cb);
+
+    assert(self != NULL);
+    cb->function = function;
+    cb->aux = aux;
+    cb->seq = rcu_grace_start();
+    list_push_back(&self->callbacks, &cb->node);
+}
+
+uint64_t
+rcu_grace_start(void)
+{
+    return __atomic_add_fetch(&global_seq, 1, __ATOMIC_SEQ_CST);
+}
+
+bool
+rcu_grace_done(uint64_t seq)
+{
+    return min_seq() >= seq;
+}
+
+void
+rcu_synchronize(void)
+{
+    uint64_t seq = rcu_grace_start();
+
+    if (self != NULL && self->seq != RCU_QUIESCENT) {
+        set_seq(seq);
+    }
+    while (!rcu_grace_done(seq)) {
+        sched_yield();
+    }
+}
@@ -0,0 +1,92 @@
+/* Copyright (c) 2012, CPqD, Brazil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef RCU_H
+#define RCU_H 1
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Quiescent state based read-copy-update.
+ *
+ * Data read by the forwarding path is published through a pointer, which
+ * readers load with rcu_get() and use without taking any lock.  A writer
+ * never changes published data in place: it builds a new version, stores
+ * its pointer with rcu_set(), and hands the old version to rcu_postpone(),
+ * which frees it once no reader may still hold it.
+ *
+ * A reader may hold pointers it loaded until it calls rcu_quiesce(), which
+ * each registered thread does regularly, between units of work (the
+ * datapath's main loop does it once per iteration).  A grace period has
+ * elapsed once every registered thread has passed through such a
+ * quiescent state; threads about to block for a while should bracket the
+ * wait with rcu_quiesce_start() and rcu_quiesce_end(), so that they do not
+ * hold grace periods back meanwhile.
+ *
+ * Postponed callbacks run in the thread which postponed them, from one of
+ * its later calls to rcu_quiesce(), so they may touch data owned by that
+ * thread without further locking. */
+
+/* Loads an RCU protected pointer, in a reader. */
+#define rcu_get(PTR) __atomic_load_n(&(PTR), __ATOMIC_ACQUIRE)
+
+/* Publishes a new value of an RCU protected pointer, in the writer. */
+#define rcu_set(PTR, VALUE) __atomic_store_n(&(PTR), (VALUE), __ATOMIC_RELEASE)
+
+/* Makes the calling thread a reader which grace periods wait for, until
+ * rcu_unregister_thread(). */
+void rcu_register_thread(void);
+void rcu_unregister_thread(void);
+
+/* Reports that the calling thread holds no pointer it loaded with
+ * rcu_get(), and runs the callbacks it postponed whose grace period has
+ * elapsed. */
+void rcu_quiesce(void);
+
+/* Marks the calling thread quiescent until rcu_quiesce_end(). */
+void rcu_quiesce_start(void);
+void rcu_quiesce_end(void);
+
+/* Runs function(aux) in the calling thread once a grace period has
+ * elapsed. */
+void rcu_postpone(void (*function)(void *aux), void *aux);
+
+/* Starts a grace period and returns a number identifying it, to be passed
+ * to rcu_grace_done(). */
+uint64_t rcu_grace_start(void);
+
+/* Returns true if the grace period 'seq' has elapsed. */
+bool rcu_grace_done(uint64_t seq);
+
+/* Waits until a grace period started now has elapsed.  The calling thread
+ * must hold no pointer it loaded with rcu_get(). */
+void rcu_synchronize(void);
+
+#endif /* rcu.h */
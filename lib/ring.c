@@ -0,0 +1,346 @@
+/* Copyright (c) 2012, CPqD, Brazil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include <config.h>
+#include "ring.h"
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include "poll-loop.h"
+#include "util.h"
+
+#define CACHE_LINE_SIZE 64
+
+struct ring_slot {
+    uint64_t seq;       /* turn the slot waits for: its position for the
+                         * producer, its position + 1 for the consumer
+                         * (unused in a RING_SPSC ring). */
+    void    *data;
+};
+
+struct ring {
+    /* Written by the producers. */
+    uint64_t head __attribute__((aligned(CACHE_LINE_SIZE)));
+                        /* next position to enqueue at. */
+    uint64_t tail_cache;
+                        /* RING_SPSC: 'tail' as the producer last saw it. */
+
+    /* Written by the consumers. */
+    uint64_t tail __attribute__((aligned(CACHE_LINE_SIZE)));
+                        /* next position to dequeue from. */
+    uint64_t head_cache;
+                        /* RING_SPSC: 'head' as the consumer last saw it. */
+
+    /* Written by both sides, only in a RING_BLOCKING ring. */
+    bool armed __attribute__((aligned(CACHE_LINE_SIZE)));
+                        /* a consumer waits for the next enqueue. */
+
+    uint64_t mask __attribute__((aligned(CACHE_LINE_SIZE)));
+                        /* capacity - 1. */
+    int flags;          /* RING_*. */
+    int fd;             /* RING_BLOCKING: eventfd, or -1. */
+    struct ring_slot *slots;
+};
+
+struct ring *
+ring_create(size_t capacity, int flags)
+{
+    struct ring *ring;
+    void *p;
+    size_t n, i;
+
+    n = 1;
+    while (n < capacity) {
+        n <<= 1;
+    }
+    if (posix_memalign(&p, CACHE_LINE_SIZE, sizeof *ring)) {
+        out_of_memory();
+    }
+    ring = p;
+    ring->head = ring->tail_cache = 0;
+    ring->tail = ring->head_cache = 0;
+    ring->armed = false;
+    ring->mask = n - 1;
+    ring->flags = flags;
+    ring->fd = -1;
+    if (flags & RING_BLOCKING) {
+        ring->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (ring->fd < 0) {
+            ofp_fatal(errno, "eventfd failed");
+        }
+    }
+    ring->slots = xmalloc(n * sizeof *ring->slots);
+    for (i = 0; i < n; i++) {
+        ring->slots[i].seq = i;
+        ring->slots[i].data = NULL;
+    }
+    return ring;
+}
+
+void
+ring_destroy(struct ring *ring)
+{
+    if (ring != NULL) {
+        if (ring->fd >= 0) {
+            close(ring->fd);
+        }
+        free(ring->slots);
+        free(ring);
+    }
+}
+
+/* Wakes up the consumer waiting for 'ring', if any, after an enqueue. */
+static void
+notify(struct ring *ring)
+{
+    /* Pairs with the fence of ring_arm(): either the consumer sees the
+     * pointers enqueued, or the producer sees it armed. */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->armed, __ATOMIC_RELAXED)
+        && __atomic_exchange_n(&ring->armed, false, __ATOMIC_RELAXED)) {
+        uint64_t one = 1;
+
+        if (write(ring->fd, &one, sizeof one) != sizeof one) {
+            ofp_error(errno, "eventfd write failed");
+        }
+    }
+}
+
+static size_t
+spsc_enqueue(struct ring *ring, void *const *objs, size_t n)
+{
+    uint64_t head = ring->head;
+    uint64_t room = ring->mask + 1 - (head - ring->tail_cache);
+    size_t i;
+
+    if (room < n) {
+        ring->tail_cache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        room = ring->mask + 1 - (head - ring->tail_cache);
+        n = MIN(n, room);
+    }
+    for (i = 0; i < n; i++) {
+        ring->slots[(head + i) & ring->mask].data = objs[i];
+    }
+    __atomic_store_n(&ring->head, head + n, __ATOMIC_RELEASE);
+    return n;
+}
+
+static size_t
+spsc_dequeue(struct ring *ring, void **objs, size_t n)
+{
+    uint64_t tail = ring->tail;
+    uint64_t avail = ring->head_cache - tail;
+    size_t i;
+
+    if (avail < n) {
+        ring->head_cache = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        avail = ring->head_cache - tail;
+        n = MIN(n, avail);
+    }
+    for (i = 0; i < n; i++) {
+        objs[i] = ring->slots[(tail + i) & ring->mask].data;
+    }
+    __atomic_store_n(&ring->tail, tail + n, __ATOMIC_RELEASE);
+    return n;
+}
+
+static size_t
+mpmc_enqueue(struct ring *ring, void *const *objs, size_t n)
+{
+    uint64_t pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    size_t i, k;
+
+    for (;;) {
+        /* Count the free slots from 'pos' on.  No other producer can take
+         * them if the head is still at 'pos' when claiming them. */
+        for (k = 0; k < n; k++) {
+            struct ring_slot *slot = &ring->slots[(pos + k) & ring->mask];
+
+            if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos + k) {
+                break;
+            }
+        }
+        if (k == 0) {
+            struct ring_slot *slot = &ring->slots[pos & ring->mask];
+            uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+            int64_t diff = (int64_t) (seq - pos);
+
+            if (diff < 0) {
+                /* The slot still holds the pointer of the previous lap. */
+                return 0;
+            }
+            /* Another producer took the turn. */
+            pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+            continue;
+        }
+        /* On failure 'pos' is reloaded with the current head. */
+        if (__atomic_compare_exchange_n(&ring->head, &pos, pos + k, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+
+    for (i = 0; i < k; i++) {
+        struct ring_slot *slot = &ring->slots[(pos + i) & ring->mask];
+
+        slot->data = objs[i];
+        __atomic_store_n(&slot->seq, pos + i + 1, __ATOMIC_RELEASE);
+    }
+    return k;
+}
+
+static size_t
+mpmc_dequeue(struct ring *ring, void **objs, size_t n)
+{
+    uint64_t pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    size_t i, k;
+
+    for (;;) {
+        for (k = 0; k < n; k++) {
+            struct ring_slot *slot = &ring->slots[(pos + k) & ring->mask];
+
+            if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos + k + 1) {
+                break;
+            }
+        }
+        if (k == 0) {
+            struct ring_slot *slot = &ring->slots[pos & ring->mask];
+            uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+            int64_t diff = (int64_t) (seq - (pos + 1));
+
+            if (diff < 0) {
+                /* Nothing enqueued at this position yet. */
+                return 0;
+            }
+            pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+            continue;
+        }
+        if (__atomic_compare_exchange_n(&ring->tail, &pos, pos + k, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+
+    for (i = 0; i < k; i++) {
+        struct ring_slot *slot = &ring->slots[(pos + i) & ring->mask];
+
+        objs[i] = slot->data;
+        /* Free the slot for the producer of the next lap. */
+        __atomic_store_n(&slot->seq, pos + i + ring->mask + 1,
+                         __ATOMIC_RELEASE);
+    }
+    return k;
+}
+
+size_t
+ring_enqueue_burst(struct ring *ring, void *const *objs, size_t n)
+{
+    size_t done = (ring->flags & RING_SPSC ? spsc_enqueue(ring, objs, n)
+                                           : mpmc_enqueue(ring, objs, n));
+
+    if (done > 0 && ring->fd >= 0) {
+        notify(ring);
+    }
+    return done;
+}
+
+size_t
+ring_dequeue_burst(struct ring *ring, void **objs, size_t n)
+{
+    return (ring->flags & RING_SPSC ? spsc_dequeue(ring, objs, n)
+                                    : mpmc_dequeue(ring, objs, n));
+}
+
+bool
+ring_enqueue(struct ring *ring, void *data)
+{
+    assert(data != NULL);
+    return ring_enqueue_burst(ring, &data, 1) == 1;
+}
+
+void *
+ring_dequeue(struct ring *ring)
+{
+    void *data;
+
+    return ring_dequeue_burst(ring, &data, 1) == 1 ? data : NULL;
+}
+
+size_t
+ring_count(const struct ring *ring)
+{
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+
+    return head > tail ? MIN(head - tail, ring->mask + 1) : 0;
+}
+
+size_t
+ring_capacity(const struct ring *ring)
+{
+    return ring->mask + 1;
+}
+
+int
+ring_fd(const struct ring *ring)
+{
+    return ring->fd;
+}
+
+bool
+ring_arm(struct ring *ring)
+{
+    uint64_t count;
+
+    assert(ring->fd >= 0);
+
+    /* Clear a wakeup left over from an enqueue seen already. */
+    if (read(ring->fd, &count, sizeof count) < 0 && errno != EAGAIN) {
+        ofp_error(errno, "eventfd read failed");
+    }
+
+    __atomic_store_n(&ring->armed, true, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return ring_count(ring) == 0;
+}
+
+void
+ring_wait(struct ring *ring)
+{
+    if (ring_arm(ring)) {
+        poll_fd_wait(ring->fd, POLLIN);
+    } else {
+        poll_immediate_wake();
+    }
+}
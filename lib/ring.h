@@ -0,0 +1,100 @@
+/* Copyright (c) 2012, CPqD, Brazil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#ifndef RING_H
+#define RING_H 1
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Bounded lock-free ring of pointers, for handing packets from thread to
+ * thread.
+ *
+ * By default any number of threads may enqueue and dequeue at the same
+ * time.  Each slot carries a sequence number which tells whether it is free
+ * for the producer of its turn or full for the consumer of its turn; a
+ * thread claims one or more turns by advancing the head (producers) or the
+ * tail (consumers) with a compare-and-swap, and then publishes the slots by
+ * storing their next sequence numbers.  A ring created with RING_SPSC
+ * serves one producer and one consumer thread instead, which just load the
+ * index of the other side, and only when the copy they cached does not
+ * show enough room or pointers.  The head and the tail live in cache lines
+ * of their own, so that producers and consumers do not steal each other's
+ * lines.
+ *
+ * A consumer of a ring created with RING_BLOCKING may wait for pointers:
+ * the ring has an eventfd, which the first enqueue after ring_arm() makes
+ * readable.  ring_wait() does so for poll_block(); threads with their own
+ * poll() loop call ring_arm() and poll ring_fd().  Producers of other rings
+ * never make system calls. */
+
+/* Flags of ring_create(). */
+enum {
+    RING_SPSC     = 1 << 0,     /* one producer and one consumer thread. */
+    RING_BLOCKING = 1 << 1      /* consumers may wait for pointers. */
+};
+
+struct ring;
+
+/* Creates a ring holding at least 'capacity' pointers (rounded up to a
+ * power of 2), with the given RING_* flags. */
+struct ring *ring_create(size_t capacity, int flags);
+void ring_destroy(struct ring *);
+
+/* Appends 'data', which must not be null, to the ring.  Returns false,
+ * leaving the ring untouched, if it is full. */
+bool ring_enqueue(struct ring *, void *data);
+
+/* Removes and returns the oldest pointer of the ring, or null if it is
+ * empty. */
+void *ring_dequeue(struct ring *);
+
+/* Appends as many of the 'n' pointers of 'objs' as there is room for, in
+ * order, and returns how many. */
+size_t ring_enqueue_burst(struct ring *, void *const *objs, size_t n);
+
+/* Removes up to 'n' of the oldest pointers of the ring into 'objs', and
+ * returns how many. */
+size_t ring_dequeue_burst(struct ring *, void **objs, size_t n);
+
+/* Returns the number of pointers in the ring, which may be stale by the time
+ * it returns if other threads use the ring. */
+size_t ring_count(const struct ring *);
+size_t ring_capacity(const struct ring *);
+
+/* Waiting for a RING_BLOCKING ring.  ring_arm() returns false if the ring
+ * holds pointers already; otherwise the fd returned by ring_fd() becomes
+ * readable once a pointer is enqueued.  ring_wait() makes the next
+ * poll_block() wake up when the ring holds pointers. */
+int ring_fd(const struct ring *);
+bool ring_arm(struct ring *);
+void ring_wait(struct ring *);
+
+#endif /* ring.h */
@@ -38,6 +38,7 @@
 #include "ofl-exp-openflow.h"
 #include "../oflib/ofl-log.h"
 #include "../oflib/ofl-print.h"
+#include "../oflib/ofl-utils.h"
 
 #define LOG_MODULE ofl_exp_of
 OFL_LOG_INIT(LOG_MODULE)
@@ -78,6 +79,176 @@ ofl_exp_openflow_msg_pack(struct ofl_msg_experimenter *msg, uint8_t **buf, size_
 
                 return 0;
             }
+            case (OFP_EXT_FLOW_CACHE_STATS_REQUEST):
+            case (OFP_EXT_TABLE_MEMORY_REQUEST):
+            case (OFP_EXT_STAGE_STATS_REQUEST):
+            case (OFP_EXT_PACKET_POOL_STATS_REQUEST): {
+                struct ofp_extension_header *ofp;
+
+                *buf_len  = sizeof(struct ofp_extension_header);
+                *buf     = (uint8_t *)malloc(*buf_len);
+
+                ofp = (struct ofp_extension_header *)(*buf);
+                ofp->vendor  = htonl(exp->header.experimenter_id);
+                ofp->subtype = htonl(exp->type);
+
+                return 0;
+            }
+            case (OFP_EXT_FLOW_CACHE_STATS_REPLY): {
+                struct ofl_exp_openflow_msg_flow_cache_stats *s = (struct ofl_exp_openflow_msg_flow_cache_stats *)exp;
+                struct openflow_ext_flow_cache_stats *ofp;
+
+                *buf_len  = sizeof(struct openflow_ext_flow_cache_stats);
+                *buf     = (uint8_t *)malloc(*buf_len);
+
+                ofp = (struct openflow_ext_flow_cache_stats *)(*buf);
+                ofp->header.vendor  = htonl(exp->header.experimenter_id);
+                ofp->header.subtype = htonl(exp->type);
+                ofp->size           = htonl(s->size);
+                ofp->used           = htonl(s->used);
+                ofp->hits           = hton64(s->hits);
+                ofp->misses         = hton64(s->misses);
+                ofp->evictions      = hton64(s->evictions);
+                ofp->invalidations  = hton64(s->invalidations);
+                ofp->megaflow_size      = htonl(s->megaflow_size);
+                ofp->megaflow_used      = htonl(s->megaflow_used);
+                ofp->megaflow_hits      = hton64(s->megaflow_hits);
+                ofp->megaflow_misses    = hton64(s->megaflow_misses);
+                ofp->megaflow_evictions = hton64(s->megaflow_evictions);
+                ofp->megaflow_expired   = hton64(s->megaflow_expired);
+                ofp->megaflow_stale     = hton64(s->megaflow_stale);
+
+                return 0;
+            }
+            case (OFP_EXT_TABLE_MEMORY_REPLY): {
+                struct ofl_exp_openflow_msg_table_memory *s = (struct ofl_exp_openflow_msg_table_memory *)exp;
+                struct openflow_ext_table_memory_stats *ofp;
+                size_t i;
+
+                *buf_len  = sizeof(struct openflow_ext_table_memory_stats) +
+                            s->tables_num * sizeof(struct openflow_ext_table_memory);
+                *buf     = (uint8_t *)malloc(*buf_len);
+
+                ofp = (struct openflow_ext_table_memory_stats *)(*buf);
+                ofp->header.vendor  = htonl(exp->header.experimenter_id);
+                ofp->header.subtype = htonl(exp->type);
+                ofp->budget         = hton64(s->budget);
+                ofp->memory         = hton64(s->memory);
+                for (i = 0; i < s->tables_num; i++) {
+                    struct openflow_ext_table_memory *t = &ofp->tables[i];
+
+                    memset(t, 0, sizeof(struct openflow_ext_table_memory));
+                    t->table_id     = s->tables[i].table_id;
+                    t->mode         = s->tables[i].mode;
+                    t->active_count = htonl(s->tables[i].active_count);
+                    t->max_entries  = htonl(s->tables[i].max_entries);
+                    t->memory       = hton64(s->tables[i].memory);
+                }
+
+                return 0;
+            }
+            case (OFP_EXT_STAGE_STATS_REPLY): {
+                struct ofl_exp_openflow_msg_stage_stats *s = (struct ofl_exp_openflow_msg_stage_stats *)exp;
+                struct openflow_ext_stage_stats *ofp;
+                size_t i;
+
+                *buf_len  = sizeof(struct openflow_ext_stage_stats) +
+                            s->stages_num * sizeof(struct openflow_ext_stage);
+                *buf     = (uint8_t *)malloc(*buf_len);
+
+                ofp = (struct openflow_ext_stage_stats *)(*buf);
+                ofp->header.vendor  = htonl(exp->header.experimenter_id);
+                ofp->header.subtype = htonl(exp->type);
+                for (i = 0; i < s->stages_num; i++) {
+                    struct openflow_ext_stage *t = &ofp->stages[i];
+
+                    memset(t, 0, sizeof(struct openflow_ext_stage));
+                    t->stage     = s->stages[i].stage;
+                    t->threads   = htonl(s->stages[i].threads);
+                    t->capacity  = htonl(s->stages[i].capacity);
+                    t->occupancy = htonl(s->stages[i].occupancy);
+                    t->packets   = hton64(s->stages[i].packets);
+                    t->dropped   = hton64(s->stages[i].dropped);
+                }
+
+                return 0;
+            }
+            case (OFP_EXT_PACKET_POOL_STATS_REPLY): {
+                struct ofl_exp_openflow_msg_packet_pool_stats *s = (struct ofl_exp_openflow_msg_packet_pool_stats *)exp;
+                struct openflow_ext_packet_pool_stats *ofp;
+                size_t i;
+
+                *buf_len  = sizeof(struct openflow_ext_packet_pool_stats) +
+                            s->pools_num * sizeof(struct openflow_ext_packet_pool);
+                *buf     = (uint8_t *)malloc(*buf_len);
+
+                ofp = (struct openflow_ext_packet_pool_stats *)(*buf);
+                ofp->header.vendor  = htonl(exp->header.experimenter_id);
+                ofp->header.subtype = htonl(exp->type);
+                for (i = 0; i < s->pools_num; i++) {
+                    struct openflow_ext_packet_pool *t = &ofp->pools[i];
+
+                    memset(t, 0, sizeof(struct openflow_ext_packet_pool));
+                    /* The rest of the name stays zeroed, terminating it. */
+                    memcpy(t->name, s->pools[i].name,
+                           strnlen(s->pools[i].name, sizeof(t->name) - 1));
+                    t->size       = htonl(s->pools[i].size);
+                    t->free       = htonl(s->pools[i].free);
+                    t->high_water = htonl(s->pools[i].high_water);
+                    t->packets    = hton64(s->pools[i].packets);
+                }
+
+                return 0;
+            }
+            case (OFP_EXT_TABLE_MODE): {
+                struct ofl_exp_openflow_msg_table_mode *s = (struct ofl_exp_openflow_msg_table_mode *)exp;
+                struct openflow_ext_table_mode *ofp;
+
+                *buf_len  = sizeof(struct openflow_ext_table_mode);
+                *buf     = (uint8_t *)malloc(*buf_len);
+
+                ofp = (struct openflow_ext_table_mode *)(*buf);
+                memset(ofp, 0, sizeof(struct openflow_ext_table_mode));
+                ofp->header.vendor  = htonl(exp->header.experimenter_id);
+                ofp->header.subtype = htonl(exp->type);
+                ofp->table_id       = s->table_id;
+                ofp->mode           = s->mode;
+
+                return 0;
+            }
+            case (OFP_EXT_BUNDLE_CONTROL): {
+                struct ofl_exp_openflow_msg_bundle_ctrl *s = (struct ofl_exp_openflow_msg_bundle_ctrl *)exp;
+                struct openflow_ext_bundle_ctrl *ofp;
+
+                *buf_len  = sizeof(struct openflow_ext_bundle_ctrl);
+                *buf     = (uint8_t *)malloc(*buf_len);
+
+                ofp = (struct openflow_ext_bundle_ctrl *)(*buf);
+                ofp->header.vendor  = htonl(exp->header.experimenter_id);
+                ofp->header.subtype = htonl(exp->type);
+                ofp->bundle_id      = htonl(s->bundle_id);
+                ofp->type           = htons(s->type);
+                ofp->flags          = htons(s->flags);
+
+                return 0;
+            }
+            case (OFP_EXT_BUNDLE_ADD): {
+                struct ofl_exp_openflow_msg_bundle_add *s = (struct ofl_exp_openflow_msg_bundle_add *)exp;
+                struct openflow_ext_bundle_add *ofp;
+
+                *buf_len  = sizeof(struct openflow_ext_bundle_add) + s->message_length;
+                *buf     = (uint8_t *)malloc(*buf_len);
+
+                ofp = (struct openflow_ext_bundle_add *)(*buf);
+                ofp->header.vendor  = htonl(exp->header.experimenter_id);
+                ofp->header.subtype = htonl(exp->type);
+                ofp->bundle_id      = htonl(s->bundle_id);
+                ofp->pad            = 0;
+                ofp->flags          = htons(s->flags);
+                memcpy(ofp->message, s->message, s->message_length);
+
+                return 0;
+            }
             default: {
                 OFL_LOG_WARN(LOG_MODULE, "Trying to print unknown Openflow Experimenter message.");
                 return -1;
@@ -152,6 +323,223 @@ ofl_exp_openflow_msg_unpack(struct ofp_header *oh, size_t *len, struct ofl_msg_e
                 (*msg) = (struct ofl_msg_experimenter *)dst;
                 return 0;
             }
+            case (OFP_EXT_FLOW_CACHE_STATS_REQUEST):
+            case (OFP_EXT_TABLE_MEMORY_REQUEST):
+            case (OFP_EXT_STAGE_STATS_REQUEST):
+            case (OFP_EXT_PACKET_POOL_STATS_REQUEST): {
+                struct ofl_exp_openflow_msg_header *dst;
+
+                *len -= sizeof(struct ofp_extension_header);
+
+                dst = (struct ofl_exp_openflow_msg_header *)malloc(sizeof(struct ofl_exp_openflow_msg_header));
+                dst->header.experimenter_id = ntohl(exp->vendor);
+                dst->type                   = ntohl(exp->subtype);
+
+                (*msg) = (struct ofl_msg_experimenter *)dst;
+                return 0;
+            }
+            case (OFP_EXT_FLOW_CACHE_STATS_REPLY): {
+                struct openflow_ext_flow_cache_stats *src;
+                struct ofl_exp_openflow_msg_flow_cache_stats *dst;
+
+                if (*len < sizeof(struct openflow_ext_flow_cache_stats)) {
+                    OFL_LOG_WARN(LOG_MODULE, "Received EXT_FLOW_CACHE_STATS_REPLY message has invalid length (%zu).", *len);
+                    return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_LEN);
+                }
+                *len -= sizeof(struct openflow_ext_flow_cache_stats);
+
+                src = (struct openflow_ext_flow_cache_stats *)exp;
+
+                dst = (struct ofl_exp_openflow_msg_flow_cache_stats *)malloc(sizeof(struct ofl_exp_openflow_msg_flow_cache_stats));
+                dst->header.header.experimenter_id = ntohl(exp->vendor);
+                dst->header.type                   = ntohl(exp->subtype);
+                dst->size          = ntohl(src->size);
+                dst->used          = ntohl(src->used);
+                dst->hits          = ntoh64(src->hits);
+                dst->misses        = ntoh64(src->misses);
+                dst->evictions     = ntoh64(src->evictions);
+                dst->invalidations = ntoh64(src->invalidations);
+                dst->megaflow_size      = ntohl(src->megaflow_size);
+                dst->megaflow_used      = ntohl(src->megaflow_used);
+                dst->megaflow_hits      = ntoh64(src->megaflow_hits);
+                dst->megaflow_misses    = ntoh64(src->megaflow_misses);
+                dst->megaflow_evictions = ntoh64(src->megaflow_evictions);
+                dst->megaflow_expired   = ntoh64(src->megaflow_expired);
+                dst->megaflow_stale     = ntoh64(src->megaflow_stale);
+
+                (*msg) = (struct ofl_msg_experimenter *)dst;
+                return 0;
+            }
+            case (OFP_EXT_TABLE_MEMORY_REPLY): {
+                struct openflow_ext_table_memory_stats *src;
+                struct ofl_exp_openflow_msg_table_memory *dst;
+                size_t i;
+
+                if (*len < sizeof(struct openflow_ext_table_memory_stats) ||
+                    (*len - sizeof(struct openflow_ext_table_memory_stats)) % sizeof(struct openflow_ext_table_memory) != 0) {
+                    OFL_LOG_WARN(LOG_MODULE, "Received EXT_TABLE_MEMORY_REPLY message has invalid length (%zu).", *len);
+                    return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_LEN);
+                }
+                *len -= sizeof(struct openflow_ext_table_memory_stats);
+
+                src = (struct openflow_ext_table_memory_stats *)exp;
+
+                dst = (struct ofl_exp_openflow_msg_table_memory *)malloc(sizeof(struct ofl_exp_openflow_msg_table_memory));
+                dst->header.header.experimenter_id = ntohl(exp->vendor);
+                dst->header.type                   = ntohl(exp->subtype);
+                dst->budget     = ntoh64(src->budget);
+                dst->memory     = ntoh64(src->memory);
+                dst->tables_num = *len / sizeof(struct openflow_ext_table_memory);
+                dst->tables     = (struct ofl_exp_openflow_table_memory *)malloc(dst->tables_num * sizeof(struct ofl_exp_openflow_table_memory));
+                for (i = 0; i < dst->tables_num; i++) {
+                    dst->tables[i].table_id     = src->tables[i].table_id;
+                    dst->tables[i].mode         = src->tables[i].mode;
+                    dst->tables[i].active_count = ntohl(src->tables[i].active_count);
+                    dst->tables[i].max_entries  = ntohl(src->tables[i].max_entries);
+                    dst->tables[i].memory       = ntoh64(src->tables[i].memory);
+                }
+                *len = 0;
+
+                (*msg) = (struct ofl_msg_experimenter *)dst;
+                return 0;
+            }
+            case (OFP_EXT_STAGE_STATS_REPLY): {
+                struct openflow_ext_stage_stats *src;
+                struct ofl_exp_openflow_msg_stage_stats *dst;
+                size_t i;
+
+                if (*len < sizeof(struct openflow_ext_stage_stats) ||
+                    (*len - sizeof(struct openflow_ext_stage_stats)) % sizeof(struct openflow_ext_stage) != 0) {
+                    OFL_LOG_WARN(LOG_MODULE, "Received EXT_STAGE_STATS_REPLY message has invalid length (%zu).", *len);
+                    return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_LEN);
+                }
+                *len -= sizeof(struct openflow_ext_stage_stats);
+
+                src = (struct openflow_ext_stage_stats *)exp;
+
+                dst = (struct ofl_exp_openflow_msg_stage_stats *)malloc(sizeof(struct ofl_exp_openflow_msg_stage_stats));
+                dst->header.header.experimenter_id = ntohl(exp->vendor);
+                dst->header.type                   = ntohl(exp->subtype);
+                dst->stages_num = *len / sizeof(struct openflow_ext_stage);
+                dst->stages     = (struct ofl_exp_openflow_stage *)malloc(dst->stages_num * sizeof(struct ofl_exp_openflow_stage));
+                for (i = 0; i < dst->stages_num; i++) {
+                    dst->stages[i].stage     = src->stages[i].stage;
+                    dst->stages[i].threads   = ntohl(src->stages[i].threads);
+                    dst->stages[i].capacity  = ntohl(src->stages[i].capacity);
+                    dst->stages[i].occupancy = ntohl(src->stages[i].occupancy);
+                    dst->stages[i].packets   = ntoh64(src->stages[i].packets);
+                    dst->stages[i].dropped   = ntoh64(src->stages[i].dropped);
+                }
+                *len = 0;
+
+                (*msg) = (struct ofl_msg_experimenter *)dst;
+                return 0;
+            }
+            case (OFP_EXT_PACKET_POOL_STATS_REPLY): {
+                struct openflow_ext_packet_pool_stats *src;
+                struct ofl_exp_openflow_msg_packet_pool_stats *dst;
+                size_t i;
+
+                if (*len < sizeof(struct openflow_ext_packet_pool_stats) ||
+                    (*len - sizeof(struct openflow_ext_packet_pool_stats)) % sizeof(struct openflow_ext_packet_pool) != 0) {
+                    OFL_LOG_WARN(LOG_MODULE, "Received EXT_PACKET_POOL_STATS_REPLY message has invalid length (%zu).", *len);
+                    return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_LEN);
+                }
+                *len -= sizeof(struct openflow_ext_packet_pool_stats);
+
+                src = (struct openflow_ext_packet_pool_stats *)exp;
+
+                dst = (struct ofl_exp_openflow_msg_packet_pool_stats *)malloc(sizeof(struct ofl_exp_openflow_msg_packet_pool_stats));
+                dst->header.header.experimenter_id = ntohl(exp->vendor);
+                dst->header.type                   = ntohl(exp->subtype);
+                dst->pools_num = *len / sizeof(struct openflow_ext_packet_pool);
+                dst->pools     = (struct ofl_exp_openflow_packet_pool *)malloc(dst->pools_num * sizeof(struct ofl_exp_openflow_packet_pool));
+                for (i = 0; i < dst->pools_num; i++) {
+                    memcpy(dst->pools[i].name, src->pools[i].name, sizeof(dst->pools[i].name));
+                    dst->pools[i].name[sizeof(dst->pools[i].name) - 1] = '\0';
+                    dst->pools[i].size       = ntohl(src->pools[i].size);
+                    dst->pools[i].free       = ntohl(src->pools[i].free);
+                    dst->pools[i].high_water = ntohl(src->pools[i].high_water);
+                    dst->pools[i].packets    = ntoh64(src->pools[i].packets);
+                }
+                *len = 0;
+
+                (*msg) = (struct ofl_msg_experimenter *)dst;
+                return 0;
+            }
+            case (OFP_EXT_TABLE_MODE): {
+                struct openflow_ext_table_mode *src;
+                struct ofl_exp_openflow_msg_table_mode *dst;
+
+                if (*len < sizeof(struct openflow_ext_table_mode)) {
+                    OFL_LOG_WARN(LOG_MODULE, "Received EXT_TABLE_MODE message has invalid length (%zu).", *len);
+                    return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_LEN);
+                }
+                *len -= sizeof(struct openflow_ext_table_mode);
+
+                src = (struct openflow_ext_table_mode *)exp;
+
+                dst = (struct ofl_exp_openflow_msg_table_mode *)malloc(sizeof(struct ofl_exp_openflow_msg_table_mode));
+                dst->header.header.experimenter_id = ntohl(exp->vendor);
+                dst->header.type                   = ntohl(exp->subtype);
+                dst->table_id = src->table_id;
+                dst->mode     = src->mode;
+
+                (*msg) = (struct ofl_msg_experimenter *)dst;
+                return 0;
+            }
+            case (OFP_EXT_BUNDLE_CONTROL): {
+                struct openflow_ext_bundle_ctrl *src;
+                struct ofl_exp_openflow_msg_bundle_ctrl *dst;
+
+                if (*len < sizeof(struct openflow_ext_bundle_ctrl)) {
+                    OFL_LOG_WARN(LOG_MODULE, "Received EXT_BUNDLE_CONTROL message has invalid length (%zu).", *len);
+                    return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_LEN);
+                }
+                *len -= sizeof(struct openflow_ext_bundle_ctrl);
+
+                src = (struct openflow_ext_bundle_ctrl *)exp;
+
+                dst = (struct ofl_exp_openflow_msg_bundle_ctrl *)malloc(sizeof(struct ofl_exp_openflow_msg_bundle_ctrl));
+                dst->header.header.experimenter_id = ntohl(exp->vendor);
+                dst->header.type                   = ntohl(exp->subtype);
+                dst->bundle_id = ntohl(src->bundle_id);
+                dst->type      = ntohs(src->type);
+                dst->flags     = ntohs(src->flags);
+
+                (*msg) = (struct ofl_msg_experimenter *)dst;
+                return 0;
+            }
+            case (OFP_EXT_BUNDLE_ADD): {
+                struct openflow_ext_bundle_add *src;
+                struct ofl_exp_openflow_msg_bundle_add *dst;
+                size_t message_length;
+
+                if (*len < sizeof(struct openflow_ext_bundle_add) + sizeof(struct ofp_header)) {
+                    OFL_LOG_WARN(LOG_MODULE, "Received EXT_BUNDLE_ADD message has invalid length (%zu).", *len);
+                    return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_LEN);
+                }
+                src = (struct openflow_ext_bundle_add *)exp;
+
+                message_length = ntohs(src->message->length);
+                if (message_length != *len - sizeof(struct openflow_ext_bundle_add)) {
+                    OFL_LOG_WARN(LOG_MODULE, "Received EXT_BUNDLE_ADD message has invalid inner length (%zu).", message_length);
+                    return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_LEN);
+                }
+                *len = 0;
+
+                dst = (struct ofl_exp_openflow_msg_bundle_add *)malloc(sizeof(struct ofl_exp_openflow_msg_bundle_add));
+                dst->header.header.experimenter_id = ntohl(exp->vendor);
+                dst->header.type                   = ntohl(exp->subtype);
+                dst->bundle_id      = ntohl(src->bundle_id);
+                dst->flags          = ntohs(src->flags);
+                dst->message_length = message_length;
+                dst->message        = (uint8_t *)malloc(message_length);
+                memcpy(dst->message, src->message, message_length);
+
+                (*msg) = (struct ofl_msg_experimenter *)dst;
+                return 0;
+            }
             default: {
                 OFL_LOG_WARN(LOG_MODULE, "Trying to unpack unknown Openflow Experimenter message.");
                 return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_EXPERIMENTER);
@@ -181,6 +569,35 @@ ofl_exp_openflow_msg_free(struct ofl_msg_experimenter *msg) {
                 free(s->dp_desc);
                 break;
             }
+            case (OFP_EXT_FLOW_CACHE_STATS_REQUEST):
+            case (OFP_EXT_FLOW_CACHE_STATS_REPLY):
+            case (OFP_EXT_TABLE_MEMORY_REQUEST):
+            case (OFP_EXT_TABLE_MODE):
+            case (OFP_EXT_BUNDLE_CONTROL):
+            case (OFP_EXT_STAGE_STATS_REQUEST):
+            case (OFP_EXT_PACKET_POOL_STATS_REQUEST): {
+                break;
+            }
+            case (OFP_EXT_BUNDLE_ADD): {
+                struct ofl_exp_openflow_msg_bundle_add *s = (struct ofl_exp_openflow_msg_bundle_add *)exp;
+                free(s->message);
+                break;
+            }
+            case (OFP_EXT_TABLE_MEMORY_REPLY): {
+                struct ofl_exp_openflow_msg_table_memory *s = (struct ofl_exp_openflow_msg_table_memory *)exp;
+                free(s->tables);
+                break;
+            }
+            case (OFP_EXT_STAGE_STATS_REPLY): {
+                struct ofl_exp_openflow_msg_stage_stats *s = (struct ofl_exp_openflow_msg_stage_stats *)exp;
+                free(s->stages);
+                break;
+            }
+            case (OFP_EXT_PACKET_POOL_STATS_REPLY): {
+                struct ofl_exp_openflow_msg_packet_pool_stats *s = (struct ofl_exp_openflow_msg_packet_pool_stats *)exp;
+                free(s->pools);
+                break;
+            }
             default: {
                 OFL_LOG_WARN(LOG_MODULE, "Trying to free unknown Openflow Experimenter message.");
             }
@@ -192,6 +609,39 @@ ofl_exp_openflow_msg_free(struct ofl_msg_experimenter *msg) {
     return 0;
 }
 
+static const char *
+table_mode_name(uint8_t mode) {
+    return mode == OFP_EXT_TABLE_MODE_AUTO    ? "auto"
+         : mode == OFP_EXT_TABLE_MODE_GENERIC ? "generic"
+         : mode == OFP_EXT_TABLE_MODE_LPM     ? "lpm"
+         : mode == OFP_EXT_TABLE_MODE_EXACT   ? "exact"
+         : "unknown";
+}
+
+static const char *
+stage_name(uint8_t stage) {
+    return stage == OFP_EXT_STAGE_RUN      ? "run"
+         : stage == OFP_EXT_STAGE_RECEIVE  ? "receive"
+         : stage == OFP_EXT_STAGE_CLASSIFY ? "classify"
+         : stage == OFP_EXT_STAGE_TRANSMIT ? "transmit"
+         : "unknown";
+}
+
+static const char *
+bundle_ctrl_type_name(uint16_t type) {
+    switch (type) {
+        case (OFP_EXT_BCT_OPEN_REQUEST):    return "open-req";
+        case (OFP_EXT_BCT_OPEN_REPLY):      return "open-repl";
+        case (OFP_EXT_BCT_CLOSE_REQUEST):   return "close-req";
+        case (OFP_EXT_BCT_CLOSE_REPLY):     return "close-repl";
+        case (OFP_EXT_BCT_COMMIT_REQUEST):  return "commit-req";
+        case (OFP_EXT_BCT_COMMIT_REPLY):    return "commit-repl";
+        case (OFP_EXT_BCT_DISCARD_REQUEST): return "discard-req";
+        case (OFP_EXT_BCT_DISCARD_REPLY):   return "discard-repl";
+        default:                            return "unknown";
+    }
+}
+
 char *
 ofl_exp_openflow_msg_to_string(struct ofl_msg_experimenter *msg) {
     char *str;
@@ -216,6 +666,106 @@ ofl_exp_openflow_msg_to_string(struct ofl_msg_experimenter *msg) {
                 fprintf(stream, "setdesc{desc=\"%s\"}", s->dp_desc);
                 break;
             }
+            case (OFP_EXT_FLOW_CACHE_STATS_REQUEST): {
+                fprintf(stream, "flowcache-req");
+                break;
+            }
+            case (OFP_EXT_FLOW_CACHE_STATS_REPLY): {
+                struct ofl_exp_openflow_msg_flow_cache_stats *s = (struct ofl_exp_openflow_msg_flow_cache_stats *)exp;
+                fprintf(stream, "flowcache-repl{size=\"%u\", used=\"%u\", hits=\"%"PRIu64"\", "
+                                "misses=\"%"PRIu64"\", evictions=\"%"PRIu64"\", invalidations=\"%"PRIu64"\", "
+                                "megaflow_size=\"%u\", megaflow_used=\"%u\", megaflow_hits=\"%"PRIu64"\", "
+                                "megaflow_misses=\"%"PRIu64"\", megaflow_evictions=\"%"PRIu64"\", "
+                                "megaflow_expired=\"%"PRIu64"\", megaflow_stale=\"%"PRIu64"\"}",
+                        s->size, s->used, s->hits, s->misses, s->evictions, s->invalidations,
+                        s->megaflow_size, s->megaflow_used, s->megaflow_hits, s->megaflow_misses,
+                        s->megaflow_evictions, s->megaflow_expired, s->megaflow_stale);
+                break;
+            }
+            case (OFP_EXT_TABLE_MEMORY_REQUEST): {
+                fprintf(stream, "tablemem-req");
+                break;
+            }
+            case (OFP_EXT_TABLE_MEMORY_REPLY): {
+                struct ofl_exp_openflow_msg_table_memory *s = (struct ofl_exp_openflow_msg_table_memory *)exp;
+                size_t i;
+
+                fprintf(stream, "tablemem-repl{budget=\"%"PRIu64"\", memory=\"%"PRIu64"\", tables=[",
+                        s->budget, s->memory);
+                for (i = 0; i < s->tables_num; i++) {
+                    struct ofl_exp_openflow_table_memory *t = &s->tables[i];
+
+                    fprintf(stream, "%s{table=\"%u\", mode=\"%s\", active=\"%u\", max=\"%u\", "
+                                    "memory=\"%"PRIu64"\", per_entry=\"%"PRIu64"\"}", i == 0 ? "" : ", ",
+                            t->table_id, table_mode_name(t->mode), t->active_count, t->max_entries,
+                            t->memory, t->active_count == 0 ? 0 : t->memory / t->active_count);
+                }
+                fprintf(stream, "]}");
+                break;
+            }
+            case (OFP_EXT_STAGE_STATS_REQUEST): {
+                fprintf(stream, "stagestats-req");
+                break;
+            }
+            case (OFP_EXT_STAGE_STATS_REPLY): {
+                struct ofl_exp_openflow_msg_stage_stats *s = (struct ofl_exp_openflow_msg_stage_stats *)exp;
+                size_t i;
+
+                fprintf(stream, "stagestats-repl{stages=[");
+                for (i = 0; i < s->stages_num; i++) {
+                    struct ofl_exp_openflow_stage *t = &s->stages[i];
+
+                    fprintf(stream, "%s{stage=\"%s\", threads=\"%u\", capacity=\"%u\", "
+                                    "occupancy=\"%u\", packets=\"%"PRIu64"\", dropped=\"%"PRIu64"\"}",
+                            i == 0 ? "" : ", ", stage_name(t->stage), t->threads, t->capacity,
+                            t->occupancy, t->packets, t->dropped);
+                }
+                fprintf(stream, "]}");
+                break;
+            }
+            case (OFP_EXT_PACKET_POOL_STATS_REQUEST): {
+                fprintf(stream, "poolstats-req");
+                break;
+            }
+            case (OFP_EXT_PACKET_POOL_STATS_REPLY): {
+                struct ofl_exp_openflow_msg_packet_pool_stats *s = (struct ofl_exp_openflow_msg_packet_pool_stats *)exp;
+                size_t i;
+
+                fprintf(stream, "poolstats-repl{pools=[");
+                for (i = 0; i < s->pools_num; i++) {
+                    struct ofl_exp_openflow_packet_pool *t = &s->pools[i];
+
+                    fprintf(stream, "%s{thread=\"%s\", size=\"%u\", free=\"%u\", "
+                                    "high_water=\"%u\", packets=\"%"PRIu64"\"}",
+                            i == 0 ? "" : ", ", t->name, t->size, t->free,
+                            t->high_water, t->packets);
+                }
+                fprintf(stream, "]}");
+                break;
+            }
+            case (OFP_EXT_TABLE_MODE): {
+                struct ofl_exp_openflow_msg_table_mode *s = (struct ofl_exp_openflow_msg_table_mode *)exp;
+
+                fprintf(stream, "tablemode{table=\"");
+                ofl_table_print(stream, s->table_id);
+                fprintf(stream, "\", mode=\"%s\"}", table_mode_name(s->mode));
+                break;
+            }
+            case (OFP_EXT_BUNDLE_CONTROL): {
+                struct ofl_exp_openflow_msg_bundle_ctrl *s = (struct ofl_exp_openflow_msg_bundle_ctrl *)exp;
+
+                fprintf(stream, "bundle{id=\"%u\", type=\"%s\", flags=\"0x%"PRIx16"\"}",
+                        s->bundle_id, bundle_ctrl_type_name(s->type), s->flags);
+                break;
+            }
+            case (OFP_EXT_BUNDLE_ADD): {
+                struct ofl_exp_openflow_msg_bundle_add *s = (struct ofl_exp_openflow_msg_bundle_add *)exp;
+
+                fprintf(stream, "bundleadd{id=\"%u\", flags=\"0x%"PRIx16"\", msg=\"", s->bundle_id, s->flags);
+                ofl_message_type_print(stream, ((struct ofp_header *)s->message)->type);
+                fprintf(stream, "\", len=\"%zu\"}", s->message_length);
+                break;
+            }
             default: {
                 OFL_LOG_WARN(LOG_MODULE, "Trying to print unknown Openflow Experimenter message.");
                 fprintf(stream, "ofexp{type=\"%u\"}", exp->type);
@@ -229,3 +779,297 @@ ofl_exp_openflow_msg_to_string(struct ofl_msg_experimenter *msg) {
     fclose(stream);
     return str;
 }
+
+int
+ofl_exp_openflow_stats_req_pack(struct ofl_msg_multipart_request_header *msg, uint8_t **buf, size_t *buf_len) {
+    struct ofl_exp_openflow_mp_request *exp = (struct ofl_exp_openflow_mp_request *)msg;
+
+    switch (exp->type) {
+        case (OFP_EXT_MP_TABLE_LOOKUP_STATS): {
+            struct ofl_exp_openflow_mp_table_lookup_stats_request *s = (struct ofl_exp_openflow_mp_table_lookup_stats_request *)exp;
+            struct ofp_multipart_request *req;
+            struct openflow_ext_table_lookup_stats_request *ofp;
+
+            *buf_len = sizeof(struct ofp_multipart_request) + sizeof(struct openflow_ext_table_lookup_stats_request);
+            *buf     = (uint8_t *)malloc(*buf_len);
+
+            req = (struct ofp_multipart_request *)(*buf);
+            ofp = (struct openflow_ext_table_lookup_stats_request *)req->body;
+            memset(ofp, 0, sizeof(struct openflow_ext_table_lookup_stats_request));
+            ofp->header.experimenter = htonl(exp->header.experimenter_id);
+            ofp->header.exp_type     = htonl(exp->type);
+            ofp->table_id            = s->table_id;
+
+            return 0;
+        }
+        default: {
+            OFL_LOG_WARN(LOG_MODULE, "Trying to pack unknown Openflow Experimenter stats request.");
+            return -1;
+        }
+    }
+}
+
+ofl_err
+ofl_exp_openflow_stats_req_unpack(struct ofp_multipart_request *os, size_t *len, struct ofl_msg_multipart_request_header **msg) {
+    struct ofp_experimenter_multipart_header *exp = (struct ofp_experimenter_multipart_header *)os->body;
+
+    switch (ntohl(exp->exp_type)) {
+        case (OFP_EXT_MP_TABLE_LOOKUP_STATS): {
+            struct openflow_ext_table_lookup_stats_request *src;
+            struct ofl_exp_openflow_mp_table_lookup_stats_request *dst;
+
+            if (*len < sizeof(struct openflow_ext_table_lookup_stats_request)) {
+                OFL_LOG_WARN(LOG_MODULE, "Received EXT_MP_TABLE_LOOKUP_STATS request has invalid length (%zu).", *len);
+                return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_LEN);
+            }
+            *len -= sizeof(struct openflow_ext_table_lookup_stats_request);
+
+            src = (struct openflow_ext_table_lookup_stats_request *)exp;
+
+            dst = (struct ofl_exp_openflow_mp_table_lookup_stats_request *)malloc(sizeof(struct ofl_exp_openflow_mp_table_lookup_stats_request));
+            dst->header.header.experimenter_id = ntohl(exp->experimenter);
+            dst->header.type                   = ntohl(exp->exp_type);
+            dst->table_id = src->table_id;
+
+            (*msg) = (struct ofl_msg_multipart_request_header *)dst;
+            return 0;
+        }
+        default: {
+            OFL_LOG_WARN(LOG_MODULE, "Trying to unpack unknown Openflow Experimenter stats request.");
+            return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_EXP_TYPE);
+        }
+    }
+}
+
+int
+ofl_exp_openflow_stats_req_free(struct ofl_msg_multipart_request_header *msg) {
+    free(msg);
+    return 0;
+}
+
+char *
+ofl_exp_openflow_stats_req_to_string(struct ofl_msg_multipart_request_header *msg) {
+    struct ofl_exp_openflow_mp_request *exp = (struct ofl_exp_openflow_mp_request *)msg;
+    char *str;
+    size_t str_size;
+    FILE *stream = open_memstream(&str, &str_size);
+
+    switch (exp->type) {
+        case (OFP_EXT_MP_TABLE_LOOKUP_STATS): {
+            struct ofl_exp_openflow_mp_table_lookup_stats_request *s = (struct ofl_exp_openflow_mp_table_lookup_stats_request *)exp;
+
+            fprintf(stream, "lookupstatsreq{table=\"");
+            ofl_table_print(stream, s->table_id);
+            fprintf(stream, "\"}");
+            break;
+        }
+        default: {
+            OFL_LOG_WARN(LOG_MODULE, "Trying to print unknown Openflow Experimenter stats request.");
+            fprintf(stream, "ofexpstats{type=\"%u\"}", exp->type);
+        }
+    }
+
+    fclose(stream);
+    return str;
+}
+
+int
+ofl_exp_openflow_stats_reply_pack(struct ofl_msg_multipart_reply_header *msg, uint8_t **buf, size_t *buf_len) {
+    struct ofl_exp_openflow_mp_reply *exp = (struct ofl_exp_openflow_mp_reply *)msg;
+
+    switch (exp->type) {
+        case (OFP_EXT_MP_TABLE_LOOKUP_STATS): {
+            struct ofl_exp_openflow_mp_table_lookup_stats_reply *s = (struct ofl_exp_openflow_mp_table_lookup_stats_reply *)exp;
+            struct ofp_multipart_reply *resp;
+            struct openflow_ext_table_lookup_stats_reply *ofp;
+            size_t i, j;
+
+            *buf_len = sizeof(struct ofp_multipart_reply) + sizeof(struct openflow_ext_table_lookup_stats_reply) +
+                       s->tables_num * sizeof(struct openflow_ext_table_lookup_stats);
+            *buf     = (uint8_t *)malloc(*buf_len);
+
+            resp = (struct ofp_multipart_reply *)(*buf);
+            ofp = (struct openflow_ext_table_lookup_stats_reply *)resp->body;
+            ofp->header.experimenter = htonl(exp->header.experimenter_id);
+            ofp->header.exp_type     = htonl(exp->type);
+            for (i = 0; i < s->tables_num; i++) {
+                struct openflow_ext_table_lookup_stats *t = &ofp->tables[i];
+                struct ofl_exp_openflow_table_lookup_stats *st = &s->tables[i];
+
+                memset(t, 0, sizeof(struct openflow_ext_table_lookup_stats));
+                t->table_id = st->table_id;
+                t->mode     = st->mode;
+                t->lookups  = hton64(st->lookups);
+                t->hits     = hton64(st->hits);
+                t->probes   = hton64(st->probes);
+                t->cycles   = hton64(st->cycles);
+                for (j = 0; j < OFP_EXT_LOOKUP_PROBE_BUCKETS; j++) {
+                    t->probe_hits[j] = hton64(st->probe_hits[j]);
+                }
+                for (j = 0; j < OFP_EXT_LOOKUP_CYCLE_BUCKETS; j++) {
+                    t->cycles_hist[j] = hton64(st->cycles_hist[j]);
+                }
+                t->reorders       = hton64(st->reorders);
+                t->before_lookups = hton64(st->before_lookups);
+                t->before_probes  = hton64(st->before_probes);
+                t->after_lookups  = hton64(st->after_lookups);
+                t->after_probes   = hton64(st->after_probes);
+            }
+
+            return 0;
+        }
+        default: {
+            OFL_LOG_WARN(LOG_MODULE, "Trying to pack unknown Openflow Experimenter stats reply.");
+            return -1;
+        }
+    }
+}
+
+ofl_err
+ofl_exp_openflow_stats_reply_unpack(struct ofp_multipart_reply *os, size_t *len, struct ofl_msg_multipart_reply_header **msg) {
+    struct ofp_experimenter_multipart_header *exp = (struct ofp_experimenter_multipart_header *)os->body;
+
+    switch (ntohl(exp->exp_type)) {
+        case (OFP_EXT_MP_TABLE_LOOKUP_STATS): {
+            struct openflow_ext_table_lookup_stats_reply *src;
+            struct ofl_exp_openflow_mp_table_lookup_stats_reply *dst;
+            size_t i, j;
+
+            if (*len < sizeof(struct openflow_ext_table_lookup_stats_reply) ||
+                (*len - sizeof(struct openflow_ext_table_lookup_stats_reply)) % sizeof(struct openflow_ext_table_lookup_stats) != 0) {
+                OFL_LOG_WARN(LOG_MODULE, "Received EXT_MP_TABLE_LOOKUP_STATS reply has invalid length (%zu).", *len);
+                return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_LEN);
+            }
+            *len -= sizeof(struct openflow_ext_table_lookup_stats_reply);
+
+            src = (struct openflow_ext_table_lookup_stats_reply *)exp;
+
+            dst = (struct ofl_exp_openflow_mp_table_lookup_stats_reply *)malloc(sizeof(struct ofl_exp_openflow_mp_table_lookup_stats_reply));
+            dst->header.header.experimenter_id = ntohl(exp->experimenter);
+            dst->header.header.data_length     = 0;
+            dst->header.header.data            = NULL;
+            dst->header.type                   = ntohl(exp->exp_type);
+            dst->tables_num = *len / sizeof(struct openflow_ext_table_lookup_stats);
+            dst->tables     = (struct ofl_exp_openflow_table_lookup_stats *)malloc(dst->tables_num * sizeof(struct ofl_exp_openflow_table_lookup_stats));
+            for (i = 0; i < dst->tables_num; i++) {
+                struct openflow_ext_table_lookup_stats *t = &src->tables[i];
+                struct ofl_exp_openflow_table_lookup_stats *st = &dst->tables[i];
+
+                st->table_id = t->table_id;
+                st->mode     = t->mode;
+                st->lookups  = ntoh64(t->lookups);
+                st->hits     = ntoh64(t->hits);
+                st->probes   = ntoh64(t->probes);
+                st->cycles   = ntoh64(t->cycles);
+                for (j = 0; j < OFP_EXT_LOOKUP_PROBE_BUCKETS; j++) {
+                    st->probe_hits[j] = ntoh64(t->probe_hits[j]);
+                }
+                for (j = 0; j < OFP_EXT_LOOKUP_CYCLE_BUCKETS; j++) {
+                    st->cycles_hist[j] = ntoh64(t->cycles_hist[j]);
+                }
+                st->reorders       = ntoh64(t->reorders);
+                st->before_lookups = ntoh64(t->before_lookups);
+                st->before_probes  = ntoh64(t->before_probes);
+                st->after_lookups  = ntoh64(t->after_lookups);
+                st->after_probes   = ntoh64(t->after_probes);
+            }
+            *len = 0;
+
+            (*msg) = (struct ofl_msg_multipart_reply_header *)dst;
+            return 0;
+        }
+        default: {
+            OFL_LOG_WARN(LOG_MODULE, "Trying to unpack unknown Openflow Experimenter stats reply.");
+            return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_EXP_TYPE);
+        }
+    }
+}
+
+int
+ofl_exp_openflow_stats_reply_free(struct ofl_msg_multipart_reply_header *msg) {
+    struct ofl_exp_openflow_mp_reply *exp = (struct ofl_exp_openflow_mp_reply *)msg;
+
+    switch (exp->type) {
+        case (OFP_EXT_MP_TABLE_LOOKUP_STATS): {
+            struct ofl_exp_openflow_mp_table_lookup_stats_reply *s = (struct ofl_exp_openflow_mp_table_lookup_stats_reply *)exp;
+
+            free(s->tables);
+            break;
+        }
+        default: {
+            OFL_LOG_WARN(LOG_MODULE, "Trying to free unknown Openflow Experimenter stats reply.");
+        }
+    }
+    free(msg);
+    return 0;
+}
+
+char *
+ofl_exp_openflow_stats_reply_to_string(struct ofl_msg_multipart_reply_header *msg) {
+    struct ofl_exp_openflow_mp_reply *exp = (struct ofl_exp_openflow_mp_reply *)msg;
+    char *str;
+    size_t str_size;
+    FILE *stream = open_memstream(&str, &str_size);
+
+    switch (exp->type) {
+        case (OFP_EXT_MP_TABLE_LOOKUP_STATS): {
+            struct ofl_exp_openflow_mp_table_lookup_stats_reply *s = (struct ofl_exp_openflow_mp_table_lookup_stats_reply *)exp;
+            size_t i;
+
+            fprintf(stream, "lookupstats{tables=[");
+            for (i = 0; i < s->tables_num; i++) {
+                struct ofl_exp_openflow_table_lookup_stats *t = &s->tables[i];
+                uint64_t hits = 0;
+                size_t j, last;
+
+                fprintf(stream, "%s\n  {table=\"", i > 0 ? "," : "");
+                ofl_table_print(stream, t->table_id);
+                fprintf(stream, "\", mode=\"%s\", lookups=\"%"PRIu64"\", hits=\"%"PRIu64"\", "
+                                "probes=\"%"PRIu64"\", cycles=\"%"PRIu64"\"",
+                        table_mode_name(t->mode), t->lookups, t->hits, t->probes, t->cycles);
+
+                /* Share of the lookups hitting within the first N probes. */
+                fprintf(stream, ",\n   first_n_hits=[");
+                for (last = OFP_EXT_LOOKUP_PROBE_BUCKETS; last > 1 && t->probe_hits[last - 1] == 0; last--);
+                for (j = 0; j < last; j++) {
+                    hits += t->probe_hits[j];
+                    if (j == OFP_EXT_LOOKUP_PROBE_BUCKETS - 1) {
+                        fprintf(stream, ", any:");
+                    } else {
+                        fprintf(stream, "%s%u:", j > 0 ? ", " : "", 1u << j);
+                    }
+                    fprintf(stream, "\"%.1f%%\"", t->lookups > 0 ? 100.0 * hits / t->lookups : 0.0);
+                }
+
+                fprintf(stream, "],\n   cycles_hist=[");
+                for (j = 0, last = 0; j < OFP_EXT_LOOKUP_CYCLE_BUCKETS; j++) {
+                    if (t->cycles_hist[j] > 0) {
+                        fprintf(stream, "%s%s%u:\"%"PRIu64"\"", last++ > 0 ? ", " : "",
+                                j == OFP_EXT_LOOKUP_CYCLE_BUCKETS - 1 ? ">" : "<=",
+                                j == OFP_EXT_LOOKUP_CYCLE_BUCKETS - 1 ? 1u << (j - 1) : 1u << j,
+                                t->cycles_hist[j]);
+                    }
+                }
+                fprintf(stream, "]");
+
+                /* Average probes per lookup around the last reordering. */
+                if (t->reorders > 0) {
+                    fprintf(stream, ",\n   reorders=\"%"PRIu64"\", avg_probes_before=\"%.2f\", "
+                                    "avg_probes_after=\"%.2f\"", t->reorders,
+                            t->before_lookups > 0 ? (double)t->before_probes / t->before_lookups : 0.0,
+                            t->after_lookups > 0 ? (double)t->after_probes / t->after_lookups : 0.0);
+                }
+                fprintf(stream, "}");
+            }
+            fprintf(stream, "]}");
+            break;
+        }
+        default: {
+            OFL_LOG_WARN(LOG_MODULE, "Trying to print unknown Openflow Experimenter stats reply.");
+            fprintf(stream, "ofexpstats{type=\"%u\"}", exp->type);
+        }
+    }
+
+    fclose(stream);
+    return str;
+}
@@ -35,6 +35,7 @@
 
 #include "../oflib/ofl-structs.h"
 #include "../oflib/ofl-messages.h"
+#include "openflow/openflow-ext.h"
 
 
 struct ofl_exp_openflow_msg_header {
@@ -58,6 +59,138 @@ struct ofl_exp_openflow_msg_set_dp_desc {
 };
 
 
+struct ofl_exp_openflow_msg_flow_cache_stats {
+    struct ofl_exp_openflow_msg_header   header; /* OFP_EXT_FLOW_CACHE_STATS_REPLY */
+
+    uint32_t   size;
+    uint32_t   used;
+    uint64_t   hits;
+    uint64_t   misses;
+    uint64_t   evictions;
+    uint64_t   invalidations;
+    uint32_t   megaflow_size;
+    uint32_t   megaflow_used;
+    uint64_t   megaflow_hits;
+    uint64_t   megaflow_misses;
+    uint64_t   megaflow_evictions;
+    uint64_t   megaflow_expired;
+    uint64_t   megaflow_stale;
+};
+
+struct ofl_exp_openflow_msg_table_mode {
+    struct ofl_exp_openflow_msg_header   header; /* OFP_EXT_TABLE_MODE */
+
+    uint8_t    table_id;
+    uint8_t    mode;
+};
+
+struct ofl_exp_openflow_msg_bundle_ctrl {
+    struct ofl_exp_openflow_msg_header   header; /* OFP_EXT_BUNDLE_CONTROL */
+
+    uint32_t   bundle_id;
+    uint16_t   type;
+    uint16_t   flags;
+};
+
+struct ofl_exp_openflow_msg_bundle_add {
+    struct ofl_exp_openflow_msg_header   header; /* OFP_EXT_BUNDLE_ADD */
+
+    uint32_t   bundle_id;
+    uint16_t   flags;
+    size_t     message_length;
+    uint8_t   *message;   /* In wire format; the datapath unpacks it with
+                             its own experimenter callbacks. */
+};
+
+struct ofl_exp_openflow_table_memory {
+    uint8_t    table_id;
+    uint8_t    mode;
+    uint32_t   active_count;
+    uint32_t   max_entries;
+    uint64_t   memory;
+};
+
+struct ofl_exp_openflow_msg_table_memory {
+    struct ofl_exp_openflow_msg_header   header; /* OFP_EXT_TABLE_MEMORY_REPLY */
+
+    uint64_t   budget;
+    uint64_t   memory;
+    size_t     tables_num;
+    struct ofl_exp_openflow_table_memory *tables;
+};
+
+struct ofl_exp_openflow_stage {
+    uint8_t    stage;
+    uint32_t   threads;
+    uint32_t   capacity;
+    uint32_t   occupancy;
+    uint64_t   packets;
+    uint64_t   dropped;
+};
+
+struct ofl_exp_openflow_msg_stage_stats {
+    struct ofl_exp_openflow_msg_header   header; /* OFP_EXT_STAGE_STATS_REPLY */
+
+    size_t     stages_num;
+    struct ofl_exp_openflow_stage *stages;
+};
+
+struct ofl_exp_openflow_packet_pool {
+    char       name[16];
+    uint32_t   size;
+    uint32_t   free;
+    uint32_t   high_water;
+    uint64_t   packets;
+};
+
+struct ofl_exp_openflow_msg_packet_pool_stats {
+    struct ofl_exp_openflow_msg_header   header; /* OFP_EXT_PACKET_POOL_STATS_REPLY */
+
+    size_t     pools_num;
+    struct ofl_exp_openflow_packet_pool *pools;
+};
+
+struct ofl_exp_openflow_mp_request {
+    struct ofl_msg_multipart_request_experimenter   header; /* OPENFLOW_VENDOR_ID */
+
+    uint32_t   type;
+};
+
+struct ofl_exp_openflow_mp_reply {
+    struct ofl_msg_multipart_reply_experimenter   header; /* OPENFLOW_VENDOR_ID */
+
+    uint32_t   type;
+};
+
+struct ofl_exp_openflow_mp_table_lookup_stats_request {
+    struct ofl_exp_openflow_mp_request   header; /* OFP_EXT_MP_TABLE_LOOKUP_STATS */
+
+    uint8_t    table_id;
+};
+
+struct ofl_exp_openflow_table_lookup_stats {
+    uint8_t    table_id;
+    uint8_t    mode;
+    uint64_t   lookups;
+    uint64_t   hits;
+    uint64_t   probes;
+    uint64_t   cycles;
+    uint64_t   probe_hits[OFP_EXT_LOOKUP_PROBE_BUCKETS];
+    uint64_t   cycles_hist[OFP_EXT_LOOKUP_CYCLE_BUCKETS];
+    uint64_t   reorders;
+    uint64_t   before_lookups;
+    uint64_t   before_probes;
+    uint64_t   after_lookups;
+    uint64_t   after_probes;
+};
+
+struct ofl_exp_openflow_mp_table_lookup_stats_reply {
+    struct ofl_exp_openflow_mp_reply   header; /* OFP_EXT_MP_TABLE_LOOKUP_STATS */
+
+    size_t     tables_num;
+    struct ofl_exp_openflow_table_lookup_stats *tables;
+};
+
 
 int
 ofl_exp_openflow_msg_pack(struct ofl_msg_experimenter *msg, uint8_t **buf, size_t *buf_len);
@@ -71,5 +204,29 @@ ofl_exp_openflow_msg_free(struct ofl_msg_experimenter *msg);
 char *
 ofl_exp_openflow_msg_to_string(struct ofl_msg_experimenter *msg);
 
+int
+ofl_exp_openflow_stats_req_pack(struct ofl_msg_multipart_request_header *msg, uint8_t **buf, size_t *buf_len);
+
+ofl_err
+ofl_exp_openflow_stats_req_unpack(struct ofp_multipart_request *os, size_t *len, struct ofl_msg_multipart_request_header **msg);
+
+int
+ofl_exp_openflow_stats_req_free(struct ofl_msg_multipart_request_header *msg);
+
+char *
+ofl_exp_openflow_stats_req_to_string(struct ofl_msg_multipart_request_header *msg);
+
+int
+ofl_exp_openflow_stats_reply_pack(struct ofl_msg_multipart_reply_header *msg, uint8_t **buf, size_t *buf_len);
+
+ofl_err
+ofl_exp_openflow_stats_reply_unpack(struct ofp_multipart_reply *os, size_t *len, struct ofl_msg_multipart_reply_header **msg);
+
+int
+ofl_exp_openflow_stats_reply_free(struct ofl_msg_multipart_reply_header *msg);
+
+char *
+ofl_exp_openflow_stats_reply_to_string(struct ofl_msg_multipart_reply_header *msg);
+
 
 #endif /* OFL_EXP_OPENFLOW_H */
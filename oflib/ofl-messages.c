@@ -180,7 +180,7 @@ ofl_msg_free_multipart_reply(struct ofl_msg_multipart_reply_header *msg, struct
             break;        
         }
         case OFPMP_EXPERIMENTER: {
-            if (exp == NULL || exp->stats || exp->stats->reply_free == NULL) {
+            if (exp == NULL || exp->stats == NULL || exp->stats->reply_free == NULL) {
                 OFL_LOG_WARN(LOG_MODULE, "Trying to free EXPERIMENTER stats reply, but no callback was given.");
                 break;
             }
@@ -0,0 +1,42 @@
+#
+# Unit tests, run by "make check"
+#
+
+check_PROGRAMS += tests/test-ring
+TESTS += tests/test-ring
+tests_test_ring_SOURCES = tests/test-ring.c tests/test-utils.h
+tests_test_ring_LDADD = lib/libopenflow.a
+
+# Built by "make check", but not run: see the usage in the source.
+check_PROGRAMS += tests/bench-ring
+tests_bench_ring_SOURCES = tests/bench-ring.c
+tests_bench_ring_LDADD = lib/libopenflow.a
+
+check_LIBRARIES += tests/libudatapath-test.a
+
+tests_libudatapath_test_a_SOURCES = $(udatapath_common_sources)
+tests_libudatapath_test_a_CPPFLAGS = $(AM_CPPFLAGS)
+
+tests_udatapath_LDADD = \
+	tests/libudatapath-test.a \
+	oflib/liboflib.a \
+	oflib-exp/liboflib_exp.a \
+	oflib/liboflib.a \
+	lib/libopenflow.a \
+	$(udatapath_nbee_link_LIBS) \
+	$(SSL_LIBS) \
+	$(FAULT_LIBS)
+
+check_PROGRAMS += tests/test-flow-cache
+TESTS += tests/test-flow-cache
+tests_test_flow_cache_SOURCES = tests/test-flow-cache.c tests/test-utils.h
+tests_test_flow_cache_CPPFLAGS = $(AM_CPPFLAGS) -I $(top_srcdir)/udatapath
+tests_test_flow_cache_LDADD = $(tests_udatapath_LDADD)
+nodist_EXTRA_tests_test_flow_cache_SOURCES = dummy.cxx
+
+check_PROGRAMS += tests/test-bundle
+TESTS += tests/test-bundle
+tests_test_bundle_SOURCES = tests/test-bundle.c tests/test-utils.h
+tests_test_bundle_CPPFLAGS = $(AM_CPPFLAGS) -I $(top_srcdir)/udatapath
+tests_test_bundle_LDADD = $(tests_udatapath_LDADD)
+nodist_EXTRA_tests_test_bundle_SOURCES = dummy.cxx
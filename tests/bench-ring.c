@@ -0,0 +1,158 @@
+/* Copyright (c) 2012, CPqD, Brazil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Throughput of the rings of lib/ring.c: producer threads hand pointers to
+ * consumer threads through a ring of 1024, in bursts of 1 and of 32, and
+ * the pointers moved per second are printed for each kind of ring.
+ *
+ * Usage: bench-ring [POINTERS]
+ *
+ * where POINTERS is the number of pointers each producer enqueues, 10
+ * million by default.  Run it on an otherwise idle machine with a core for
+ * every thread; spinning threads sharing a core measure the scheduler. */
+
+#include <config.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ring.h"
+#include "util.h"
+
+#define RING_SIZE 1024
+#define MAX_THREADS 4
+
+struct bench {
+    struct ring *ring;
+    uint64_t per_producer;      /* pointers each producer enqueues. */
+    uint64_t total;             /* pointers all producers enqueue. */
+    uint64_t consumed;          /* pointers dequeued so far. */
+    size_t burst;
+};
+
+static void *
+produce(void *b_)
+{
+    struct bench *b = b_;
+    void *objs[32];
+    uint64_t i = 0;
+    size_t j;
+
+    for (j = 0; j < b->burst; j++) {
+        objs[j] = (void *) (uintptr_t) (j + 1);
+    }
+    while (i < b->per_producer) {
+        size_t n = MIN(b->burst, b->per_producer - i);
+        size_t done = ring_enqueue_burst(b->ring, objs, n);
+
+        if (done == 0) {
+            sched_yield();
+        }
+        i += done;
+    }
+    return NULL;
+}
+
+static void *
+consume(void *b_)
+{
+    struct bench *b = b_;
+    void *objs[32];
+
+    while (__atomic_load_n(&b->consumed, __ATOMIC_RELAXED) < b->total) {
+        size_t done = ring_dequeue_burst(b->ring, objs, b->burst);
+
+        if (done == 0) {
+            sched_yield();
+            continue;
+        }
+        __atomic_add_fetch(&b->consumed, done, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+run(const char *name, int n_producers, int n_consumers, int flags,
+    size_t burst, uint64_t per_producer)
+{
+    pthread_t threads[2 * MAX_THREADS];
+    struct bench b;
+    double start, secs;
+    int i;
+
+    b.ring = ring_create(RING_SIZE, flags);
+    b.per_producer = per_producer;
+    b.total = per_producer * n_producers;
+    b.consumed = 0;
+    b.burst = burst;
+
+    start = now();
+    for (i = 0; i < n_producers + n_consumers; i++) {
+        if (pthread_create(&threads[i], NULL,
+                           i < n_producers ? produce : consume, &b)) {
+            ofp_fatal(0, "pthread_create failed");
+        }
+    }
+    for (i = 0; i < n_producers + n_consumers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    secs = now() - start;
+
+    printf("%-6s %dx%d  burst %2zu  %8.2f Mpointers/s\n", name,
+           n_producers, n_consumers, burst, b.total / secs / 1e6);
+    ring_destroy(b.ring);
+}
+
+int
+main(int argc, char *argv[])
+{
+    uint64_t per_producer = argc > 1 ? strtoull(argv[1], NULL, 10) : 10000000;
+    size_t bursts[] = { 1, 32 };
+    size_t i;
+
+    set_program_name(argv[0]);
+    for (i = 0; i < ARRAY_SIZE(bursts); i++) {
+        run("spsc", 1, 1, RING_SPSC, bursts[i], per_producer);
+        run("mpmc", 1, 1, 0, bursts[i], per_producer);
+        run("mpmc", 2, 2, 0, bursts[i], per_producer / 2);
+        run("mpmc", 4, 1, 0, bursts[i], per_producer / 4);
+    }
+    return 0;
+}
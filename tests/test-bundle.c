@@ -0,0 +1,182 @@
+/* Copyright (c) 2012, CPqD, Brazil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Commits batches of flow mods, as bundles do, which fail on the tables as
+ * their own earlier mods leave them, and checks that none of their mods is
+ * applied then. */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "compiler.h"
+#include "datapath.h"
+#include "flow_table.h"
+#include "pipeline.h"
+#include "test-utils.h"
+#include "timeval.h"
+#include "util.h"
+#include "vlog.h"
+#include "oflib/ofl-actions.h"
+
+/* Adds an instruction applying an output to the group to the flow mod. */
+static void
+add_group(struct ofl_msg_flow_mod *mod, uint32_t group_id) {
+    struct ofl_instruction_actions *inst = xmalloc(sizeof *inst);
+    struct ofl_action_group *act = xmalloc(sizeof *act);
+
+    act->header.type = OFPAT_GROUP;
+    act->group_id = group_id;
+    inst->header.type = OFPIT_APPLY_ACTIONS;
+    inst->actions_num = 1;
+    inst->actions = xmalloc(sizeof *inst->actions);
+    inst->actions[0] = &act->header;
+    add_instruction(mod, &inst->header);
+}
+
+/* Adds a meter instruction to the flow mod. */
+static void
+add_meter(struct ofl_msg_flow_mod *mod, uint32_t meter_id) {
+    struct ofl_instruction_meter *inst = xmalloc(sizeof *inst);
+
+    inst->header.type = OFPIT_METER;
+    inst->meter_id = meter_id;
+    add_instruction(mod, &inst->header);
+}
+
+static ofl_err
+commit(struct pipeline *pl, struct ofl_msg_flow_mod **mods, size_t n) {
+    return pipeline_commit_flow_mods(pl, mods, n);
+}
+
+static bool
+has_entry(struct pipeline *pl, uint32_t in_port) {
+    struct ofl_msg_flow_mod *mod = make_flow_mod(0, OFPFC_ADD, in_port, 0);
+    bool found;
+
+    found = flow_index_find_strict(&pl->tables[0]->index, mod->match,
+                                   mod->priority) != NULL;
+    ofl_msg_free((struct ofl_msg_header *)mod, NULL);
+    return found;
+}
+
+static size_t
+entries(struct pipeline *pl) {
+    return pl->tables[0]->stats->active_count;
+}
+
+/* Leaves table 0 with entries for ports 1 and 2 only. */
+static void
+reset(struct pipeline *pl) {
+    struct ofl_msg_flow_mod *mods[3];
+
+    mods[0] = make_flow_mod(0, OFPFC_DELETE, 0, 0);
+    mods[1] = make_flow_mod(0, OFPFC_ADD, 1, 0);
+    mods[2] = make_flow_mod(0, OFPFC_ADD, 2, 0);
+    CHECK(commit(pl, mods, 3) == 0);
+    CHECK(entries(pl) == 2);
+}
+
+int
+main(int argc UNUSED, char *argv[]) {
+    struct ofl_msg_flow_mod *mods[4];
+    struct datapath *dp;
+    struct pipeline *pl;
+    size_t memory;
+
+    set_program_name(argv[0]);
+    time_init();
+    vlog_init();
+    dp = dp_new();
+    pl = dp->pipeline;
+    pipeline_set_max_entries(pl, 0, 3);
+
+    /* Deleting one entry of a table makes room for one add, not two. */
+    reset(pl);
+    mods[0] = make_flow_mod(0, OFPFC_DELETE_STRICT, 1, 0);
+    mods[1] = make_flow_mod(0, OFPFC_ADD, 3, 0);
+    mods[2] = make_flow_mod(0, OFPFC_ADD, 4, 0);
+    mods[3] = make_flow_mod(0, OFPFC_ADD, 5, 0);
+    CHECK(commit(pl, mods, 4) == ofl_error(OFPET_FLOW_MOD_FAILED, OFPFMFC_TABLE_FULL));
+    CHECK(entries(pl) == 2 && has_entry(pl, 1) && !has_entry(pl, 3));
+
+    mods[0] = make_flow_mod(0, OFPFC_DELETE_STRICT, 1, 0);
+    mods[1] = make_flow_mod(0, OFPFC_ADD, 3, 0);
+    mods[2] = make_flow_mod(0, OFPFC_ADD, 4, 0);
+    CHECK(commit(pl, mods, 3) == 0);
+    CHECK(entries(pl) == 3 && !has_entry(pl, 1) && has_entry(pl, 4));
+
+    /* An entry added twice takes room once. */
+    reset(pl);
+    mods[0] = make_flow_mod(0, OFPFC_ADD, 3, 0);
+    mods[1] = make_flow_mod(0, OFPFC_ADD, 3, 0);
+    CHECK(commit(pl, mods, 2) == 0);
+    CHECK(entries(pl) == 3);
+
+    /* Entries added by the batch are checked against each other... */
+    reset(pl);
+    mods[0] = make_flow_mod(0, OFPFC_DELETE, 0, 0);
+    mods[1] = make_flow_mod(0, OFPFC_ADD, 3, 0);
+    mods[2] = make_flow_mod(0, OFPFC_ADD, 0, OFPFF_CHECK_OVERLAP);
+    CHECK(commit(pl, mods, 3) == ofl_error(OFPET_FLOW_MOD_FAILED, OFPFMFC_OVERLAP));
+    CHECK(entries(pl) == 2 && has_entry(pl, 1) && !has_entry(pl, 3));
+
+    /* ...and not against the entries it deleted before. */
+    mods[0] = make_flow_mod(0, OFPFC_DELETE, 0, 0);
+    mods[1] = make_flow_mod(0, OFPFC_ADD, 0, OFPFF_CHECK_OVERLAP);
+    CHECK(commit(pl, mods, 2) == 0);
+    CHECK(entries(pl) == 1 && has_entry(pl, 0));
+
+    /* The memory budget holds for batches which also delete. */
+    reset(pl);
+    memory = pipeline_memory_used(pl);
+    pipeline_set_memory_budget(pl, memory + memory / 4);
+    mods[0] = make_flow_mod(0, OFPFC_DELETE_STRICT, 1, 0);
+    mods[1] = make_flow_mod(0, OFPFC_ADD, 3, 0);
+    mods[2] = make_flow_mod(0, OFPFC_ADD, 4, 0);
+    CHECK(commit(pl, mods, 3) == ofl_error(OFPET_FLOW_MOD_FAILED, OFPFMFC_TABLE_FULL));
+    CHECK(entries(pl) == 2 && has_entry(pl, 1) && !has_entry(pl, 3));
+    pipeline_set_memory_budget(pl, 0);
+
+    /* Groups and meters referred to must exist at commit. */
+    reset(pl);
+    mods[0] = make_flow_mod(0, OFPFC_DELETE_STRICT, 1, 0);
+    mods[1] = make_flow_mod(0, OFPFC_ADD, 3, 0);
+    add_group(mods[1], 7);
+    CHECK(commit(pl, mods, 2) == ofl_error(OFPET_BAD_ACTION, OFPBAC_BAD_OUT_GROUP));
+    CHECK(entries(pl) == 2 && has_entry(pl, 1) && !has_entry(pl, 3));
+
+    mods[0] = make_flow_mod(0, OFPFC_DELETE_STRICT, 1, 0);
+    mods[1] = make_flow_mod(0, OFPFC_ADD, 3, 0);
+    add_meter(mods[1], 7);
+    CHECK(commit(pl, mods, 2) == ofl_error(OFPET_METER_MOD_FAILED, OFPMMFC_UNKNOWN_METER));
+    CHECK(entries(pl) == 2 && has_entry(pl, 1) && !has_entry(pl, 3));
+
+    return failures != 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,129 @@
+/* Copyright (c) 2012, CPqD, Brazil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Runs packets of flows whose microflows share a cache slot through the
+ * pipeline in the same batch, and checks each one follows its own path. */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "compiler.h"
+#include "datapath.h"
+#include "dp_buffers.h"
+#include "flow_table.h"
+#include "ofpbuf.h"
+#include "packet.h"
+#include "pipeline.h"
+#include "test-utils.h"
+#include "timeval.h"
+#include "util.h"
+#include "vlog.h"
+
+/* Adds an instruction going on to 'table_id' to the flow mod. */
+static void
+add_goto(struct ofl_msg_flow_mod *mod, uint8_t table_id) {
+    struct ofl_instruction_goto_table *inst = xmalloc(sizeof *inst);
+
+    inst->header.type = OFPIT_GOTO_TABLE;
+    inst->table_id = table_id;
+    add_instruction(mod, &inst->header);
+}
+
+static struct packet *
+make_packet(struct datapath *dp, uint32_t in_port) {
+    static const uint8_t frame[] = {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x02,     /* eth_dst */
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x01,     /* eth_src */
+        0x88, 0xb5,                             /* eth_type */
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    };
+    struct ofpbuf *buf = ofpbuf_new(sizeof frame);
+
+    ofpbuf_put(buf, frame, sizeof frame);
+    return packet_create(dp, in_port, buf, false);
+}
+
+static uint64_t
+matched(struct datapath *dp, uint8_t table_id) {
+    return dp->pipeline->tables[table_id]->stats->matched_count;
+}
+
+int
+main(int argc UNUSED, char *argv[]) {
+    struct datapath *dp;
+    struct pipeline *pl;
+    struct ofl_msg_flow_mod *mods[3];
+    struct packet *pkts[2];
+
+    set_program_name(argv[0]);
+    time_init();
+    vlog_init();
+    dp = dp_new();
+    pl = dp->pipeline;
+
+    /* A single slot, which every microflow maps to. */
+    pipeline_set_flow_cache(pl, 1, 0);
+
+    /* Port 1 goes through tables 0 and 1, port 2 through table 0 only. */
+    mods[0] = make_flow_mod(0, OFPFC_ADD, 1, 0);
+    add_goto(mods[0], 1);
+    mods[1] = make_flow_mod(0, OFPFC_ADD, 2, 0);
+    mods[2] = make_flow_mod(1, OFPFC_ADD, 0, 0);
+    CHECK(pipeline_commit_flow_mods(pl, mods, 3) == 0);
+
+    /* Caches the path of port 1. */
+    pkts[0] = make_packet(dp, 1);
+    pipeline_process_batch(pl, pl->cache, pkts, 1);
+    CHECK(matched(dp, 0) == 1);
+    CHECK(matched(dp, 1) == 1);
+
+    /* The packet of port 1 replays the cached path, while the one of port 2
+     * misses and stores its shorter path in the same slot, before the first
+     * packet reaches table 1. */
+    pkts[0] = make_packet(dp, 1);
+    pkts[1] = make_packet(dp, 2);
+    pipeline_process_batch(pl, pl->cache, pkts, 2);
+    CHECK(matched(dp, 0) == 3);
+    CHECK(matched(dp, 1) == 2);
+
+    /* And the other way round. */
+    pkts[0] = make_packet(dp, 2);
+    pkts[1] = make_packet(dp, 1);
+    pipeline_process_batch(pl, pl->cache, pkts, 2);
+    CHECK(matched(dp, 0) == 5);
+    CHECK(matched(dp, 1) == 3);
+
+    return failures != 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,324 @@
+/* Copyright (c) 2012, CPqD, Brazil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Checks the rings of lib/ring.c: partial bursts and wraparound on a single
+ * thread, the wakeups of blocking rings, and then producer and consumer
+ * threads hammering small rings, every pointer being dequeued exactly once
+ * and in the order of its producer. */
+
+#include <config.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "compiler.h"
+#include "ring.h"
+#include "test-utils.h"
+#include "util.h"
+
+/* Pointers are never null: values start at 1. */
+#define VALUE(N) ((void *) (uintptr_t) ((N) + 1))
+#define NUMBER(P) ((uintptr_t) (P) - 1)
+
+/* Returns true if the fd of the ring is readable right now. */
+static bool
+woken(const struct ring *ring)
+{
+    struct pollfd pfd = { ring_fd(ring), POLLIN, 0 };
+
+    return poll(&pfd, 1, 0) == 1;
+}
+
+/* Moves pointers through a ring of 8 for many laps, in bursts of sizes
+ * which do not divide the capacity, so that they straddle its end and
+ * find it too full or too empty for all of them. */
+static void
+test_bursts(int flags)
+{
+    struct ring *ring = ring_create(5, flags);
+    size_t capacity = ring_capacity(ring);
+    uint64_t next_in = 0, next_out = 0;
+    int i;
+
+    CHECK(capacity == 8);
+    CHECK(ring_dequeue(ring) == NULL);
+
+    for (i = 0; i < 10000; i++) {
+        void *objs[16];
+        size_t count = next_in - next_out;
+        size_t n = 1 + i % 11;
+        size_t done, j;
+
+        for (j = 0; j < n; j++) {
+            objs[j] = VALUE(next_in + j);
+        }
+        done = ring_enqueue_burst(ring, objs, n);
+        CHECK(done == MIN(n, capacity - count));
+        next_in += done;
+        CHECK(ring_count(ring) == next_in - next_out);
+
+        count = next_in - next_out;
+        n = 1 + (i * 7) % 13;
+        done = ring_dequeue_burst(ring, objs, n);
+        CHECK(done == MIN(n, count));
+        for (j = 0; j < done; j++) {
+            CHECK(NUMBER(objs[j]) == next_out + j);
+        }
+        next_out += done;
+        CHECK(ring_count(ring) == next_in - next_out);
+    }
+
+    /* Single pointers: full and empty. */
+    while (ring_enqueue(ring, VALUE(next_in))) {
+        next_in++;
+    }
+    CHECK(ring_count(ring) == capacity);
+    while (next_out < next_in) {
+        void *p = ring_dequeue(ring);
+
+        CHECK(p != NULL && NUMBER(p) == next_out);
+        next_out++;
+    }
+    CHECK(ring_dequeue(ring) == NULL);
+    CHECK(ring_count(ring) == 0);
+    ring_destroy(ring);
+}
+
+/* Checks when the fd of a blocking ring becomes readable. */
+static void
+test_wakeup(int flags)
+{
+    struct ring *ring = ring_create(4, flags | RING_BLOCKING);
+    uint64_t count;
+    void *p;
+
+    CHECK(ring_fd(ring) >= 0);
+    CHECK(!woken(ring));
+
+    /* Armed on an empty ring: woken by the next enqueue only. */
+    CHECK(ring_arm(ring));
+    CHECK(!woken(ring));
+    CHECK(ring_enqueue(ring, VALUE(0)));
+    CHECK(woken(ring));
+
+    /* Not armed on a ring holding pointers; a stale wakeup is cleared. */
+    CHECK(!ring_arm(ring));
+    CHECK(!woken(ring));
+    p = ring_dequeue(ring);
+    CHECK(p != NULL && NUMBER(p) == 0);
+
+    /* Armed once, woken once: the second enqueue does not write. */
+    CHECK(ring_arm(ring));
+    CHECK(ring_enqueue(ring, VALUE(1)));
+    CHECK(ring_enqueue(ring, VALUE(2)));
+    CHECK(read(ring_fd(ring), &count, sizeof count) == sizeof count);
+    CHECK(count == 1);
+
+    /* A burst wakes like a single pointer. */
+    while (ring_dequeue(ring) != NULL) {
+        continue;
+    }
+    CHECK(ring_arm(ring));
+    {
+        void *objs[3] = { VALUE(3), VALUE(4), VALUE(5) };
+
+        CHECK(ring_enqueue_burst(ring, objs, 3) == 3);
+    }
+    CHECK(woken(ring));
+    ring_destroy(ring);
+}
+
+#define MAX_THREADS 8
+#define PER_PRODUCER 200000
+
+struct stress {
+    struct ring *ring;
+    int n_producers;
+    int n_consumers;
+    uint64_t total;             /* pointers all producers enqueue. */
+    uint64_t consumed;          /* pointers dequeued so far. */
+    uint8_t *seen;              /* times each pointer was dequeued. */
+};
+
+struct stress_thread {
+    struct stress *stress;
+    pthread_t thread;
+    int id;
+};
+
+/* Producer 'id' enqueues the numbers id, id + n_producers, ... in bursts
+ * of 1 to 7 pointers, retrying what does not fit. */
+static void *
+produce(void *t_)
+{
+    struct stress_thread *t = t_;
+    struct stress *s = t->stress;
+    uint64_t i = 0;
+
+    while (i < PER_PRODUCER) {
+        void *objs[7];
+        size_t n = MIN(1 + i % 7, PER_PRODUCER - i);
+        size_t j, done;
+
+        for (j = 0; j < n; j++) {
+            objs[j] = VALUE((i + j) * s->n_producers + t->id);
+        }
+        done = ring_enqueue_burst(s->ring, objs, n);
+        if (done < n) {
+            sched_yield();
+        }
+        i += done;
+    }
+    return NULL;
+}
+
+/* Waits for pointers in a blocking ring. A single consumer has nobody else
+ * to take the pointers it was woken for, so it must never time out with
+ * pointers in the ring; several consumers wait a short while, as another
+ * one may take the last pointers. */
+static void
+consumer_wait(struct stress *s)
+{
+    if (ring_arm(s->ring)) {
+        struct pollfd pfd = { ring_fd(s->ring), POLLIN, 0 };
+        int timeout = s->n_consumers == 1 ? 5000 : 10;
+
+        if (poll(&pfd, 1, timeout) == 0 && s->n_consumers == 1) {
+            CHECK(ring_count(s->ring) == 0);
+        }
+    }
+}
+
+static void *
+consume(void *t_)
+{
+    struct stress_thread *t = t_;
+    struct stress *s = t->stress;
+    uint64_t last[MAX_THREADS];
+    bool blocking = ring_fd(s->ring) >= 0;
+    size_t n = 1;
+
+    memset(last, 0, sizeof last);
+    while (__atomic_load_n(&s->consumed, __ATOMIC_RELAXED) < s->total) {
+        void *objs[16];
+        size_t done, j;
+
+        /* Bursts of 1 to 16 pointers. */
+        n = n % 16 + 1;
+        done = ring_dequeue_burst(s->ring, objs, n);
+        if (done == 0) {
+            if (blocking) {
+                consumer_wait(s);
+            } else {
+                sched_yield();
+            }
+            continue;
+        }
+        for (j = 0; j < done; j++) {
+            uint64_t number = NUMBER(objs[j]);
+            int producer = number % s->n_producers;
+            uint64_t seq = number / s->n_producers + 1;
+
+            CHECK(number < s->total);
+            if (number < s->total) {
+                __atomic_add_fetch(&s->seen[number], 1, __ATOMIC_RELAXED);
+            }
+            /* A consumer sees the pointers of a producer in order. */
+            CHECK(seq > last[producer]);
+            last[producer] = seq;
+        }
+        __atomic_add_fetch(&s->consumed, done, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+static void
+test_threads(int n_producers, int n_consumers, int flags)
+{
+    struct stress_thread threads[2 * MAX_THREADS];
+    struct stress s;
+    uint64_t i;
+    int j;
+
+    s.ring = ring_create(16, flags);
+    s.n_producers = n_producers;
+    s.n_consumers = n_consumers;
+    s.total = (uint64_t) n_producers * PER_PRODUCER;
+    s.consumed = 0;
+    s.seen = xcalloc(s.total, 1);
+
+    for (j = 0; j < n_producers + n_consumers; j++) {
+        threads[j].stress = &s;
+        threads[j].id = j < n_producers ? j : j - n_producers;
+        if (pthread_create(&threads[j].thread, NULL,
+                           j < n_producers ? produce : consume, &threads[j])) {
+            ofp_fatal(0, "pthread_create failed");
+        }
+    }
+    for (j = 0; j < n_producers + n_consumers; j++) {
+        pthread_join(threads[j].thread, NULL);
+    }
+
+    for (i = 0; i < s.total; i++) {
+        if (s.seen[i] != 1) {
+            fprintf(stderr, "pointer %"PRIu64" dequeued %d times\n",
+                    i, s.seen[i]);
+            failures++;
+            break;
+        }
+    }
+    CHECK(ring_count(s.ring) == 0);
+    free(s.seen);
+    ring_destroy(s.ring);
+}
+
+int
+main(int argc UNUSED, char *argv[])
+{
+    set_program_name(argv[0]);
+
+    test_bursts(0);
+    test_bursts(RING_SPSC);
+    test_wakeup(0);
+    test_wakeup(RING_SPSC);
+
+    test_threads(1, 1, RING_SPSC);
+    test_threads(1, 1, RING_SPSC | RING_BLOCKING);
+    test_threads(1, 1, 0);
+    test_threads(4, 1, RING_BLOCKING);
+    test_threads(4, 4, 0);
+    test_threads(4, 4, RING_BLOCKING);
+
+    return failures != 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
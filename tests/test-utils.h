@@ -0,0 +1,87 @@
+/* Copyright (c) 2012, CPqD, Brazil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Helpers shared by the unit tests. */
+
+#ifndef TEST_UTILS_H
+#define TEST_UTILS_H 1
+
+#include <stdint.h>
+#include <stdio.h>
+#include "util.h"
+#include "oflib/ofl-messages.h"
+#include "oflib/ofl-structs.h"
+#include "oflib/oxm-match.h"
+
+static int failures;
+
+/* Reports a failed check and carries on. Safe to use from several threads. */
+#define CHECK(COND)                                                     \
+    do {                                                                \
+        if (!(COND)) {                                                  \
+            fprintf(stderr, "%s:%d: check failed: %s\n",                \
+                    __FILE__, __LINE__, #COND);                         \
+            __atomic_add_fetch(&failures, 1, __ATOMIC_RELAXED);         \
+        }                                                               \
+    } while (0)
+
+/* Returns a flow mod for the entries of 'table_id' matching 'in_port', or
+ * every packet if 'in_port' is zero, with no instructions. */
+static inline struct ofl_msg_flow_mod *
+make_flow_mod(uint8_t table_id, enum ofp_flow_mod_command command,
+              uint32_t in_port, uint16_t flags) {
+    struct ofl_msg_flow_mod *mod = xcalloc(1, sizeof *mod);
+    struct ofl_match *match = xmalloc(sizeof *match);
+
+    ofl_structs_match_init(match);
+    if (in_port != 0) {
+        ofl_structs_match_put32(match, OXM_OF_IN_PORT, in_port);
+    }
+    mod->header.type = OFPT_FLOW_MOD;
+    mod->table_id = table_id;
+    mod->command = command;
+    mod->priority = 100;
+    mod->buffer_id = OFP_NO_BUFFER;
+    mod->out_port = OFPP_ANY;
+    mod->out_group = OFPG_ANY;
+    mod->flags = flags;
+    mod->match = (struct ofl_match_header *)match;
+    return mod;
+}
+
+/* Appends 'inst' to the instructions of the flow mod. */
+static inline void
+add_instruction(struct ofl_msg_flow_mod *mod,
+                struct ofl_instruction_header *inst) {
+    mod->instructions = xrealloc(mod->instructions, (mod->instructions_num + 1)
+                                                    * sizeof *mod->instructions);
+    mod->instructions[mod->instructions_num++] = inst;
+}
+
+#endif /* TEST_UTILS_H */
@@ -47,13 +47,6 @@ static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(60, 60);
 
 struct action_set_entry;
 
-struct action_set {
-    struct list     actions;   /* the list of actions in the action set,
-+                                   stored in the order of precedence as defined
-+                                   by the specification. */
-    struct ofl_exp *exp;       /* experimenter callbacks */
-};
-
 struct action_set_entry {
     struct list                node;
 
@@ -95,17 +88,27 @@ action_set_order(struct ofl_action_header *act) {
 
 
 /* Creates a new set entry */
+void
+action_set_init(struct action_set *set, struct ofl_exp *exp) {
+    list_init(&set->actions);
+    set->exp = exp;
+}
+
+void
+action_set_uninit(struct action_set *set) {
+    action_set_clear_actions(set);
+}
+
 struct action_set *
 action_set_create(struct ofl_exp *exp) {
     struct action_set *set = xmalloc(sizeof(struct action_set));
-    list_init(&set->actions);
-    set->exp = exp;
+    action_set_init(set, exp);
 
     return set;
 }
 
 void action_set_destroy(struct action_set *set) {
-    action_set_clear_actions(set);
+    action_set_uninit(set);
     free(set);
 }
 
@@ -35,12 +35,12 @@
 #include <sys/types.h>
 #include <stdio.h>
 #include "datapath.h"
+#include "list.h"
 #include "packet.h"
 #include "oflib/ofl.h"
 #include "oflib/ofl-actions.h"
 #include "oflib/ofl-structs.h"
 
-struct action_set;
 struct datapath;
 struct packet;
 
@@ -49,6 +49,22 @@ struct packet;
  * Implementation of an action set associated with a datapath packet
  ****************************************************************************/
 
+struct action_set {
+    struct list     actions;   /* the list of actions in the action set,
+                                  stored in the order of precedence as defined
+                                  by the specification. */
+    struct ofl_exp *exp;       /* experimenter callbacks */
+};
+
+/* Initializes an empty action set in memory owned by the caller, e.g. as part
+ * of a packet. */
+void
+action_set_init(struct action_set *set, struct ofl_exp *exp);
+
+/* Frees the entries of an action set initialized with action_set_init. */
+void
+action_set_uninit(struct action_set *set);
+
 struct action_set *
 action_set_create(struct ofl_exp *exp);
 
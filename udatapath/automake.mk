@@ -5,9 +5,12 @@
 bin_PROGRAMS += udatapath/ofdatapath
 man_MANS += udatapath/ofdatapath.8
 
-udatapath_ofdatapath_SOURCES = \
+# Everything but main(), shared with the tests.
+udatapath_common_sources = \
 	udatapath/action_set.c \
 	udatapath/action_set.h \
+	udatapath/classifier.c \
+	udatapath/classifier.h \
 	udatapath/crc32.c \
 	udatapath/crc32.h \
 	udatapath/datapath.c \
@@ -16,16 +19,28 @@ udatapath_ofdatapath_SOURCES = \
 	udatapath/dp_actions.h \
 	udatapath/dp_buffers.c \
 	udatapath/dp_buffers.h \
+	udatapath/dp_bundle.c \
+	udatapath/dp_bundle.h \
 	udatapath/dp_control.c \
 	udatapath/dp_control.h \
 	udatapath/dp_exp.c \
 	udatapath/dp_exp.h \
 	udatapath/dp_ports.c \
 	udatapath/dp_ports.h \
+	udatapath/dp_workers.c \
+	udatapath/dp_workers.h \
+	udatapath/flow_cache.c \
+	udatapath/flow_cache.h \
 	udatapath/flow_table.c \
 	udatapath/flow_table.h \
 	udatapath/flow_entry.c \
 	udatapath/flow_entry.h \
+	udatapath/flow_exact.c \
+	udatapath/flow_exact.h \
+	udatapath/flow_index.c \
+	udatapath/flow_index.h \
+	udatapath/flow_lpm.c \
+	udatapath/flow_lpm.h \
 	udatapath/group_table.c \
 	udatapath/group_table.h \
 	udatapath/group_entry.c \
@@ -40,11 +55,24 @@ udatapath_ofdatapath_SOURCES = \
 	udatapath/packet.h \
 	udatapath/packet_handle_std.c \
     udatapath/packet_handle_std.h \
+	udatapath/packet_key.c \
+	udatapath/packet_key.h \
+	udatapath/packet_parser.c \
+	udatapath/packet_parser.h \
 	udatapath/pipeline.c \
 	udatapath/pipeline.h \
+	udatapath/timer_wheel.c \
+	udatapath/timer_wheel.h
+
+udatapath_ofdatapath_SOURCES = \
+	$(udatapath_common_sources) \
 	udatapath/udatapath.c
 
-udatapath_ofdatapath_LDADD = lib/libopenflow.a oflib/liboflib.a oflib-exp/liboflib_exp.a nbee_link/libnbee_link.a $(SSL_LIBS) $(FAULT_LIBS)
+if USE_NBEE
+udatapath_nbee_link_LIBS = nbee_link/libnbee_link.a
+endif
+
+udatapath_ofdatapath_LDADD = lib/libopenflow.a oflib/liboflib.a oflib-exp/liboflib_exp.a $(udatapath_nbee_link_LIBS) $(SSL_LIBS) $(FAULT_LIBS)
 udatapath_ofdatapath_CPPFLAGS = $(AM_CPPFLAGS)
 nodist_EXTRA_udatapath_ofdatapath_SOURCES = dummy.cxx
 
@@ -70,6 +98,8 @@ noinst_LIBRARIES += udatapath/libudatapath.a
 udatapath_libudatapath_a_SOURCES = \
 	udatapath/action_set.c \
 	udatapath/action_set.h \
+	udatapath/classifier.c \
+	udatapath/classifier.h \
 	udatapath/crc32.c \
 	udatapath/crc32.h \
 	udatapath/datapath.c \
@@ -78,14 +108,24 @@ udatapath_libudatapath_a_SOURCES = \
 	udatapath/dp_actions.h \
 	udatapath/dp_buffers.c \
 	udatapath/dp_buffers.h \
+	udatapath/dp_bundle.c \
+	udatapath/dp_bundle.h \
 	udatapath/dp_control.c \
 	udatapath/dp_control.h \
 	udatapath/dp_exp.c \
 	udatapath/dp_exp.h \
+	udatapath/dp_workers.c \
+	udatapath/dp_workers.h \
 	udatapath/flow_table.c \
 	udatapath/flow_table.h \
 	udatapath/flow_entry.c \
 	udatapath/flow_entry.h \
+	udatapath/flow_exact.c \
+	udatapath/flow_exact.h \
+	udatapath/flow_index.c \
+	udatapath/flow_index.h \
+	udatapath/flow_lpm.c \
+	udatapath/flow_lpm.h \
 	udatapath/group_table.c \
 	udatapath/group_table.h \
 	udatapath/group_entry.c \
@@ -96,8 +136,14 @@ udatapath_libudatapath_a_SOURCES = \
 	udatapath/packet.h \
 	udatapath/packet_handle_std.c \
 	udatapath/packet_handle_std.h \
+	udatapath/packet_key.c \
+	udatapath/packet_key.h \
+	udatapath/packet_parser.c \
+	udatapath/packet_parser.h \
 	udatapath/pipeline.c \
 	udatapath/pipeline.h \
+	udatapath/timer_wheel.c \
+	udatapath/timer_wheel.h \
 	udatapath/udatapath.c
 
 udatapath_libudatapath_a_CPPFLAGS = $(AM_CPPFLAGS)
@@ -0,0 +1,157 @@
+/* Copyright (c) 2012, CPqD, Brazil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef CLASSIFIER_H
+#define CLASSIFIER_H 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "hmap.h"
+#include "list.h"
+#include "packet_key.h"
+#include "oflib/ofl-structs.h"
+
+/****************************************************************************
+ * Tuple space search classifier of the flow entries of a table.
+ *
+ * Each OXM match is compiled to a mask and a masked value over the words of
+ * the packet key; the first word (the presence bitmap) carries which fields
+ * must be present or absent. Rules with the same mask are grouped in a
+ * subtable, which hashes them by their masked value. A subtable keeps its
+ * mask for the lanes of the key it is not zero in, so probing it masks and
+ * compares whole lanes (words, or 16 bytes with SSE2). A lookup
+ * probes each subtable once, in descending order of the highest priority
+ * in the subtable, and stops as soon as no remaining subtable can hold a
+ * rule with a higher priority than the best match found so far. Among
+ * rules of equal priority, the one inserted first wins, as in the table's
+ * entry list.
+ *
+ * A rule known to overlap no other rule of its priority cannot tie, so a
+ * lookup matching it also skips the remaining subtables of that priority.
+ * Subtables of equal highest priority are probed in descending order of
+ * the hits credited to them, so the busy ones are probed first.
+ *
+ * The classifier also summarizes the values a few small, commonly matched
+ * fields take in its rules: a bitmap for one byte fields, a counting Bloom
+ * filter for the others. While every rule but those matching anything
+ * (such as a table miss entry) matches a field exactly, a key whose value
+ * of the field is not in the summary can only match those, and the lookup
+ * probes their subtable alone.
+ ****************************************************************************/
+
+#define CLS_KEY_WORDS (sizeof(struct packet_key) / sizeof(uint64_t))
+
+struct cls_subtable;
+struct cls_bucket;
+struct cls_filter;
+
+struct cls_rule {
+    struct list          node;      /* in the bucket, by priority and then
+                                       insertion order. */
+    struct cls_subtable *subtable;  /* NULL if the rule can never match. */
+    struct cls_bucket   *bucket;
+    uint16_t             priority;
+    uint64_t             seq;       /* insertion order. */
+    bool                 alone;     /* no rule of the same priority may
+                                       match a key this one matches; false
+                                       when inserted, set by the user. */
+};
+
+struct classifier {
+    struct hmap           subtables;  /* cls_subtable, hashed by mask. */
+    struct cls_subtable **ordered;    /* subtables by max priority, descending. */
+    size_t                n_ordered;
+    size_t                n_rules;    /* number of indexed rules. */
+    uint64_t              next_seq;
+    struct cls_filter    *filter;     /* field value summaries of the rules,
+                                         NULL until a rule is indexed. */
+};
+
+/* Initializes an empty classifier. */
+void
+classifier_init(struct classifier *cls);
+
+/* Frees the classifier. It must not hold any rules. */
+void
+classifier_destroy(struct classifier *cls);
+
+/* Compiles the match and inserts the rule behind the rules of equal
+ * priority. Rules with a match that can never be satisfied are recorded,
+ * but not indexed. */
+void
+classifier_insert(struct classifier *cls, struct cls_rule *rule,
+                  struct ofl_match_header *match, uint16_t priority);
+
+/* Inserts a rule given by a mask and value over the words of the packet
+ * key, behind the rules of equal priority. */
+void
+classifier_insert_masked(struct classifier *cls, struct cls_rule *rule,
+                         const uint64_t *mask, const uint64_t *value,
+                         uint16_t priority);
+
+/* Inserts the rule in place of the old one, which is removed. The new rule
+ * keeps the position of the old one among rules of equal priority. */
+void
+classifier_replace(struct classifier *cls, struct cls_rule *old,
+                   struct cls_rule *rule, struct ofl_match_header *match,
+                   uint16_t priority);
+
+/* Removes the rule from the classifier. */
+void
+classifier_remove(struct classifier *cls, struct cls_rule *rule);
+
+/* Credits hits to the subtable of the rule, for the next
+ * classifier_reorder(). */
+void
+classifier_add_hits(struct cls_rule *rule, uint64_t hits);
+
+/* Orders the subtables of equal highest priority by the hits credited to
+ * them, halving those of earlier rounds. Returns true if the order
+ * changed. */
+bool
+classifier_reorder(struct classifier *cls);
+
+/* Compiles the match to the mask and masked value (CLS_KEY_WORDS words
+ * each) the classifier indexes it by. Returns false if no packet can
+ * match. */
+bool
+classifier_compile(struct ofl_match_header *match, uint64_t *mask,
+                   uint64_t *value);
+
+/* Returns the rule with the highest priority matching the key, or NULL.
+ * If wc is not NULL, the bits of the key the lookup depended on are added
+ * to it (CLS_KEY_WORDS words); any key which agrees with this one on those
+ * bits gets the same result. If probes is not NULL, it is set to the number
+ * of subtables looked into. */
+struct cls_rule *
+classifier_lookup(const struct classifier *cls, const struct packet_key *key,
+                  uint64_t *wc, size_t *probes);
+
+#endif /* CLASSIFIER_H */
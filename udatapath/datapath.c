@@ -46,7 +46,9 @@
 #include <unistd.h>
 #include "csum.h"
 #include "dp_buffers.h"
+#include "dp_bundle.h"
 #include "dp_control.h"
+#include "dp_workers.h"
 #include "ofp.h"
 #include "ofpbuf.h"
 #include "group_table.h"
@@ -65,6 +67,9 @@
 #include "rconn.h"
 #include "stp.h"
 #include "vconn.h"
+#if defined(OF_HW_PLAT)
+#include "ring.h"
+#endif
 
 #define LOG_MODULE VLM_dp
 
@@ -95,11 +100,21 @@ static struct ofl_exp_msg dp_exp_msg =
          .free      = ofl_exp_msg_free,
          .to_string = ofl_exp_msg_to_string};
 
+static struct ofl_exp_stats dp_exp_multipart =
+        {.req_pack        = ofl_exp_stats_req_pack,
+         .req_unpack      = ofl_exp_stats_req_unpack,
+         .req_free        = ofl_exp_stats_req_free,
+         .req_to_string   = ofl_exp_stats_req_to_string,
+         .reply_pack      = ofl_exp_stats_reply_pack,
+         .reply_unpack    = ofl_exp_stats_reply_unpack,
+         .reply_free      = ofl_exp_stats_reply_free,
+         .reply_to_string = ofl_exp_stats_reply_to_string};
+
 static struct ofl_exp dp_exp =
         {.act   = NULL,
          .inst  = NULL,
          .match = NULL,
-         .stats = NULL,
+         .stats = &dp_exp_multipart,
          .msg   = &dp_exp_msg};
 
 /* Generates and returns a random datapath id. */
@@ -141,6 +156,7 @@ dp_new(void) {
 
     memset(dp->ports, 0x00, sizeof (dp->ports));
     dp->local_port = NULL;
+    dp->workers = NULL;
 
     dp->buffers = dp_buffers_create(dp);
     dp->pipeline = pipeline_create(dp);
@@ -199,11 +215,15 @@ dp_run(struct datapath *dp) {
 
     poll_timer_wait(100);
     dp_ports_run(dp);
+    dp_workers_run(dp);
 
     /* Talk to remotes. */
     LIST_FOR_EACH_SAFE (r, rn, struct remote, node, &dp->remotes) {
         remote_run(dp, r);
     }
+    /* Packets received from the next iteration on see the flow mods of
+     * this one. */
+    pipeline_publish(dp->pipeline);
 
     for (i = 0; i < dp->n_listeners; ) {
         struct pvconn *pvconn = dp->listeners[i];
@@ -342,6 +362,7 @@ remote_destroy(struct remote *r)
 	if(r->mp_req_msg != NULL) {
 	  ofl_msg_free((struct ofl_msg_header *) r->mp_req_msg, NULL);
 	}
+        dp_bundle_discard_all(&r->bundles);
         free(r);
     }
 }
@@ -359,6 +380,7 @@ remote_create(struct datapath *dp, struct rconn *rconn, struct rconn *rconn_aux)
     remote->mp_req_msg = NULL;
     remote->mp_req_xid = 0;  /* Currently not needed. Jean II. */
     remote->role = OFPCR_ROLE_EQUAL;
+    list_init(&remote->bundles);
     /* Set the remote configuration to receive any asynchronous message*/
     for(i = 0; i < 2; i++){
         memset(&remote->config.packet_in_mask[i], 0x7, sizeof(uint32_t));
@@ -377,11 +399,15 @@ dp_wait(struct datapath *dp)
     size_t i;
 
     LIST_FOR_EACH (p, struct sw_port, node, &dp->port_list) {
-        if (IS_HW_PORT(p)) {
+        if (IS_HW_PORT(p) || p->flags & SWP_WORKER_RECV) {
             continue;
         }
         netdev_recv_wait(p->netdev);
     }
+    dp_workers_wait(dp);
+#if defined(OF_HW_PLAT) && !defined(USE_NETDEV)
+    ring_wait(dp->hw_pkt_q);
+#endif
     LIST_FOR_EACH (r, struct remote, node, &dp->remotes) {
         remote_wait(r);
     }
@@ -430,6 +456,31 @@ dp_set_max_queues(struct datapath *dp, uint32_t max_queues) {
     dp->max_queues = max_queues;
 }
 
+void
+dp_set_flow_cache_size(struct datapath *dp, size_t size, size_t megaflows) {
+    pipeline_set_flow_cache(dp->pipeline, size, megaflows);
+}
+
+void
+dp_set_table_max_entries(struct datapath *dp, uint8_t table_id, uint32_t max_entries) {
+    pipeline_set_max_entries(dp->pipeline, table_id, max_entries);
+}
+
+void
+dp_set_flow_memory(struct datapath *dp, size_t budget) {
+    pipeline_set_memory_budget(dp->pipeline, budget);
+}
+
+void
+dp_set_lookup_stats(struct datapath *dp, bool enable) {
+    pipeline_set_lookup_stats(dp->pipeline, enable);
+}
+
+void
+dp_set_reorder_interval(struct datapath *dp, unsigned int secs) {
+    pipeline_set_reorder_interval(dp->pipeline, secs);
+}
+
 
 static int
 send_openflow_buffer_to_remote(struct ofpbuf *buffer, struct remote *remote) {
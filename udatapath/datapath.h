@@ -58,6 +58,8 @@
 struct rconn;
 struct pvconn;
 struct sender;
+struct dp_workers;
+struct ring;
 
 /****************************************************************************
  * The datapath
@@ -108,13 +110,15 @@ struct datapath {
     /* Experimenter handling. */
     struct ofl_exp  *exp;
 
+    struct dp_workers *workers; /* Worker threads, if any. */
+
 #if defined(OF_HW_PLAT)
     /* Although the chain maintains the pointer to the HW driver
      * for flow operations, the datapath needs the port functions
      * in the driver structure
      */
     of_hw_driver_t *hw_drv;
-    struct hw_pkt_q_entry *hw_pkt_list_head, *hw_pkt_list_tail;
+    struct ring *hw_pkt_q; /* Packets received by the HW driver thread. */
 #endif
 };
 
@@ -150,6 +154,8 @@ struct remote {
     /* Multipart request message pending reassembly. */
     struct ofl_msg_multipart_request_header *mp_req_msg; /* Message. */
     uint32_t mp_req_xid;     /* Multipart request OpenFlow transaction ID. */
+
+    struct list bundles;     /* Bundles opened on the connection. */
 };
 
 /* Creates a new datapath */
@@ -193,6 +199,29 @@ dp_set_serial_num(struct datapath *dp, char *serial_num);
 void
 dp_set_max_queues(struct datapath *dp, uint32_t max_queues);
 
+/* Sets the number of entries of the microflow and megaflow caches; zero
+ * disables the respective cache. */
+void
+dp_set_flow_cache_size(struct datapath *dp, size_t size, size_t megaflows);
+
+/* Sets the maximum number of entries of a flow table, or of all tables if
+ * table_id is OFPTT_ALL. */
+void
+dp_set_table_max_entries(struct datapath *dp, uint8_t table_id, uint32_t max_entries);
+
+/* Sets the number of bytes the flow entries may hold; zero means unlimited. */
+void
+dp_set_flow_memory(struct datapath *dp, size_t budget);
+
+/* Starts or stops counting the cost of the flow table lookups. */
+void
+dp_set_lookup_stats(struct datapath *dp, bool enable);
+
+/* Sets the number of seconds between reorderings of the flow tables by
+ * hits; zero disables them. */
+void
+dp_set_reorder_interval(struct datapath *dp, unsigned int secs);
+
 
 /* Sends the given OFLib message to the connection represented by sender,
  * or to all open connections, if sender is null. */
@@ -36,6 +36,7 @@
 #include "dp_exp.h"
 #include "dp_actions.h"
 #include "dp_buffers.h"
+#include "dp_workers.h"
 #include "datapath.h"
 #include "oflib/ofl.h"
 #include "oflib/ofl-actions.h"
@@ -69,19 +70,42 @@ output(struct packet *pkt, struct ofl_action_output *action) {
     }
 }
 
-/* Executes a set field action.
-TODO: if we use the the index structure to the packet fields
-revalidation is not needed  */
+/* Returns the depth a packet must be parsed to, before the given field can
+ * be set. Apart from the field itself, setting an IP address needs the
+ * transport header, to update its checksum. */
+static enum packet_parse_depth
+set_field_depth(uint8_t field) {
+    switch (field) {
+        case OFPXMT_OFB_IPV4_SRC:
+        case OFPXMT_OFB_IPV4_DST:
+        case OFPXMT_OFB_IPV6_SRC:
+        case OFPXMT_OFB_IPV6_DST:
+            return PACKET_PARSE_L4;
+        default:
+            /* The network headers are located at any depth. */
+            return field < PACKET_KEY_FIELDS
+                   && (PACKET_KEY_BIT(field) & PACKET_PARSE_L4_FIELDS)
+                   ? PACKET_PARSE_L4 : PACKET_PARSE_L2;
+    }
+}
 
+/* Executes a set field action. The header is rewritten in place, so the
+ * packet key is updated with the new value instead of parsing the packet
+ * again. */
 static void
 set_field(struct packet *pkt, struct ofl_action_set_field *act )
 {
-    packet_handle_std_validate(pkt->handle_std);
+    uint8_t field = OXM_FIELD(act->field->header);
+
+    packet_handle_std_validate_depth(pkt->handle_std, set_field_depth(field));
     if (pkt->handle_std->valid)
     {
+        /* Setting these fields changes how the rest of the packet is
+         * decoded. */
+        bool reparse = false;
+
         /*Field existence is guaranteed by the
         field pre-requisite on matching */
-        fprintf(stderr, "Header %d\n", OXM_FIELD(act->field->header));
         switch(act->field->header){
             case OXM_OF_ETH_DST:{
                 memcpy(pkt->handle_std->proto->eth->eth_dst,
@@ -96,6 +120,7 @@ set_field(struct packet *pkt, struct ofl_action_set_field *act )
             case OXM_OF_ETH_TYPE:{
                 uint16_t v = *((uint16_t*) act->field->value);
                 pkt->handle_std->proto->eth->eth_type = htons(v);
+                reparse = true;
                 break;
             }
             case OXM_OF_VLAN_VID:{
@@ -113,8 +138,8 @@ set_field(struct packet *pkt, struct ofl_action_set_field *act )
                 if(vlan != NULL){
                     vlan->vlan_tci = (vlan->vlan_tci & ~htons(VLAN_PCP_MASK))
                                     | htons(*act->field->value << VLAN_PCP_SHIFT);
-                    break;
                 }
+                break;
             }
             case OXM_OF_IP_DSCP:{
                 if (pkt->handle_std->proto->ipv4){
@@ -160,6 +185,7 @@ set_field(struct packet *pkt, struct ofl_action_set_field *act )
                 new_val =  htons((ipv4->ip_ttl << 8) + proto);
                 ipv4->ip_csum = recalc_csum16(ipv4->ip_csum, old_val, new_val);
                 ipv4->ip_proto = proto;
+                reparse = true;
                 break;
             }
             case OXM_OF_IPV4_SRC:{
@@ -384,6 +410,8 @@ set_field(struct packet *pkt, struct ofl_action_set_field *act )
                     icmp->icmp_csum = recalc_csum16(icmp->icmp_csum, old_val16, new_val16);
                     icmp->icmp_csum = recalc_csum32(icmp->icmp_csum, old_val32, new_val32);
                 }                                
+                /* The option rewritten might not be the one of the field. */
+                reparse = true;
                 break;
             }
             case OXM_OF_MPLS_LABEL:{
@@ -409,23 +437,23 @@ set_field(struct packet *pkt, struct ofl_action_set_field *act )
                 struct pbb_header *pbb = pkt->handle_std->proto->pbb;
                 uint8_t* pbb_isid;
                 pbb_isid = act->field->value; 
-                pbb->id = (pbb->id & 0xFF) | ((pbb_isid[2] << 24) | (pbb_isid[1] << 16) | (pbb_isid[1] << 8));                 
+                /* The I-SID is the low 24 bits of the I-TAG, in wire order. */
+                memcpy((uint8_t *)&pbb->id + 1, pbb_isid, PBB_ISID_LEN);
                 break;
             }
             case OXM_OF_TUNNEL_ID :{
-                struct  ofl_match_tlv *f;
-                HMAP_FOR_EACH_WITH_HASH(f, struct ofl_match_tlv,
-                    hmap_node, hash_int(OXM_OF_TUNNEL_ID, 0), &(pkt)->handle_std->match.match_fields){
-                    uint64_t *tunnel_id = (uint64_t*) f->value;
-                    *tunnel_id = *((uint64_t*) act->field->value);
-                }
+                /* Not a packet header, it only lives in the key. */
                 break;
             }
             default:
                 VLOG_WARN_RL(LOG_MODULE, &rl, "Trying to set unknow field.");
-                break;
+                return;
+        }
+        if (reparse) {
+            pkt->handle_std->valid = false;
+        } else if (packet_key_has(&pkt->handle_std->key, field)) {
+            packet_key_set_field(&pkt->handle_std->key, field, act->field->value);
         }
-        pkt->handle_std->valid = false;
         return;
     }
 
@@ -434,7 +462,7 @@ set_field(struct packet *pkt, struct ofl_action_set_field *act )
 /* Executes copy ttl out action.*/
 static void
 copy_ttl_out(struct packet *pkt, struct ofl_action_header *act UNUSED) {
-    packet_handle_std_validate(pkt->handle_std);
+    packet_handle_std_validate_depth(pkt->handle_std, PACKET_PARSE_L2);
     if (pkt->handle_std->proto->mpls != NULL) {
         struct mpls_header *mpls = pkt->handle_std->proto->mpls;        
         if ((ntohl(mpls->fields) & MPLS_S_MASK) == 0) {
@@ -467,7 +495,7 @@ copy_ttl_out(struct packet *pkt, struct ofl_action_header *act UNUSED) {
 /* Executes copy ttl in action. */
 static void
 copy_ttl_in(struct packet *pkt, struct ofl_action_header *act UNUSED) {
-    packet_handle_std_validate(pkt->handle_std);
+    packet_handle_std_validate_depth(pkt->handle_std, PACKET_PARSE_L2);
     if (pkt->handle_std->proto->mpls != NULL) {
         struct mpls_header *mpls = pkt->handle_std->proto->mpls;
 
@@ -508,8 +536,9 @@ copy_ttl_in(struct packet *pkt, struct ofl_action_header *act UNUSED) {
 static void
 push_vlan(struct packet *pkt, struct ofl_action_push *act) {
     // TODO Zoltan: if 802.3, check if new length is still valid
-    packet_handle_std_validate(pkt->handle_std);
+    packet_handle_std_validate_depth(pkt->handle_std, PACKET_PARSE_L2);
     if (pkt->handle_std->proto->eth != NULL) {
+        uint8_t *old_data = pkt->buffer->data;
         struct eth_header  *eth,  *new_eth;
         struct snap_header *snap, *new_snap;
         struct vlan_header *vlan, *new_vlan, *push_vlan;
@@ -567,9 +596,8 @@ push_vlan(struct packet *pkt, struct ofl_action_push *act) {
             new_eth->eth_type = ntohs(act->ethertype);
         }
 
-        // TODO Zoltan: This could be faster if VLAN match is updated
-        //              and proto pointers are shifted in case of realloc, ...
-        pkt->handle_std->valid = false;
+        packet_handle_std_headers_moved(pkt->handle_std, old_data, eth_size,
+                                        VLAN_HEADER_LEN, false);
 
     } else {
         VLOG_WARN_RL(LOG_MODULE, &rl, "Trying to execute push vlan action on packet with no eth.");
@@ -579,7 +607,7 @@ push_vlan(struct packet *pkt, struct ofl_action_push *act) {
 /*Executes pop vlan action. */
 static void
 pop_vlan(struct packet *pkt, struct ofl_action_header *act UNUSED) {
-    packet_handle_std_validate(pkt->handle_std);
+    packet_handle_std_validate_depth(pkt->handle_std, PACKET_PARSE_L2);
     if (pkt->handle_std->proto->eth != NULL && pkt->handle_std->proto->vlan != NULL) {
         struct eth_header *eth = pkt->handle_std->proto->eth;
         struct snap_header *eth_snap = pkt->handle_std->proto->eth_snap;
@@ -600,8 +628,8 @@ pop_vlan(struct packet *pkt, struct ofl_action_header *act UNUSED) {
 
         memmove(pkt->buffer->data, eth, move_size);
 
-        //TODO Zoltan: revalidating might not be necessary in all cases
-        pkt->handle_std->valid = false;
+        packet_handle_std_headers_moved(pkt->handle_std, (uint8_t *)eth, move_size,
+                                        -VLAN_HEADER_LEN, false);
     } else {
         VLOG_WARN_RL(LOG_MODULE, &rl, "Trying to execute POP_VLAN action on packet with no eth/vlan.");
     }
@@ -611,7 +639,7 @@ pop_vlan(struct packet *pkt, struct ofl_action_header *act UNUSED) {
 /*Executes set mpls ttl action.*/
 static void
 set_mpls_ttl(struct packet *pkt, struct ofl_action_mpls_ttl *act) {
-    packet_handle_std_validate(pkt->handle_std);
+    packet_handle_std_validate_depth(pkt->handle_std, PACKET_PARSE_L2);
     if (pkt->handle_std->proto->mpls != NULL) {
         struct mpls_header *mpls = pkt->handle_std->proto->mpls;
 
@@ -625,7 +653,7 @@ set_mpls_ttl(struct packet *pkt, struct ofl_action_mpls_ttl *act) {
 /*Executes dec mpls ttl action.*/
 static void
 dec_mpls_ttl(struct packet *pkt, struct ofl_action_header *act UNUSED) {
-    packet_handle_std_validate(pkt->handle_std);
+    packet_handle_std_validate_depth(pkt->handle_std, PACKET_PARSE_L2);
     if (pkt->handle_std->proto->mpls != NULL) {
         struct mpls_header *mpls = pkt->handle_std->proto->mpls;
 
@@ -643,8 +671,9 @@ dec_mpls_ttl(struct packet *pkt, struct ofl_action_header *act UNUSED) {
 static void
 push_mpls(struct packet *pkt, struct ofl_action_push *act) {
     // TODO Zoltan: if 802.3, check if new length is still valid
-    packet_handle_std_validate(pkt->handle_std);
+    packet_handle_std_validate_depth(pkt->handle_std, PACKET_PARSE_L2);
     if (pkt->handle_std->proto->eth != NULL) {
+        uint8_t *old_data = pkt->buffer->data;
         struct eth_header  *eth,  *new_eth;
         struct snap_header *snap, *new_snap;
         struct vlan_header *vlan, *new_vlan;
@@ -734,9 +763,9 @@ push_mpls(struct packet *pkt, struct ofl_action_push *act) {
             new_eth->eth_type = htons(ntohs(new_eth->eth_type) + MPLS_HEADER_LEN);
         }
 
-        // in 1.1 all proto but eth and mpls will be hidden,
-        // so revalidating won't be a tedious work (probably)
-        pkt->handle_std->valid = false;
+        // all proto but eth and mpls will be hidden
+        packet_handle_std_headers_moved(pkt->handle_std, old_data, head_offset,
+                                        MPLS_HEADER_LEN, true);
     } else {
         VLOG_WARN_RL(LOG_MODULE, &rl, "Trying to execute PUSH_MPLS action on packet with no eth.");
     }
@@ -745,7 +774,7 @@ push_mpls(struct packet *pkt, struct ofl_action_push *act) {
 /* Executes pop mpls action. */
 static void
 pop_mpls(struct packet *pkt, struct ofl_action_pop_mpls *act) {
-    packet_handle_std_validate(pkt->handle_std);
+    packet_handle_std_validate_depth(pkt->handle_std, PACKET_PARSE_L2);
     if (pkt->handle_std->proto->eth != NULL && pkt->handle_std->proto->mpls != NULL) {
         struct eth_header *eth = pkt->handle_std->proto->eth;
         struct snap_header *snap = pkt->handle_std->proto->eth_snap;
@@ -773,8 +802,9 @@ pop_mpls(struct packet *pkt, struct ofl_action_pop_mpls *act) {
             new_eth->eth_type = htons(ntohs(new_eth->eth_type) + MPLS_HEADER_LEN);
         }
 
-        //TODO Zoltan: revalidating might not be necessary at all cases
-        pkt->handle_std->valid = false;
+        // the next label, or the payload if it was the last one, is decoded
+        packet_handle_std_headers_moved(pkt->handle_std, (uint8_t *)eth, move_size,
+                                        -MPLS_HEADER_LEN, true);
     } else {
         VLOG_WARN_RL(LOG_MODULE, &rl, "Trying to execute POP_MPLS action on packet with no eth/mpls.");
     }
@@ -784,8 +814,9 @@ pop_mpls(struct packet *pkt, struct ofl_action_pop_mpls *act) {
 static void
 push_pbb(struct packet *pkt, struct ofl_action_push *act) {
     // TODO Zoltan: if 802.3, check if new length is still valid
-    packet_handle_std_validate(pkt->handle_std);
+    packet_handle_std_validate_depth(pkt->handle_std, PACKET_PARSE_L2);
     if (pkt->handle_std->proto->eth != NULL) {
+        uint8_t *old_data = pkt->buffer->data;
         struct eth_header  *eth,  *new_eth;
         struct snap_header *snap, *new_snap;
         struct pbb_header *pbb, *new_pbb, *push_pbb;
@@ -851,7 +882,10 @@ push_pbb(struct packet *pkt, struct ofl_action_push *act) {
             new_eth->eth_type = ntohs(act->ethertype);
         }
 
-        pkt->handle_std->valid = false;
+        // only the outermost PBB header is decoded, the payload is hidden
+        // behind the existing one
+        packet_handle_std_headers_moved(pkt->handle_std, old_data, eth_size,
+                                        PBB_HEADER_LEN, pbb != NULL);
 
     } else {
         VLOG_WARN_RL(LOG_MODULE, &rl, "Trying to execute push pbb action on packet with no eth.");
@@ -862,7 +896,7 @@ push_pbb(struct packet *pkt, struct ofl_action_push *act) {
 /*Executes pop pbb action. */
 static void
 pop_pbb(struct packet *pkt, struct ofl_action_header *act UNUSED) {
-    packet_handle_std_validate(pkt->handle_std);
+    packet_handle_std_validate_depth(pkt->handle_std, PACKET_PARSE_L2);
     if (pkt->handle_std->proto->eth != NULL && pkt->handle_std->proto->pbb != NULL) {
         struct eth_header *eth = pkt->handle_std->proto->eth;
         struct pbb_header *pbb = pkt->handle_std->proto->pbb;
@@ -875,7 +909,8 @@ pop_pbb(struct packet *pkt, struct ofl_action_header *act UNUSED) {
         memmove(pkt->buffer->data, pbb->c_eth_dst, (pkt->buffer->size - move_size));
         pkt->buffer->size -= move_size;
 
-        pkt->handle_std->valid = false;
+        packet_handle_std_headers_moved(pkt->handle_std, pkt->buffer->data, 0,
+                                        -(int)move_size, false);
     } else {
         VLOG_WARN_RL(LOG_MODULE, &rl, "Trying to execute POP_PBB action on packet with no PBB header.");
     }
@@ -898,7 +933,7 @@ group(struct packet *pkt, struct ofl_action_group *act) {
 TODO Set IPv6 hop limit*/
 static void
 set_nw_ttl(struct packet *pkt, struct ofl_action_set_nw_ttl *act) {
-    packet_handle_std_validate(pkt->handle_std);
+    packet_handle_std_validate_depth(pkt->handle_std, PACKET_PARSE_L2);
     if (pkt->handle_std->proto->ipv4 != NULL) {
         struct ip_header *ipv4 = pkt->handle_std->proto->ipv4;
 
@@ -919,7 +954,7 @@ set_nw_ttl(struct packet *pkt, struct ofl_action_set_nw_ttl *act) {
 TODO Dec IPv6 hop limit*/
 static void
 dec_nw_ttl(struct packet *pkt, struct ofl_action_header *act UNUSED) {
-    packet_handle_std_validate(pkt->handle_std);
+    packet_handle_std_validate_depth(pkt->handle_std, PACKET_PARSE_L2);
     if (pkt->handle_std->proto->ipv4 != NULL) {
 
         struct ip_header *ipv4 = pkt->handle_std->proto->ipv4;
@@ -1097,32 +1132,8 @@ dp_actions_output_port(struct packet *pkt, uint32_t out_port, uint32_t out_queue
             break;
         }
         case (OFPP_CONTROLLER): {
-            struct ofl_msg_packet_in msg;
-            msg.header.type = OFPT_PACKET_IN;
-            msg.total_len   = pkt->buffer->size;
-            msg.reason = pkt->handle_std->table_miss? OFPR_NO_MATCH:OFPR_ACTION;
-            msg.table_id = pkt->table_id;
-            msg.data        = pkt->buffer->data;
-            msg.cookie = cookie;
-
-            if (pkt->dp->config.miss_send_len != OFPCML_NO_BUFFER){
-                dp_buffers_save(pkt->dp->buffers, pkt);
-                msg.buffer_id = pkt->buffer_id;
-                msg.data_length = MIN(max_len, pkt->buffer->size);
-            }
-            else {
-                msg.buffer_id = OFP_NO_BUFFER;
-                msg.data_length =  pkt->buffer->size;
-            }
-
-            if (!pkt->handle_std->valid){
-                packet_handle_std_validate(pkt->handle_std);
-            }
-            /* In this implementation the fields in_port and in_phy_port
-                always will be the same, because we are not considering logical
-                ports*/
-            msg.match = (struct ofl_match_header*) &pkt->handle_std->match;
-            dp_send_message(pkt->dp, (struct ofl_msg_header *)&msg, NULL);
+            dp_actions_packet_in(pkt, pkt->handle_std->table_miss ? OFPR_NO_MATCH : OFPR_ACTION,
+                                 pkt->table_id, max_len, cookie);
             break;
         }
         case (OFPP_FLOOD):
@@ -1144,6 +1155,41 @@ dp_actions_output_port(struct packet *pkt, uint32_t out_port, uint32_t out_queue
     }
 }
 
+void
+dp_actions_packet_in(struct packet *pkt, uint8_t reason, uint8_t table_id,
+                     uint16_t max_len, uint64_t cookie) {
+    struct ofl_msg_packet_in msg;
+
+    if (dp_workers_in_worker()) {
+        /* Only the main thread talks to the controllers. */
+        dp_workers_packet_in(pkt, reason, table_id, max_len, cookie);
+        return;
+    }
+
+    msg.header.type = OFPT_PACKET_IN;
+    msg.total_len   = pkt->buffer->size;
+    msg.reason      = reason;
+    msg.table_id    = table_id;
+    msg.data        = pkt->buffer->data;
+    msg.cookie      = cookie;
+
+    if (pkt->dp->config.miss_send_len != OFPCML_NO_BUFFER){
+        dp_buffers_save(pkt->dp->buffers, pkt);
+        msg.buffer_id = pkt->buffer_id;
+        msg.data_length = MIN(max_len, pkt->buffer->size);
+    }
+    else {
+        msg.buffer_id = OFP_NO_BUFFER;
+        msg.data_length =  pkt->buffer->size;
+    }
+
+    /* In this implementation the fields in_port and in_phy_port
+        always will be the same, because we are not considering logical
+        ports*/
+    msg.match = (struct ofl_match_header*) packet_handle_std_get_match(pkt->handle_std);
+    dp_send_message(pkt->dp, (struct ofl_msg_header *)&msg, NULL);
+}
+
 bool
 dp_actions_list_has_out_port(size_t actions_num, struct ofl_action_header **actions, uint32_t port) {
     size_t i;
@@ -57,6 +57,14 @@ dp_execute_action_list(struct packet *pkt,
 void
 dp_actions_output_port(struct packet *pkt, uint32_t out_port, uint32_t out_queue, uint16_t max_len, uint64_t cookie);
 
+/* Sends a packet_in message of the packet to the controllers, buffering
+ * the packet and sending its first max_len bytes, unless the switch is
+ * configured not to buffer. Worker threads hand the message to the main
+ * thread instead. */
+void
+dp_actions_packet_in(struct packet *pkt, uint8_t reason, uint8_t table_id,
+                     uint16_t max_len, uint64_t cookie);
+
 /* Returns true if the given list of actions has an output action to the port. */
 bool
 dp_actions_list_has_out_port(size_t actions_num, struct ofl_action_header **actions, uint32_t port);
@@ -0,0 +1,223 @@
+/* Copyright (c) 2012, CPqD, Brazil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "datapath.h"
+#include "dp_bundle.h"
+#include "pipeline.h"
+#include "list.h"
+#include "oflib/ofl.h"
+#include "oflib/ofl-messages.h"
+#include "oflib-exp/ofl-exp-openflow.h"
+#include "openflow/openflow.h"
+#include "openflow/openflow-ext.h"
+#include "util.h"
+#include "vlog.h"
+
+#define LOG_MODULE VLM_dp_bundle
+
+static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(60, 60);
+
+struct bundle {
+    struct list               node;      /* in the bundles of the remote. */
+    struct datapath          *dp;
+    uint32_t                  id;
+    uint16_t                  flags;
+    bool                      closed;    /* no more messages may be added. */
+    struct ofl_msg_flow_mod **mods;      /* checked flow mods, in order. */
+    size_t                    mods_num;
+    size_t                    mods_size;
+};
+
+static struct bundle *
+bundle_find(struct list *bundles, uint32_t id) {
+    struct bundle *bundle;
+
+    LIST_FOR_EACH (bundle, struct bundle, node, bundles) {
+        if (bundle->id == id) {
+            return bundle;
+        }
+    }
+    return NULL;
+}
+
+/* Removes a bundle from its remote, and frees it with its messages. */
+static void
+bundle_discard(struct bundle *bundle) {
+    size_t i;
+
+    for (i = 0; i < bundle->mods_num; i++) {
+        ofl_msg_free((struct ofl_msg_header *)bundle->mods[i], bundle->dp->exp);
+    }
+    list_remove(&bundle->node);
+    free(bundle->mods);
+    free(bundle);
+}
+
+/* Applies the messages of a bundle, and frees it. */
+static ofl_err
+bundle_commit(struct bundle *bundle) {
+    struct datapath *dp = bundle->dp;
+    ofl_err error;
+
+    list_remove(&bundle->node);
+    VLOG_DBG(LOG_MODULE, "Committing bundle %u of %zu flow mods.",
+             bundle->id, bundle->mods_num);
+    error = pipeline_commit_flow_mods(dp->pipeline, bundle->mods, bundle->mods_num);
+    free(bundle->mods);
+    free(bundle);
+    return error;
+}
+
+ofl_err
+dp_bundle_handle_control(struct datapath *dp,
+                         struct ofl_exp_openflow_msg_bundle_ctrl *msg,
+                         const struct sender *sender) {
+    struct list *bundles = &sender->remote->bundles;
+    struct bundle *bundle = bundle_find(bundles, msg->bundle_id);
+    ofl_err error;
+
+    switch (msg->type) {
+        case (OFP_EXT_BCT_OPEN_REQUEST): {
+            if (bundle != NULL || list_size(bundles) >= DP_BUNDLE_MAX) {
+                return ofl_error(OFPET_BAD_REQUEST, OFPBRC_EPERM);
+            }
+            bundle = xmalloc(sizeof(struct bundle));
+            bundle->dp = dp;
+            bundle->id = msg->bundle_id;
+            bundle->flags = msg->flags;
+            bundle->closed = false;
+            bundle->mods = NULL;
+            bundle->mods_num = 0;
+            bundle->mods_size = 0;
+            list_push_back(bundles, &bundle->node);
+            break;
+        }
+        case (OFP_EXT_BCT_CLOSE_REQUEST): {
+            if (bundle == NULL || bundle->closed) {
+                return ofl_error(OFPET_BAD_REQUEST, OFPBRC_EPERM);
+            }
+            bundle->closed = true;
+            break;
+        }
+        case (OFP_EXT_BCT_COMMIT_REQUEST): {
+            if (bundle == NULL) {
+                return ofl_error(OFPET_BAD_REQUEST, OFPBRC_EPERM);
+            }
+            if (sender->remote->role == OFPCR_ROLE_SLAVE) {
+                bundle_discard(bundle);
+                return ofl_error(OFPET_BAD_REQUEST, OFPBRC_IS_SLAVE);
+            }
+            /* The bundle is gone, whether it fails or not. */
+            error = bundle_commit(bundle);
+            if (error) {
+                return error;
+            }
+            break;
+        }
+        case (OFP_EXT_BCT_DISCARD_REQUEST): {
+            if (bundle == NULL) {
+                return ofl_error(OFPET_BAD_REQUEST, OFPBRC_EPERM);
+            }
+            bundle_discard(bundle);
+            break;
+        }
+        default: {
+            VLOG_WARN_RL(LOG_MODULE, &rl, "Received bundle control message of unknown type (%u).", msg->type);
+            return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_EXP_TYPE);
+        }
+    }
+
+    {
+        /* Each request type is followed by its reply type. */
+        struct ofl_exp_openflow_msg_bundle_ctrl reply =
+                {{{{.type = OFPT_EXPERIMENTER},
+                   .experimenter_id = OPENFLOW_VENDOR_ID},
+                  .type = OFP_EXT_BUNDLE_CONTROL},
+                 .bundle_id = msg->bundle_id,
+                 .type      = msg->type + 1,
+                 .flags     = msg->flags};
+
+        dp_send_message(dp, (struct ofl_msg_header *)&reply, sender);
+    }
+
+    ofl_msg_free((struct ofl_msg_header *)msg, dp->exp);
+    return 0;
+}
+
+ofl_err
+dp_bundle_handle_add(struct datapath *dp,
+                     struct ofl_exp_openflow_msg_bundle_add *msg,
+                     const struct sender *sender) {
+    struct bundle *bundle = bundle_find(&sender->remote->bundles, msg->bundle_id);
+    struct ofl_msg_header *added;
+    ofl_err error;
+
+    if (bundle == NULL || bundle->closed ||
+        bundle->mods_num >= DP_BUNDLE_MAX_MESSAGES) {
+        return ofl_error(OFPET_BAD_REQUEST, OFPBRC_EPERM);
+    }
+    if (sender->remote->role == OFPCR_ROLE_SLAVE) {
+        return ofl_error(OFPET_BAD_REQUEST, OFPBRC_IS_SLAVE);
+    }
+
+    error = ofl_msg_unpack(msg->message, msg->message_length, &added, NULL, dp->exp);
+    if (error) {
+        return error;
+    }
+    if (added->type != OFPT_FLOW_MOD) {
+        ofl_msg_free(added, dp->exp);
+        return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_TYPE);
+    }
+    /* Refused now rather than at commit; the commit checks it again. */
+    error = pipeline_check_flow_mod(dp->pipeline, (struct ofl_msg_flow_mod *)added);
+    if (error) {
+        ofl_msg_free(added, dp->exp);
+        return error;
+    }
+
+    if (bundle->mods_num == bundle->mods_size) {
+        bundle->mods_size = bundle->mods_size == 0 ? 64 : bundle->mods_size * 2;
+        bundle->mods = xrealloc(bundle->mods, bundle->mods_size * sizeof(struct ofl_msg_flow_mod *));
+    }
+    bundle->mods[bundle->mods_num++] = (struct ofl_msg_flow_mod *)added;
+
+    ofl_msg_free((struct ofl_msg_header *)msg, dp->exp);
+    return 0;
+}
+
+void
+dp_bundle_discard_all(struct list *bundles) {
+    struct bundle *bundle, *next;
+
+    LIST_FOR_EACH_SAFE (bundle, next, struct bundle, node, bundles) {
+        bundle_discard(bundle);
+    }
+}
@@ -0,0 +1,67 @@
+/* Copyright (c) 2012, CPqD, Brazil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef DP_BUNDLE_H
+#define DP_BUNDLE_H 1
+
+#include "list.h"
+#include "oflib/ofl.h"
+#include "oflib-exp/ofl-exp-openflow.h"
+
+struct datapath;
+struct sender;
+
+/****************************************************************************
+ * Bundles of flow mods, following the OpenFlow 1.4 bundles. A controller
+ * opens a bundle, adds flow mods to it, which are checked as they arrive,
+ * and commits it: the flow mods are then applied in order, as a single
+ * change (see pipeline_commit_flow_mods()). Bundles belong to the
+ * connection which opened them, and are discarded with it.
+ ****************************************************************************/
+
+#define DP_BUNDLE_MAX 16                /* open bundles per connection. */
+#define DP_BUNDLE_MAX_MESSAGES (1 << 20) /* flow mods per bundle. */
+
+/* Handles a bundle control experimenter message. */
+ofl_err
+dp_bundle_handle_control(struct datapath *dp,
+                         struct ofl_exp_openflow_msg_bundle_ctrl *msg,
+                         const struct sender *sender);
+
+/* Handles a bundle add experimenter message. */
+ofl_err
+dp_bundle_handle_add(struct datapath *dp,
+                     struct ofl_exp_openflow_msg_bundle_add *msg,
+                     const struct sender *sender);
+
+/* Discards the bundles of a connection. */
+void
+dp_bundle_discard_all(struct list *bundles);
+
+#endif /* DP_BUNDLE_H */
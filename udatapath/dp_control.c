@@ -154,7 +154,10 @@ handle_control_packet_out(struct datapath *dp, struct ofl_msg_packet_out *msg,
         /* This might be a wrong req., or a timed out buffer */
         return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BUFFER_EMPTY);
     }
-    
+
+    /* The packet may be sent to the flow tables, which must reflect the
+     * flow mods received before it. */
+    pipeline_publish(dp->pipeline);
     dp_execute_action_list(pkt, msg->actions_num, msg->actions, 0xffffffffffffffff);
 
     packet_destroy(pkt);
@@ -32,8 +32,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include "datapath.h"
+#include "dp_bundle.h"
 #include "dp_exp.h"
+#include "dp_workers.h"
 #include "packet.h"
+#include "pipeline.h"
 #include "oflib/ofl.h"
 #include "oflib/ofl-actions.h"
 #include "oflib/ofl-structs.h"
@@ -60,11 +63,29 @@ dp_exp_inst(struct packet *pkt UNUSED, struct ofl_instruction_experimenter *inst
 }
 
 ofl_err
-dp_exp_stats(struct datapath *dp UNUSED,
+dp_exp_stats(struct datapath *dp,
                                   struct ofl_msg_multipart_request_experimenter *msg,
-                                  const struct sender *sender UNUSED) {
-	VLOG_WARN_RL(LOG_MODULE, &rl, "Trying to handle unknown experimenter stats (%u).", msg->experimenter_id);
-    return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_EXPERIMENTER);
+                                  const struct sender *sender) {
+
+    switch (msg->experimenter_id) {
+        case (OPENFLOW_VENDOR_ID): {
+            struct ofl_exp_openflow_mp_request *exp = (struct ofl_exp_openflow_mp_request *)msg;
+
+            switch (exp->type) {
+                case (OFP_EXT_MP_TABLE_LOOKUP_STATS): {
+                    return pipeline_handle_table_lookup_stats_request(dp->pipeline, (struct ofl_exp_openflow_mp_table_lookup_stats_request *)msg, sender);
+                }
+                default: {
+                    VLOG_WARN_RL(LOG_MODULE, &rl, "Trying to handle unknown experimenter stats type (%u).", exp->type);
+                    return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_EXP_TYPE);
+                }
+            }
+        }
+        default: {
+            VLOG_WARN_RL(LOG_MODULE, &rl, "Trying to handle unknown experimenter stats (%u).", msg->experimenter_id);
+            return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_EXPERIMENTER);
+        }
+    }
 }
 
 
@@ -87,6 +108,27 @@ dp_exp_message(struct datapath *dp,
                 case (OFP_EXT_SET_DESC): {
                     return dp_handle_set_desc(dp, (struct ofl_exp_openflow_msg_set_dp_desc *)msg, sender);
                 }
+                case (OFP_EXT_FLOW_CACHE_STATS_REQUEST): {
+                    return pipeline_handle_flow_cache_stats_request(dp->pipeline, exp, sender);
+                }
+                case (OFP_EXT_TABLE_MEMORY_REQUEST): {
+                    return pipeline_handle_table_memory_request(dp->pipeline, exp, sender);
+                }
+                case (OFP_EXT_TABLE_MODE): {
+                    return pipeline_handle_table_mode(dp->pipeline, (struct ofl_exp_openflow_msg_table_mode *)msg, sender);
+                }
+                case (OFP_EXT_BUNDLE_CONTROL): {
+                    return dp_bundle_handle_control(dp, (struct ofl_exp_openflow_msg_bundle_ctrl *)msg, sender);
+                }
+                case (OFP_EXT_BUNDLE_ADD): {
+                    return dp_bundle_handle_add(dp, (struct ofl_exp_openflow_msg_bundle_add *)msg, sender);
+                }
+                case (OFP_EXT_STAGE_STATS_REQUEST): {
+                    return dp_workers_handle_stage_stats_request(dp, exp, sender);
+                }
+                case (OFP_EXT_PACKET_POOL_STATS_REQUEST): {
+                    return packet_pool_handle_stats_request(dp, exp, sender);
+                }
                 default: {
                 	VLOG_WARN_RL(LOG_MODULE, &rl, "Trying to handle unknown experimenter type (%u).", exp->type);
                     return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_EXPERIMENTER);
@@ -43,6 +43,7 @@
 #include <inttypes.h>
 #include "dp_exp.h"
 #include "dp_ports.h"
+#include "dp_workers.h"
 #include "datapath.h"
 #include "packets.h"
 #include "pipeline.h"
@@ -59,69 +60,36 @@ static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(60, 60);
 
 #if defined(OF_HW_PLAT)
 #include <openflow/of_hw_api.h>
-#include <pthread.h>
+#include "ring.h"
 #endif
 
 
 #if defined(OF_HW_PLAT) && !defined(USE_NETDEV)
-/* Queue to decouple receive packet thread from rconn control thread */
-/* Could make mutex per-DP */
-static pthread_mutex_t pkt_q_mutex = PTHREAD_MUTEX_INITIALIZER;
-#define PKT_Q_LOCK pthread_mutex_lock(&pkt_q_mutex)
-#define PKT_Q_UNLOCK pthread_mutex_unlock(&pkt_q_mutex)
+/* Ring to decouple receive packet thread from rconn control thread.  The
+ * buffers carry their port number in 'private_p'. */
+#define HW_PKT_Q_SIZE 1024
 
 static void
 enqueue_pkt(struct datapath *dp, struct ofpbuf *buffer, of_port_t port_no,
-            int reason)
+            int reason UNUSED)
 {
-    struct hw_pkt_q_entry *q_entry;
-
-    if ((q_entry = xmalloc(sizeof(*q_entry))) == NULL) {
-        VLOG_WARN(LOG_MODULE, "Could not alloc q entry\n");
-        /* FIXME: Dealloc buffer */
-        return;
-    }
-    q_entry->buffer = buffer;
-    q_entry->next = NULL;
-    q_entry->port_no = port_no;
-    q_entry->reason = reason;
-    pthread_mutex_lock(&pkt_q_mutex);
-    if (dp->hw_pkt_list_head == NULL) {
-        dp->hw_pkt_list_head = q_entry;
-    } else {
-        dp->hw_pkt_list_tail->next = q_entry;
+    buffer->private_p = (void *)(uintptr_t)port_no;
+    if (!ring_enqueue(dp->hw_pkt_q, buffer)) {
+        VLOG_WARN_RL(LOG_MODULE, &rl, "HW packet queue full, dropping packet");
+        ofpbuf_delete(buffer);
     }
-    dp->hw_pkt_list_tail = q_entry;
-    pthread_mutex_unlock(&pkt_q_mutex);
 }
 
 /* If queue non-empty, fill out params and return 1; else return 0 */
 static int
-dequeue_pkt(struct datapath *dp, struct ofpbuf **buffer, of_port_t *port_no,
-            int *reason)
+dequeue_pkt(struct datapath *dp, struct ofpbuf **buffer, of_port_t *port_no)
 {
-    struct hw_pkt_q_entry *q_entry;
-    int rv = 0;
-
-    pthread_mutex_lock(&pkt_q_mutex);
-    q_entry = dp->hw_pkt_list_head;
-    if (dp->hw_pkt_list_head != NULL) {
-        dp->hw_pkt_list_head = dp->hw_pkt_list_head->next;
-        if (dp->hw_pkt_list_head == NULL) {
-            dp->hw_pkt_list_tail = NULL;
-        }
-    }
-    pthread_mutex_unlock(&pkt_q_mutex);
-
-    if (q_entry != NULL) {
-        rv = 1;
-        *buffer = q_entry->buffer;
-        *port_no = q_entry->port_no;
-        *reason = q_entry->reason;
-        free(q_entry);
+    *buffer = ring_dequeue(dp->hw_pkt_q);
+    if (*buffer == NULL) {
+        return 0;
     }
-
-    return rv;
+    *port_no = (uintptr_t)(*buffer)->private_p;
+    return 1;
 }
 #endif
 
@@ -177,8 +145,8 @@ hw_packet_in(of_port_t port_no, of_packet_t *packet, int reason,
         buffer->data = (char*)buffer->data + headroom;
         buffer->size = packet->length;
         memcpy(buffer->data, packet->data, packet->length);
+        /* Wakes up the main thread through the eventfd of the ring. */
         enqueue_pkt(dp, buffer, port_no, reason);
-        poll_immediate_wake();
     }
 
     return 0;
@@ -189,8 +157,8 @@ hw_packet_in(of_port_t port_no, of_packet_t *packet, int reason,
 static int
 dp_hw_drv_init(struct datapath *dp)
 {
-    dp->hw_pkt_list_head = NULL;
-    dp->hw_pkt_list_tail = NULL;
+    /* Filled by the receive thread of the driver only. */
+    dp->hw_pkt_q = ring_create(HW_PKT_Q_SIZE, RING_SPSC | RING_BLOCKING);
 
     dp->hw_drv = new_of_hw_driver(dp);
     if (dp->hw_drv == NULL) {
@@ -210,26 +178,54 @@ dp_hw_drv_init(struct datapath *dp)
 #endif
 
 
-/* Runs a datapath packet through the pipeline, if the port is not set to down. */
-static void
-process_buffer(struct datapath *dp, struct sw_port *p, struct ofpbuf *buffer) {
-    struct packet *pkt;
+size_t
+dp_ports_recv_burst(struct datapath *dp, struct sw_port *p, int fd,
+                    struct packet **spare, struct ofl_port_stats *stats,
+                    struct packet **pkts, int *error) {
+    const int mtu = netdev_get_mtu(p->netdev);
+    size_t n_pkts = 0;
 
-    if (p->conf->config & ((OFPPC_NO_RECV | OFPPC_PORT_DOWN) != 0)) {
-        ofpbuf_delete(buffer);
-        return;
-    }
+    *error = 0;
+    while (n_pkts < PIPELINE_BATCH) {
+        struct packet *pkt = *spare;
+        struct ofpbuf *buffer;
 
-    // packet takes ownership of ofpbuf buffer
-    pkt = packet_create(dp, p->stats->port_no, buffer, false);
-    pipeline_process_packet(dp->pipeline, pkt);
+        if (pkt != NULL && ofpbuf_tailroom(pkt->buffer) < VLAN_ETH_HEADER_LEN + mtu) {
+            /* Left over by a port with a smaller MTU. */
+            packet_destroy(pkt);
+            pkt = NULL;
+        }
+        if (pkt == NULL) {
+            /* Allocate buffer with some headroom to add headers in forwarding
+             * to the controller or adding a vlan tag, plus an extra 2 bytes to
+             * allow IP headers to be aligned on a 4-byte boundary.  */
+            const int headroom = 128 + 2;
+            pkt = packet_alloc(dp, VLAN_ETH_HEADER_LEN + mtu, headroom);
+            *spare = pkt;
+        }
+        buffer = pkt->buffer;
+        *error = fd >= 0 ? netdev_fanout_recv(p->netdev, fd, buffer, VLAN_ETH_HEADER_LEN + mtu)
+                         : netdev_recv(p->netdev, buffer, VLAN_ETH_HEADER_LEN + mtu);
+        if (*error) {
+            break;
+        }
+        stats->rx_packets++;
+        stats->rx_bytes += buffer->size;
+        *spare = NULL;
+        if (p->conf->config & ((OFPPC_NO_RECV | OFPPC_PORT_DOWN) != 0)) {
+            packet_destroy(pkt);
+            continue;
+        }
+        packet_received(pkt, p->stats->port_no);
+        pkts[n_pkts++] = pkt;
+    }
+    return n_pkts;
 }
 
 void
 dp_ports_run(struct datapath *dp) {
-    // static, so an unused buffer can be reused at the dp_ports_run call
-    static struct ofpbuf *buffer = NULL;
-    int max_mtu = 0;
+    // static, so an unused packet can be reused at the dp_ports_run call
+    static struct packet *spare = NULL;
 
     struct sw_port *p, *pn;
 
@@ -237,10 +233,9 @@ dp_ports_run(struct datapath *dp) {
     { /* Process packets received from callback thread */
         struct ofpbuf *buffer;
         of_port_t port_no;
-        int reason;
         struct sw_port *p;
 
-        while (dequeue_pkt(dp, &buffer, &port_no, &reason)) {
+        while (dequeue_pkt(dp, &buffer, &port_no)) {
             p = dp_ports_lookup(dp, port_no);
             /* FIXME:  We're throwing away the reason that came from HW */
             process_packet(dp, p, buffer);
@@ -248,18 +243,11 @@ dp_ports_run(struct datapath *dp) {
     }
 #endif
 
-    // find largest MTU on our interfaces
-    // buffer is shared among all (idle) interfaces...
-    LIST_FOR_EACH_SAFE (p, pn, struct sw_port, node, &dp->port_list) {        
-        const int mtu = netdev_get_mtu(p->netdev);
-        if (IS_HW_PORT(p)) 
-            continue;
-        if (mtu > max_mtu)
-            max_mtu = mtu;
-    }
-
     LIST_FOR_EACH_SAFE (p, pn, struct sw_port, node, &dp->port_list) {
+        struct packet *pkts[PIPELINE_BATCH];
+        size_t n_pkts;
         int error;
+        uint32_t state = p->conf->state;
         /* Check for interface state change */
         enum netdev_link_state link_state = netdev_link_state(p->netdev);
         if (link_state == NETDEV_LINK_UP){
@@ -270,25 +258,20 @@ dp_ports_run(struct datapath *dp) {
             p->conf->state |= OFPPS_LINK_DOWN;
             dp_port_live_update(p);
         }
+        if (p->conf->state != state) {
+            pipeline_invalidate_cache(dp->pipeline);
+        }
 
-        if (IS_HW_PORT(p)) {
+        if (IS_HW_PORT(p) || (p->flags & SWP_WORKER_RECV)) {
             continue;
         }
-        if (buffer == NULL) {
-            /* Allocate buffer with some headroom to add headers in forwarding
-             * to the controller or adding a vlan tag, plus an extra 2 bytes to
-             * allow IP headers to be aligned on a 4-byte boundary.  */
-            const int headroom = 128 + 2;
-            buffer = ofpbuf_new_with_headroom(VLAN_ETH_HEADER_LEN + max_mtu, headroom);
+        /* Receive a burst of packets from the port, which then go through
+         * the pipeline together. */
+        n_pkts = dp_ports_recv_burst(dp, p, -1, &spare, p->stats, pkts, &error);
+        if (n_pkts > 0) {
+            pipeline_process_batch(dp->pipeline, dp->pipeline->cache, pkts, n_pkts);
         }
-        error = netdev_recv(p->netdev, buffer, VLAN_ETH_HEADER_LEN + max_mtu);
-        if (!error) {
-            p->stats->rx_packets++;
-            p->stats->rx_bytes += buffer->size;
-            // process_buffer takes ownership of ofpbuf buffer
-            process_buffer(dp, p, buffer);
-            buffer = NULL;
-        } else if (error != EAGAIN) {
+        if (error && error != EAGAIN) {
             VLOG_ERR_RL(LOG_MODULE, &rl, "error receiving data from %s: %s",
                         netdev_get_name(p->netdev), strerror(error));
         }
@@ -439,6 +422,7 @@ new_port(struct datapath *dp, struct sw_port *port, uint32_t port_no,
 
     list_push_back(&dp->port_list, &port->node);
     dp->ports_num++;
+    pipeline_invalidate_cache(dp->pipeline);
 
     {
     /* Notify the controllers that this port has been added */
@@ -580,6 +564,8 @@ dp_ports_output(struct datapath *dp, struct ofpbuf *buffer, uint32_t out_port,
     uint16_t class_id;
     struct sw_queue * q;
     struct sw_port *p;
+    struct ofl_port_stats *stats;
+    int error;
 
     p = dp_ports_lookup(dp, out_port);
 
@@ -625,15 +611,20 @@ dp_ports_output(struct datapath *dp, struct ofpbuf *buffer, uint32_t out_port,
                 }
             }
 
-            if (!netdev_send(p->netdev, buffer, class_id)) {
-                p->stats->tx_packets++;
-                p->stats->tx_bytes += buffer->size;
+            /* Worker threads send on their own socket of the port, and
+             * count into their own port counters. */
+            stats = dp_workers_port_stats(p);
+            error = class_id == 0 ? dp_workers_send(p, buffer)
+                                  : netdev_send(p->netdev, buffer, class_id);
+            if (!error) {
+                stats->tx_packets++;
+                stats->tx_bytes += buffer->size;
                 if (q != NULL) {
-                    q->stats->tx_packets++;
-                    q->stats->tx_bytes += buffer->size;
+                    __atomic_add_fetch(&q->stats->tx_packets, 1, __ATOMIC_RELAXED);
+                    __atomic_add_fetch(&q->stats->tx_bytes, buffer->size, __ATOMIC_RELAXED);
                 }
             } else {
-                p->stats->tx_dropped++;
+                stats->tx_dropped++;
             }
         }
         /* NOTE: no need to delete buffer, it is deleted along with the packet in caller. */
@@ -691,6 +682,7 @@ dp_ports_handle_port_mod(struct datapath *dp, struct ofl_msg_port_mod *msg,
         p->conf->config &= ~msg->mask;
         p->conf->config |= msg->config & msg->mask;
         dp_port_live_update(p);
+        pipeline_invalidate_cache(dp->pipeline);
     }
 
     /*Notify all controllers that the port status has changed*/
@@ -75,6 +75,8 @@ struct sw_queue {
 enum sw_port_flags {
     SWP_USED             = 1 << 0,    /* Is port being used */
     SWP_HW_DRV_PORT      = 1 << 1,    /* Port controlled by HW driver */
+    SWP_WORKER_RECV      = 1 << 2,    /* Packets received by the worker
+                                         threads */
 };
 #if defined(OF_HW_PLAT) && !defined(USE_NETDEV)
 #define IS_HW_PORT(p) ((p)->flags & SWP_HW_DRV_PORT)
@@ -100,15 +102,6 @@ struct sw_port {
 };
 
 
-#if defined(OF_HW_PLAT)
-struct hw_pkt_q_entry {
-    struct ofpbuf *buffer;
-    struct hw_pkt_q_entry *next;
-    of_port_t port_no;
-    int reason;
-};
-#endif
-
 #define DP_MAX_PORTS 255
 BUILD_ASSERT_DECL(DP_MAX_PORTS <= OFPP_MAX);
 
@@ -134,6 +127,17 @@ dp_ports_lookup(struct datapath *, uint32_t);
 struct sw_queue *
 dp_ports_lookup_queue(struct sw_port *, uint32_t);
 
+/* Receives a burst of at most PIPELINE_BATCH packets of the port into
+ * 'pkts', through 'fd' if not negative, a fanout socket of the port, or
+ * else through its network device, and returns their number. '*spare'
+ * holds a packet to receive into left over by the previous call, or NULL. The
+ * packets are counted in 'stats', and '*error' is set to the error which
+ * ended the burst. */
+size_t
+dp_ports_recv_burst(struct datapath *dp, struct sw_port *p, int fd,
+                    struct packet **spare, struct ofl_port_stats *stats,
+                    struct packet **pkts, int *error);
+
 /* Outputs a datapath packet on the port. */
 void
 dp_ports_output(struct datapath *dp, struct ofpbuf *buffer, uint32_t out_port,
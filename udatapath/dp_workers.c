@@ -0,0 +1,620 @@
+/* Copyright (c) 2012, CPqD, Brazil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "datapath.h"
+#include "dp_actions.h"
+#include "dp_ports.h"
+#include "dp_workers.h"
+#include "flow_cache.h"
+#include "flow_table.h"
+#include "netdev.h"
+#include "packet.h"
+#include "packet_handle_std.h"
+#include "pipeline.h"
+#include "poll-loop.h"
+#include "rcu.h"
+#include "ring.h"
+#include "timeval.h"
+#include "util.h"
+#include "oflib-exp/ofl-exp-openflow.h"
+#include "vlog.h"
+
+#define LOG_MODULE VLM_dp_workers
+
+static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(60, 60);
+
+/* Packet-ins queued and not yet sent, above which new ones are dropped. */
+#define MAX_PACKET_INS 1024
+
+/* Packets the ring in front of each classifier or transmitter holds. */
+#define STAGE_RING_SIZE 1024
+
+/* How often the worker expires the entries of its flow cache, in ms. */
+#define CACHE_RUN_INTERVAL 1000
+
+/* What a worker does with the packets; the values are those of
+ * openflow_ext_stages. */
+enum worker_stage {
+    STAGE_RUN      = OFP_EXT_STAGE_RUN,      /* receive and run through the
+                                                pipeline. */
+    STAGE_RECEIVE  = OFP_EXT_STAGE_RECEIVE,  /* receive and parse, for the
+                                                classifiers. */
+    STAGE_CLASSIFY = OFP_EXT_STAGE_CLASSIFY, /* run through the pipeline. */
+    STAGE_TRANSMIT = OFP_EXT_STAGE_TRANSMIT, /* send what the classifiers
+                                                output. */
+    STAGE_N
+};
+
+static const char *stage_names[STAGE_N] = {"worker", "receiver", "classifier",
+                                           "transmitter"};
+
+struct worker_port {
+    int fd;                             /* fanout socket, or -1. */
+    struct ofl_port_stats stats;        /* counted by the worker. */
+    struct ofl_port_stats folded;       /* part of 'stats' already folded. */
+};
+
+struct dp_worker {
+    struct dp_workers  *workers;
+    unsigned int        id;             /* among the workers of the stage. */
+    enum worker_stage   stage;
+    pthread_t           thread;
+    struct flow_cache  *cache;
+    uint64_t            cache_seq;
+    long long int       cache_run;      /* next flow_cache_run(). */
+
+    struct ring        *ring;           /* input of a classifier (packets)
+                                           or a transmitter (buffers). */
+    uint64_t            packets;        /* handled by the worker. */
+    uint64_t            dropped;        /* dropped as the next ring was full,
+                                           or failed to send. */
+
+    /* Indexed by port number, the local port at 0. */
+    struct worker_port  ports[DP_MAX_PORTS + 1];
+    struct pollfd      *pollfds;
+    struct sw_port    **pollports;
+    size_t              n_pollfds;
+
+    struct flow_table_counters tables[PIPELINE_TABLES];
+    struct flow_table_counters tables_folded[PIPELINE_TABLES];
+};
+
+struct packet_in {
+    struct packet   *pkt;       /* copy of the packet. */
+    uint8_t          reason;
+    uint8_t          table_id;
+    uint16_t         max_len;
+    uint64_t         cookie;
+};
+
+struct dp_workers {
+    struct datapath    *dp;
+    struct dp_worker  **workers;        /* ordered by stage. */
+    unsigned int        n;
+
+    /* The workers of each stage, in 'workers'. */
+    struct dp_worker  **stages[STAGE_N];
+    unsigned int        n_stage[STAGE_N];
+
+    struct ring        *packet_ins;     /* to the main thread, which waits
+                                           for it. */
+};
+
+static __thread struct dp_worker *self;
+
+static inline size_t
+port_index(struct sw_port *p) {
+    return p == p->dp->local_port ? 0 : p - p->dp->ports;
+}
+
+/* Receives a burst from each port of the worker. Workers running to
+ * completion run the packets through the pipeline; receivers parse them and
+ * hand each to the classifier its flow hashes to, so that the packets of a
+ * flow keep their order. */
+static bool
+receive(struct dp_worker *w, struct packet **spare) {
+    struct dp_workers *workers = w->workers;
+    struct pipeline *pl = workers->dp->pipeline;
+    bool busy = false;
+    size_t i, j;
+
+    for (i = 0; i < w->n_pollfds; i++) {
+        struct sw_port *p = w->pollports[i];
+        struct worker_port *wp = &w->ports[port_index(p)];
+        struct packet *pkts[PIPELINE_BATCH];
+        unsigned int classifiers[PIPELINE_BATCH];
+        size_t n_pkts;
+        int error;
+
+        n_pkts = dp_ports_recv_burst(workers->dp, p, wp->fd, spare, &wp->stats,
+                                     pkts, &error);
+        if (error && error != EAGAIN) {
+            VLOG_ERR_RL(LOG_MODULE, &rl, "%s %u: error receiving data from %s: %s",
+                        stage_names[w->stage], w->id, netdev_get_name(p->netdev),
+                        strerror(error));
+        }
+        if (n_pkts == 0) {
+            continue;
+        }
+        busy = true;
+        w->packets += n_pkts;
+        if (w->stage == STAGE_RUN) {
+            pipeline_process_batch(pl, w->cache, pkts, n_pkts);
+            continue;
+        }
+
+        /* Group the packets by classifier, keeping their order, and hand
+         * each group over in one burst. */
+        for (j = 0; j < n_pkts; j++) {
+            struct packet_handle_std *handle = pkts[j]->handle_std;
+
+            packet_handle_std_validate_depth(handle,
+                    __atomic_load_n(&pl->parse_depth, __ATOMIC_RELAXED));
+            classifiers[j] = packet_key_hash(&handle->key, 0)
+                             % workers->n_stage[STAGE_CLASSIFY];
+        }
+        for (j = 0; j < n_pkts; j++) {
+            struct packet *group[PIPELINE_BATCH];
+            unsigned int c = classifiers[j];
+            size_t n_group = 0, n_sent, k;
+
+            if (pkts[j] == NULL) {
+                continue;
+            }
+            for (k = j; k < n_pkts; k++) {
+                if (pkts[k] != NULL && classifiers[k] == c) {
+                    group[n_group++] = pkts[k];
+                    pkts[k] = NULL;
+                }
+            }
+            n_sent = ring_enqueue_burst(workers->stages[STAGE_CLASSIFY][c]->ring,
+                                        (void **) group, n_group);
+            for (k = n_sent; k < n_group; k++) {
+                packet_destroy(group[k]);
+                w->dropped++;
+            }
+        }
+    }
+    return busy;
+}
+
+/* Runs a burst of the packets of the ring through the pipeline. */
+static bool
+classify(struct dp_worker *w) {
+    struct packet *pkts[PIPELINE_BATCH];
+    size_t n_pkts;
+
+    n_pkts = ring_dequeue_burst(w->ring, (void **) pkts, PIPELINE_BATCH);
+    if (n_pkts > 0) {
+        w->packets += n_pkts;
+        pipeline_process_batch(w->workers->dp->pipeline, w->cache, pkts, n_pkts);
+    }
+    return n_pkts > 0;
+}
+
+/* Sends a burst of the buffers of the ring, each on the port it carries in
+ * 'private_p'. */
+static bool
+transmit(struct dp_worker *w) {
+    struct ofpbuf *buffers[PIPELINE_BATCH];
+    size_t n, i;
+
+    n = ring_dequeue_burst(w->ring, (void **) buffers, PIPELINE_BATCH);
+    for (i = 0; i < n; i++) {
+        struct ofpbuf *buffer = buffers[i];
+        struct sw_port *p = buffer->private_p;
+
+        if (netdev_send(p->netdev, buffer, 0)) {
+            /* The classifier counted the packet as sent already. */
+            w->ports[port_index(p)].stats.tx_dropped++;
+            w->dropped++;
+        }
+        ofpbuf_delete(buffer);
+    }
+    w->packets += n;
+    return n > 0;
+}
+
+/* Waits for packets: on the sockets of the worker if it receives, or on
+ * the eventfd of its ring otherwise. */
+static void
+idle(struct dp_worker *w) {
+    rcu_quiesce_start();
+    if (w->ring == NULL) {
+        poll(w->pollfds, w->n_pollfds, CACHE_RUN_INTERVAL);
+    } else if (ring_arm(w->ring)) {
+        struct pollfd pfd = {.fd = ring_fd(w->ring), .events = POLLIN};
+
+        poll(&pfd, 1, CACHE_RUN_INTERVAL);
+    }
+    rcu_quiesce_end();
+}
+
+static void *
+worker_main(void *w_) {
+    struct dp_worker *w = w_;
+    struct pipeline *pl = w->workers->dp->pipeline;
+    struct packet *spare = NULL;
+    char name[16];
+
+    self = w;
+    rcu_register_thread();
+    snprintf(name, sizeof name, "%s %u", stage_names[w->stage], w->id);
+    packet_pool_set_name(name);
+    flow_table_set_thread_counters(w->tables);
+
+    for (;;) {
+        long long int now;
+        bool busy;
+
+        pipeline_refresh_thread_cache(pl, w->cache, &w->cache_seq);
+        busy = w->stage == STAGE_CLASSIFY ? classify(w)
+             : w->stage == STAGE_TRANSMIT ? transmit(w)
+             : receive(w, &spare);
+        rcu_quiesce();
+
+        now = time_msec();
+        if (w->cache != NULL && now >= w->cache_run) {
+            flow_cache_run(w->cache);
+            w->cache_run = now + CACHE_RUN_INTERVAL;
+        }
+
+        if (!busy) {
+            idle(w);
+        }
+    }
+    return NULL;
+}
+
+/* Opens a fanout socket on the port for each worker which receives, all in
+ * one group. On failure closes those already opened and returns the
+ * error. */
+static int
+open_port(struct dp_workers *workers, struct sw_port *p) {
+    size_t idx = port_index(p);
+    uint16_t group_id = 0;
+    unsigned int i;
+    int error = 0;
+
+    for (i = 0; i < workers->n; i++) {
+        struct dp_worker *w = workers->workers[i];
+
+        if (w->ring == NULL) {
+            error = netdev_fanout_open(p->netdev, &group_id, &w->ports[idx].fd);
+            if (error) {
+                break;
+            }
+        }
+    }
+    if (!error) {
+        error = netdev_set_recv_discard(p->netdev, true);
+    }
+    if (error) {
+        for (i = 0; i < workers->n; i++) {
+            struct dp_worker *w = workers->workers[i];
+
+            if (w->ports[idx].fd >= 0) {
+                close(w->ports[idx].fd);
+                w->ports[idx].fd = -1;
+            }
+        }
+        return error;
+    }
+
+    for (i = 0; i < workers->n; i++) {
+        struct dp_worker *w = workers->workers[i];
+
+        if (w->ports[idx].fd >= 0) {
+            w->pollfds[w->n_pollfds].fd = w->ports[idx].fd;
+            w->pollfds[w->n_pollfds].events = POLLIN;
+            w->pollports[w->n_pollfds] = p;
+            w->n_pollfds++;
+        }
+    }
+    p->flags |= SWP_WORKER_RECV;
+    return 0;
+}
+
+static struct dp_worker *
+worker_create(struct dp_workers *workers, enum worker_stage stage,
+              unsigned int id) {
+    struct dp_worker *w = xcalloc(1, sizeof *w);
+    size_t i;
+
+    w->workers = workers;
+    w->id = id;
+    w->stage = stage;
+    if (stage == STAGE_RUN || stage == STAGE_CLASSIFY) {
+        w->cache = pipeline_add_thread_cache(workers->dp->pipeline);
+    }
+    w->cache_run = time_msec() + CACHE_RUN_INTERVAL;
+    if (stage == STAGE_CLASSIFY || stage == STAGE_TRANSMIT) {
+        /* Fed by the workers of the previous stage, started already. */
+        unsigned int n_producers = workers->n_stage[stage - 1];
+
+        w->ring = ring_create(STAGE_RING_SIZE,
+                              RING_BLOCKING | (n_producers == 1 ? RING_SPSC : 0));
+    }
+    for (i = 0; i < ARRAY_SIZE(w->ports); i++) {
+        w->ports[i].fd = -1;
+    }
+    w->pollfds = xmalloc((DP_MAX_PORTS + 1) * sizeof *w->pollfds);
+    w->pollports = xmalloc((DP_MAX_PORTS + 1) * sizeof *w->pollports);
+    return w;
+}
+
+/* Starts n_stage[s] workers for each stage 's'. */
+static int
+start(struct datapath *dp, const unsigned int n_stage[STAGE_N]) {
+    struct dp_workers *workers;
+    struct sw_port *p;
+    sigset_t all, old;
+    unsigned int i, s;
+    int error = 0;
+
+    if (dp->workers != NULL) {
+        return EBUSY;
+    }
+
+    workers = xmalloc(sizeof *workers);
+    workers->dp = dp;
+    workers->n = 0;
+    for (s = 0; s < STAGE_N; s++) {
+        workers->n += n_stage[s];
+    }
+    workers->workers = xmalloc(workers->n * sizeof *workers->workers);
+    workers->packet_ins = ring_create(MAX_PACKET_INS, RING_BLOCKING);
+
+    workers->n = 0;
+    for (s = 0; s < STAGE_N; s++) {
+        workers->stages[s] = &workers->workers[workers->n];
+        workers->n_stage[s] = n_stage[s];
+        for (i = 0; i < n_stage[s]; i++) {
+            workers->workers[workers->n++] = worker_create(workers, s, i);
+        }
+    }
+
+    LIST_FOR_EACH (p, struct sw_port, node, &dp->port_list) {
+        if (IS_HW_PORT(p)) {
+            continue;
+        }
+        error = open_port(workers, p);
+        if (error) {
+            VLOG_WARN(LOG_MODULE, "port %s stays on the main thread: %s",
+                      netdev_get_name(p->netdev), strerror(error));
+        }
+    }
+    dp->workers = workers;
+
+    /* The signals are handled by the main thread. */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    for (i = 0; i < workers->n; i++) {
+        struct dp_worker *w = workers->workers[i];
+
+        error = pthread_create(&w->thread, NULL, worker_main, w);
+        if (error) {
+            VLOG_ERR(LOG_MODULE, "failed to start %s %u: %s",
+                     stage_names[w->stage], w->id, strerror(error));
+            break;
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    return error;
+}
+
+int
+dp_workers_start(struct datapath *dp, unsigned int n) {
+    unsigned int n_stage[STAGE_N] = {[STAGE_RUN] = n};
+
+    return n == 0 ? 0 : start(dp, n_stage);
+}
+
+int
+dp_workers_start_staged(struct datapath *dp, unsigned int n_receive,
+                        unsigned int n_classify, unsigned int n_transmit) {
+    unsigned int n_stage[STAGE_N] = {[STAGE_RECEIVE]  = n_receive,
+                                     [STAGE_CLASSIFY] = n_classify,
+                                     [STAGE_TRANSMIT] = n_transmit};
+
+    if (n_receive == 0 || n_classify == 0 || n_transmit == 0) {
+        return EINVAL;
+    }
+    return start(dp, n_stage);
+}
+
+static inline void
+fold_counter(const uint64_t *counter, uint64_t *folded, uint64_t *total) {
+    uint64_t value = __atomic_load_n(counter, __ATOMIC_RELAXED);
+
+    *total += value - *folded;
+    *folded = value;
+}
+
+static void
+fold_port(struct worker_port *wp, struct ofl_port_stats *stats) {
+    fold_counter(&wp->stats.rx_packets, &wp->folded.rx_packets, &stats->rx_packets);
+    fold_counter(&wp->stats.tx_packets, &wp->folded.tx_packets, &stats->tx_packets);
+    fold_counter(&wp->stats.rx_bytes, &wp->folded.rx_bytes, &stats->rx_bytes);
+    fold_counter(&wp->stats.tx_bytes, &wp->folded.tx_bytes, &stats->tx_bytes);
+    fold_counter(&wp->stats.rx_dropped, &wp->folded.rx_dropped, &stats->rx_dropped);
+    fold_counter(&wp->stats.tx_dropped, &wp->folded.tx_dropped, &stats->tx_dropped);
+}
+
+void
+dp_workers_run(struct datapath *dp) {
+    struct dp_workers *workers = dp->workers;
+    struct packet_in *pi;
+    struct sw_port *p;
+    unsigned int i;
+    size_t t;
+
+    if (workers == NULL) {
+        return;
+    }
+
+    for (i = 0; i < workers->n; i++) {
+        struct dp_worker *w = workers->workers[i];
+
+        if (w->cache != NULL) {
+            for (t = 0; t < PIPELINE_TABLES; t++) {
+                flow_table_fold_counters(dp->pipeline->tables[t], &w->tables[t],
+                                         &w->tables_folded[t]);
+            }
+        }
+        LIST_FOR_EACH (p, struct sw_port, node, &dp->port_list) {
+            fold_port(&w->ports[port_index(p)], p->stats);
+        }
+    }
+
+    while ((pi = ring_dequeue(workers->packet_ins)) != NULL) {
+        dp_actions_packet_in(pi->pkt, pi->reason, pi->table_id, pi->max_len,
+                             pi->cookie);
+        packet_destroy(pi->pkt);
+        free(pi);
+    }
+}
+
+void
+dp_workers_wait(struct datapath *dp) {
+    if (dp->workers != NULL) {
+        ring_wait(dp->workers->packet_ins);
+    }
+}
+
+bool
+dp_workers_in_worker(void) {
+    return self != NULL;
+}
+
+void
+dp_workers_packet_in(struct packet *pkt, uint8_t reason, uint8_t table_id,
+                     uint16_t max_len, uint64_t cookie) {
+    struct dp_workers *workers = self->workers;
+    struct packet_in *pi;
+
+    pi = xmalloc(sizeof *pi);
+    pi->pkt = packet_clone(pkt);
+    pi->reason = reason;
+    pi->table_id = table_id;
+    pi->max_len = max_len;
+    pi->cookie = cookie;
+
+    if (!ring_enqueue(workers->packet_ins, pi)) {
+        VLOG_WARN_RL(LOG_MODULE, &rl, "%s %u: dropped packet-in, too many queued.",
+                     stage_names[self->stage], self->id);
+        packet_destroy(pi->pkt);
+        free(pi);
+    }
+}
+
+struct ofl_port_stats *
+dp_workers_port_stats(struct sw_port *p) {
+    return self != NULL ? &self->ports[port_index(p)].stats : p->stats;
+}
+
+int
+dp_workers_send(struct sw_port *p, struct ofpbuf *buffer) {
+    if (self != NULL && self->stage == STAGE_CLASSIFY) {
+        /* The packet is destroyed once the pipeline is done with it, so the
+         * transmitter gets a copy. Each port has one transmitter, which
+         * keeps the order of its packets. */
+        struct dp_workers *workers = self->workers;
+        struct dp_worker *transmitter = workers->stages[STAGE_TRANSMIT]
+                [port_index(p) % workers->n_stage[STAGE_TRANSMIT]];
+        struct ofpbuf *copy = ofpbuf_clone(buffer);
+
+        copy->private_p = p;
+        if (!ring_enqueue(transmitter->ring, copy)) {
+            ofpbuf_delete(copy);
+            self->dropped++;
+            return ENOBUFS;
+        }
+        return 0;
+    }
+    if (self != NULL && self->ports[port_index(p)].fd >= 0) {
+        return netdev_fanout_send(p->netdev, self->ports[port_index(p)].fd,
+                                  buffer);
+    }
+    return netdev_send(p->netdev, buffer, 0);
+}
+
+ofl_err
+dp_workers_handle_stage_stats_request(struct datapath *dp,
+                                      struct ofl_exp_openflow_msg_header *msg,
+                                      const struct sender *sender) {
+    struct dp_workers *workers = dp->workers;
+    struct ofl_exp_openflow_stage stages[STAGE_N];
+    size_t stages_num = 0;
+    unsigned int i, s;
+
+    for (s = 0; workers != NULL && s < STAGE_N; s++) {
+        struct ofl_exp_openflow_stage *stage = &stages[stages_num];
+
+        if (workers->n_stage[s] == 0) {
+            continue;
+        }
+        memset(stage, 0, sizeof *stage);
+        stage->stage = s;
+        stage->threads = workers->n_stage[s];
+        for (i = 0; i < workers->n_stage[s]; i++) {
+            struct dp_worker *w = workers->stages[s][i];
+
+            if (w->ring != NULL) {
+                stage->capacity += ring_capacity(w->ring);
+                stage->occupancy += ring_count(w->ring);
+            }
+            stage->packets += __atomic_load_n(&w->packets, __ATOMIC_RELAXED);
+            stage->dropped += __atomic_load_n(&w->dropped, __ATOMIC_RELAXED);
+        }
+        stages_num++;
+    }
+
+    {
+        struct ofl_exp_openflow_msg_stage_stats reply =
+                {{{{.type = OFPT_EXPERIMENTER},
+                   .experimenter_id = OPENFLOW_VENDOR_ID},
+                  .type = OFP_EXT_STAGE_STATS_REPLY},
+                 .stages_num = stages_num,
+                 .stages     = stages};
+
+        dp_send_message(dp, (struct ofl_msg_header *)&reply, sender);
+    }
+
+    ofl_msg_free((struct ofl_msg_header *)msg, dp->exp);
+    return 0;
+}
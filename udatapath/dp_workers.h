@@ -0,0 +1,112 @@
+/* Copyright (c) 2012, CPqD, Brazil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef DP_WORKERS_H
+#define DP_WORKERS_H 1
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "oflib/ofl.h"
+
+struct datapath;
+struct ofl_exp_openflow_msg_header;
+struct ofl_port_stats;
+struct ofpbuf;
+struct packet;
+struct sender;
+struct sw_port;
+
+/****************************************************************************
+ * Worker threads running the pipeline.
+ *
+ * Each worker opens a PACKET_FANOUT socket on every port, joined to one
+ * fanout group per port which hashes the flows over the workers, and runs
+ * the packets it receives through the pipeline with its own flow cache.
+ * The flow tables are read through RCU; the table and port counters are
+ * kept per worker and folded into the shared ones by the main thread, which
+ * also sends the packet-in messages queued by the workers. Ports which
+ * cannot fan out (tap devices) are still served by the main thread.
+ *
+ * In the staged mode the work of a packet is split over three kinds of
+ * workers instead, connected by lock-free rings: receivers own the fanout
+ * sockets and parse the packets, classifiers run them through the pipeline,
+ * and transmitters send what the classifiers output. Each flow goes to one
+ * classifier and each port to one transmitter, so packets keep their order.
+ * A stage which cannot keep up drops the packets its rings have no room
+ * for; dpctl stage-stats shows the occupancy and drops of each stage.
+ ****************************************************************************/
+
+#define DP_WORKERS_MAX 64
+
+/* Starts 'n' workers on the ports of the datapath, each running the
+ * packets it receives to completion. */
+int
+dp_workers_start(struct datapath *dp, unsigned int n);
+
+/* Starts the given number of receivers, classifiers and transmitters on the
+ * ports of the datapath. */
+int
+dp_workers_start_staged(struct datapath *dp, unsigned int n_receive,
+                        unsigned int n_classify, unsigned int n_transmit);
+
+/* Folds the counters of the workers and sends their packet-ins. */
+void
+dp_workers_run(struct datapath *dp);
+
+/* Wakes up the main thread when a worker queued a packet-in. */
+void
+dp_workers_wait(struct datapath *dp);
+
+/* Returns true if called from a worker thread. */
+bool
+dp_workers_in_worker(void);
+
+/* Queues a copy of the packet, for the main thread to send it to the
+ * controllers. */
+void
+dp_workers_packet_in(struct packet *pkt, uint8_t reason, uint8_t table_id,
+                     uint16_t max_len, uint64_t cookie);
+
+/* Returns the statistics of the port the calling thread counts into. */
+struct ofl_port_stats *
+dp_workers_port_stats(struct sw_port *p);
+
+/* Sends the buffer on the port, through the fanout socket of the calling
+ * worker if it has one. Takes the same return values as netdev_send(). */
+int
+dp_workers_send(struct sw_port *p, struct ofpbuf *buffer);
+
+/* Handles a stage stats request. */
+ofl_err
+dp_workers_handle_stage_stats_request(struct datapath *dp,
+                                      struct ofl_exp_openflow_msg_header *msg,
+                                      const struct sender *sender);
+
+
+#endif /* DP_WORKERS_H */
@@ -0,0 +1,470 @@
+/* Copyright (c) 2012, CPqD, Brazil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "classifier.h"
+#include "flow_cache.h"
+#include "flow_entry.h"
+#include "flow_table.h"
+#include "list.h"
+#include "rcu.h"
+#include "timeval.h"
+#include "util.h"
+#include "oflib/ofl-actions.h"
+#include "oflib/ofl-structs.h"
+#include "oflib/oxm-match.h"
+
+#include "vlog.h"
+#define LOG_MODULE VLM_flow_c
+
+/* Megaflows not hit for this long (in milliseconds) are expired. */
+#define MEGAFLOW_IDLE_TIMEOUT 10000
+
+struct flow_cache_slot {
+    struct flow_cache_path  path;
+    uint64_t                generation; /* generation of the path, 0 if the
+                                           slot was never used. */
+    uint32_t                hash;
+};
+
+/* A wildcarded path. The tables it visited are kept apart from the entries,
+ * as the entries may be gone once the tables changed. */
+struct megaflow {
+    struct cls_rule     rule;         /* in flow_cache's megaflows. */
+    struct list         lru_node;     /* in flow_cache's megaflow_lru. */
+    uint64_t            last_used;
+    size_t              entries_num;
+    struct flow_entry  *entries[PIPELINE_TABLES];
+    struct flow_table  *miss_table;
+    size_t              tables_num;
+    struct flow_table  *tables[PIPELINE_TABLES + 1];
+    uint64_t            generations[PIPELINE_TABLES + 1];
+};
+
+struct flow_cache {
+    struct flow_cache_slot *slots;      /* NULL if there are no slots. */
+    size_t                  mask;       /* number of slots - 1. */
+    uint64_t                generation;
+    uint32_t                used;
+    uint64_t                hits;
+    uint64_t                misses;
+    uint64_t                evictions;
+    uint64_t                invalidations;
+
+    struct classifier       megaflows;
+    struct list             megaflow_lru;  /* most recently hit first. */
+    size_t                  megaflow_max;
+    uint64_t                megaflow_hits;
+    uint64_t                megaflow_misses;
+    uint64_t                megaflow_evictions;
+    uint64_t                megaflow_expired;
+    uint64_t                megaflow_stale;
+};
+
+struct flow_cache *
+flow_cache_create(size_t size, size_t megaflows) {
+    struct flow_cache *cache = xmalloc(sizeof(struct flow_cache));
+    size_t n = 0;
+
+    cache->slots = NULL;
+    if (size > 0) {
+        void *slots;
+
+        n = 1;
+        while (n < size) {
+            n <<= 1;
+        }
+        if (posix_memalign(&slots, CACHE_LINE_SIZE, n * sizeof(struct flow_cache_slot))) {
+            out_of_memory();
+        }
+        memset(slots, 0, n * sizeof(struct flow_cache_slot));
+        cache->slots = slots;
+    }
+    cache->mask = n - 1;
+    cache->generation = 1;
+    cache->used = 0;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->evictions = 0;
+    cache->invalidations = 0;
+
+    classifier_init(&cache->megaflows);
+    list_init(&cache->megaflow_lru);
+    cache->megaflow_max = megaflows;
+    cache->megaflow_hits = 0;
+    cache->megaflow_misses = 0;
+    cache->megaflow_evictions = 0;
+    cache->megaflow_expired = 0;
+    cache->megaflow_stale = 0;
+
+    VLOG_INFO(LOG_MODULE, "Flow cache enabled with %zu entries and %zu megaflows.",
+              n, megaflows);
+    return cache;
+}
+
+static void
+megaflow_remove(struct flow_cache *cache, struct megaflow *mf) {
+    classifier_remove(&cache->megaflows, &mf->rule);
+    list_remove(&mf->lru_node);
+    free(mf);
+}
+
+void
+flow_cache_destroy(struct flow_cache *cache) {
+    if (cache != NULL) {
+        struct megaflow *mf, *next;
+
+        LIST_FOR_EACH_SAFE (mf, next, struct megaflow, lru_node, &cache->megaflow_lru) {
+            megaflow_remove(cache, mf);
+        }
+        classifier_destroy(&cache->megaflows);
+        free(cache->slots);
+        free(cache);
+    }
+}
+
+/* Returns true if none of the tables the megaflow visited changed since it
+ * was recorded. */
+static bool
+megaflow_valid(const struct megaflow *mf) {
+    size_t i;
+
+    for (i = 0; i < mf->tables_num; i++) {
+        if (mf->tables[i]->generation != mf->generations[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void
+microflow_insert(struct flow_cache *cache, const struct flow_cache_path *path) {
+    uint32_t hash;
+    struct flow_cache_slot *slot;
+
+    if (cache->slots == NULL) {
+        return;
+    }
+
+    hash = packet_key_hash(&path->key, 0);
+    slot = &cache->slots[hash & cache->mask];
+    if (slot->generation == cache->generation) {
+        if (slot->hash != hash || !packet_key_equal(&slot->path.key, &path->key)) {
+            cache->evictions++;
+        }
+    } else {
+        cache->used++;
+    }
+
+    memcpy(&slot->path.key, &path->key, sizeof(struct packet_key));
+    memcpy(slot->path.entries, path->entries,
+           path->entries_num * sizeof(struct flow_entry *));
+    slot->path.entries_num = path->entries_num;
+    slot->path.miss_table = path->miss_table;
+    slot->path.cacheable = true;
+    slot->path.wildcardable = path->wildcardable;
+    slot->generation = cache->generation;
+    slot->hash = hash;
+}
+
+static bool
+megaflow_lookup(struct flow_cache *cache, const struct packet_key *key,
+                struct flow_cache_path *path) {
+    struct cls_rule *rule;
+    struct megaflow *mf;
+
+    if (cache->megaflow_max == 0) {
+        return false;
+    }
+
+    rule = classifier_lookup(&cache->megaflows, key, NULL, NULL);
+    if (rule == NULL) {
+        cache->megaflow_misses++;
+        return false;
+    }
+    mf = CONTAINER_OF(rule, struct megaflow, rule);
+    if (!megaflow_valid(mf)) {
+        megaflow_remove(cache, mf);
+        cache->megaflow_stale++;
+        cache->megaflow_misses++;
+        return false;
+    }
+
+    cache->megaflow_hits++;
+    mf->last_used = time_msec();
+    list_remove(&mf->lru_node);
+    list_push_front(&cache->megaflow_lru, &mf->lru_node);
+
+    flow_cache_path_init(path, key);
+    memcpy(path->entries, mf->entries,
+           mf->entries_num * sizeof(struct flow_entry *));
+    path->entries_num = mf->entries_num;
+    path->miss_table = mf->miss_table;
+
+    /* Let the following packets of the microflow skip the megaflow lookup. */
+    microflow_insert(cache, path);
+    return true;
+}
+
+bool
+flow_cache_lookup(struct flow_cache *cache, const struct packet_key *key,
+                  struct flow_cache_path *path) {
+    if (cache->slots != NULL) {
+        uint32_t hash = packet_key_hash(key, 0);
+        struct flow_cache_slot *slot = &cache->slots[hash & cache->mask];
+
+        if (slot->generation == cache->generation && slot->hash == hash &&
+            packet_key_equal(&slot->path.key, key)) {
+            /* Copied out, as the slot may be taken by another microflow
+             * before the packet is done with the path. */
+            memcpy(path->entries, slot->path.entries,
+                   slot->path.entries_num * sizeof(struct flow_entry *));
+            path->entries_num = slot->path.entries_num;
+            path->miss_table = slot->path.miss_table;
+            cache->hits++;
+            return true;
+        }
+        cache->misses++;
+    }
+    return megaflow_lookup(cache, key, path);
+}
+
+void
+flow_cache_path_init(struct flow_cache_path *path, const struct packet_key *key) {
+    memcpy(&path->key, key, sizeof(struct packet_key));
+    path->entries_num = 0;
+    path->miss_table = NULL;
+    path->cacheable = true;
+    path->wildcardable = true;
+}
+
+/* Returns true if the actions only change the packet key in ways which
+ * follow from the key itself. Popping a header or rewriting the type of the
+ * next one exposes fields the key did not hold, so any later lookup could
+ * depend on them. */
+static bool
+actions_cacheable(size_t actions_num, struct ofl_action_header **actions) {
+    size_t i;
+
+    for (i = 0; i < actions_num; i++) {
+        uint16_t type = actions[i]->type;
+
+        if (type == OFPAT_POP_VLAN || type == OFPAT_POP_MPLS ||
+            type == OFPAT_POP_PBB || type == OFPAT_EXPERIMENTER) {
+            return false;
+        }
+        if (type == OFPAT_SET_FIELD) {
+            struct ofl_action_set_field *sf = (struct ofl_action_set_field *)actions[i];
+            uint8_t field = OXM_FIELD(sf->field->header);
+
+            if (field == OFPXMT_OFB_ETH_TYPE || field == OFPXMT_OFB_IP_PROTO ||
+                field == OFPXMT_OFB_IPV6_ND_SLL || field == OFPXMT_OFB_IPV6_ND_TLL) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* Returns true if the actions only change fields of the packet key from
+ * constants or from the same field. Pushing a PBB tag derives the I-SID from
+ * the VLAN tag, which the lookups may not have looked at. */
+static bool
+actions_wildcardable(size_t actions_num, struct ofl_action_header **actions) {
+    size_t i;
+
+    for (i = 0; i < actions_num; i++) {
+        if (actions[i]->type == OFPAT_PUSH_PBB) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool
+entry_cacheable(struct flow_entry *entry, bool *wildcardable) {
+    struct flow_entry_insts *insts = rcu_get(entry->insts);
+    size_t i;
+
+    for (i = 0; i < insts->num; i++) {
+        struct ofl_instruction_header *inst = insts->insts[i];
+
+        if (inst->type == OFPIT_EXPERIMENTER) {
+            return false;
+        }
+        if (inst->type == OFPIT_APPLY_ACTIONS) {
+            struct ofl_instruction_actions *ia = (struct ofl_instruction_actions *)inst;
+
+            if (!actions_cacheable(ia->actions_num, ia->actions)) {
+                return false;
+            }
+            if (!actions_wildcardable(ia->actions_num, ia->actions)) {
+                *wildcardable = false;
+            }
+        }
+    }
+    return true;
+}
+
+void
+flow_cache_path_add(struct flow_cache_path *path, struct flow_table *table,
+                    struct flow_entry *entry) {
+    if (entry == NULL) {
+        path->miss_table = table;
+        return;
+    }
+    if (path->entries_num == PIPELINE_TABLES) {
+        path->cacheable = false;
+        return;
+    }
+    path->entries[path->entries_num++] = entry;
+    if (path->cacheable && !entry_cacheable(entry, &path->wildcardable)) {
+        path->cacheable = false;
+    }
+}
+
+static void
+megaflow_insert(struct flow_cache *cache, const struct flow_cache_path *path,
+                const uint64_t *wc) {
+    const struct packet_key *key = &path->key;
+    uint64_t mask[CLS_KEY_WORDS];
+    struct megaflow *mf;
+    size_t i;
+
+    if (cache->megaflows.n_rules >= cache->megaflow_max) {
+        megaflow_remove(cache, CONTAINER_OF(list_back(&cache->megaflow_lru),
+                                            struct megaflow, lru_node));
+        cache->megaflow_evictions++;
+    }
+
+    /* The lookups looked at the bytes of fields the packet lacks only for
+     * the presence bit, which stays in the mask. Their bytes in the key are
+     * not set, so must not be part of the megaflow. */
+    memcpy(mask, wc, sizeof(mask));
+    for (i = 0; i < PACKET_KEY_FIELDS; i++) {
+        if (!(key->present & PACKET_KEY_BIT(i))) {
+            memset((uint8_t *)mask + packet_key_fields[i].offset, 0,
+                   packet_key_fields[i].length);
+        }
+    }
+
+    mf = xmalloc(sizeof(struct megaflow));
+    mf->last_used = time_msec();
+    mf->entries_num = path->entries_num;
+    memcpy(mf->entries, path->entries,
+           path->entries_num * sizeof(struct flow_entry *));
+    mf->miss_table = path->miss_table;
+    mf->tables_num = 0;
+    for (i = 0; i < path->entries_num; i++) {
+        mf->tables[mf->tables_num] = path->entries[i]->table;
+        mf->generations[mf->tables_num++] = path->entries[i]->table->generation;
+    }
+    if (path->miss_table != NULL) {
+        mf->tables[mf->tables_num] = path->miss_table;
+        mf->generations[mf->tables_num++] = path->miss_table->generation;
+    }
+
+    classifier_insert_masked(&cache->megaflows, &mf->rule, mask,
+                             (const uint64_t *)key, 0);
+    list_push_front(&cache->megaflow_lru, &mf->lru_node);
+}
+
+void
+flow_cache_insert(struct flow_cache *cache, const struct flow_cache_path *path,
+                  const uint64_t *wc) {
+    if (!path->cacheable) {
+        return;
+    }
+    microflow_insert(cache, path);
+    if (cache->megaflow_max > 0 && path->wildcardable) {
+        megaflow_insert(cache, path, wc);
+    }
+}
+
+void
+flow_cache_run(struct flow_cache *cache) {
+    uint64_t now = time_msec();
+    struct megaflow *mf, *next;
+
+    LIST_FOR_EACH_SAFE (mf, next, struct megaflow, lru_node, &cache->megaflow_lru) {
+        if (now > mf->last_used + MEGAFLOW_IDLE_TIMEOUT) {
+            megaflow_remove(cache, mf);
+            cache->megaflow_expired++;
+        } else if (!megaflow_valid(mf)) {
+            megaflow_remove(cache, mf);
+            cache->megaflow_stale++;
+        }
+    }
+}
+
+void
+flow_cache_invalidate(struct flow_cache *cache) {
+    cache->generation++;
+    cache->used = 0;
+    cache->invalidations++;
+}
+
+void
+flow_cache_get_stats(struct flow_cache *cache, struct flow_cache_stats *stats) {
+    stats->size = cache->slots != NULL ? cache->mask + 1 : 0;
+    stats->used = cache->used;
+    stats->hits = cache->hits;
+    stats->misses = cache->misses;
+    stats->evictions = cache->evictions;
+    stats->invalidations = cache->invalidations;
+    stats->megaflow_size = cache->megaflow_max;
+    stats->megaflow_used = cache->megaflows.n_rules;
+    stats->megaflow_hits = cache->megaflow_hits;
+    stats->megaflow_misses = cache->megaflow_misses;
+    stats->megaflow_evictions = cache->megaflow_evictions;
+    stats->megaflow_expired = cache->megaflow_expired;
+    stats->megaflow_stale = cache->megaflow_stale;
+}
+
+void
+flow_cache_add_stats(struct flow_cache *cache, struct flow_cache_stats *stats) {
+    struct flow_cache_stats s;
+
+    flow_cache_get_stats(cache, &s);
+    stats->size += s.size;
+    stats->used += s.used;
+    stats->hits += s.hits;
+    stats->misses += s.misses;
+    stats->evictions += s.evictions;
+    stats->invalidations += s.invalidations;
+    stats->megaflow_size += s.megaflow_size;
+    stats->megaflow_used += s.megaflow_used;
+    stats->megaflow_hits += s.megaflow_hits;
+    stats->megaflow_misses += s.megaflow_misses;
+    stats->megaflow_evictions += s.megaflow_evictions;
+    stats->megaflow_expired += s.megaflow_expired;
+    stats->megaflow_stale += s.megaflow_stale;
+}
@@ -0,0 +1,145 @@
+/* Copyright (c) 2012, CPqD, Brazil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef FLOW_CACHE_H
+#define FLOW_CACHE_H 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "packet_key.h"
+#include "openflow/openflow.h"
+
+struct flow_entry;
+struct flow_table;
+
+/****************************************************************************
+ * Exact match (microflow) cache of the pipeline. It maps the packet key seen
+ * at the entry of the pipeline to the flow entries the packet matched in
+ * each table it visited, so a packet of a known microflow skips the table
+ * lookups and only runs the instructions of these entries.
+ *
+ * The cache is a direct mapped array. Cached paths hold pointers to flow
+ * entries and are only valid for the generation they were recorded in; the
+ * generation is bumped by any change of the flow, group or meter tables or
+ * of the ports.
+ *
+ * Behind it sits a wildcarded (megaflow) cache, consulted on a microflow
+ * miss. While a packet goes through the tables, the bits of the key the
+ * classifier lookups depended on are collected; the path is then stored
+ * under these bits only, so it serves every key which agrees with the
+ * packet on them. A megaflow remembers the generation of each table it
+ * visited and is dropped as soon as one of them changes. Megaflows not hit
+ * for a while are expired, and the least recently used one is evicted when
+ * the cache is full.
+ ****************************************************************************/
+
+/* Flow entries matched by a packet, in the order of the tables visited. */
+struct flow_cache_path {
+    struct packet_key   key;          /* key at the entry of the pipeline. */
+    size_t              entries_num;
+    struct flow_entry  *entries[PIPELINE_TABLES];
+    struct flow_table  *miss_table;   /* table without a matching entry, which
+                                         ended the path, or NULL. */
+    bool                cacheable;    /* false if an entry's instructions make
+                                         the path depend on more than the key. */
+    bool                wildcardable; /* false if the path depends on fields
+                                         the lookups did not look at. */
+};
+
+struct flow_cache_stats {
+    uint32_t   size;          /* number of slots. */
+    uint32_t   used;          /* number of slots of the current generation. */
+    uint64_t   hits;
+    uint64_t   misses;
+    uint64_t   evictions;     /* valid paths replaced by another one. */
+    uint64_t   invalidations; /* generation changes. */
+
+    uint32_t   megaflow_size; /* maximum number of megaflows. */
+    uint32_t   megaflow_used;
+    uint64_t   megaflow_hits;
+    uint64_t   megaflow_misses;
+    uint64_t   megaflow_evictions; /* megaflows dropped for a new one. */
+    uint64_t   megaflow_expired;   /* megaflows dropped for being idle. */
+    uint64_t   megaflow_stale;     /* megaflows dropped after a table change. */
+};
+
+struct flow_cache;
+
+/* Creates a cache with the given number of microflow slots, rounded up to a
+ * power of two, and room for the given number of megaflows. Either may be
+ * zero to disable that level. */
+struct flow_cache *
+flow_cache_create(size_t size, size_t megaflows);
+
+/* Destroys the cache. */
+void
+flow_cache_destroy(struct flow_cache *cache);
+
+/* Looks up the cached path of the packet key. On a hit, copies the entries
+ * of the path to 'path' and returns true; the copy stays valid whatever the
+ * cache stores afterwards. */
+bool
+flow_cache_lookup(struct flow_cache *cache, const struct packet_key *key,
+                  struct flow_cache_path *path);
+
+/* Starts recording the path of a packet with the given key. */
+void
+flow_cache_path_init(struct flow_cache_path *path, const struct packet_key *key);
+
+/* Appends the result of a lookup in a table to the path. */
+void
+flow_cache_path_add(struct flow_cache_path *path, struct flow_table *table,
+                    struct flow_entry *entry);
+
+/* Stores a complete path in the cache, if it is cacheable. 'wc' holds the
+ * bits of the key (CLS_KEY_WORDS words) the lookups of the path depended
+ * on. */
+void
+flow_cache_insert(struct flow_cache *cache, const struct flow_cache_path *path,
+                  const uint64_t *wc);
+
+/* Expires idle megaflows and drops stale ones. */
+void
+flow_cache_run(struct flow_cache *cache);
+
+/* Invalidates all cached paths. */
+void
+flow_cache_invalidate(struct flow_cache *cache);
+
+/* Fills in the statistics of the cache. */
+void
+flow_cache_get_stats(struct flow_cache *cache, struct flow_cache_stats *stats);
+
+/* Adds the statistics of the cache to 'stats'. The cache may belong to
+ * another thread, whose latest updates may be missed. */
+void
+flow_cache_add_stats(struct flow_cache *cache, struct flow_cache_stats *stats);
+
+#endif /* FLOW_CACHE_H */
@@ -42,7 +42,9 @@
 #include "oflib/ofl-structs.h"
 #include "oflib/ofl-actions.h"
 #include "oflib/ofl-utils.h"
+#include "oflib/oxm-match.h"
 #include "packets.h"
+#include "rcu.h"
 #include "timeval.h"
 #include "util.h"
 
@@ -126,26 +128,56 @@ flow_entry_matches(struct flow_entry *entry, struct ofl_msg_flow_mod *mod, bool
 bool
 flow_entry_overlaps(struct flow_entry *entry, struct ofl_msg_flow_mod *mod) {
         return (entry->stats->priority == mod->priority &&
-            (mod->out_port == OFPP_ANY || flow_entry_has_out_port(entry, mod->out_port)) &&
-            (mod->out_group == OFPG_ANY || flow_entry_has_out_group(entry, mod->out_group)) &&
+            (mod->out_port == OFPP_ANY || flow_index_has_out_port(entry, mod->out_port)) &&
+            (mod->out_group == OFPG_ANY || flow_index_has_out_group(entry, mod->out_group)) &&
             match_std_overlap((struct ofl_match *)entry->stats->match,
                                             (struct ofl_match *)mod->match));
 }
 
 
+/* Returns a new set of the current instructions of the entry. */
+static struct flow_entry_insts *
+insts_create(struct flow_entry *entry) {
+    struct flow_entry_insts *insts = xmalloc(sizeof(struct flow_entry_insts));
+
+    insts->num   = entry->stats->instructions_num;
+    insts->insts = entry->stats->instructions;
+    insts->exp   = entry->dp->exp;
+    return insts;
+}
+
+/* Frees a set of instructions the entry no longer has, with the
+ * instructions. */
+static void
+insts_free(void *insts_) {
+    struct flow_entry_insts *insts = insts_;
+
+    OFL_UTILS_FREE_ARR_FUN2(insts->insts, insts->num,
+                            ofl_structs_free_instruction, insts->exp);
+    free(insts);
+}
+
 void
 flow_entry_replace_instructions(struct flow_entry *entry,
                                       size_t instructions_num,
                                       struct ofl_instruction_header **instructions) {
 
+    struct flow_entry_insts *old = entry->insts;
+
     /* TODO Zoltan: could be done more efficiently, but... */
     del_group_refs(entry);
 
-    OFL_UTILS_FREE_ARR_FUN2(entry->stats->instructions, entry->stats->instructions_num,
-                            ofl_structs_free_instruction, entry->dp->exp);
-
+    /* Packets may still be executing the old instructions; they are freed
+     * with their set once no packet can. */
     entry->stats->instructions_num = instructions_num;
     entry->stats->instructions     = instructions;
+    rcu_set(entry->insts, insts_create(entry));
+    rcu_postpone(insts_free, old);
+
+    entry->table->memory -= entry->memory;
+    entry->memory = flow_entry_memory(entry->stats->match, instructions_num,
+                                      instructions, entry->dp->exp);
+    entry->table->memory += entry->memory;
 
     init_group_refs(entry);
 }
@@ -188,6 +220,33 @@ flow_entry_hard_timeout(struct flow_entry *entry) {
     return timeout;
 }
 
+void
+flow_entry_schedule_timeout(struct flow_entry *entry) {
+    struct timer_wheel *timeouts = &entry->dp->pipeline->timeouts;
+    uint64_t expires = entry->remove_at;
+
+    if (entry->stats->idle_timeout != 0) {
+        uint64_t idle = entry->last_used + entry->stats->idle_timeout * 1000;
+
+        if (expires == 0 || idle < expires) {
+            expires = idle;
+        }
+    }
+
+    if (expires != 0) {
+        timer_wheel_insert(timeouts, &entry->timer, expires);
+    } else {
+        timer_wheel_cancel(timeouts, &entry->timer);
+    }
+}
+
+void
+flow_entry_timeout(struct flow_entry *entry) {
+    if (!flow_entry_hard_timeout(entry) && !flow_entry_idle_timeout(entry)) {
+        flow_entry_schedule_timeout(entry);
+    }
+}
+
 void
 flow_entry_update(struct flow_entry *entry) {
     entry->stats->duration_sec  =  (time_msec() - entry->created) / 1000;
@@ -325,6 +384,31 @@ del_meter_refs(struct flow_entry *entry) {
 }
 
 
+size_t
+flow_entry_memory(struct ofl_match_header *match, size_t instructions_num,
+                  struct ofl_instruction_header **instructions, struct ofl_exp *exp) {
+    size_t size = sizeof(struct flow_entry) + sizeof(struct ofl_flow_stats);
+
+    if (match->type == OFPMT_OXM) {
+        struct ofl_match *m = (struct ofl_match *)match;
+        struct ofl_match_tlv *f;
+
+        size += sizeof(struct ofl_match);
+        if (m->match_fields.mask > 0) {
+            size += (m->match_fields.mask + 1) * sizeof(struct hmap_node *);
+        }
+        HMAP_FOR_EACH (f, struct ofl_match_tlv, hmap_node, &m->match_fields) {
+            size += sizeof(struct ofl_match_tlv) + OXM_LENGTH(f->header);
+        }
+    }
+
+    /* The instructions and actions are about their wire size in memory. */
+    size += instructions_num * sizeof(struct ofl_instruction_header *);
+    size += ofl_structs_instructions_ofp_total_len(instructions, instructions_num, exp);
+
+    return size;
+}
+
 struct flow_entry *
 flow_entry_create(struct datapath *dp, struct flow_table *table, struct ofl_msg_flow_mod *mod) {
     struct flow_entry *entry;
@@ -361,6 +445,7 @@ flow_entry_create(struct datapath *dp, struct flow_table *table, struct ofl_msg_
     entry->stats->instructions_num = mod->instructions_num;
     entry->stats->instructions     = mod->instructions;
 
+    entry->insts = insts_create(entry);
     entry->match = mod->match; /* TODO: MOD MATCH? */
 
     entry->created      = now;
@@ -369,8 +454,7 @@ flow_entry_create(struct datapath *dp, struct flow_table *table, struct ofl_msg_
     entry->last_used    = now;
     entry->send_removed = ((mod->flags & OFPFF_SEND_FLOW_REM) != 0);
     list_init(&entry->match_node);
-    list_init(&entry->idle_node);
-    list_init(&entry->hard_node);
+    timer_wheel_node_init(&entry->timer);
 
     list_init(&entry->group_refs);
     init_group_refs(entry);
@@ -378,6 +462,13 @@ flow_entry_create(struct datapath *dp, struct flow_table *table, struct ofl_msg_
     list_init(&entry->meter_refs);
     init_meter_refs(entry);
 
+    entry->memory = flow_entry_memory(mod->match, mod->instructions_num,
+                                      mod->instructions, dp->exp);
+
+    entry->alone           = false;
+    entry->reorder_packets = 0;
+    entry->recent_hits     = 0;
+
     return entry;
 }
 
@@ -388,11 +479,18 @@ flow_entry_destroy(struct flow_entry *entry) {
     del_group_refs(entry);
     del_meter_refs(entry);
     ofl_structs_free_flow_stats(entry->stats, entry->dp->exp);
+    free(entry->insts);
     // assumes it is a standard match
     //free(entry->match);
     free(entry);
 }
 
+void
+flow_entry_detach(struct flow_entry *entry) {
+    del_group_refs(entry);
+    del_meter_refs(entry);
+}
+
 void
 flow_entry_remove(struct flow_entry *entry, uint8_t reason) {
     if (entry->send_removed) {
@@ -408,8 +506,14 @@ flow_entry_remove(struct flow_entry *entry, uint8_t reason) {
     }
 
     list_remove(&entry->match_node);
-    list_remove(&entry->hard_node);
-    list_remove(&entry->idle_node);
+    timer_wheel_cancel(&entry->dp->pipeline->timeouts, &entry->timer);
     entry->table->stats->active_count--;
-    flow_entry_destroy(entry);
+    entry->table->memory -= entry->memory;
+    flow_index_remove(&entry->table->index, entry);
+    entry->table->generation++;
+    pipeline_invalidate_cache(entry->dp->pipeline);
+    flow_table_unref_fields(entry->table, entry);
+    flow_entry_detach(entry);
+    /* Destroys the entry, once the lookups no longer see it. */
+    flow_table_unlink(entry->table, entry);
 }
@@ -34,24 +34,40 @@
 
 #include <stdbool.h>
 #include <sys/types.h>
+#include "classifier.h"
 #include "datapath.h"
+#include "flow_index.h"
 #include "list.h"
 #include "oflib/ofl-structs.h"
 #include "oflib/ofl-messages.h"
+#include "timer_wheel.h"
 #include "timeval.h"
 
 /****************************************************************************
  * Implementation of a flow table entry.
  ****************************************************************************/
 
+/* Instructions executed on the packets matching a flow entry. A modified
+ * entry gets a new set, so that a packet in flight executes either the old
+ * or the new instructions. */
+struct flow_entry_insts {
+    size_t                          num;
+    struct ofl_instruction_header **insts;
+    struct ofl_exp                 *exp;
+};
+
 struct flow_entry {
-    struct list              match_node;  /* list nodes in flow table lists. */
-    struct list              hard_node;
-    struct list              idle_node;
+    struct list              match_node;  /* in the flow table's entries. */
+    struct timer_wheel_node  timer;       /* in the pipeline's timeouts. */
+    struct cls_rule          cls_rule[2]; /* in the classifiers of the table's
+                                             two lookup copies. */
+    struct flow_index_node   index_node;  /* in the table's flow mod index. */
 
     struct datapath         *dp;
     struct flow_table       *table;
     struct ofl_flow_stats   *stats;
+    struct flow_entry_insts *insts; /* the instructions of stats, read by
+                                       packets through rcu_get(). */
     struct ofl_match_header *match; /* Original match structure is stored in stats;
                                        this one is a modified version, which reflects
                                        1.2 matching rules. */
@@ -66,6 +82,14 @@ struct flow_entry {
     bool                     no_byt_count; /* true if doesn't keep track of flow matched bytes*/
     struct list              group_refs;  /* list of groups referencing the flow. */
     struct list              meter_refs;  /* list of meters referencing the flow. */
+    size_t                   memory;      /* estimated bytes held by the entry. */
+
+    bool                     alone;       /* true if no entry of the same priority
+                                             overlaps this one in the table. */
+    uint64_t                 reorder_packets; /* packet count at the table's last
+                                                 reordering. */
+    uint64_t                 recent_hits; /* packets matched between the last two
+                                             reorderings. */
 };
 
 struct packet;
@@ -97,6 +121,17 @@ flow_entry_idle_timeout(struct flow_entry *entry);
 bool
 flow_entry_hard_timeout(struct flow_entry *entry);
 
+/* Schedules the timer of the entry for the earliest time it may time out at,
+ * taking its idle timeout from the last time it was used. */
+void
+flow_entry_schedule_timeout(struct flow_entry *entry);
+
+/* Handles the timer of the entry firing: removes the entry if its hard or
+ * idle timeout has passed, or schedules the timer again if the entry has
+ * been used since it was set. */
+void
+flow_entry_timeout(struct flow_entry *entry);
+
 /* Returns true if the flow entry has an output action to the given port. */
 bool
 flow_entry_has_out_port(struct flow_entry *entry, uint32_t port);
@@ -110,6 +145,12 @@ flow_entry_has_out_group(struct flow_entry *entry, uint32_t group);
 void
 flow_entry_update(struct flow_entry *entry);
 
+/* Returns an estimate of the bytes held by a flow entry with the given match
+ * and instructions. */
+size_t
+flow_entry_memory(struct ofl_match_header *match, size_t instructions_num,
+                  struct ofl_instruction_header **instructions, struct ofl_exp *exp);
+
 /* Creates a flow entry. */
 struct flow_entry *
 flow_entry_create(struct datapath *dp, struct flow_table *table, struct ofl_msg_flow_mod *mod);
@@ -118,6 +159,12 @@ flow_entry_create(struct datapath *dp, struct flow_table *table, struct ofl_msg_
 void
 flow_entry_destroy(struct flow_entry *entry);
 
+/* Drops the group and meter references of a flow entry leaving its table.
+ * The table destroys the entry later, once no packet may still be using
+ * it. */
+void
+flow_entry_detach(struct flow_entry *entry);
+
 /* Removes a flow entry with the given reason. A flow removed message is sent if needed. */
 void
 flow_entry_remove(struct flow_entry *entry, uint8_t reason);
@@ -0,0 +1,316 @@
+/* Copyright (c) 2012, CPqD, Brazil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "classifier.h"
+#include "flow_entry.h"
+#include "flow_exact.h"
+#include "hmap.h"
+#include "util.h"
+#include "oflib/ofl-structs.h"
+#include "oflib/oxm-match.h"
+
+#define EXACT_MIN_SLOTS 16
+
+typedef uint64_t __attribute__((__may_alias__)) exact_word;
+
+struct exact_slot {
+    struct flow_entry *entry;           /* NULL if the slot is free. */
+    uint32_t           hash;
+};
+
+struct flow_exact {
+    uint64_t           mask[CLS_KEY_WORDS]; /* mask shared by the entries. */
+    uint8_t            idx[CLS_KEY_WORDS];  /* key words it is not zero in. */
+    uint64_t           word_mask[CLS_KEY_WORDS]; /* mask of these words. */
+    size_t             n_words;
+    struct exact_slot *slots;           /* open addressing, linear probing. */
+    uint64_t          *values;          /* n_words masked key words of the
+                                           entry in each slot. */
+    size_t             n_slots;         /* a power of 2. */
+    size_t             n_entries;
+    struct flow_entry *deflt;           /* entry with an empty match, which
+                                           has a lower priority than all
+                                           others. */
+};
+
+static uint32_t
+hash_words(const uint64_t *value, size_t n) {
+    uint64_t hash = 0;
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        hash = (hash ^ value[i]) * 0x9e3779b97f4a7c15ULL;
+        hash ^= hash >> 29;
+    }
+    return hash ^ (hash >> 32);
+}
+
+static bool
+is_empty_match(struct flow_entry *entry) {
+    return entry->match->length == 0;
+}
+
+/* Compiles the match of an entry. Returns false if it does not fit. */
+static bool
+compile(struct flow_entry *entry, uint64_t *mask, uint64_t *value) {
+    struct ofl_match *match = (struct ofl_match *)entry->match;
+    struct ofl_match_tlv *f;
+
+    if (entry->match->type != OFPMT_OXM) {
+        return false;
+    }
+    HMAP_FOR_EACH(f, struct ofl_match_tlv, hmap_node, &match->match_fields) {
+        if (OXM_HASMASK(f->header)) {
+            return false;
+        }
+    }
+    return classifier_compile(entry->match, mask, value);
+}
+
+static void
+set_mask(struct flow_exact *exact, const uint64_t *mask) {
+    size_t i;
+
+    memcpy(exact->mask, mask, sizeof(exact->mask));
+    exact->n_words = 0;
+    for (i = 0; i < CLS_KEY_WORDS; i++) {
+        if (mask[i] != 0) {
+            exact->idx[exact->n_words] = i;
+            exact->word_mask[exact->n_words] = mask[i];
+            exact->n_words++;
+        }
+    }
+}
+
+/* Extracts the words of a (masked) value the structure keys on. */
+static void
+gather(const struct flow_exact *exact, const uint64_t *value, uint64_t *words) {
+    size_t i;
+
+    for (i = 0; i < exact->n_words; i++) {
+        words[i] = value[exact->idx[i]] & exact->word_mask[i];
+    }
+}
+
+static uint64_t *
+slot_value(const struct flow_exact *exact, size_t i) {
+    return &exact->values[i * exact->n_words];
+}
+
+/* Returns the slot holding the given words, or the free slot ending their
+ * probe sequence. */
+static size_t
+find_slot(const struct flow_exact *exact, const uint64_t *words, uint32_t hash) {
+    size_t mask = exact->n_slots - 1;
+    size_t i;
+
+    for (i = hash & mask; exact->slots[i].entry != NULL; i = (i + 1) & mask) {
+        if (exact->slots[i].hash == hash &&
+            !memcmp(slot_value(exact, i), words,
+                    exact->n_words * sizeof(uint64_t))) {
+            break;
+        }
+    }
+    return i;
+}
+
+static void
+resize(struct flow_exact *exact, size_t n_slots) {
+    struct exact_slot *slots = exact->slots;
+    uint64_t *values = exact->values;
+    size_t old = exact->n_slots;
+    size_t i;
+
+    exact->slots = xcalloc(n_slots, sizeof(struct exact_slot));
+    exact->values = xmalloc(n_slots * MAX(exact->n_words, 1) * sizeof(uint64_t));
+    exact->n_slots = n_slots;
+    for (i = 0; i < old; i++) {
+        if (slots[i].entry != NULL) {
+            const uint64_t *words = &values[i * exact->n_words];
+            size_t j = find_slot(exact, words, slots[i].hash);
+
+            exact->slots[j] = slots[i];
+            memcpy(slot_value(exact, j), words, exact->n_words * sizeof(uint64_t));
+        }
+    }
+    free(slots);
+    free(values);
+}
+
+struct flow_exact *
+flow_exact_create(void) {
+    struct flow_exact *exact = xcalloc(1, sizeof(struct flow_exact));
+
+    resize(exact, EXACT_MIN_SLOTS);
+    return exact;
+}
+
+void
+flow_exact_destroy(struct flow_exact *exact) {
+    if (exact == NULL) {
+        return;
+    }
+    free(exact->slots);
+    free(exact->values);
+    free(exact);
+}
+
+bool
+flow_exact_fits(struct flow_entry *entry) {
+    uint64_t mask[CLS_KEY_WORDS], value[CLS_KEY_WORDS];
+
+    return is_empty_match(entry) || compile(entry, mask, value);
+}
+
+bool
+flow_exact_insert(struct flow_exact *exact, struct flow_entry *entry) {
+    uint64_t mask[CLS_KEY_WORDS], value[CLS_KEY_WORDS], words[CLS_KEY_WORDS];
+    uint16_t priority = entry->stats->priority;
+    uint32_t hash;
+    size_t i;
+
+    if (is_empty_match(entry)) {
+        if (exact->deflt != NULL) {
+            return false;
+        }
+        for (i = 0; i < exact->n_slots; i++) {
+            if (exact->slots[i].entry != NULL &&
+                exact->slots[i].entry->stats->priority <= priority) {
+                return false;
+            }
+        }
+        exact->deflt = entry;
+        return true;
+    }
+
+    if (!compile(entry, mask, value) ||
+        (exact->deflt != NULL && exact->deflt->stats->priority >= priority)) {
+        return false;
+    }
+    if (exact->n_entries == 0) {
+        set_mask(exact, mask);
+        resize(exact, EXACT_MIN_SLOTS);
+    } else if (memcmp(mask, exact->mask, sizeof(mask))) {
+        return false;
+    }
+
+    gather(exact, value, words);
+    hash = hash_words(words, exact->n_words);
+    i = find_slot(exact, words, hash);
+    if (exact->slots[i].entry != NULL) {
+        return false;
+    }
+    if ((exact->n_entries + 1) * 2 > exact->n_slots) {
+        resize(exact, exact->n_slots * 2);
+        i = find_slot(exact, words, hash);
+    }
+    exact->slots[i].entry = entry;
+    exact->slots[i].hash = hash;
+    memcpy(slot_value(exact, i), words, exact->n_words * sizeof(uint64_t));
+    exact->n_entries++;
+    return true;
+}
+
+void
+flow_exact_remove(struct flow_exact *exact, struct flow_entry *entry) {
+    uint64_t mask[CLS_KEY_WORDS], value[CLS_KEY_WORDS], words[CLS_KEY_WORDS];
+    size_t slot_mask = exact->n_slots - 1;
+    size_t i, j;
+
+    if (entry == exact->deflt) {
+        exact->deflt = NULL;
+        return;
+    }
+    compile(entry, mask, value);
+    gather(exact, value, words);
+    i = find_slot(exact, words, hash_words(words, exact->n_words));
+    if (exact->slots[i].entry != entry) {
+        return;
+    }
+
+    /* Shift back the entries behind the freed slot which would no longer
+     * be reached from their home slot. */
+    for (j = (i + 1) & slot_mask; exact->slots[j].entry != NULL;
+         j = (j + 1) & slot_mask) {
+        size_t home = exact->slots[j].hash & slot_mask;
+
+        if ((j > i && (home <= i || home > j)) ||
+            (j < i && (home <= i && home > j))) {
+            exact->slots[i] = exact->slots[j];
+            memcpy(slot_value(exact, i), slot_value(exact, j),
+                   exact->n_words * sizeof(uint64_t));
+            i = j;
+        }
+    }
+    exact->slots[i].entry = NULL;
+    exact->n_entries--;
+
+    if (exact->n_slots > EXACT_MIN_SLOTS && exact->n_entries * 8 < exact->n_slots) {
+        resize(exact, exact->n_slots / 2);
+    }
+}
+
+struct flow_entry *
+flow_exact_lookup(const struct flow_exact *exact, const struct packet_key *key,
+                  uint64_t *wc, size_t *probes) {
+    const exact_word *kw = (const exact_word *)key;
+    uint64_t words[CLS_KEY_WORDS];
+    uint32_t hash;
+    size_t i;
+
+    if (exact->n_entries == 0) {
+        if (probes != NULL) {
+            *probes = 0;
+        }
+        return exact->deflt;
+    }
+    for (i = 0; i < exact->n_words; i++) {
+        words[i] = kw[exact->idx[i]] & exact->word_mask[i];
+    }
+    if (wc != NULL) {
+        for (i = 0; i < exact->n_words; i++) {
+            wc[exact->idx[i]] |= exact->word_mask[i];
+        }
+    }
+    hash = hash_words(words, exact->n_words);
+    i = find_slot(exact, words, hash);
+    if (probes != NULL) {
+        *probes = ((i - hash) & (exact->n_slots - 1)) + 1;
+    }
+    return exact->slots[i].entry != NULL ? exact->slots[i].entry : exact->deflt;
+}
+
+size_t
+flow_exact_memory(const struct flow_exact *exact) {
+    return sizeof(struct flow_exact) +
+           exact->n_slots * (sizeof(struct exact_slot) +
+                             MAX(exact->n_words, 1) * sizeof(uint64_t));
+}
@@ -0,0 +1,86 @@
+/* Copyright (c) 2012, CPqD, Brazil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef FLOW_EXACT_H
+#define FLOW_EXACT_H 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "packet_key.h"
+
+struct flow_entry;
+
+/****************************************************************************
+ * Exact match structure for tables whose entries all match on the same
+ * fields, without masks (MAC tables, per host rules). The entries share
+ * one mask over the packet key, so a lookup masks the key once and probes
+ * a single open addressing hash table, in time independent of the number
+ * of entries. No two entries may have the same match, as the table would
+ * then have to order them by priority.
+ ****************************************************************************/
+
+struct flow_exact;
+
+/* Creates an empty structure. */
+struct flow_exact *
+flow_exact_create(void);
+
+/* Destroys the structure; the entries are not touched. */
+void
+flow_exact_destroy(struct flow_exact *exact);
+
+/* Returns true if the match of the entry is fully specified: it has no
+ * masked field and can be satisfied. */
+bool
+flow_exact_fits(struct flow_entry *entry);
+
+/* Inserts the entry. Returns false, leaving the structure unchanged, if the
+ * entry does not fit, if it matches on other fields than the entries
+ * already held, or if one of them has the same match. */
+bool
+flow_exact_insert(struct flow_exact *exact, struct flow_entry *entry);
+
+/* Removes an entry inserted before. */
+void
+flow_exact_remove(struct flow_exact *exact, struct flow_entry *entry);
+
+/* Returns the entry matching the key, or NULL. If wc is not NULL, the bits
+ * of the key the result depends on are added to it, as by
+ * classifier_lookup(). If probes is not NULL, it is set to the number of
+ * slots looked into. */
+struct flow_entry *
+flow_exact_lookup(const struct flow_exact *exact, const struct packet_key *key,
+                  uint64_t *wc, size_t *probes);
+
+/* Returns the bytes held by the structure. */
+size_t
+flow_exact_memory(const struct flow_exact *exact);
+
+#endif /* FLOW_EXACT_H */
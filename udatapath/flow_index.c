@@ -0,0 +1,698 @@
+/* Copyright (c) 2012, CPqD, Brazil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "flow_entry.h"
+#include "flow_index.h"
+#include "hash.h"
+#include "match_std.h"
+#include "util.h"
+#include "oflib/ofl-actions.h"
+#include "oflib/ofl-structs.h"
+#include "oflib/oxm-match.h"
+#include "openflow/openflow.h"
+
+/* Entries of equal priority and shape. */
+struct flow_index_group {
+    struct hmap_node   node;        /* in flow_index's groups. */
+    uint16_t           priority;
+    struct ofl_match  *shape;       /* match of an entry of the group. */
+    struct hmap        entries;     /* flow entries, by masked values. */
+};
+
+/* Entries with the same cookie. */
+struct flow_index_cookie {
+    struct hmap_node   node;        /* in flow_index's cookies. */
+    uint64_t           cookie;
+    struct list        entries;     /* flow entries, by cookie_node. */
+};
+
+enum output_kind {
+    OUTPUT_PORT,
+    OUTPUT_GROUP
+};
+
+/* Entries outputting to a port or group. */
+struct flow_index_output {
+    struct hmap_node   node;        /* in flow_index's outputs. */
+    uint8_t            kind;        /* OUTPUT_PORT or OUTPUT_GROUP. */
+    uint32_t           id;
+    struct list        refs;        /* flow_index_refs. */
+};
+
+/* Class and field of an OXM header, without the mask bit and length. */
+#define OXM_FIELD_ID(HEADER) ((HEADER) >> 9)
+
+static const uint8_t all_ones[16] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+};
+
+/* Returns the length of the value of the TLV and sets 'mask' to its mask,
+ * all ones if it has none. */
+static size_t
+tlv_value(const struct ofl_match_tlv *f, const uint8_t **mask) {
+    size_t len = OXM_LENGTH(f->header);
+
+    if (OXM_HASMASK(f->header)) {
+        len /= 2;
+        *mask = f->value + len;
+    } else {
+        *mask = all_ones;
+    }
+    return len;
+}
+
+/* Hashes the value of a TLV under 'mask'. */
+static uint32_t
+hash_value(const struct ofl_match_tlv *f, const uint8_t *mask, size_t len,
+           uint32_t basis) {
+    uint8_t masked[16];
+    size_t i;
+
+    for (i = 0; i < len && i < sizeof(masked); i++) {
+        masked[i] = f->value[i] & mask[i];
+    }
+    return hash_bytes(masked, i, basis);
+}
+
+/* Hashes the value of a TLV under its own mask. */
+static uint32_t
+hash_masked(const struct ofl_match_tlv *f, uint32_t basis) {
+    const uint8_t *mask;
+    size_t len = tlv_value(f, &mask);
+
+    return hash_value(f, mask, len, basis);
+}
+
+/* Fields are combined by addition, as the order of the fields in a match
+ * depends on how it was built. */
+static uint32_t
+hash_strict(struct ofl_match *match, uint16_t priority) {
+    struct ofl_match_tlv *f;
+    uint32_t hash = 0;
+
+    HMAP_FOR_EACH (f, struct ofl_match_tlv, hmap_node, &match->match_fields) {
+        const uint8_t *mask;
+        size_t len = tlv_value(f, &mask);
+
+        hash += hash_bytes(mask, len, hash_masked(f, f->header));
+    }
+    return hash_int(priority, hash);
+}
+
+static uint32_t
+hash_shape(struct ofl_match *match, uint16_t priority) {
+    struct ofl_match_tlv *f;
+    uint32_t hash = 0;
+
+    HMAP_FOR_EACH (f, struct ofl_match_tlv, hmap_node, &match->match_fields) {
+        const uint8_t *mask;
+        size_t len = tlv_value(f, &mask);
+
+        hash += hash_bytes(mask, len, OXM_FIELD_ID(f->header));
+    }
+    return hash_int(priority, hash);
+}
+
+/* match_std_overlap() does not compare 24 bit fields, so they are left out
+ * of the values an overlap probe relies on. */
+static bool
+overlap_field(const struct ofl_match_tlv *f) {
+    const uint8_t *mask;
+
+    return tlv_value(f, &mask) != 3;
+}
+
+static uint32_t
+hash_values(struct ofl_match *match) {
+    struct ofl_match_tlv *f;
+    uint32_t hash = 0;
+
+    HMAP_FOR_EACH (f, struct ofl_match_tlv, hmap_node, &match->match_fields) {
+        if (overlap_field(f)) {
+            hash += hash_masked(f, OXM_FIELD_ID(f->header));
+        }
+    }
+    return hash;
+}
+
+/* Returns the TLV of the match for the same field as 'f', masked or not. */
+static struct ofl_match_tlv *
+lookup_field(const struct ofl_match_tlv *f, struct ofl_match *match) {
+    uint32_t header = f->header & 0xfffffe00;
+    size_t len = OXM_LENGTH(f->header) / (OXM_HASMASK(f->header) ? 2 : 1);
+    struct ofl_match_tlv *g;
+
+    g = oxm_match_lookup(header | len, match);
+    if (g == NULL) {
+        g = oxm_match_lookup(header | 0x100 | (len * 2), match);
+    }
+    return g;
+}
+
+/* Returns true if both matches have the same fields with the same masks. */
+static bool
+same_shape(struct ofl_match *a, struct ofl_match *b) {
+    struct ofl_match_tlv *f;
+
+    if (hmap_count(&a->match_fields) != hmap_count(&b->match_fields)) {
+        return false;
+    }
+    HMAP_FOR_EACH (f, struct ofl_match_tlv, hmap_node, &a->match_fields) {
+        struct ofl_match_tlv *g = lookup_field(f, b);
+        const uint8_t *mask_f, *mask_g;
+        size_t len;
+
+        if (g == NULL) {
+            return false;
+        }
+        len = tlv_value(f, &mask_f);
+        tlv_value(g, &mask_g);
+        if (memcmp(mask_f, mask_g, len)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Computes the hash the entries of a group overlapping with the match would
+ * have. That is only possible if the match has every field of the group with
+ * at least the group's mask bits set; otherwise returns false, and any entry
+ * of the group may overlap. */
+static bool
+hash_probe(struct ofl_match *shape, struct ofl_match *match, uint32_t *hash) {
+    struct ofl_match_tlv *f;
+
+    *hash = 0;
+    HMAP_FOR_EACH (f, struct ofl_match_tlv, hmap_node, &shape->match_fields) {
+        struct ofl_match_tlv *g;
+        const uint8_t *mask_f, *mask_g;
+        size_t len, i;
+
+        if (!overlap_field(f)) {
+            continue;
+        }
+        g = lookup_field(f, match);
+        if (g == NULL) {
+            return false;
+        }
+        len = tlv_value(f, &mask_f);
+        tlv_value(g, &mask_g);
+        for (i = 0; i < len; i++) {
+            if (mask_f[i] & ~mask_g[i]) {
+                return false;
+            }
+        }
+        *hash += hash_value(g, mask_f, len, OXM_FIELD_ID(f->header));
+    }
+    return true;
+}
+
+/* Cookies hash to themselves folded, so that a masked filter on the top
+ * bits (the usual way to tag the entries of an application) still spreads
+ * over the buckets. */
+static uint32_t
+hash_cookie(uint64_t cookie) {
+    return hash_int((uint32_t)cookie ^ (uint32_t)(cookie >> 32), 0);
+}
+
+static uint32_t
+hash_output(uint8_t kind, uint32_t id) {
+    return hash_int(id, kind);
+}
+
+static struct flow_index_cookie *
+find_cookie(const struct flow_index *index, uint64_t cookie) {
+    struct flow_index_cookie *c;
+
+    HMAP_FOR_EACH_WITH_HASH (c, struct flow_index_cookie, node,
+                             hash_cookie(cookie), &index->cookies) {
+        if (c->cookie == cookie) {
+            return c;
+        }
+    }
+    return NULL;
+}
+
+static struct flow_index_output *
+find_output(const struct flow_index *index, uint8_t kind, uint32_t id) {
+    struct flow_index_output *o;
+
+    HMAP_FOR_EACH_WITH_HASH (o, struct flow_index_output, node,
+                             hash_output(kind, id), &index->outputs) {
+        if (o->kind == kind && o->id == id) {
+            return o;
+        }
+    }
+    return NULL;
+}
+
+static void
+insert_cookie(struct flow_index *index, struct flow_entry *entry) {
+    uint64_t cookie = entry->stats->cookie;
+    struct flow_index_cookie *c = find_cookie(index, cookie);
+
+    if (c == NULL) {
+        c = xmalloc(sizeof(struct flow_index_cookie));
+        c->cookie = cookie;
+        list_init(&c->entries);
+        hmap_insert(&index->cookies, &c->node, hash_cookie(cookie));
+    }
+    list_push_back(&c->entries, &entry->index_node.cookie_node);
+    entry->index_node.cookie = c;
+}
+
+static void
+remove_cookie(struct flow_index *index, struct flow_entry *entry) {
+    struct flow_index_cookie *c = entry->index_node.cookie;
+
+    list_remove(&entry->index_node.cookie_node);
+    if (list_is_empty(&c->entries)) {
+        hmap_remove(&index->cookies, &c->node);
+        free(c);
+    }
+}
+
+/* Returns the output bucket of a port or group, creating it if needed. */
+static struct flow_index_output *
+get_output(struct flow_index *index, uint8_t kind, uint32_t id) {
+    struct flow_index_output *o = find_output(index, kind, id);
+
+    if (o == NULL) {
+        o = xmalloc(sizeof(struct flow_index_output));
+        o->kind = kind;
+        o->id = id;
+        list_init(&o->refs);
+        hmap_insert(&index->outputs, &o->node, hash_output(kind, id));
+    }
+    return o;
+}
+
+/* Adds a reference from the entry to the output, unless it has one. */
+static void
+add_output(struct flow_index *index, struct flow_entry *entry,
+           uint8_t kind, uint32_t id) {
+    struct flow_index_node *node = &entry->index_node;
+    struct flow_index_output *o = get_output(index, kind, id);
+    struct flow_index_ref *ref;
+    size_t i;
+
+    for (i = 0; i < node->n_refs; i++) {
+        if (node->refs[i].output == o) {
+            return;
+        }
+    }
+    ref = &node->refs[node->n_refs++];
+    ref->output = o;
+    ref->entry = entry;
+    list_push_back(&o->refs, &ref->node);
+}
+
+/* Indexes the ports and groups the apply and write actions of the entry
+ * output to, as flow_entry_has_out_port() and flow_entry_has_out_group()
+ * find them. */
+static void
+insert_outputs(struct flow_index *index, struct flow_entry *entry) {
+    struct flow_index_node *node = &entry->index_node;
+    size_t n_actions = 0;
+    size_t i, j;
+
+    for (i = 0; i < entry->stats->instructions_num; i++) {
+        struct ofl_instruction_header *inst = entry->stats->instructions[i];
+
+        if (inst->type == OFPIT_APPLY_ACTIONS || inst->type == OFPIT_WRITE_ACTIONS) {
+            n_actions += ((struct ofl_instruction_actions *)inst)->actions_num;
+        }
+    }
+
+    /* Sized for every action, so the references do not move once linked. */
+    node->refs = n_actions == 0 ? NULL
+                 : xmalloc(n_actions * sizeof(struct flow_index_ref));
+    node->n_refs = 0;
+    for (i = 0; i < entry->stats->instructions_num; i++) {
+        struct ofl_instruction_header *inst = entry->stats->instructions[i];
+        struct ofl_instruction_actions *ia;
+
+        if (inst->type != OFPIT_APPLY_ACTIONS && inst->type != OFPIT_WRITE_ACTIONS) {
+            continue;
+        }
+        ia = (struct ofl_instruction_actions *)inst;
+        for (j = 0; j < ia->actions_num; j++) {
+            if (ia->actions[j]->type == OFPAT_OUTPUT) {
+                add_output(index, entry, OUTPUT_PORT,
+                           ((struct ofl_action_output *)ia->actions[j])->port);
+            } else if (ia->actions[j]->type == OFPAT_GROUP) {
+                add_output(index, entry, OUTPUT_GROUP,
+                           ((struct ofl_action_group *)ia->actions[j])->group_id);
+            }
+        }
+    }
+}
+
+static void
+remove_outputs(struct flow_index *index, struct flow_entry *entry) {
+    struct flow_index_node *node = &entry->index_node;
+    size_t i;
+
+    for (i = 0; i < node->n_refs; i++) {
+        struct flow_index_output *o = node->refs[i].output;
+
+        list_remove(&node->refs[i].node);
+        if (list_is_empty(&o->refs)) {
+            hmap_remove(&index->outputs, &o->node);
+            free(o);
+        }
+    }
+    free(node->refs);
+    node->refs = NULL;
+    node->n_refs = 0;
+}
+
+void
+flow_index_init(struct flow_index *index) {
+    hmap_init(&index->strict);
+    hmap_init(&index->groups);
+    hmap_init(&index->cookies);
+    hmap_init(&index->outputs);
+    index->next_seq = 0;
+}
+
+void
+flow_index_destroy(struct flow_index *index) {
+    struct flow_index_group *group, *next;
+
+    HMAP_FOR_EACH_SAFE (group, next, struct flow_index_group, node, &index->groups) {
+        hmap_remove(&index->groups, &group->node);
+        hmap_destroy(&group->entries);
+        free(group);
+    }
+    hmap_destroy(&index->groups);
+    hmap_destroy(&index->strict);
+    hmap_destroy(&index->cookies);
+    hmap_destroy(&index->outputs);
+}
+
+static struct flow_index_group *
+find_group(struct flow_index *index, struct ofl_match *match,
+           uint16_t priority, uint32_t hash) {
+    struct flow_index_group *group;
+
+    HMAP_FOR_EACH_WITH_HASH (group, struct flow_index_group, node, hash, &index->groups) {
+        if (group->priority == priority && same_shape(group->shape, match)) {
+            return group;
+        }
+    }
+    return NULL;
+}
+
+void
+flow_index_insert(struct flow_index *index, struct flow_entry *entry) {
+    struct ofl_match *match = (struct ofl_match *)entry->stats->match;
+    uint16_t priority = entry->stats->priority;
+    struct flow_index_group *group;
+    uint32_t hash;
+
+    hmap_insert(&index->strict, &entry->index_node.strict_node,
+                hash_strict(match, priority));
+
+    hash = hash_shape(match, priority);
+    group = find_group(index, match, priority, hash);
+    if (group == NULL) {
+        group = xmalloc(sizeof(struct flow_index_group));
+        group->priority = priority;
+        group->shape = match;
+        hmap_init(&group->entries);
+        hmap_insert(&index->groups, &group->node, hash);
+    }
+
+    entry->index_node.group = group;
+    hmap_insert(&group->entries, &entry->index_node.group_node,
+                hash_values(match));
+
+    entry->index_node.seq = index->next_seq++;
+    insert_cookie(index, entry);
+    insert_outputs(index, entry);
+}
+
+void
+flow_index_remove(struct flow_index *index, struct flow_entry *entry) {
+    struct flow_index_group *group = entry->index_node.group;
+
+    hmap_remove(&index->strict, &entry->index_node.strict_node);
+    hmap_remove(&group->entries, &entry->index_node.group_node);
+
+    if (hmap_is_empty(&group->entries)) {
+        hmap_remove(&index->groups, &group->node);
+        hmap_destroy(&group->entries);
+        free(group);
+    } else if (group->shape == (struct ofl_match *)entry->stats->match) {
+        struct flow_entry *other = CONTAINER_OF(hmap_first(&group->entries),
+                                                struct flow_entry,
+                                                index_node.group_node);
+        group->shape = (struct ofl_match *)other->stats->match;
+    }
+
+    remove_cookie(index, entry);
+    remove_outputs(index, entry);
+}
+
+void
+flow_index_replace(struct flow_index *index, struct flow_entry *old,
+                   struct flow_entry *entry) {
+    uint64_t seq = old->index_node.seq;
+
+    flow_index_remove(index, old);
+    flow_index_insert(index, entry);
+    entry->index_node.seq = seq;
+}
+
+void
+flow_index_update_outputs(struct flow_index *index, struct flow_entry *entry) {
+    remove_outputs(index, entry);
+    insert_outputs(index, entry);
+}
+
+/* The hmap iteration macros test the address of the member for NULL, which
+ * only works for members at the start of the structure; the index nodes are
+ * not, so their maps are walked node by node. */
+
+struct flow_entry *
+flow_index_find_strict(const struct flow_index *index,
+                       struct ofl_match_header *match_, uint16_t priority) {
+    struct ofl_match *match = (struct ofl_match *)match_;
+    struct hmap_node *node;
+
+    for (node = hmap_first_with_hash(&index->strict, hash_strict(match, priority));
+         node != NULL; node = hmap_next_with_hash(node)) {
+        struct flow_entry *entry = CONTAINER_OF(node, struct flow_entry,
+                                                index_node.strict_node);
+
+        if (entry->stats->priority == priority &&
+            match_std_strict(match, (struct ofl_match *)entry->stats->match)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+bool
+flow_index_overlaps(const struct flow_index *index, struct ofl_msg_flow_mod *mod) {
+    struct ofl_match *match = (struct ofl_match *)mod->match;
+    struct flow_index_group *group;
+
+    HMAP_FOR_EACH (group, struct flow_index_group, node, &index->groups) {
+        struct hmap_node *node;
+        bool probe;
+        uint32_t hash;
+
+        if (group->priority != mod->priority) {
+            continue;
+        }
+        probe = hash_probe(group->shape, match, &hash);
+        for (node = probe ? hmap_first_with_hash(&group->entries, hash)
+                          : hmap_first(&group->entries);
+             node != NULL;
+             node = probe ? hmap_next_with_hash(node)
+                          : hmap_next(&group->entries, node)) {
+            struct flow_entry *entry = CONTAINER_OF(node, struct flow_entry,
+                                                    index_node.group_node);
+
+            if (flow_entry_overlaps(entry, mod)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void
+flow_index_find_overlaps(const struct flow_index *index,
+                         struct ofl_match_header *match_, uint16_t priority,
+                         struct flow_entry ***entries, size_t *n) {
+    struct ofl_match *match = (struct ofl_match *)match_;
+    struct flow_index_group *group;
+    size_t size = 4;
+
+    *entries = xmalloc(size * sizeof(struct flow_entry *));
+    *n = 0;
+    HMAP_FOR_EACH (group, struct flow_index_group, node, &index->groups) {
+        struct hmap_node *node;
+        bool probe;
+        uint32_t hash;
+
+        if (group->priority != priority) {
+            continue;
+        }
+        probe = hash_probe(group->shape, match, &hash);
+        for (node = probe ? hmap_first_with_hash(&group->entries, hash)
+                          : hmap_first(&group->entries);
+             node != NULL;
+             node = probe ? hmap_next_with_hash(node)
+                          : hmap_next(&group->entries, node)) {
+            struct flow_entry *entry = CONTAINER_OF(node, struct flow_entry,
+                                                    index_node.group_node);
+
+            if (match_std_overlap((struct ofl_match *)entry->stats->match, match)) {
+                if (*n == size) {
+                    size *= 2;
+                    *entries = xrealloc(*entries, size * sizeof(struct flow_entry *));
+                }
+                (*entries)[(*n)++] = entry;
+            }
+        }
+    }
+}
+
+static bool
+has_output(const struct flow_entry *entry, uint8_t kind, uint32_t id) {
+    const struct flow_index_node *node = &entry->index_node;
+    size_t i;
+
+    for (i = 0; i < node->n_refs; i++) {
+        if (node->refs[i].output->kind == kind && node->refs[i].output->id == id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool
+flow_index_has_out_port(const struct flow_entry *entry, uint32_t port) {
+    return has_output(entry, OUTPUT_PORT, port);
+}
+
+bool
+flow_index_has_out_group(const struct flow_entry *entry, uint32_t group) {
+    return has_output(entry, OUTPUT_GROUP, group);
+}
+
+/* Entries picked by flow_index_select(). */
+struct selection {
+    struct flow_entry **entries;
+    size_t              n;
+    size_t              size;
+    uint64_t            cookie;         /* masked by cookie_mask. */
+    uint64_t            cookie_mask;
+    uint32_t            out_port;
+    uint32_t            out_group;
+};
+
+static void
+select_entry(struct selection *sel, struct flow_entry *entry) {
+    if ((entry->stats->cookie & sel->cookie_mask) != sel->cookie ||
+        (sel->out_port != OFPP_ANY && !has_output(entry, OUTPUT_PORT, sel->out_port)) ||
+        (sel->out_group != OFPG_ANY && !has_output(entry, OUTPUT_GROUP, sel->out_group))) {
+        return;
+    }
+    if (sel->n == sel->size) {
+        sel->size = sel->size == 0 ? 16 : sel->size * 2;
+        sel->entries = xrealloc(sel->entries, sel->size * sizeof(struct flow_entry *));
+    }
+    sel->entries[sel->n++] = entry;
+}
+
+static int
+cmp_seq(const void *a_, const void *b_) {
+    const struct flow_entry *a = *(struct flow_entry *const *)a_;
+    const struct flow_entry *b = *(struct flow_entry *const *)b_;
+
+    return a->index_node.seq < b->index_node.seq ? -1
+         : a->index_node.seq > b->index_node.seq;
+}
+
+bool
+flow_index_select(const struct flow_index *index, uint64_t cookie,
+                  uint64_t cookie_mask, uint32_t out_port, uint32_t out_group,
+                  struct flow_entry ***entries, size_t *n) {
+    struct selection sel = {NULL, 0, 0, cookie & cookie_mask, cookie_mask,
+                            out_port, out_group};
+    struct flow_index_cookie *c;
+    struct flow_entry *entry;
+
+    if (out_port != OFPP_ANY || out_group != OFPG_ANY) {
+        /* A port or group is referenced by few entries; walk those. */
+        struct flow_index_output *o = out_port != OFPP_ANY
+                                      ? find_output(index, OUTPUT_PORT, out_port)
+                                      : find_output(index, OUTPUT_GROUP, out_group);
+        struct flow_index_ref *ref;
+
+        if (o != NULL) {
+            LIST_FOR_EACH (ref, struct flow_index_ref, node, &o->refs) {
+                select_entry(&sel, ref->entry);
+            }
+        }
+    } else if (cookie_mask == UINT64_MAX) {
+        c = find_cookie(index, cookie);
+        if (c != NULL) {
+            LIST_FOR_EACH (entry, struct flow_entry, index_node.cookie_node, &c->entries) {
+                select_entry(&sel, entry);
+            }
+        }
+    } else if (cookie_mask != 0) {
+        HMAP_FOR_EACH (c, struct flow_index_cookie, node, &index->cookies) {
+            if ((c->cookie & cookie_mask) != sel.cookie) {
+                continue;
+            }
+            LIST_FOR_EACH (entry, struct flow_entry, index_node.cookie_node, &c->entries) {
+                select_entry(&sel, entry);
+            }
+        }
+    } else {
+        return false;
+    }
+
+    if (sel.n > 1) {
+        qsort(sel.entries, sel.n, sizeof(struct flow_entry *), cmp_seq);
+    }
+    *entries = sel.entries;
+    *n = sel.n;
+    return true;
+}
@@ -0,0 +1,149 @@
+/* Copyright (c) 2012, CPqD, Brazil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef FLOW_INDEX_H
+#define FLOW_INDEX_H 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "hmap.h"
+#include "list.h"
+#include "oflib/ofl-messages.h"
+#include "oflib/ofl-structs.h"
+
+struct flow_entry;
+
+/****************************************************************************
+ * Indexes of the entries of a flow table for flow mod processing, so that
+ * adding, modifying and deleting entries does not need to scan the table.
+ *
+ * The strict index hashes an entry by its priority and its normalized match
+ * (the set of fields, their masks and their masked values), and finds the
+ * entry a strict flow mod refers to.
+ *
+ * The overlap index groups the entries by priority and shape, i.e. the set
+ * of fields and their masks. Within a group the entries are hashed by their
+ * masked values. Two entries of the same shape only overlap if their masked
+ * values are equal, so a flow mod matching on every field of a group is
+ * checked against a single bucket of it; other groups are scanned.
+ *
+ * The secondary indexes serve the cookie, out_port and out_group filters of
+ * flow mods and flow stats requests. Entries are bucketed by cookie, so a
+ * masked cookie filter checks each distinct cookie once rather than each
+ * entry, and by the ports and groups their actions output to.
+ ****************************************************************************/
+
+struct flow_index {
+    struct hmap   strict;       /* entries, by priority and match. */
+    struct hmap   groups;       /* flow_index_groups, by priority and shape. */
+    struct hmap   cookies;      /* flow_index_cookies, by cookie. */
+    struct hmap   outputs;      /* flow_index_outputs, by port or group. */
+    uint64_t      next_seq;
+};
+
+/* Reference from an entry to a port or group its actions output to. */
+struct flow_index_ref {
+    struct list                node;        /* in the output's refs. */
+    struct flow_index_output  *output;
+    struct flow_entry         *entry;
+};
+
+/* Index nodes of a flow entry. */
+struct flow_index_node {
+    struct hmap_node          strict_node;  /* in flow_index's strict. */
+    struct hmap_node          group_node;   /* in the group's entries. */
+    struct flow_index_group  *group;
+    struct list               cookie_node;  /* in the cookie's entries. */
+    struct flow_index_cookie *cookie;
+    struct flow_index_ref    *refs;         /* one per output port or group. */
+    size_t                    n_refs;
+    uint64_t                  seq;          /* position in the table. */
+};
+
+void
+flow_index_init(struct flow_index *index);
+
+void
+flow_index_destroy(struct flow_index *index);
+
+/* Adds the entry to the index. */
+void
+flow_index_insert(struct flow_index *index, struct flow_entry *entry);
+
+/* Removes the entry from the index. */
+void
+flow_index_remove(struct flow_index *index, struct flow_entry *entry);
+
+/* Puts the entry in place of the old one, which is removed, keeping its
+ * position among the entries of the table. */
+void
+flow_index_replace(struct flow_index *index, struct flow_entry *old,
+                   struct flow_entry *entry);
+
+/* Updates the output ports and groups of the entry after its instructions
+ * changed. */
+void
+flow_index_update_outputs(struct flow_index *index, struct flow_entry *entry);
+
+/* Returns the entry with the given priority and a match strictly equal to
+ * the given one, or NULL. */
+struct flow_entry *
+flow_index_find_strict(const struct flow_index *index,
+                       struct ofl_match_header *match, uint16_t priority);
+
+/* Returns true if an entry overlaps with the match of the flow mod (see
+ * flow_entry_overlaps()). */
+bool
+flow_index_overlaps(const struct flow_index *index, struct ofl_msg_flow_mod *mod);
+
+/* Sets 'entries' to a new array of the entries with the given priority
+ * whose match overlaps the given one, and 'n' to their number. */
+void
+flow_index_find_overlaps(const struct flow_index *index,
+                         struct ofl_match_header *match, uint16_t priority,
+                         struct flow_entry ***entries, size_t *n);
+
+/* Returns true if the actions of the entry output to the port. */
+bool
+flow_index_has_out_port(const struct flow_entry *entry, uint32_t port);
+
+/* Returns true if the actions of the entry output to the group. */
+bool
+flow_index_has_out_group(const struct flow_entry *entry, uint32_t group);
+
+/* Sets 'entries' to a new array of the entries passing the cookie, out_port
+ * and out_group filters, in the order of the table, and 'n' to their
+ * number. Returns false, setting nothing, if none of the filters is set. */
+bool
+flow_index_select(const struct flow_index *index, uint64_t cookie,
+                  uint64_t cookie_mask, uint32_t out_port, uint32_t out_group,
+                  struct flow_entry ***entries, size_t *n);
+
+#endif /* FLOW_INDEX_H */
@@ -0,0 +1,561 @@
+/* Copyright (c) 2012, CPqD, Brazil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "flow_entry.h"
+#include "flow_lpm.h"
+#include "hash.h"
+#include "hmap.h"
+#include "packets.h"
+#include "util.h"
+#include "oflib/ofl-structs.h"
+#include "oflib/oxm-match.h"
+#include "openflow/openflow.h"
+
+#define LPM_STRIDE    8
+#define LPM_FANOUT    (1 << LPM_STRIDE)
+#define LPM_MAX_BYTES 16
+#define LPM_MAX_PLEN  (LPM_MAX_BYTES * 8)
+
+enum lpm_family {
+    LPM_IPV4,
+    LPM_IPV6,
+    LPM_FAMILIES
+};
+
+static const struct {
+    uint16_t   eth_type;
+    uint8_t    field;       /* OXM field of the destination address. */
+    uint8_t    n_bytes;     /* length of the address. */
+} families[LPM_FAMILIES] = {
+    { ETH_TYPE_IP,   OFPXMT_OFB_IPV4_DST, 4  },
+    { ETH_TYPE_IPV6, OFPXMT_OFB_IPV6_DST, 16 },
+};
+
+struct lpm_node {
+    struct flow_entry *best[LPM_FANOUT];     /* longest prefix ending in the
+                                                node covering each value of
+                                                its byte, or NULL. */
+    uint8_t            best_len[LPM_FANOUT]; /* bits of that prefix within
+                                                the node, 1 to 8, or 0. */
+    struct lpm_node   *child[LPM_FANOUT];
+    size_t             n_prefixes;           /* prefixes ending in the node. */
+    size_t             n_children;
+};
+
+struct lpm_prefix {
+    struct hmap_node   node;                 /* in lpm_trie's prefixes. */
+    uint8_t            plen;
+    uint8_t            addr[LPM_MAX_BYTES];  /* masked to the prefix. */
+    struct flow_entry *entry;
+};
+
+struct lpm_trie {
+    struct lpm_node   *root;
+    struct hmap        prefixes;             /* lpm_prefix, by length and
+                                                address. */
+    struct flow_entry *zero;                 /* entry on the ethertype only. */
+    uint32_t           count[LPM_MAX_PLEN + 1];    /* entries by prefix length;
+                                                      0 is the ethertype only. */
+    uint16_t           priority[LPM_MAX_PLEN + 1]; /* their priority. */
+    uint8_t            max_plen;             /* longest prefix held. */
+};
+
+struct flow_lpm {
+    struct lpm_trie    tries[LPM_FAMILIES];
+    struct flow_entry *deflt;                /* entry with an empty match. */
+    size_t             n_nodes;
+};
+
+/* Where an entry goes: the family is -1 for an empty match. */
+struct lpm_key {
+    int        family;
+    uint8_t    plen;
+    uint8_t    addr[LPM_MAX_BYTES];
+};
+
+/* Returns the length of a prefix mask of 'n' bytes, or -1 if the mask is
+ * not a prefix. */
+static int
+prefix_len(const uint8_t *mask, size_t n) {
+    int plen = 0;
+    size_t i;
+
+    for (i = 0; i < n && mask[i] == 0xff; i++) {
+        plen += 8;
+    }
+    if (i < n) {
+        uint8_t m = mask[i];
+
+        while (m & 0x80) {
+            m <<= 1;
+            plen++;
+        }
+        if (m != 0) {
+            return -1;
+        }
+        for (i++; i < n; i++) {
+            if (mask[i] != 0) {
+                return -1;
+            }
+        }
+    }
+    return plen;
+}
+
+/* Works out where the entry goes. Returns false if it does not fit. */
+static bool
+entry_key(struct flow_entry *entry, struct lpm_key *k) {
+    struct ofl_match *match = (struct ofl_match *)entry->match;
+    struct ofl_match_tlv *f, *type = NULL, *addr = NULL;
+    uint16_t eth_type;
+    size_t n, i;
+
+    memset(k, 0, sizeof(struct lpm_key));
+    k->family = -1;
+    if (match->header.type != OFPMT_OXM) {
+        return false;
+    }
+
+    HMAP_FOR_EACH(f, struct ofl_match_tlv, hmap_node, &match->match_fields) {
+        if (f->header == OXM_OF_ETH_TYPE && type == NULL) {
+            type = f;
+        } else if ((f->header == OXM_OF_IPV4_DST || f->header == OXM_OF_IPV4_DST_W ||
+                    f->header == OXM_OF_IPV6_DST || f->header == OXM_OF_IPV6_DST_W) &&
+                   addr == NULL) {
+            addr = f;
+        } else {
+            return false;
+        }
+    }
+    if (type == NULL) {
+        return addr == NULL;
+    }
+
+    memcpy(&eth_type, type->value, sizeof(uint16_t));
+    for (k->family = 0; k->family < LPM_FAMILIES; k->family++) {
+        if (families[k->family].eth_type == eth_type) {
+            break;
+        }
+    }
+    if (k->family == LPM_FAMILIES) {
+        return false;
+    }
+    if (addr == NULL) {
+        return true;
+    }
+
+    n = families[k->family].n_bytes;
+    if (OXM_FIELD(addr->header) != families[k->family].field) {
+        return false;
+    }
+    if (OXM_HASMASK(addr->header)) {
+        int plen = prefix_len(addr->value + n, n);
+
+        /* A zero mask still requires the address to be present, which the
+         * ethertype-only slot does not. */
+        if (plen <= 0) {
+            return false;
+        }
+        k->plen = plen;
+        for (i = 0; i < n; i++) {
+            k->addr[i] = addr->value[i] & addr->value[n + i];
+        }
+    } else {
+        k->plen = n * 8;
+        memcpy(k->addr, addr->value, n);
+    }
+    return true;
+}
+
+/* Returns true if an entry with the given priority can go where 'k' says
+ * without making a shorter prefix win over a longer one. */
+static bool
+priority_fits(const struct flow_lpm *lpm, const struct lpm_key *k,
+              uint16_t priority) {
+    int family, plen;
+
+    if (k->family < 0) {
+        if (lpm->deflt != NULL) {
+            return false;
+        }
+        for (family = 0; family < LPM_FAMILIES; family++) {
+            const struct lpm_trie *t = &lpm->tries[family];
+
+            for (plen = 0; plen <= LPM_MAX_PLEN; plen++) {
+                if (t->count[plen] > 0 && t->priority[plen] <= priority) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    if (lpm->deflt != NULL && lpm->deflt->stats->priority >= priority) {
+        return false;
+    }
+    for (plen = 0; plen <= LPM_MAX_PLEN; plen++) {
+        const struct lpm_trie *t = &lpm->tries[k->family];
+
+        if (t->count[plen] == 0) {
+            continue;
+        }
+        if ((plen < k->plen && t->priority[plen] >= priority) ||
+            (plen == k->plen && t->priority[plen] != priority) ||
+            (plen > k->plen && t->priority[plen] <= priority)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint32_t
+hash_prefix(uint8_t plen, const uint8_t *addr) {
+    return hash_bytes(addr, LPM_MAX_BYTES, plen);
+}
+
+/* Returns the prefix of the given length of 'addr', which is masked to at
+ * least that length. */
+static struct lpm_prefix *
+find_prefix(const struct lpm_trie *t, uint8_t plen, const uint8_t *addr) {
+    uint8_t masked[LPM_MAX_BYTES];
+    struct lpm_prefix *p;
+    size_t i;
+
+    for (i = 0; i < LPM_MAX_BYTES; i++) {
+        int bits = MIN(MAX((int)plen - (int)i * 8, 0), 8);
+
+        masked[i] = addr[i] & (uint8_t)(0xff00 >> bits);
+    }
+    HMAP_FOR_EACH_WITH_HASH(p, struct lpm_prefix, node,
+                            hash_prefix(plen, masked), &t->prefixes) {
+        if (p->plen == plen && !memcmp(p->addr, masked, LPM_MAX_BYTES)) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static struct lpm_node *
+node_create(struct flow_lpm *lpm) {
+    lpm->n_nodes++;
+    return xcalloc(1, sizeof(struct lpm_node));
+}
+
+/* Returns the first of the values of the last byte of a prefix ending in a
+ * node with 'bits' bits, and sets 'n' to the number of values it covers. */
+static size_t
+prefix_range(uint8_t byte, int bits, size_t *n) {
+    *n = 1 << (LPM_STRIDE - bits);
+    return byte & (uint8_t)(0xff00 >> bits);
+}
+
+static void
+trie_insert(struct flow_lpm *lpm, struct lpm_trie *t, const struct lpm_prefix *p) {
+    int depth = (p->plen - 1) / LPM_STRIDE;
+    int bits = p->plen - depth * LPM_STRIDE;
+    struct lpm_node *node;
+    size_t first, n, s;
+    int i;
+
+    if (t->root == NULL) {
+        t->root = node_create(lpm);
+    }
+    node = t->root;
+    for (i = 0; i < depth; i++) {
+        if (node->child[p->addr[i]] == NULL) {
+            node->child[p->addr[i]] = node_create(lpm);
+            node->n_children++;
+        }
+        node = node->child[p->addr[i]];
+    }
+
+    first = prefix_range(p->addr[depth], bits, &n);
+    for (s = first; s < first + n; s++) {
+        if (node->best_len[s] < bits) {
+            node->best[s] = p->entry;
+            node->best_len[s] = bits;
+        }
+    }
+    node->n_prefixes++;
+}
+
+static void
+trie_remove(struct flow_lpm *lpm, struct lpm_trie *t, const struct lpm_prefix *p) {
+    int depth = (p->plen - 1) / LPM_STRIDE;
+    int bits = p->plen - depth * LPM_STRIDE;
+    struct lpm_node *path[LPM_MAX_BYTES];
+    uint8_t addr[LPM_MAX_BYTES];
+    struct lpm_node *node = t->root;
+    size_t first, n, s;
+    int i;
+
+    for (i = 0; i < depth; i++) {
+        path[i] = node;
+        node = node->child[p->addr[i]];
+    }
+    path[depth] = node;
+
+    /* Hand the values the prefix covered to the next longest prefix of the
+     * node covering them. */
+    memcpy(addr, p->addr, LPM_MAX_BYTES);
+    first = prefix_range(p->addr[depth], bits, &n);
+    for (s = first; s < first + n; s++) {
+        int shorter;
+
+        if (node->best[s] != p->entry) {
+            continue;
+        }
+        node->best[s] = NULL;
+        node->best_len[s] = 0;
+        addr[depth] = s;
+        for (shorter = bits - 1; shorter > 0; shorter--) {
+            struct lpm_prefix *q = find_prefix(t, depth * LPM_STRIDE + shorter, addr);
+
+            if (q != NULL) {
+                node->best[s] = q->entry;
+                node->best_len[s] = shorter;
+                break;
+            }
+        }
+    }
+    node->n_prefixes--;
+
+    /* Free the nodes left empty. */
+    for (i = depth; i >= 0; i--) {
+        node = path[i];
+        if (node->n_prefixes > 0 || node->n_children > 0) {
+            break;
+        }
+        free(node);
+        lpm->n_nodes--;
+        if (i > 0) {
+            path[i - 1]->child[p->addr[i - 1]] = NULL;
+            path[i - 1]->n_children--;
+        } else {
+            t->root = NULL;
+        }
+    }
+}
+
+static void
+trie_destroy(struct lpm_node *node) {
+    size_t i;
+
+    if (node == NULL) {
+        return;
+    }
+    for (i = 0; i < LPM_FANOUT; i++) {
+        trie_destroy(node->child[i]);
+    }
+    free(node);
+}
+
+struct flow_lpm *
+flow_lpm_create(void) {
+    struct flow_lpm *lpm = xcalloc(1, sizeof(struct flow_lpm));
+    int family;
+
+    for (family = 0; family < LPM_FAMILIES; family++) {
+        hmap_init(&lpm->tries[family].prefixes);
+    }
+    return lpm;
+}
+
+void
+flow_lpm_destroy(struct flow_lpm *lpm) {
+    int family;
+
+    if (lpm == NULL) {
+        return;
+    }
+    for (family = 0; family < LPM_FAMILIES; family++) {
+        struct lpm_trie *t = &lpm->tries[family];
+        struct lpm_prefix *p, *next;
+
+        HMAP_FOR_EACH_SAFE(p, next, struct lpm_prefix, node, &t->prefixes) {
+            hmap_remove(&t->prefixes, &p->node);
+            free(p);
+        }
+        hmap_destroy(&t->prefixes);
+        trie_destroy(t->root);
+    }
+    free(lpm);
+}
+
+bool
+flow_lpm_fits(struct flow_entry *entry) {
+    struct lpm_key k;
+
+    return entry_key(entry, &k);
+}
+
+bool
+flow_lpm_insert(struct flow_lpm *lpm, struct flow_entry *entry) {
+    uint16_t priority = entry->stats->priority;
+    struct lpm_trie *t;
+    struct lpm_key k;
+
+    if (!entry_key(entry, &k) || !priority_fits(lpm, &k, priority)) {
+        return false;
+    }
+    if (k.family < 0) {
+        lpm->deflt = entry;
+        return true;
+    }
+
+    t = &lpm->tries[k.family];
+    if (k.plen == 0) {
+        if (t->zero != NULL) {
+            return false;
+        }
+        t->zero = entry;
+    } else {
+        struct lpm_prefix *p;
+
+        /* The same prefix may be written as a full mask or no mask. */
+        if (find_prefix(t, k.plen, k.addr) != NULL) {
+            return false;
+        }
+        p = xmalloc(sizeof(struct lpm_prefix));
+        p->plen = k.plen;
+        memcpy(p->addr, k.addr, LPM_MAX_BYTES);
+        p->entry = entry;
+        hmap_insert(&t->prefixes, &p->node, hash_prefix(p->plen, p->addr));
+        trie_insert(lpm, t, p);
+    }
+
+    t->count[k.plen]++;
+    t->priority[k.plen] = priority;
+    t->max_plen = MAX(t->max_plen, k.plen);
+    return true;
+}
+
+void
+flow_lpm_remove(struct flow_lpm *lpm, struct flow_entry *entry) {
+    struct lpm_trie *t;
+    struct lpm_key k;
+
+    entry_key(entry, &k);
+    if (k.family < 0) {
+        lpm->deflt = NULL;
+        return;
+    }
+
+    t = &lpm->tries[k.family];
+    if (k.plen == 0) {
+        t->zero = NULL;
+    } else {
+        struct lpm_prefix *p = find_prefix(t, k.plen, k.addr);
+
+        trie_remove(lpm, t, p);
+        hmap_remove(&t->prefixes, &p->node);
+        free(p);
+    }
+
+    if (--t->count[k.plen] == 0 && k.plen == t->max_plen) {
+        while (t->max_plen > 0 && t->count[t->max_plen] == 0) {
+            t->max_plen--;
+        }
+    }
+}
+
+struct flow_entry *
+flow_lpm_lookup(const struct flow_lpm *lpm, const struct packet_key *key,
+                uint64_t *wc, size_t *probes) {
+    const struct packet_key_field *type = &packet_key_fields[OFPXMT_OFB_ETH_TYPE];
+    struct flow_entry *best = NULL;
+    int family;
+
+    if (probes != NULL) {
+        *probes = 0;
+    }
+    if (wc != NULL) {
+        /* The lookup looks at the ethertype and whether the addresses are
+         * there; the first word of the key holds the presence bits. */
+        wc[0] |= PACKET_KEY_BIT(OFPXMT_OFB_ETH_TYPE);
+        for (family = 0; family < LPM_FAMILIES; family++) {
+            wc[0] |= PACKET_KEY_BIT(families[family].field);
+        }
+        memset((uint8_t *)wc + type->offset, 0xff, type->length);
+    }
+    if (!(key->present & PACKET_KEY_BIT(OFPXMT_OFB_ETH_TYPE))) {
+        return lpm->deflt;
+    }
+
+    for (family = 0; family < LPM_FAMILIES; family++) {
+        if (families[family].eth_type == key->eth_type) {
+            break;
+        }
+    }
+    if (family < LPM_FAMILIES) {
+        const struct lpm_trie *t = &lpm->tries[family];
+        uint8_t field = families[family].field;
+
+        best = t->zero;
+        if (key->present & PACKET_KEY_BIT(field)) {
+            const uint8_t *addr = (const uint8_t *)key + packet_key_fields[field].offset;
+            const struct lpm_node *node = t->root;
+            size_t i;
+
+            for (i = 0; node != NULL && i < families[family].n_bytes; i++) {
+                if (node->best[addr[i]] != NULL) {
+                    best = node->best[addr[i]];
+                }
+                node = node->child[addr[i]];
+            }
+            if (probes != NULL) {
+                *probes = i;
+            }
+
+            if (wc != NULL) {
+                /* No entry looks further than the longest prefix. */
+                uint8_t *w = (uint8_t *)wc + packet_key_fields[field].offset;
+
+                for (i = 0; (int)i * 8 < t->max_plen; i++) {
+                    w[i] |= (uint8_t)(0xff00 >> MIN(t->max_plen - i * 8, 8));
+                }
+            }
+        }
+    }
+    return best != NULL ? best : lpm->deflt;
+}
+
+size_t
+flow_lpm_memory(const struct flow_lpm *lpm) {
+    size_t prefixes = 0;
+    int family;
+
+    for (family = 0; family < LPM_FAMILIES; family++) {
+        prefixes += hmap_count(&lpm->tries[family].prefixes);
+    }
+    return sizeof(struct flow_lpm) + lpm->n_nodes * sizeof(struct lpm_node)
+           + prefixes * sizeof(struct lpm_prefix);
+}
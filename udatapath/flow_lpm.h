@@ -0,0 +1,91 @@
+/* Copyright (c) 2012, CPqD, Brazil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef FLOW_LPM_H
+#define FLOW_LPM_H 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "packet_key.h"
+
+struct flow_entry;
+
+/****************************************************************************
+ * Longest prefix match structure for tables used as routing tables, whose
+ * entries match on an IPv4 or IPv6 ethertype and a prefix of the
+ * destination address (or on nothing, as a default route), with priorities
+ * increasing with the prefix length.
+ *
+ * Each address family has a multibit trie with 8 bit strides. A node holds,
+ * for each value of its address byte, the longest prefix ending in the node
+ * which covers it (expanded over the values it covers) and the child node;
+ * a lookup walks at most 4 (IPv4) or 16 (IPv6) nodes and keeps the last
+ * prefix seen.
+ ****************************************************************************/
+
+struct flow_lpm;
+
+/* Creates an empty structure. */
+struct flow_lpm *
+flow_lpm_create(void);
+
+/* Destroys the structure; the entries are not touched. */
+void
+flow_lpm_destroy(struct flow_lpm *lpm);
+
+/* Returns true if the match of the entry has a shape the structure can
+ * hold. */
+bool
+flow_lpm_fits(struct flow_entry *entry);
+
+/* Inserts the entry. Returns false, leaving the structure unchanged, if the
+ * entry does not fit, or if its priority is not consistent with those of
+ * the entries already held (so that the longest prefix would not always be
+ * the highest priority match). */
+bool
+flow_lpm_insert(struct flow_lpm *lpm, struct flow_entry *entry);
+
+/* Removes an entry inserted before. */
+void
+flow_lpm_remove(struct flow_lpm *lpm, struct flow_entry *entry);
+
+/* Returns the entry matching the key with the longest prefix, or NULL. If
+ * wc is not NULL, the bits of the key the result depends on are added to
+ * it, as by classifier_lookup(). If probes is not NULL, it is set to the
+ * number of trie nodes looked into. */
+struct flow_entry *
+flow_lpm_lookup(const struct flow_lpm *lpm, const struct packet_key *key,
+                uint64_t *wc, size_t *probes);
+
+/* Returns the bytes held by the structure. */
+size_t
+flow_lpm_memory(const struct flow_lpm *lpm);
+
+#endif /* FLOW_LPM_H */
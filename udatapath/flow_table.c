@@ -30,15 +30,22 @@
 
 #include <stdbool.h>
 #include <string.h>
+#include <time.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
 #include "dynamic-string.h"
 #include "datapath.h"
 #include "flow_table.h"
 #include "flow_entry.h"
+#include "hash.h"
 #include "oflib/ofl.h"
 #include "oflib/oxm-match.h"
+#include "openflow/openflow-ext.h"
 #include "time.h"
 #include "dp_capabilities.h"
-//#include "packet_handle_std.h"
+#include "packet_handle_std.h"
+#include "rcu.h"
 
 #include "vlog.h"
 #define LOG_MODULE VLM_flow_t
@@ -82,87 +89,637 @@ struct ofl_action_header actions[] = { {OFPAT_OUTPUT, 4},
 
 #define N_ACTIONS       (sizeof(actions) / sizeof(struct ofl_action_header))
 
-/* When inserting an entry, this function adds the flow entry to the list of
- * hard and idle timeout entries, if appropriate. */
+/* Adds delta to the reference counts of the OXM fields matched on by the
+ * entry, and propagates any change in the set of matched fields to the
+ * pipeline, which decides how deep packets are parsed. */
 static void
-add_to_timeout_lists(struct flow_table *table, struct flow_entry *entry) {
-    if (entry->stats->idle_timeout > 0) {
-        list_insert(&table->idle_entries, &entry->idle_node);
+update_field_refs(struct flow_table *table, struct flow_entry *entry, int delta) {
+    struct ofl_match *match = (struct ofl_match *)entry->match;
+    struct ofl_match_tlv *f;
+    uint64_t fields = table->match_fields;
+
+    if (match->header.type != OFPMT_OXM) {
+        return;
     }
 
-    if (entry->remove_at > 0) {
-        struct flow_entry *e;
+    HMAP_FOR_EACH(f, struct ofl_match_tlv, hmap_node, &match->match_fields) {
+        uint8_t field = OXM_FIELD(f->header);
 
-        /* hard timeout entries are ordered by the time they should be removed at. */
-        LIST_FOR_EACH (e, struct flow_entry, hard_node, &table->hard_entries) {
-            if (e->remove_at > entry->remove_at) {
-                list_insert(&e->hard_node, &entry->hard_node);
-                return;
-            }
+        if (OXM_VENDOR(f->header) != OFPXMC_OPENFLOW_BASIC ||
+            field >= PACKET_KEY_FIELDS) {
+            continue;
+        }
+        table->field_refs[field] += delta;
+        if (table->field_refs[field] == 0) {
+            fields &= ~PACKET_KEY_BIT(field);
+        } else {
+            fields |= PACKET_KEY_BIT(field);
         }
-        list_insert(&e->hard_node, &entry->hard_node);
+    }
+
+    if (fields != table->match_fields) {
+        table->match_fields = fields;
+        table->parse_depth = packet_parse_depth(fields);
+        pipeline_update_match_fields(table->dp->pipeline);
     }
 }
 
-/* Handles flow mod messages with ADD command. */
-static ofl_err
-flow_table_add(struct flow_table *table, struct ofl_msg_flow_mod *mod, bool check_overlap, bool *match_kept, bool *insts_kept) {
-    // Note: new entries will be placed behind those with equal priority
-    struct flow_entry *entry, *new_entry;
+void
+flow_table_ref_fields(struct flow_table *table, struct flow_entry *entry) {
+    update_field_refs(table, entry, 1);
+}
+
+void
+flow_table_unref_fields(struct flow_table *table, struct flow_entry *entry) {
+    update_field_refs(table, entry, -1);
+}
+
+/* A change of the staged lookup copy of a table, replayed on the other copy
+ * once packets no longer look it up. */
+enum change_type {
+    CHANGE_INSERT,   /* 'entry' was added. */
+    CHANGE_REMOVE,   /* 'entry' was removed; destroyed after the replay. */
+    CHANGE_REPLACE,  /* 'entry' took the place of 'old', which is destroyed
+                        after the replay. */
+    CHANGE_REBUILD,  /* the copy was rebuilt from the entry list. */
+    CHANGE_ALONE,    /* 'entry' lost its alone flag to an overlapping
+                        entry. */
+    CHANGE_REORDER   /* the subtables of the classifier were reordered by
+                        the recent hits of the entries. */
+};
+
+struct change {
+    struct list        node;   /* in the table's changes. */
+    enum change_type   type;
+    struct flow_entry *entry;
+    struct flow_entry *old;
+};
+
+/* Returns the entry the classifier rule of a lookup copy belongs to. */
+static struct flow_entry *
+rule_entry(struct flow_table_lookup *lookup, struct cls_rule *rule) {
+    return CONTAINER_OF(rule - lookup->rule, struct flow_entry, cls_rule);
+}
+
+static void
+lookup_init(struct flow_table_lookup *lookup, uint8_t rule) {
+    classifier_init(&lookup->classifier);
+    lookup->lpm = NULL;
+    lookup->exact = NULL;
+    lookup->mode = OFP_EXT_TABLE_MODE_GENERIC;
+    lookup->rule = rule;
+}
+
+static void
+lookup_destroy(struct flow_table_lookup *lookup) {
+    classifier_destroy(&lookup->classifier);
+    flow_lpm_destroy(lookup->lpm);
+    flow_exact_destroy(lookup->exact);
+}
+
+/* Adds an entry to a lookup copy. Returns false, leaving the copy as it
+ * is, if the entry does not fit its mode. */
+static bool
+lookup_insert(struct flow_table_lookup *lookup, struct flow_entry *entry) {
+    if (lookup->lpm != NULL) {
+        return flow_lpm_insert(lookup->lpm, entry);
+    }
+    if (lookup->exact != NULL) {
+        return flow_exact_insert(lookup->exact, entry);
+    }
+    classifier_insert(&lookup->classifier, &entry->cls_rule[lookup->rule],
+                      entry->match, entry->stats->priority);
+    entry->cls_rule[lookup->rule].alone = entry->alone;
+    return true;
+}
+
+static void
+lookup_remove(struct flow_table_lookup *lookup, struct flow_entry *entry) {
+    if (lookup->lpm != NULL) {
+        flow_lpm_remove(lookup->lpm, entry);
+    } else if (lookup->exact != NULL) {
+        flow_exact_remove(lookup->exact, entry);
+    } else {
+        classifier_remove(&lookup->classifier, &entry->cls_rule[lookup->rule]);
+    }
+}
+
+/* Puts an entry in the place of one with the same match and priority. */
+static void
+lookup_replace(struct flow_table_lookup *lookup, struct flow_entry *old,
+               struct flow_entry *entry) {
+    if (lookup->lpm != NULL) {
+        /* Same match and priority: the new entry fits where the old one
+         * was. */
+        flow_lpm_remove(lookup->lpm, old);
+        flow_lpm_insert(lookup->lpm, entry);
+    } else if (lookup->exact != NULL) {
+        flow_exact_remove(lookup->exact, old);
+        flow_exact_insert(lookup->exact, entry);
+    } else {
+        classifier_replace(&lookup->classifier, &old->cls_rule[lookup->rule],
+                           &entry->cls_rule[lookup->rule], entry->match,
+                           entry->stats->priority);
+        entry->cls_rule[lookup->rule].alone = entry->alone;
+    }
+}
+
+/* Empties a lookup copy, and sets it up for the given mode. */
+static void
+lookup_reset(struct flow_table_lookup *lookup, uint8_t mode) {
+    lookup_destroy(lookup);
+    lookup_init(lookup, lookup->rule);
+    lookup->mode = mode;
+    if (mode == OFP_EXT_TABLE_MODE_LPM) {
+        lookup->lpm = flow_lpm_create();
+    } else if (mode == OFP_EXT_TABLE_MODE_EXACT) {
+        lookup->exact = flow_exact_create();
+    }
+}
+
+/* Fills an empty lookup copy with the entries of the table, in their
+ * insertion order. Returns false if they do not fit its mode. */
+static bool
+lookup_fill(struct flow_table *table, struct flow_table_lookup *lookup) {
+    struct flow_entry *entry;
 
     LIST_FOR_EACH (entry, struct flow_entry, match_node, &table->match_entries) {
-        if (check_overlap && flow_entry_overlaps(entry, mod)) {
-            return ofl_error(OFPET_FLOW_MOD_FAILED, OFPFMFC_OVERLAP);
+        if (!lookup_insert(lookup, entry)) {
+            return false;
         }
+    }
+    return true;
+}
 
-        /* if the entry equals, replace the old one */
-        if (flow_entry_matches(entry, mod, true/*strict*/, false/*check_cookie*/)) {
-            new_entry = flow_entry_create(table->dp, table, mod);
-            *match_kept = true;
-            *insts_kept = true;
+static void
+log_change(struct flow_table *table, enum change_type type,
+           struct flow_entry *entry, struct flow_entry *old) {
+    struct change *change = xmalloc(sizeof(struct change));
+
+    change->type = type;
+    change->entry = entry;
+    change->old = old;
+    list_push_back(&table->changes, &change->node);
+    table->dirty = true;
+}
 
-            /* NOTE: no flow removed message should be generated according to spec. */
-            list_replace(&new_entry->match_node, &entry->match_node);
-            list_remove(&entry->hard_node);
-            list_remove(&entry->idle_node);
-            flow_entry_destroy(entry);
-            add_to_timeout_lists(table, new_entry);
-            return 0;
+/* Forgets the logged changes, destroying the entries they removed. */
+static void
+free_changes(struct flow_table *table) {
+    struct change *change, *next;
+
+    LIST_FOR_EACH_SAFE (change, next, struct change, node, &table->changes) {
+        if (change->type == CHANGE_REMOVE) {
+            flow_entry_destroy(change->entry);
+        } else if (change->type == CHANGE_REPLACE) {
+            flow_entry_destroy(change->old);
         }
+        list_remove(&change->node);
+        free(change);
+    }
+}
 
-        if (mod->priority > entry->stats->priority) {
+/* Brings the staged copy of the table, which packets stopped looking up a
+ * grace period ago, up to date with the published one, and destroys the
+ * entries neither copy holds any more. */
+static void
+catch_up(struct flow_table *table) {
+    struct flow_table_lookup *staged = table->staged;
+    struct change *change;
+    bool rebuild = false;
+    bool reorder = false;
+
+    LIST_FOR_EACH (change, struct change, node, &table->changes) {
+        if (change->type == CHANGE_REBUILD) {
+            rebuild = true;
             break;
         }
     }
 
-    if (table->stats->active_count == FLOW_TABLE_MAX_ENTRIES) {
+    if (!rebuild) {
+        LIST_FOR_EACH (change, struct change, node, &table->changes) {
+            if (change->type == CHANGE_INSERT) {
+                if (!lookup_insert(staged, change->entry)) {
+                    rebuild = true;
+                    break;
+                }
+            } else if (change->type == CHANGE_REMOVE) {
+                lookup_remove(staged, change->entry);
+            } else if (change->type == CHANGE_REPLACE) {
+                lookup_replace(staged, change->old, change->entry);
+            } else if (change->type == CHANGE_ALONE) {
+                change->entry->cls_rule[staged->rule].alone = false;
+            } else if (change->type == CHANGE_REORDER) {
+                reorder = true;
+            }
+        }
+    }
+    if (rebuild) {
+        /* The entry list holds the entries of the published copy. */
+        lookup_reset(staged, table->published->mode);
+        if (!lookup_fill(table, staged)) {
+            lookup_reset(staged, OFP_EXT_TABLE_MODE_GENERIC);
+            lookup_fill(table, staged);
+        }
+    }
+    if (reorder && staged->mode == OFP_EXT_TABLE_MODE_GENERIC) {
+        /* The copy now holds the entries of the list; entries added since
+         * the reordering have no recent hits. */
+        struct flow_entry *entry;
+
+        LIST_FOR_EACH (entry, struct flow_entry, match_node, &table->match_entries) {
+            struct cls_rule *rule = &entry->cls_rule[staged->rule];
+
+            rule->alone = entry->alone;
+            classifier_add_hits(rule, entry->recent_hits);
+        }
+        classifier_reorder(&staged->classifier);
+    }
+
+    free_changes(table);
+    table->grace = 0;
+}
+
+/* Makes the staged copy of the table ready for changes, waiting for the
+ * packets looking up the copy last published before it, if necessary. */
+static void
+prepare_changes(struct flow_table *table) {
+    if (table->grace == 0) {
+        return;
+    }
+    if (!rcu_grace_done(table->grace)) {
+        rcu_synchronize();
+    }
+    catch_up(table);
+}
+
+bool
+flow_table_publish(struct flow_table *table) {
+    struct flow_table_lookup *published = table->published;
+
+    if (!table->dirty) {
+        if (table->grace != 0 && rcu_grace_done(table->grace)) {
+            catch_up(table);
+        }
+        return false;
+    }
+    rcu_set(table->published, table->staged);
+    table->staged = published;
+    table->dirty = false;
+    table->grace = rcu_grace_start();
+    return true;
+}
+
+/* Moves the entries of the table to the given lookup structure, built
+ * from scratch in the staged copy. Returns false, leaving the table as it
+ * is, if they do not fit. */
+static bool
+use_mode(struct flow_table *table, uint8_t mode) {
+    struct flow_table_lookup *staged = table->staged;
+    struct flow_lpm *lpm = NULL;
+    struct flow_exact *exact = NULL;
+    struct flow_entry *entry;
+
+    if (mode == OFP_EXT_TABLE_MODE_LPM) {
+        lpm = flow_lpm_create();
+        LIST_FOR_EACH (entry, struct flow_entry, match_node, &table->match_entries) {
+            if (!flow_lpm_insert(lpm, entry)) {
+                flow_lpm_destroy(lpm);
+                return false;
+            }
+        }
+    } else if (mode == OFP_EXT_TABLE_MODE_EXACT) {
+        exact = flow_exact_create();
+        LIST_FOR_EACH (entry, struct flow_entry, match_node, &table->match_entries) {
+            if (!flow_exact_insert(exact, entry)) {
+                flow_exact_destroy(exact);
+                return false;
+            }
+        }
+    }
+
+    lookup_reset(staged, OFP_EXT_TABLE_MODE_GENERIC);
+    staged->mode = mode;
+    staged->lpm = lpm;
+    staged->exact = exact;
+    if (mode == OFP_EXT_TABLE_MODE_GENERIC) {
+        lookup_fill(table, staged);
+    }
+    table->mode = mode;
+    table->generation++;
+    log_change(table, CHANGE_REBUILD, NULL, NULL);
+    VLOG_DBG(LOG_MODULE, "Table %u uses the %s lookup.", table->stats->table_id,
+             mode == OFP_EXT_TABLE_MODE_LPM ? "longest prefix match"
+             : mode == OFP_EXT_TABLE_MODE_EXACT ? "exact match" : "classifier");
+    return true;
+}
+
+/* Moves the entries of the table to the classifier, in their insertion
+ * order. */
+static void
+use_classifier(struct flow_table *table) {
+    if (table->mode != OFP_EXT_TABLE_MODE_GENERIC) {
+        use_mode(table, OFP_EXT_TABLE_MODE_GENERIC);
+    }
+}
+
+/* Number of entries a table falling back to the classifier tries another
+ * mode again at, once the entries which did not fit are gone. */
+static size_t
+mode_threshold(struct flow_table *table) {
+    return table->mode_config == OFP_EXT_TABLE_MODE_AUTO ? FLOW_TABLE_MODE_MIN_ENTRIES : 0;
+}
+
+/* Moves a table using the classifier to the exact match or the LPM mode,
+ * if it may and its entries fit. */
+static void
+update_mode(struct flow_table *table) {
+    bool try_exact, try_lpm;
+
+    if (table->mode != OFP_EXT_TABLE_MODE_GENERIC ||
+        table->mode_config == OFP_EXT_TABLE_MODE_GENERIC ||
+        table->stats->active_count < table->mode_retry_at) {
+        return;
+    }
+
+    /* Entries sharing one mask fill one subtable of the classifier, plus
+     * one for a table miss entry. */
+    try_exact = table->mode_config != OFP_EXT_TABLE_MODE_LPM &&
+                table->exact_misfits == 0 &&
+                hmap_count(&table->staged->classifier.subtables) <= 2;
+    try_lpm = table->mode_config != OFP_EXT_TABLE_MODE_EXACT &&
+              table->lpm_misfits == 0;
+
+    if ((try_exact && use_mode(table, OFP_EXT_TABLE_MODE_EXACT)) ||
+        (try_lpm && use_mode(table, OFP_EXT_TABLE_MODE_LPM))) {
+        return;
+    }
+    if (try_exact || try_lpm) {
+        /* Some entries share a match, or have priorities not following
+         * their prefix length; back off. */
+        table->mode_retry_at = table->stats->active_count * 2;
+    }
+}
+
+/* Clears the alone flag of the entries of the same priority as a new entry
+ * overlapping it, in the staged copy now and in the other one on replay. */
+static void
+clear_alone(struct flow_table *table, struct flow_entry *entry) {
+    struct flow_entry **overlaps;
+    size_t i, n;
+
+    flow_index_find_overlaps(&table->index, entry->stats->match,
+                             entry->stats->priority, &overlaps, &n);
+    for (i = 0; i < n; i++) {
+        struct flow_entry *other = overlaps[i];
+
+        if (other->alone) {
+            other->alone = false;
+            other->cls_rule[table->staged->rule].alone = false;
+            table->n_alone--;
+            log_change(table, CHANGE_ALONE, other, NULL);
+        }
+    }
+    free(overlaps);
+}
+
+/* Adds an entry, already in the entry list, to the lookup structure. */
+static void
+link_entry(struct flow_table *table, struct flow_entry *entry) {
+    bool lpm_fits = flow_lpm_fits(entry);
+    bool exact_fits = flow_exact_fits(entry);
+
+    if (!lpm_fits) {
+        table->lpm_misfits++;
+    }
+    if (!exact_fits) {
+        table->exact_misfits++;
+    }
+    if (table->n_alone > 0) {
+        clear_alone(table, entry);
+    }
+
+    log_change(table, CHANGE_INSERT, entry, NULL);
+    if (table->batch) {
+        return;
+    }
+    if (lookup_insert(table->staged, entry)) {
+        if (table->mode == OFP_EXT_TABLE_MODE_GENERIC) {
+            update_mode(table);
+        }
+        return;
+    }
+    if (table->mode == OFP_EXT_TABLE_MODE_LPM) {
+        table->mode_retry_at = lpm_fits ? table->stats->active_count * 2
+                                        : mode_threshold(table);
+    } else {
+        table->mode_retry_at = exact_fits ? table->stats->active_count * 2
+                                          : mode_threshold(table);
+    }
+    use_classifier(table);
+}
+
+void
+flow_table_unlink(struct flow_table *table, struct flow_entry *entry) {
+    prepare_changes(table);
+    if (entry->alone) {
+        table->n_alone--;
+    }
+    /* Entries it overlapped may be alone now. */
+    table->alone_stale = true;
+    if (!table->batch) {
+        lookup_remove(table->staged, entry);
+    }
+    log_change(table, CHANGE_REMOVE, entry, NULL);
+    if (!flow_lpm_fits(entry)) {
+        table->lpm_misfits--;
+    }
+    if (!flow_exact_fits(entry)) {
+        table->exact_misfits--;
+    }
+    if (!table->batch) {
+        update_mode(table);
+    }
+}
+
+void
+flow_table_batch_begin(struct flow_table *table, size_t changes) {
+    prepare_changes(table);
+    /* Rebuilding costs a pass over all entries; only worth it for a batch
+     * changing a good part of the table. */
+    table->batch = changes * FLOW_TABLE_BATCH_RATIO >= table->stats->active_count;
+}
+
+void
+flow_table_batch_end(struct flow_table *table) {
+    uint8_t mode = table->mode;
+
+    if (!table->batch) {
+        return;
+    }
+    table->batch = false;
+
+    if ((mode == OFP_EXT_TABLE_MODE_LPM && table->lpm_misfits > 0) ||
+        (mode == OFP_EXT_TABLE_MODE_EXACT && table->exact_misfits > 0)) {
+        mode = OFP_EXT_TABLE_MODE_GENERIC;
+        table->mode_retry_at = mode_threshold(table);
+    }
+    if (!use_mode(table, mode)) {
+        /* Some entries share a match, or have priorities not following
+         * their prefix length; back off. */
+        table->mode_retry_at = table->stats->active_count * 2;
+        use_mode(table, OFP_EXT_TABLE_MODE_GENERIC);
+    }
+    update_mode(table);
+}
+
+ofl_err
+flow_table_set_mode(struct flow_table *table, uint8_t mode) {
+    prepare_changes(table);
+    if (mode == OFP_EXT_TABLE_MODE_GENERIC) {
+        table->mode_config = mode;
+        use_classifier(table);
+        return 0;
+    }
+    if (mode == OFP_EXT_TABLE_MODE_AUTO) {
+        table->mode_config = mode;
+        table->mode_retry_at = mode_threshold(table);
+        update_mode(table);
+        return 0;
+    }
+    if (mode == OFP_EXT_TABLE_MODE_LPM) {
+        if (table->mode != mode && (table->lpm_misfits > 0 || !use_mode(table, mode))) {
+            return ofl_error(OFPET_TABLE_MOD_FAILED, OFPTMFC_BAD_CONFIG);
+        }
+        table->mode_config = mode;
+        table->mode_retry_at = mode_threshold(table);
+        return 0;
+    }
+    if (mode == OFP_EXT_TABLE_MODE_EXACT) {
+        if (table->mode != mode && (table->exact_misfits > 0 || !use_mode(table, mode))) {
+            return ofl_error(OFPET_TABLE_MOD_FAILED, OFPTMFC_BAD_CONFIG);
+        }
+        table->mode_config = mode;
+        table->mode_retry_at = mode_threshold(table);
+        return 0;
+    }
+    return ofl_error(OFPET_TABLE_MOD_FAILED, OFPTMFC_BAD_CONFIG);
+}
+
+/* Handles flow mod messages with ADD command. */
+static ofl_err
+flow_table_add(struct flow_table *table, struct ofl_msg_flow_mod *mod, bool check_overlap, bool *match_kept, bool *insts_kept) {
+    // Note: new entries will be placed behind those with equal priority
+    struct flow_entry *entry, *new_entry;
+
+    if (check_overlap && flow_index_overlaps(&table->index, mod)) {
+        return ofl_error(OFPET_FLOW_MOD_FAILED, OFPFMFC_OVERLAP);
+    }
+
+    /* if the entry equals, replace the old one */
+    entry = flow_index_find_strict(&table->index, mod->match, mod->priority);
+    if (entry != NULL) {
+        new_entry = flow_entry_create(table->dp, table, mod);
+        *match_kept = true;
+        *insts_kept = true;
+
+        /* NOTE: no flow removed message should be generated according to spec. */
+        list_replace(&new_entry->match_node, &entry->match_node);
+        new_entry->alone = entry->alone;
+        if (!table->batch) {
+            lookup_replace(table->staged, entry, new_entry);
+        }
+        log_change(table, CHANGE_REPLACE, new_entry, entry);
+        flow_index_replace(&table->index, entry, new_entry);
+        timer_wheel_cancel(&table->dp->pipeline->timeouts, &entry->timer);
+        table->memory += new_entry->memory - entry->memory;
+        flow_table_ref_fields(table, new_entry);
+        flow_table_unref_fields(table, entry);
+        flow_entry_detach(entry);
+        flow_entry_schedule_timeout(new_entry);
+        return 0;
+    }
+
+    if (table->stats->active_count >= table->features->max_entries) {
+        return ofl_error(OFPET_FLOW_MOD_FAILED, OFPFMFC_TABLE_FULL);
+    }
+    if (!pipeline_memory_available(table->dp->pipeline,
+                                   flow_entry_memory(mod->match, mod->instructions_num,
+                                                     mod->instructions, table->dp->exp))) {
+        VLOG_WARN_RL(LOG_MODULE, &rl, "Flow entry refused in table %u: the flow "
+                     "memory budget is exhausted.", table->stats->table_id);
         return ofl_error(OFPET_FLOW_MOD_FAILED, OFPFMFC_TABLE_FULL);
     }
     table->stats->active_count++;
 
     new_entry = flow_entry_create(table->dp, table, mod);
+    table->memory += new_entry->memory;
     *match_kept = true;
     *insts_kept = true;
 
-    list_insert(&entry->match_node, &new_entry->match_node);
-    add_to_timeout_lists(table, new_entry);
+    list_push_back(&table->match_entries, &new_entry->match_node);
+    table->alone_stale = true;
+    link_entry(table, new_entry);
+    flow_index_insert(&table->index, new_entry);
+    flow_entry_schedule_timeout(new_entry);
+    flow_table_ref_fields(table, new_entry);
 
     return 0;
 }
 
+/* Returns a new array of the entries of the table passing the cookie,
+ * out_port and out_group filters, in insertion order, and sets 'n' to their
+ * number. */
+static struct flow_entry **
+select_entries(struct flow_table *table, uint64_t cookie, uint64_t cookie_mask,
+               uint32_t out_port, uint32_t out_group, size_t *n) {
+    struct flow_entry **entries;
+    struct flow_entry *entry;
+
+    if (flow_index_select(&table->index, cookie, cookie_mask, out_port,
+                          out_group, &entries, n)) {
+        return entries;
+    }
+
+    /* No filter is set: all entries. */
+    entries = xmalloc(MAX(list_size(&table->match_entries), 1) * sizeof(struct flow_entry *));
+    *n = 0;
+    LIST_FOR_EACH (entry, struct flow_entry, match_node, &table->match_entries) {
+        entries[(*n)++] = entry;
+    }
+    return entries;
+}
+
 /* Handles flow mod messages with MODIFY command. 
     If the flow doesn't exists don't do nothing*/
 static ofl_err
 flow_table_modify(struct flow_table *table, struct ofl_msg_flow_mod *mod, bool strict, bool *insts_kept) {
+    struct flow_entry **entries;
     struct flow_entry *entry;
+    size_t n, i;
 
-    LIST_FOR_EACH (entry, struct flow_entry, match_node, &table->match_entries) {
+    if (strict) {
+        entry = flow_index_find_strict(&table->index, mod->match, mod->priority);
+        if (entry != NULL && flow_entry_matches(entry, mod, true/*strict*/, true/*check_cookie*/)) {
+            flow_entry_replace_instructions(entry, mod->instructions_num, mod->instructions);
+            flow_index_update_outputs(&table->index, entry);
+            flow_entry_modify_stats(entry, mod);
+            *insts_kept = true;
+        }
+        return 0;
+    }
+
+    entries = select_entries(table, mod->cookie, mod->cookie_mask, OFPP_ANY, OFPG_ANY, &n);
+    for (i = 0; i < n; i++) {
+        entry = entries[i];
         if (flow_entry_matches(entry, mod, strict, true/*check_cookie*/)) {
             flow_entry_replace_instructions(entry, mod->instructions_num, mod->instructions);
+            flow_index_update_outputs(&table->index, entry);
 	    flow_entry_modify_stats(entry, mod);
             *insts_kept = true;
         }
     }
+    free(entries);
 
     return 0;
 }
@@ -170,15 +727,30 @@ flow_table_modify(struct flow_table *table, struct ofl_msg_flow_mod *mod, bool s
 /* Handles flow mod messages with DELETE command. */
 static ofl_err
 flow_table_delete(struct flow_table *table, struct ofl_msg_flow_mod *mod, bool strict) {
-    struct flow_entry *entry, *next;
+    struct flow_entry **entries;
+    struct flow_entry *entry;
+    size_t n, i;
+
+    if (strict) {
+        entry = flow_index_find_strict(&table->index, mod->match, mod->priority);
+        if (entry != NULL &&
+            (mod->out_port == OFPP_ANY || flow_index_has_out_port(entry, mod->out_port)) &&
+            (mod->out_group == OFPG_ANY || flow_index_has_out_group(entry, mod->out_group)) &&
+            flow_entry_matches(entry, mod, true/*strict*/, true/*check_cookie*/)) {
+            flow_entry_remove(entry, OFPRR_DELETE);
+        }
+        return 0;
+    }
 
-    LIST_FOR_EACH_SAFE (entry, next, struct flow_entry, match_node, &table->match_entries) {
-        if ((mod->out_port == OFPP_ANY || flow_entry_has_out_port(entry, mod->out_port)) &&
-            (mod->out_group == OFPG_ANY || flow_entry_has_out_group(entry, mod->out_group)) &&
-            flow_entry_matches(entry, mod, strict, true/*check_cookie*/)) {
-             flow_entry_remove(entry, OFPRR_DELETE);
+    /* The selected entries pass the cookie and output filters already. */
+    entries = select_entries(table, mod->cookie, mod->cookie_mask,
+                             mod->out_port, mod->out_group, &n);
+    for (i = 0; i < n; i++) {
+        if (flow_entry_matches(entries[i], mod, strict, false/*check_cookie*/)) {
+             flow_entry_remove(entries[i], OFPRR_DELETE);
         }
     }
+    free(entries);
 
     return 0;
 }
@@ -186,6 +758,9 @@ flow_table_delete(struct flow_table *table, struct ofl_msg_flow_mod *mod, bool s
 
 ofl_err
 flow_table_flow_mod(struct flow_table *table, struct ofl_msg_flow_mod *mod, bool *match_kept, bool *insts_kept) {
+    prepare_changes(table);
+    table->generation++;
+
     switch (mod->command) {
         case (OFPFC_ADD): {
             bool overlap = ((mod->flags & OFPFF_CHECK_OVERLAP) != 0);
@@ -209,62 +784,525 @@ flow_table_flow_mod(struct flow_table *table, struct ofl_msg_flow_mod *mod, bool
     }
 }
 
+/* An entry of the table a checked batch replaces, modifies or removes. */
+struct check_gone {
+    struct hmap_node   node;        /* in flow_table_check's gone. */
+    struct flow_entry *entry;
+};
 
-struct flow_entry *
-flow_table_lookup(struct flow_table *table, struct packet *pkt) {
+void
+flow_table_check_init(struct flow_table_check *check, struct flow_table *table) {
+    check->table = table;
+    check->active_count = table->stats->active_count;
+    hmap_init(&check->gone);
+    flow_index_init(&check->index);
+    list_init(&check->copies);
+}
+
+/* Copies have no table, and only what the flow mod checks look at. */
+static bool
+check_is_copy(const struct flow_entry *entry) {
+    return entry->table == NULL;
+}
+
+static struct flow_entry *
+check_copy(struct flow_table_check *check, struct ofl_match_header *match,
+           uint16_t priority, uint64_t cookie, size_t instructions_num,
+           struct ofl_instruction_header **instructions) {
+    struct flow_entry *copy = xcalloc(1, sizeof(struct flow_entry));
+
+    copy->stats = xcalloc(1, sizeof(struct ofl_flow_stats));
+    copy->stats->priority = priority;
+    copy->stats->cookie = cookie;
+    copy->stats->match = match;
+    copy->stats->instructions_num = instructions_num;
+    copy->stats->instructions = instructions;
+    copy->memory = flow_entry_memory(match, instructions_num, instructions,
+                                     check->table->dp->exp);
+    list_push_back(&check->copies, &copy->match_node);
+    flow_index_insert(&check->index, copy);
+    return copy;
+}
+
+static void
+check_free_copy(struct flow_table_check *check, struct flow_entry *copy) {
+    list_remove(&copy->match_node);
+    flow_index_remove(&check->index, copy);
+    free(copy->stats);
+    free(copy);
+}
+
+static bool
+check_is_gone(const struct flow_table_check *check, struct flow_entry *entry) {
+    struct check_gone *gone;
+
+    HMAP_FOR_EACH_WITH_HASH (gone, struct check_gone, node,
+                             hash_pointer(entry, 0), &check->gone) {
+        if (gone->entry == entry) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Takes an entry, of the table or a copy, out of the checked table. */
+static void
+check_remove(struct flow_table_check *check, struct flow_entry *entry,
+             size_t *memory) {
+    *memory -= entry->memory;
+    if (check_is_copy(entry)) {
+        check_free_copy(check, entry);
+    } else {
+        struct check_gone *gone = xmalloc(sizeof(struct check_gone));
+
+        gone->entry = entry;
+        hmap_insert(&check->gone, &gone->node, hash_pointer(entry, 0));
+    }
+}
+
+void
+flow_table_check_destroy(struct flow_table_check *check) {
+    struct check_gone *gone, *next;
+
+    while (!list_is_empty(&check->copies)) {
+        check_free_copy(check, CONTAINER_OF(list_front(&check->copies),
+                                            struct flow_entry, match_node));
+    }
+    flow_index_destroy(&check->index);
+    HMAP_FOR_EACH_SAFE (gone, next, struct check_gone, node, &check->gone) {
+        hmap_remove(&check->gone, &gone->node);
+        free(gone);
+    }
+    hmap_destroy(&check->gone);
+}
+
+/* The checked table's counterpart of flow_index_find_strict(). */
+static struct flow_entry *
+check_find_strict(struct flow_table_check *check, struct ofl_match_header *match,
+                  uint16_t priority) {
     struct flow_entry *entry;
 
-    table->stats->lookup_count++;
+    entry = flow_index_find_strict(&check->table->index, match, priority);
+    if (entry != NULL && !check_is_gone(check, entry)) {
+        return entry;
+    }
+    return flow_index_find_strict(&check->index, match, priority);
+}
 
-    LIST_FOR_EACH(entry, struct flow_entry, match_node, &table->match_entries) {
-        struct ofl_match_header *m;
+/* The checked table's counterpart of flow_index_overlaps(). */
+static bool
+check_overlaps(struct flow_table_check *check, struct ofl_msg_flow_mod *mod) {
+    struct flow_entry **entries;
+    bool overlaps = false;
+    size_t n, i;
+
+    flow_index_find_overlaps(&check->table->index, mod->match, mod->priority,
+                             &entries, &n);
+    for (i = 0; i < n && !overlaps; i++) {
+        overlaps = !check_is_gone(check, entries[i]) &&
+                   flow_entry_overlaps(entries[i], mod);
+    }
+    free(entries);
+    return overlaps || flow_index_overlaps(&check->index, mod);
+}
 
-        m = entry->match == NULL ? entry->stats->match : entry->match;
+/* The checked table's counterpart of select_entries(), in no given order. */
+static struct flow_entry **
+check_select(struct flow_table_check *check, uint64_t cookie, uint64_t cookie_mask,
+             uint32_t out_port, uint32_t out_group, size_t *n) {
+    struct flow_entry **entries, **copies;
+    size_t n_entries, n_copies, i;
+
+    entries = select_entries(check->table, cookie, cookie_mask, out_port,
+                             out_group, &n_entries);
+    if (!flow_index_select(&check->index, cookie, cookie_mask, out_port,
+                           out_group, &copies, &n_copies)) {
+        struct flow_entry *copy;
+
+        copies = xmalloc(MAX(list_size(&check->copies), 1) * sizeof(struct flow_entry *));
+        n_copies = 0;
+        LIST_FOR_EACH (copy, struct flow_entry, match_node, &check->copies) {
+            copies[n_copies++] = copy;
+        }
+    }
 
-        /* select appropriate handler, based on match type of flow entry. */
-        switch (m->type) {
-            case (OFPMT_OXM): {
-               if (packet_handle_std_match(pkt->handle_std,
-                                            (struct ofl_match *)m)) {
-                    if (!entry->no_byt_count)                                            
-                        entry->stats->byte_count += pkt->buffer->size;
-                    if (!entry->no_pkt_count)
-                        entry->stats->packet_count++;
-                    entry->last_used = time_msec();
+    entries = xrealloc(entries, MAX(n_entries + n_copies, 1) * sizeof(struct flow_entry *));
+    *n = 0;
+    for (i = 0; i < n_entries; i++) {
+        if (!check_is_gone(check, entries[i])) {
+            entries[(*n)++] = entries[i];
+        }
+    }
+    memcpy(&entries[*n], copies, n_copies * sizeof(struct flow_entry *));
+    *n += n_copies;
+    free(copies);
+    return entries;
+}
 
-                    table->stats->matched_count++;
+/* Puts a copy of the entry with the instructions of the flow mod in its
+ * place. */
+static void
+check_modify_entry(struct flow_table_check *check, struct flow_entry *entry,
+                   struct ofl_msg_flow_mod *mod, size_t *memory) {
+    struct flow_entry *copy;
+
+    copy = check_copy(check, entry->stats->match, entry->stats->priority,
+                      entry->stats->cookie, mod->instructions_num,
+                      mod->instructions);
+    *memory += copy->memory;
+    check_remove(check, entry, memory);
+}
 
-                    return entry;
-                }
-                break;
+/* Follows flow_table_add(). */
+static ofl_err
+check_add(struct flow_table_check *check, struct ofl_msg_flow_mod *mod,
+          size_t *memory) {
+    struct flow_table *table = check->table;
+    size_t budget = table->dp->pipeline->memory_budget;
+    struct flow_entry *entry, *copy;
+
+    if ((mod->flags & OFPFF_CHECK_OVERLAP) != 0 && check_overlaps(check, mod)) {
+        return ofl_error(OFPET_FLOW_MOD_FAILED, OFPFMFC_OVERLAP);
+    }
 
-                break;
-            }
-            default: {
-                VLOG_WARN_RL(LOG_MODULE, &rl, "Trying to process flow entry with unknown match type (%u).", m->type);
-            }
+    entry = check_find_strict(check, mod->match, mod->priority);
+    if (entry != NULL) {
+        /* Replaced, whatever the memory it takes. */
+        copy = check_copy(check, mod->match, mod->priority, mod->cookie,
+                          mod->instructions_num, mod->instructions);
+        *memory += copy->memory;
+        check_remove(check, entry, memory);
+        return 0;
+    }
+
+    if (check->active_count >= table->features->max_entries) {
+        return ofl_error(OFPET_FLOW_MOD_FAILED, OFPFMFC_TABLE_FULL);
+    }
+    copy = check_copy(check, mod->match, mod->priority, mod->cookie,
+                      mod->instructions_num, mod->instructions);
+    if (budget != 0 && *memory + copy->memory > budget) {
+        check_free_copy(check, copy);
+        return ofl_error(OFPET_FLOW_MOD_FAILED, OFPFMFC_TABLE_FULL);
+    }
+    check->active_count++;
+    *memory += copy->memory;
+    return 0;
+}
+
+/* Follows flow_table_modify(). */
+static void
+check_modify(struct flow_table_check *check, struct ofl_msg_flow_mod *mod,
+             bool strict, size_t *memory) {
+    struct flow_entry **entries;
+    struct flow_entry *entry;
+    size_t n, i;
+
+    if (strict) {
+        entry = check_find_strict(check, mod->match, mod->priority);
+        if (entry != NULL && flow_entry_matches(entry, mod, true/*strict*/, true/*check_cookie*/)) {
+            check_modify_entry(check, entry, mod, memory);
         }
+        return;
     }
 
-    return NULL;
+    entries = check_select(check, mod->cookie, mod->cookie_mask, OFPP_ANY, OFPG_ANY, &n);
+    for (i = 0; i < n; i++) {
+        if (flow_entry_matches(entries[i], mod, false/*strict*/, true/*check_cookie*/)) {
+            check_modify_entry(check, entries[i], mod, memory);
+        }
+    }
+    free(entries);
 }
 
+/* Follows flow_table_delete(). */
+static void
+check_delete(struct flow_table_check *check, struct ofl_msg_flow_mod *mod,
+             bool strict, size_t *memory) {
+    struct flow_entry **entries;
+    struct flow_entry *entry;
+    size_t n, i;
+
+    if (strict) {
+        entry = check_find_strict(check, mod->match, mod->priority);
+        if (entry != NULL &&
+            (mod->out_port == OFPP_ANY || flow_index_has_out_port(entry, mod->out_port)) &&
+            (mod->out_group == OFPG_ANY || flow_index_has_out_group(entry, mod->out_group)) &&
+            flow_entry_matches(entry, mod, true/*strict*/, true/*check_cookie*/)) {
+            check_remove(check, entry, memory);
+            check->active_count--;
+        }
+        return;
+    }
 
+    entries = check_select(check, mod->cookie, mod->cookie_mask,
+                           mod->out_port, mod->out_group, &n);
+    for (i = 0; i < n; i++) {
+        if (flow_entry_matches(entries[i], mod, false/*strict*/, false/*check_cookie*/)) {
+            check_remove(check, entries[i], memory);
+            check->active_count--;
+        }
+    }
+    free(entries);
+}
+
+ofl_err
+flow_table_check_flow_mod(struct flow_table_check *check,
+                          struct ofl_msg_flow_mod *mod, size_t *memory) {
+    switch (mod->command) {
+        case (OFPFC_ADD): {
+            return check_add(check, mod, memory);
+        }
+        case (OFPFC_MODIFY): {
+            check_modify(check, mod, false, memory);
+            return 0;
+        }
+        case (OFPFC_MODIFY_STRICT): {
+            check_modify(check, mod, true, memory);
+            return 0;
+        }
+        case (OFPFC_DELETE): {
+            check_delete(check, mod, false, memory);
+            return 0;
+        }
+        case (OFPFC_DELETE_STRICT): {
+            check_delete(check, mod, true, memory);
+            return 0;
+        }
+        default: {
+            return ofl_error(OFPET_FLOW_MOD_FAILED, OFPFMFC_BAD_COMMAND);
+        }
+    }
+}
+
+
+/* Counters of the calling thread, or NULL if it counts into the tables. */
+static __thread struct flow_table_counters *thread_counters;
 
 void
-flow_table_timeout(struct flow_table *table) {
-    struct flow_entry *entry, *next;
+flow_table_set_thread_counters(struct flow_table_counters *counters) {
+    thread_counters = counters;
+}
 
-    /* NOTE: hard timeout entries are ordered by the time they should be removed at,
-     * so if one is not removed, the rest will not be either. */
-    LIST_FOR_EACH_SAFE (entry, next, struct flow_entry, hard_node, &table->hard_entries) {
-        if (!flow_entry_hard_timeout(entry)) {
-            break;
+void
+flow_table_account(struct flow_table *table, struct flow_entry *entry,
+                   struct packet *pkt) {
+    uint64_t *lookup_count, *matched_count;
+
+    if (thread_counters == NULL) {
+        lookup_count = &table->stats->lookup_count;
+        matched_count = &table->stats->matched_count;
+    } else {
+        lookup_count = &thread_counters[table->stats->table_id].lookup_count;
+        matched_count = &thread_counters[table->stats->table_id].matched_count;
+    }
+
+    (*lookup_count)++;
+    if (entry == NULL) {
+        return;
+    }
+
+    /* Entries are shared by the threads, but the packets of a flow all go
+     * to the same worker, so the atomic updates seldom contend. */
+    if (!entry->no_byt_count) {
+        __atomic_add_fetch(&entry->stats->byte_count, pkt->buffer->size,
+                           __ATOMIC_RELAXED);
+    }
+    if (!entry->no_pkt_count) {
+        __atomic_add_fetch(&entry->stats->packet_count, 1, __ATOMIC_RELAXED);
+    }
+    entry->last_used = time_msec();
+    (*matched_count)++;
+}
+
+/* Returns what 'counter' counted since '*folded', and updates '*folded'. */
+static inline uint64_t
+fold(const uint64_t *counter, uint64_t *folded) {
+    uint64_t value = __atomic_load_n(counter, __ATOMIC_RELAXED);
+    uint64_t delta = value - *folded;
+
+    *folded = value;
+    return delta;
+}
+
+void
+flow_table_fold_counters(struct flow_table *table,
+                         const struct flow_table_counters *counters,
+                         struct flow_table_counters *folded) {
+    const struct flow_table_lookup_stats *c = &counters->lookup_stats;
+    struct flow_table_lookup_stats *f = &folded->lookup_stats;
+    struct flow_table_lookup_stats *stats = table->lookup_stats;
+    size_t i;
+
+    table->stats->lookup_count += fold(&counters->lookup_count,
+                                       &folded->lookup_count);
+    table->stats->matched_count += fold(&counters->matched_count,
+                                        &folded->matched_count);
+    if (stats == NULL) {
+        return;
+    }
+    stats->lookups += fold(&c->lookups, &f->lookups);
+    stats->hits += fold(&c->hits, &f->hits);
+    stats->probes += fold(&c->probes, &f->probes);
+    stats->cycles += fold(&c->cycles, &f->cycles);
+    for (i = 0; i < FLOW_TABLE_PROBE_BUCKETS; i++) {
+        stats->probe_hits[i] += fold(&c->probe_hits[i], &f->probe_hits[i]);
+    }
+    for (i = 0; i < FLOW_TABLE_CYCLE_BUCKETS; i++) {
+        stats->cycles_hist[i] += fold(&c->cycles_hist[i], &f->cycles_hist[i]);
+    }
+}
+
+/* Returns a free running count of CPU cycles, or of nanoseconds where
+ * there is no cycle counter. */
+static inline uint64_t
+read_cycles(void) {
+#if defined(__i386__) || defined(__x86_64__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+/* Returns the log2 histogram bucket of a value, see
+ * struct flow_table_lookup_stats. */
+static inline size_t
+log2_bucket(uint64_t value, size_t n_buckets) {
+    size_t bucket = value <= 1 ? 0 : 64 - __builtin_clzll(value - 1);
+
+    return MIN(bucket, n_buckets - 1);
+}
+
+static void
+account_lookup(struct flow_table_lookup_stats *stats, struct flow_entry *entry,
+               size_t probes, uint64_t cycles) {
+    stats->lookups++;
+    stats->probes += probes;
+    stats->cycles += cycles;
+    stats->cycles_hist[log2_bucket(cycles, FLOW_TABLE_CYCLE_BUCKETS)]++;
+    if (entry != NULL) {
+        stats->hits++;
+        stats->probe_hits[log2_bucket(probes, FLOW_TABLE_PROBE_BUCKETS)]++;
+    }
+}
+
+struct flow_entry *
+flow_table_lookup(struct flow_table *table, struct packet *pkt, uint64_t *wc) {
+    struct flow_table_lookup *lookup = rcu_get(table->published);
+    struct flow_table_lookup_stats *stats = table->lookup_stats;
+    struct flow_entry *entry = NULL;
+    struct cls_rule *rule;
+    uint64_t start = 0;
+    size_t probes;
+
+    if (stats != NULL && thread_counters != NULL) {
+        stats = &thread_counters[table->stats->table_id].lookup_stats;
+    }
+
+    /* Parse the packet, if the fields matched on in this table have not
+     * been extracted yet. */
+    packet_handle_std_validate_depth(pkt->handle_std, table->parse_depth);
+
+    if (stats != NULL) {
+        start = read_cycles();
+    }
+    if (lookup->lpm != NULL) {
+        entry = flow_lpm_lookup(lookup->lpm, &pkt->handle_std->key, wc,
+                                stats != NULL ? &probes : NULL);
+    } else if (lookup->exact != NULL) {
+        entry = flow_exact_lookup(lookup->exact, &pkt->handle_std->key, wc,
+                                  stats != NULL ? &probes : NULL);
+    } else {
+        rule = classifier_lookup(&lookup->classifier, &pkt->handle_std->key, wc,
+                                 stats != NULL ? &probes : NULL);
+        if (rule != NULL) {
+            entry = rule_entry(lookup, rule);
         }
     }
+    if (stats != NULL) {
+        account_lookup(stats, entry, probes, read_cycles() - start);
+    }
+    flow_table_account(table, entry, pkt);
+
+    return entry;
+}
+
+void
+flow_table_set_lookup_stats(struct flow_table *table, bool enable) {
+    free(table->lookup_stats);
+    table->lookup_stats = enable ? xcalloc(1, sizeof(struct flow_table_lookup_stats))
+                                 : NULL;
+}
 
-    LIST_FOR_EACH_SAFE (entry, next, struct flow_entry, idle_node, &table->idle_entries) {
-        flow_entry_idle_timeout(entry);
+/* Sets the alone flag of the entries of the table, in the staged copy, and
+ * credits their hits since the last call to their subtables. Returns true
+ * if a flag was set, and sets 'hits' to true if a hit was credited. */
+static bool
+update_entries(struct flow_table *table, bool *hits) {
+    uint8_t rule = table->staged->rule;
+    bool check = table->alone_stale &&
+                 table->stats->active_count <= FLOW_TABLE_ALONE_MAX_ENTRIES;
+    struct flow_entry *entry;
+    bool changed = false;
+
+    *hits = false;
+    LIST_FOR_EACH (entry, struct flow_entry, match_node, &table->match_entries) {
+        if (!entry->alone && check) {
+            struct flow_entry **overlaps;
+            size_t n;
+
+            /* The entry overlaps itself. */
+            flow_index_find_overlaps(&table->index, entry->stats->match,
+                                     entry->stats->priority, &overlaps, &n);
+            free(overlaps);
+            if (n <= 1) {
+                entry->alone = true;
+                entry->cls_rule[rule].alone = true;
+                table->n_alone++;
+                changed = true;
+            }
+        }
+
+        entry->recent_hits = 0;
+        if (!entry->no_pkt_count) {
+            entry->recent_hits = entry->stats->packet_count - entry->reorder_packets;
+            entry->reorder_packets = entry->stats->packet_count;
+        }
+        if (entry->recent_hits > 0) {
+            classifier_add_hits(&entry->cls_rule[rule], entry->recent_hits);
+            *hits = true;
+        }
+    }
+    table->alone_stale = false;
+    return changed;
+}
+
+void
+flow_table_reorder(struct flow_table *table) {
+    struct flow_table_lookup_stats *stats = table->lookup_stats;
+    bool changed, hits;
+
+    if (!table->reorder) {
+        return;
+    }
+    prepare_changes(table);
+    if (table->mode != OFP_EXT_TABLE_MODE_GENERIC || table->batch) {
+        return;
+    }
+
+    changed = update_entries(table, &hits);
+    changed = classifier_reorder(&table->staged->classifier) || changed;
+    if (changed && stats != NULL) {
+        stats->before_lookups = stats->lookups - stats->reorder_lookups;
+        stats->before_probes = stats->probes - stats->reorder_probes;
+        stats->reorder_lookups = stats->lookups;
+        stats->reorder_probes = stats->probes;
+        stats->reorders++;
+    }
+    if (changed || hits) {
+        log_change(table, CHANGE_REORDER, NULL, NULL);
     }
 }
 
@@ -402,8 +1440,30 @@ flow_table_create(struct datapath *dp, uint8_t table_id) {
     table->features->properties_num = flow_table_features(table->features);
 
     list_init(&table->match_entries);
-    list_init(&table->hard_entries);
-    list_init(&table->idle_entries);
+    lookup_init(&table->lookups[0], 0);
+    lookup_init(&table->lookups[1], 1);
+    table->published = &table->lookups[0];
+    table->staged = &table->lookups[1];
+    list_init(&table->changes);
+    table->dirty = false;
+    table->batch = false;
+    table->grace = 0;
+    table->lookup_stats = NULL;
+    table->reorder = false;
+    table->n_alone = 0;
+    table->alone_stale = false;
+    flow_index_init(&table->index);
+    table->mode = OFP_EXT_TABLE_MODE_GENERIC;
+    table->mode_config = OFP_EXT_TABLE_MODE_AUTO;
+    table->lpm_misfits = 0;
+    table->exact_misfits = 0;
+    table->mode_retry_at = FLOW_TABLE_MODE_MIN_ENTRIES;
+    table->generation = 0;
+    table->memory = 0;
+
+    memset(table->field_refs, 0, sizeof(table->field_refs));
+    table->match_fields = 0;
+    table->parse_depth  = PACKET_PARSE_L2;
 
     return table;
 }
@@ -412,9 +1472,16 @@ void
 flow_table_destroy(struct flow_table *table) {
     struct flow_entry *entry, *next;
 
+    rcu_synchronize();
+    free_changes(table);
     LIST_FOR_EACH_SAFE (entry, next, struct flow_entry, match_node, &table->match_entries) {
+        flow_index_remove(&table->index, entry);
         flow_entry_destroy(entry);
     }
+    lookup_destroy(&table->lookups[0]);
+    lookup_destroy(&table->lookups[1]);
+    flow_index_destroy(&table->index);
+    free(table->lookup_stats);
     free(table->features);
     free(table->stats);
     free(table);
@@ -423,12 +1490,15 @@ flow_table_destroy(struct flow_table *table) {
 void
 flow_table_stats(struct flow_table *table, struct ofl_msg_multipart_request_flow *msg,
                  struct ofl_flow_stats ***stats, size_t *stats_size, size_t *stats_num) {
-    struct flow_entry *entry;
+    struct flow_entry **entries;
+    size_t n, i;
 
-    LIST_FOR_EACH(entry, struct flow_entry, match_node, &table->match_entries) {
-        if ((msg->out_port == OFPP_ANY || flow_entry_has_out_port(entry, msg->out_port)) &&
-            (msg->out_group == OFPG_ANY || flow_entry_has_out_group(entry, msg->out_group)) &&
-            match_std_nonstrict((struct ofl_match *)msg->match,
+    entries = select_entries(table, msg->cookie, msg->cookie_mask,
+                             msg->out_port, msg->out_group, &n);
+    for (i = 0; i < n; i++) {
+        struct flow_entry *entry = entries[i];
+
+        if (match_std_nonstrict((struct ofl_match *)msg->match,
                                 (struct ofl_match *)entry->stats->match)) {
 
             flow_entry_update(entry);
@@ -440,16 +1510,22 @@ flow_table_stats(struct flow_table *table, struct ofl_msg_multipart_request_flow
             (*stats_num)++;
         }
     }
+    free(entries);
 }
 
 void
 flow_table_aggregate_stats(struct flow_table *table, struct ofl_msg_multipart_request_flow *msg,
                            uint64_t *packet_count, uint64_t *byte_count, uint32_t *flow_count) {
-    struct flow_entry *entry;
+    struct flow_entry **entries;
+    size_t n, i;
+
+    entries = select_entries(table, msg->cookie, msg->cookie_mask,
+                             msg->out_port, msg->out_group, &n);
+    for (i = 0; i < n; i++) {
+        struct flow_entry *entry = entries[i];
 
-    LIST_FOR_EACH(entry, struct flow_entry, match_node, &table->match_entries) {
-        if ((msg->out_port == OFPP_ANY || flow_entry_has_out_port(entry, msg->out_port)) &&
-            (msg->out_group == OFPG_ANY || flow_entry_has_out_group(entry, msg->out_group))) {
+        if (match_std_nonstrict((struct ofl_match *)msg->match,
+                                (struct ofl_match *)entry->stats->match)) {
 			
 			if (!entry->no_pkt_count)
             	(*packet_count) += entry->stats->packet_count;
@@ -458,6 +1534,6 @@ flow_table_aggregate_stats(struct flow_table *table, struct ofl_msg_multipart_re
             (*flow_count)++;
         }
     }
-
+    free(entries);
 }
 
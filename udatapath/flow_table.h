@@ -30,21 +30,116 @@
 
 #ifndef FLOW_TABLE_H
 #define FLOW_TABLE_H 1
+#include "classifier.h"
+#include "flow_exact.h"
+#include "flow_index.h"
+#include "flow_lpm.h"
 #include "oflib/ofl.h"
 #include "oflib/ofl-messages.h"
 #include "oflib/ofl-structs.h"
+#include "openflow/openflow-ext.h"
+#include "packet_parser.h"
 #include "pipeline.h"
 #include "timeval.h"
 
 
-#define FLOW_TABLE_MAX_ENTRIES 4096
+#define FLOW_TABLE_MAX_ENTRIES 4096        /* default capacity of a table. */
+#define FLOW_TABLE_ENTRIES_LIMIT (1 << 24) /* largest capacity a table can be
+                                              configured to. */
+#define FLOW_TABLE_MODE_MIN_ENTRIES 64 /* entries a table picking its own
+                                          lookup structure needs to hold
+                                          before moving to exact or
+                                          longest prefix match. */
+#define FLOW_TABLE_BATCH_RATIO 4 /* a batch of flow mods skips the staged
+                                    copy and rebuilds it once when it holds
+                                    at least one change for this many
+                                    entries of the table. */
+#define FLOW_TABLE_ALONE_MAX_ENTRIES 4096 /* largest table whose entries
+                                            are checked for overlaps when
+                                            reordered; the check costs a
+                                            pass over the entries of the
+                                            same priority for each. */
+#define FLOW_TABLE_PROBE_BUCKETS OFP_EXT_LOOKUP_PROBE_BUCKETS /* buckets of the
+                                                 probe histogram. */
+#define FLOW_TABLE_CYCLE_BUCKETS OFP_EXT_LOOKUP_CYCLE_BUCKETS /* buckets of the
+                                                 lookup cycle histogram. */
 #define TABLE_FEATURES_NUM 14
 
 /****************************************************************************
  * Implementation of a flow table. The current implementation stores flow
- * entries in priority and then insertion order.
+ * entries in insertion order, indexes them in a tuple space search
+ * classifier for the lookups, and by their match for flow mods.
+ *
+ * A table whose entries all match on the same fields without masks is
+ * looked up in an exact match hash table instead of the classifier, and
+ * one whose entries all match on a destination prefix, with priorities
+ * following the prefix length, in a longest prefix match structure. The
+ * table moves to these when asked to, or on its own once it holds enough
+ * entries, and moves back to the classifier as soon as an entry which does
+ * not fit is added.
+ *
+ * Packets never wait for flow mods: the table keeps two copies of its
+ * lookup structure, and packets look up the published one, read through
+ * rcu_get(). Flow mods change the other, staged, copy and log the changes;
+ * flow_table_publish() swaps the copies, and once a grace period has
+ * elapsed, the logged changes are replayed on the copy packets stopped
+ * looking up, and the entries removed meanwhile are destroyed.
+ *
+ * A large batch of flow mods, such as a committed bundle, does not update
+ * the staged copy one entry at a time: the copy is rebuilt once, in the
+ * mode the entries fit, when the batch ends.
+ *
+ * Tables using the classifier may be reordered periodically: subtables of
+ * equal priority are looked into by decreasing recent hits, and a lookup
+ * stops at an entry no other entry of its priority overlaps.
  ****************************************************************************/
 
+/* A copy of the lookup structure of a flow table. */
+struct flow_table_lookup {
+    struct classifier  classifier;  /* entries indexed by their match, in
+                                       the generic mode. */
+    struct flow_lpm   *lpm;         /* entries indexed by their prefix, in
+                                       the LPM mode. */
+    struct flow_exact *exact;       /* entries indexed by their match, in
+                                       the exact mode. */
+    uint8_t            mode;        /* lookup structure in use,
+                                       OFP_EXT_TABLE_MODE_*. */
+    uint8_t            rule;        /* index of the entries' cls_rule the
+                                       classifier holds. */
+};
+
+
+/* Lookup cost counters of a flow table, kept only when enabled. A probe is
+ * a classifier subtable, a longest prefix match trie node or an exact
+ * match slot looked into. Bucket i of a histogram counts the values v
+ * with 2^(i-1) < v <= 2^i, bucket 0 those up to 1, and the last bucket
+ * also the values above its range. */
+struct flow_table_lookup_stats {
+    uint64_t lookups;      /* lookups counted. */
+    uint64_t hits;         /* lookups which found an entry. */
+    uint64_t probes;       /* probes of all lookups. */
+    uint64_t cycles;       /* cycles spent in all lookups. */
+    uint64_t probe_hits[FLOW_TABLE_PROBE_BUCKETS];  /* hits by the number
+                                                       of probes made. */
+    uint64_t cycles_hist[FLOW_TABLE_CYCLE_BUCKETS]; /* lookups by the
+                                                       cycles spent. */
+    uint64_t reorders;        /* reorderings which changed the lookup. */
+    uint64_t reorder_lookups; /* lookups at the last reordering. */
+    uint64_t reorder_probes;  /* probes at the last reordering. */
+    uint64_t before_lookups;  /* lookups between the two last reorderings. */
+    uint64_t before_probes;   /* probes between the two last reorderings. */
+};
+
+/* Counters of the packets a worker thread looks up in a flow table. Worker
+ * threads count into their own copy rather than into the table, which the
+ * main thread folds into the table's counters; see
+ * flow_table_set_thread_counters(). */
+struct flow_table_counters {
+    uint64_t lookup_count;
+    uint64_t matched_count;
+    struct flow_table_lookup_stats lookup_stats; /* lookup cost counters, if
+                                                    the table keeps them. */
+};
 
 struct flow_table {
     struct datapath           *dp;
@@ -52,11 +147,69 @@ struct flow_table {
     struct ofl_table_features *features;      /*store table features*/
     struct ofl_table_stats    *stats;         /* structure storing table statistics. */
     
-    struct list               match_entries;  /* list of entries in order. */
-    struct list               hard_entries;   /* list of entries with hard timeout;
-                                                ordered by their timeout times. */
-    struct list               idle_entries;   /* unordered list of entries with
-                                                idle timeout. */
+    struct list               match_entries;  /* list of entries in insertion
+                                                order. */
+    struct flow_table_lookup  lookups[2];
+    struct flow_table_lookup *published;      /* copy packets look up. */
+    struct flow_table_lookup *staged;         /* copy flow mods change. */
+    struct list               changes;        /* changes of the staged copy
+                                                not replayed on the other one
+                                                yet. */
+    bool                      dirty;          /* staged copy has changes not
+                                                published yet. */
+    bool                      batch;          /* staged copy left behind
+                                                until the batch of flow mods
+                                                ends. */
+    uint64_t                  grace;          /* grace period to wait for
+                                                before the staged copy, last
+                                                published, is brought up to
+                                                date; 0 if it is. */
+    uint8_t                   mode;           /* lookup structure in use,
+                                                OFP_EXT_TABLE_MODE_*. */
+    uint8_t                   mode_config;    /* lookup structure asked for. */
+    size_t                    lpm_misfits;    /* entries which do not fit the
+                                                LPM mode. */
+    size_t                    exact_misfits;  /* entries which are not fully
+                                                specified. */
+    size_t                    mode_retry_at;  /* number of entries the other
+                                                modes are next tried at. */
+    struct flow_index         index;          /* entries indexed for flow mods. */
+
+    uint32_t                  field_refs[PACKET_KEY_FIELDS]; /* number of entries
+                                                matching on each OXM field. */
+    uint64_t                  match_fields;   /* OXM fields matched on by any
+                                                entry, as packet key presence bits. */
+    enum packet_parse_depth   parse_depth;    /* depth packets must be parsed to
+                                                for a lookup in the table. */
+    uint64_t                  generation;     /* bumped whenever an entry is
+                                                added, modified or removed. */
+    size_t                    memory;         /* estimated bytes held by the
+                                                entries. */
+    struct flow_table_lookup_stats *lookup_stats; /* lookup cost counters, or
+                                                NULL if not kept. */
+    bool                      reorder;        /* the classifier is reordered
+                                                by hits. */
+    size_t                    n_alone;        /* entries with alone set. */
+    bool                      alone_stale;    /* entries were added or removed
+                                                since the alone flags were
+                                                last computed. */
+};
+
+/* A table as a batch of flow mods checked so far would leave it, kept aside
+ * from the table, which is left untouched; see flow_table_check_flow_mod().
+ * The entries the mods add, replace or modify are copies in 'index', and
+ * those of the table they replace, modify or remove are listed in 'gone'.
+ * The copies refer to the matches and instructions of the mods, which must
+ * outlive the check. */
+struct flow_table_check {
+    struct flow_table        *table;
+    size_t                    active_count;   /* entries the table would
+                                                hold. */
+    struct hmap               gone;           /* entries of the table no
+                                                longer there. */
+    struct flow_index         index;          /* copies of the entries added
+                                                or changed. */
+    struct list               copies;         /* the same copies. */
 };
 
 extern uint32_t oxm_ids[];
@@ -70,13 +223,88 @@ extern struct ofl_action_header actions[];
 ofl_err
 flow_table_flow_mod(struct flow_table *table, struct ofl_msg_flow_mod *mod, bool *match_kept, bool *insts_kept);
 
-/* Finds the flow entry with the highest priority, which matches the packet. */
+/* Starts checking a batch of flow mods against the table. */
+void
+flow_table_check_init(struct flow_table_check *check, struct flow_table *table);
+
+/* Frees what checking a batch of flow mods took. */
+void
+flow_table_check_destroy(struct flow_table_check *check);
+
+/* Returns the error flow_table_flow_mod() would return for the flow mod,
+ * on the table as the mods checked before leave it, and records the effect
+ * of the mod in 'check' if there is none. 'memory' holds the bytes the
+ * entries of all tables would take, and is updated. */
+ofl_err
+flow_table_check_flow_mod(struct flow_table_check *check,
+                          struct ofl_msg_flow_mod *mod, size_t *memory);
+
+/* Finds the flow entry with the highest priority, which matches the packet.
+ * If wc is not NULL, the bits of the packet key the result depends on are
+ * added to it (see classifier_lookup()). */
 struct flow_entry *
-flow_table_lookup(struct flow_table *table, struct packet *pkt);
+flow_table_lookup(struct flow_table *table, struct packet *pkt, uint64_t *wc);
+
+/* Updates the table and entry counters for a packet looked up in the table,
+ * which matched the entry (or none, if NULL). */
+void
+flow_table_account(struct flow_table *table, struct flow_entry *entry,
+                   struct packet *pkt);
+
+/* Makes the calling thread count the packets it looks up into 'counters',
+ * an array of PIPELINE_TABLES counters indexed by table id, instead of
+ * into the tables, or into the tables again if NULL. The entry counters
+ * are then updated atomically. */
+void
+flow_table_set_thread_counters(struct flow_table_counters *counters);
+
+/* Adds to the counters of the table what 'counters' counted since
+ * 'folded' was last passed, and updates 'folded'. */
+void
+flow_table_fold_counters(struct flow_table *table,
+                         const struct flow_table_counters *counters,
+                         struct flow_table_counters *folded);
+
+/* Starts or stops counting the cost of the lookups in the table. Starting
+ * clears the counters. */
+void
+flow_table_set_lookup_stats(struct flow_table *table, bool enable);
+
+/* Orders the subtables of equal priority of a table using the classifier by
+ * the hits of their entries since the last call, and marks the entries no
+ * other entry of the same priority overlaps, whose match ends a lookup. */
+void
+flow_table_reorder(struct flow_table *table);
+
+/* Removes an entry from the lookup structure of the table. The table
+ * destroys the entry once no packet may still be using it. */
+void
+flow_table_unlink(struct flow_table *table, struct flow_entry *entry);
+
+/* Makes the changes of the table visible to the packets looked up from now
+ * on. Returns true if there were any. */
+bool
+flow_table_publish(struct flow_table *table);
+
+/* Starts a batch of flow mods, making 'changes' changes to the table. */
+void
+flow_table_batch_begin(struct flow_table *table, size_t changes);
+
+/* Ends a batch of flow mods, bringing the staged copy up to date. */
+void
+flow_table_batch_end(struct flow_table *table);
+
+/* Sets the lookup structure of the table, one of OFP_EXT_TABLE_MODE_*. */
+ofl_err
+flow_table_set_mode(struct flow_table *table, uint8_t mode);
+
+/* Counts the OXM fields matched on by a flow entry inserted in the table. */
+void
+flow_table_ref_fields(struct flow_table *table, struct flow_entry *entry);
 
-/* Orders the flow table to check the timeout its flows. */
+/* Uncounts the OXM fields matched on by a flow entry removed from the table. */
 void
-flow_table_timeout(struct flow_table *table);
+flow_table_unref_fields(struct flow_table *table, struct flow_entry *entry);
 
 /* Creates a flow table. */
 struct flow_table *
@@ -34,6 +34,7 @@
 #include "group_table.h"
 #include "dp_actions.h"
 #include "datapath.h"
+#include "rcu.h"
 #include "util.h"
 #include "oflib/ofl.h"
 #include "oflib/ofl-structs.h"
@@ -117,10 +118,23 @@ group_entry_create(struct datapath *dp, struct group_table *table, struct ofl_ms
         }
     }
     list_init(&entry->flow_refs);
+    pthread_mutex_init(&entry->mutex, NULL);
     return entry;
 }
 
 
+/* Frees a group entry no packet may be executing any more. */
+static void
+free_entry(void *entry_) {
+    struct group_entry *entry = entry_;
+
+    ofl_structs_free_group_desc_stats(entry->desc, entry->dp->exp);
+    ofl_structs_free_group_stats(entry->stats);
+    free(entry->data);
+    pthread_mutex_destroy(&entry->mutex);
+    free(entry);
+}
+
 void
 group_entry_destroy(struct group_entry *entry) {
     struct flow_ref_entry *ref, *next;
@@ -133,10 +147,18 @@ group_entry_destroy(struct group_entry *entry) {
 
     }
 
-    ofl_structs_free_group_desc_stats(entry->desc, entry->dp->exp);
-    ofl_structs_free_group_stats(entry->stats);
-    free(entry->data);
-    free(entry);
+    rcu_postpone(free_entry, entry);
+}
+
+/* Counts a packet of 'size' bytes executed through bucket 'b'. */
+static void
+count_packet(struct group_entry *entry, size_t b, size_t size) {
+    pthread_mutex_lock(&entry->mutex);
+    entry->stats->byte_count += size;
+    entry->stats->packet_count++;
+    entry->stats->counters[b]->byte_count += size;
+    entry->stats->counters[b]->packet_count++;
+    pthread_mutex_unlock(&entry->mutex);
 }
 
 /* Executes a group entry of type ALL. */
@@ -158,10 +180,7 @@ execute_all(struct group_entry *entry, struct packet *pkt) {
 
         action_set_write_actions(p->action_set, bucket->actions_num, bucket->actions);
 
-        entry->stats->byte_count += p->buffer->size;
-        entry->stats->packet_count++;
-        entry->stats->counters[i]->byte_count += p->buffer->size;
-        entry->stats->counters[i]->packet_count++;
+        count_packet(entry, i, p->buffer->size);
 
         /* Cookie field is set 0xffffffffffffffff
            because we cannot associate to any
@@ -175,7 +194,11 @@ execute_all(struct group_entry *entry, struct packet *pkt) {
 /* Executes a group entry of type SELECT. */
 static void
 execute_select(struct group_entry *entry, struct packet *pkt) {
-    size_t b  = select_from_select_group(entry);
+    size_t b;
+
+    pthread_mutex_lock(&entry->mutex);
+    b = select_from_select_group(entry);
+    pthread_mutex_unlock(&entry->mutex);
 
     if (b != -1) {
         struct ofl_bucket *bucket = entry->desc->buckets[b];
@@ -188,10 +211,7 @@ execute_select(struct group_entry *entry, struct packet *pkt) {
 
         action_set_write_actions(pkt->action_set, bucket->actions_num, bucket->actions);
 
-        entry->stats->byte_count += pkt->buffer->size;
-        entry->stats->packet_count++;
-        entry->stats->counters[b]->byte_count += pkt->buffer->size;
-        entry->stats->counters[b]->packet_count++;
+        count_packet(entry, b, pkt->buffer->size);
         /* Cookie field is set 0xffffffffffffffff
            because we cannot associate to any
            particular flow */
@@ -217,10 +237,7 @@ execute_indirect(struct group_entry *entry, struct packet *pkt) {
 
         action_set_write_actions(pkt->action_set, bucket->actions_num, bucket->actions);
 
-        entry->stats->byte_count += pkt->buffer->size;
-        entry->stats->packet_count++;
-        entry->stats->counters[0]->byte_count += pkt->buffer->size;
-        entry->stats->counters[0]->packet_count++;
+        count_packet(entry, 0, pkt->buffer->size);
         /* Cookie field is set 0xffffffffffffffff
            because we cannot associate to any
            particular flow */
@@ -247,10 +264,7 @@ execute_ff(struct group_entry *entry, struct packet *pkt) {
 
         action_set_write_actions(pkt->action_set, bucket->actions_num, bucket->actions);
 
-        entry->stats->byte_count += pkt->buffer->size;
-        entry->stats->packet_count++;
-        entry->stats->counters[b]->byte_count += pkt->buffer->size;
-        entry->stats->counters[b]->packet_count++;
+        count_packet(entry, b, pkt->buffer->size);
         /* Cookie field is set 0xffffffffffffffff
            because we cannot associate to any
            particular flow */
@@ -32,6 +32,7 @@
 #ifndef GROUP_entry_H
 #define GROUP_entry_H 1
 
+#include <pthread.h>
 #include <stdbool.h>
 #include "hmap.h"
 #include "packet.h"
@@ -58,6 +59,9 @@ struct group_entry {
     struct ofl_group_stats      *stats;
     uint64_t created;
     void                        *data;     /* private data for group implementation. */
+    pthread_mutex_t              mutex;    /* guards data and the counters of
+                                              stats, which the packets of all
+                                              threads update. */
 
     struct list                  flow_refs; /* references to flows referencing the group. */
 };
@@ -74,7 +78,9 @@ group_entry_execute(struct group_entry *entry,
 struct group_entry *
 group_entry_create(struct datapath *dp, struct group_table *table, struct ofl_msg_group_mod *mod);
 
-/* Destroys a group entry. */
+/* Destroys a group entry, removed from its table already, and the flow
+ * entries referencing it. The entry is freed once no packet may still be
+ * executing it. */
 void
 group_entry_destroy(struct group_entry *entry);
 
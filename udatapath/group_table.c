@@ -38,6 +38,8 @@
 #include "hmap.h"
 #include "list.h"
 #include "packet.h"
+#include "pipeline.h"
+#include "rcu.h"
 #include "util.h"
 #include "openflow/openflow.h"
 #include "oflib/ofl.h"
@@ -71,6 +73,57 @@ group_table_find(struct group_table *table, uint32_t group_id) {
     return CONTAINER_OF(hnode, struct group_entry, node);
 }
 
+static int
+compare_slots(const void *a_, const void *b_) {
+    const struct group_table_slot *a = a_;
+    const struct group_table_slot *b = b_;
+
+    return a->group_id < b->group_id ? -1 : a->group_id > b->group_id;
+}
+
+/* Publishes a snapshot of the groups in the table; the previous one is
+ * freed once no packet may be looking it up. Must be called before the
+ * entries removed from the table are destroyed. */
+static void
+publish_snapshot(struct group_table *table) {
+    struct group_table_snapshot *old = table->snapshot;
+    struct group_table_snapshot *snapshot;
+    struct group_entry *entry;
+
+    snapshot = xmalloc(sizeof(struct group_table_snapshot) +
+                       hmap_count(&table->entries) * sizeof(struct group_table_slot));
+    snapshot->entries_num = 0;
+    HMAP_FOR_EACH(entry, struct group_entry, node, &table->entries) {
+        struct group_table_slot *slot = &snapshot->entries[snapshot->entries_num++];
+
+        slot->group_id = entry->stats->group_id;
+        slot->entry = entry;
+    }
+    qsort(snapshot->entries, snapshot->entries_num,
+          sizeof(struct group_table_slot), compare_slots);
+
+    rcu_set(table->snapshot, snapshot);
+    rcu_postpone(free, old);
+}
+
+/* Returns the group with the given ID in a snapshot. */
+static struct group_entry *
+snapshot_find(const struct group_table_snapshot *snapshot, uint32_t group_id) {
+    size_t low = 0, high = snapshot->entries_num;
+
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+
+        if (snapshot->entries[mid].group_id < group_id) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low < snapshot->entries_num && snapshot->entries[low].group_id == group_id
+           ? snapshot->entries[low].entry : NULL;
+}
+
 /* Handles group mod messages with ADD command. */
 static ofl_err
 group_table_add(struct group_table *table, struct ofl_msg_group_mod *mod) {
@@ -92,6 +145,7 @@ group_table_add(struct group_table *table, struct ofl_msg_group_mod *mod) {
     entry = group_entry_create(table->dp, table, mod);
 
     hmap_insert(&table->entries, &entry->node, entry->stats->group_id);
+    publish_snapshot(table);
 
     table->entries_num++;
     table->buckets_num += entry->desc->buckets_num;
@@ -122,6 +176,7 @@ group_table_modify(struct group_table *table, struct ofl_msg_group_mod *mod) {
 
     hmap_remove(&table->entries, &entry->node);
     hmap_insert_fast(&table->entries, &new_entry->node, mod->group_id);
+    publish_snapshot(table);
 
     table->buckets_num = table->buckets_num - entry->desc->buckets_num + new_entry->desc->buckets_num;
 
@@ -139,13 +194,16 @@ group_table_modify(struct group_table *table, struct ofl_msg_group_mod *mod) {
 static ofl_err
 group_table_delete(struct group_table *table, struct ofl_msg_group_mod *mod) {
     if (mod->group_id == OFPG_ALL) {
+        struct hmap entries;
         struct group_entry *entry, *next;
 
-        HMAP_FOR_EACH_SAFE(entry, next, struct group_entry, node, &table->entries) {
+        hmap_init(&entries);
+        hmap_swap(&entries, &table->entries);
+        publish_snapshot(table);
+        HMAP_FOR_EACH_SAFE(entry, next, struct group_entry, node, &entries) {
             group_entry_destroy(entry);
         }
-        hmap_destroy(&table->entries);
-        hmap_init(&table->entries);
+        hmap_destroy(&entries);
 
         table->entries_num = 0;
         table->buckets_num = 0;
@@ -172,6 +230,7 @@ group_table_delete(struct group_table *table, struct ofl_msg_group_mod *mod) {
             table->buckets_num -= entry->desc->buckets_num;
 
             hmap_remove(&table->entries, &entry->node);
+            publish_snapshot(table);
             group_entry_destroy(entry);
         }
 
@@ -198,6 +257,8 @@ group_table_handle_group_mod(struct group_table *table, struct ofl_msg_group_mod
         }
     }
 
+    pipeline_invalidate_cache(table->dp->pipeline);
+
     switch (mod->command) {
         case (OFPGC_ADD): {
             return group_table_add(table, mod);
@@ -314,7 +375,7 @@ void
 group_table_execute(struct group_table *table, struct packet *packet, uint32_t group_id) {
     struct group_entry *entry;
 
-    entry = group_table_find(table, group_id);
+    entry = snapshot_find(rcu_get(table->snapshot), group_id);
 
     if (entry == NULL) {
         VLOG_WARN_RL(LOG_MODULE, &rl, "Trying to execute non-existing group (%u).", group_id);
@@ -342,6 +403,7 @@ group_table_create(struct datapath *dp) {
     table->entries_num = 0;
     hmap_init(&table->entries);
     table->buckets_num = 0;
+    table->snapshot = xcalloc(1, sizeof(struct group_table_snapshot));
 
     return table;
 }
@@ -353,6 +415,8 @@ group_table_destroy(struct group_table *table) {
     HMAP_FOR_EACH_SAFE(entry, next, struct group_entry, node, &table->entries) {
         group_entry_destroy(entry);
     }
+    hmap_destroy(&table->entries);
+    free(table->snapshot);
 
     free(table);
 }
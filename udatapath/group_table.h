@@ -51,12 +51,26 @@ struct datapath;
 struct packet;
 struct sender;
 
+/* A group in a snapshot. */
+struct group_table_slot {
+    uint32_t            group_id;
+    struct group_entry *entry;
+};
+
+/* The groups packets look up, sorted by ID. Group mods replace the whole
+ * snapshot, so packets never see the table in the middle of a change. */
+struct group_table_snapshot {
+    size_t                  entries_num;
+    struct group_table_slot entries[];
+};
+
 struct group_table {
     struct datapath  *dp;
 	struct ofl_msg_multipart_reply_group_features *features;   
 	size_t            entries_num;
     struct hmap       entries;
     size_t            buckets_num;
+    struct group_table_snapshot *snapshot; /* read through rcu_get(). */
 };
 
 
@@ -147,10 +147,9 @@ match_mask128(uint8_t *a, uint8_t *am, uint8_t *b) {
 
 /* Returns true if the fields in *packet matches the flow entry in *flow_match */
 bool
-packet_match(struct ofl_match *flow_match, struct ofl_match *packet){
+packet_match(struct ofl_match *flow_match, struct packet_key *packet){
 
     struct ofl_match_tlv *f;
-    struct ofl_match_tlv *packet_f;
     bool has_mask;
     int field_len;
     int packet_header;
@@ -176,9 +175,9 @@ packet_match(struct ofl_match *flow_match, struct ofl_match *packet){
             packet_header |= field_len;
             flow_mask = f->value + field_len;
         }
-        /* Lookup the packet header */
-        packet_f = oxm_match_lookup(packet_header, packet);
-        if (!packet_f) {
+        /* Lookup the packet field in the packet key */
+        packet_val = packet_key_lookup(packet, packet_header);
+        if (!packet_val) {
         	if (f->header==OXM_OF_VLAN_VID &&
         			*((uint16_t *) f->value)==OFPVID_NONE) {
         		/* There is no VLAN tag, as required */
@@ -188,7 +187,6 @@ packet_match(struct ofl_match *flow_match, struct ofl_match *packet){
         }
 
         /* Compare the flow and packet field values, considering the mask, if any */
-        packet_val = packet_f->value;
         switch (field_len) {
             case 1:
                 if (has_mask) {
@@ -310,7 +308,7 @@ packet_match(struct ofl_match *flow_match, struct ofl_match *packet){
 
 static inline bool
 strict_mask8(uint8_t *a, uint8_t *b, uint8_t *am, uint8_t *bm) {
-    return ((am[0] == bm[0]) && ((a[0] ^ b[0]) & am[0])) == 0;
+    return (am[0] == bm[0]) && ((a[0] ^ b[0]) & am[0]) == 0;
 }
 
 static inline bool
@@ -319,7 +317,7 @@ strict_mask16(uint8_t *a, uint8_t *b, uint8_t *am, uint8_t *bm) {
     uint16_t *b1 = (uint16_t *) b;
     uint16_t *mask_a = (uint16_t *) am;
     uint16_t *mask_b = (uint16_t *) bm;
-    return ((*mask_a == *mask_b) && ((*a1 ^ *b1) & (*mask_a))) == 0;
+    return (*mask_a == *mask_b) && ((*a1 ^ *b1) & *mask_a) == 0;
 }
 
 static inline bool
@@ -334,7 +332,7 @@ strict_mask32(uint8_t *a, uint8_t *b, uint8_t *am, uint8_t *bm) {
     uint32_t *b1 = (uint32_t *) b;
     uint32_t *mask_a = (uint32_t *) am;
     uint32_t *mask_b = (uint32_t *) bm;
-    return ((*mask_a == *mask_b) && ((*a1 ^ *b1) & (*mask_a))) == 0;
+    return (*mask_a == *mask_b) && ((*a1 ^ *b1) & *mask_a) == 0;
 }
 
 static inline bool
@@ -343,7 +341,7 @@ strict_mask_ip(uint8_t *a, uint8_t *b, uint8_t *am, uint8_t *bm) {
     uint32_t *b1 = (uint32_t *) b;
     uint32_t *mask_a = (uint32_t *) am;
     uint32_t *mask_b = (uint32_t *) bm;
-    return ((*mask_a == *mask_b) && ((*a1 ^ *b1) & (*mask_a))) == 0;
+    return (*mask_a == *mask_b) && ((*a1 ^ *b1) & *mask_a) == 0;
 }
 
 static inline bool
@@ -358,7 +356,7 @@ strict_mask64(uint8_t *a, uint8_t *b, uint8_t *am, uint8_t *bm) {
     uint64_t *b1 = (uint64_t *) b;
     uint64_t *mask_a = (uint64_t *) am;
     uint64_t *mask_b = (uint64_t *) bm;
-    return ((*mask_a == *mask_b) && ((*a1 ^ *b1) & (*mask_a))) == 0;
+    return (*mask_a == *mask_b) && ((*a1 ^ *b1) & *mask_a) == 0;
 }
 
 static inline bool
@@ -707,7 +705,7 @@ match_std_nonstrict(struct ofl_match *a, struct ofl_match *b)
 static inline bool
 incompatible_8(uint8_t *a, uint8_t *b, uint8_t *am, uint8_t *bm) {
 
-    return (( (*am&*a) ^ (*bm&*b) ) != 0);
+    return (((*a ^ *b) & *am & *bm) != 0);
 }
 
 static inline bool
@@ -717,7 +715,7 @@ incompatible_16(uint8_t *a, uint8_t *b, uint8_t *am, uint8_t *bm) {
     uint16_t *mask_a = (uint16_t *) am;
     uint16_t *mask_b = (uint16_t *) bm;
 
-    return (( (*mask_a&*a1) ^ (*mask_b&*b1) ) != 0);
+    return (((*a1 ^ *b1) & *mask_a & *mask_b) != 0);
 }
 
 static inline bool
@@ -727,7 +725,7 @@ incompatible_32(uint8_t *a, uint8_t *b, uint8_t *am, uint8_t *bm) {
     uint32_t *mask_a = (uint32_t *) am;
     uint32_t *mask_b = (uint32_t *) bm;
 
-    return (( (*mask_a&*a1)^(*mask_b&*b1) ) != 0);
+    return (((*a1 ^ *b1) & *mask_a & *mask_b) != 0);
 }
 
 static inline bool
@@ -743,7 +741,7 @@ incompatible_64(uint8_t *a, uint8_t *b, uint8_t *am, uint8_t *bm) {
     uint64_t *mask_a = (uint64_t *) am;
     uint64_t *mask_b = (uint64_t *) bm;
 
-    return (( (*mask_a&*a1) ^ (*mask_b&*b1) ) != 0);
+    return (((*a1 ^ *b1) & *mask_a & *mask_b) != 0);
 }
 
 static inline bool
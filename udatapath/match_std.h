@@ -34,6 +34,7 @@
 
 #include <stdbool.h>
 #include "oflib/ofl-structs.h"
+#include "packet_key.h"
 
 /****************************************************************************
  * Functions for comparing two extended match structures.
@@ -42,8 +43,9 @@
 bool
 match_std_overlap(struct ofl_match *a, struct ofl_match *b);
 
-bool 
-packet_match(struct ofl_match *a, struct ofl_match *b);
+/* Returns true if the packet key matches the flow match. */
+bool
+packet_match(struct ofl_match *flow_match, struct packet_key *packet);
 
 /* Returns true if match a matches match b, in a strict manner. */
 bool
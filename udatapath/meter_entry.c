@@ -36,6 +36,7 @@
 #include "meter_table.h"
 #include "dp_actions.h"
 #include "datapath.h"
+#include "rcu.h"
 #include "util.h"
 #include "oflib/ofl.h"
 #include "oflib/ofl-structs.h"
@@ -135,6 +136,7 @@ meter_entry_create(struct datapath *dp, struct meter_table *table, struct ofl_ms
     }
 
     list_init(&entry->flow_refs);
+    pthread_mutex_init(&entry->mutex, NULL);
 
     return entry;
 }
@@ -145,6 +147,20 @@ meter_entry_update(struct meter_entry *entry) {
     entry->stats->duration_nsec = ((time_msec() - entry->created) % 1000) * 1000000;
 }
 
+/* Frees a meter entry no packet may be going through any more. */
+static void
+free_entry(void *entry_) {
+    struct meter_entry *entry = entry_;
+
+    OFL_UTILS_FREE_ARR_FUN(entry->config->bands, entry->config->meter_bands_num, ofl_structs_free_meter_bands);
+    free(entry->config);
+
+    OFL_UTILS_FREE_ARR(entry->stats->band_stats, entry->stats->meter_bands_num);
+    free(entry->stats);
+    pthread_mutex_destroy(&entry->mutex);
+    free(entry);
+}
+
 void
 meter_entry_destroy(struct meter_entry *entry) {
     struct flow_ref_entry *ref, *next;
@@ -155,12 +171,7 @@ meter_entry_destroy(struct meter_entry *entry) {
         // Note: the flow_ref_entryf will be destroyed after a chain of calls in flow_entry_remove
     }
 
-    OFL_UTILS_FREE_ARR_FUN(entry->config->bands, entry->config->meter_bands_num, ofl_structs_free_meter_bands);
-    free(entry->config);
-
-    OFL_UTILS_FREE_ARR(entry->stats->band_stats, entry->stats->meter_bands_num);
-    free(entry->stats);
-    free(entry);
+    rcu_postpone(free_entry, entry);
 }
 
 static bool
@@ -212,10 +223,17 @@ meter_entry_apply(struct meter_entry *entry, struct packet **pkt){
 	size_t b;
 	bool drop = false;
 
+    pthread_mutex_lock(&entry->mutex);
     entry->stats->packet_in_count++;
     entry->stats->byte_in_count += (*pkt)->buffer->size;
 
 	b = choose_band(entry, *pkt);
+	if(b != -1){
+        entry->stats->band_stats[b]->byte_band_count += (*pkt)->buffer->size;
+        entry->stats->band_stats[b]->packet_band_count++;
+    }
+    pthread_mutex_unlock(&entry->mutex);
+
 	if(b != -1){
         struct ofl_meter_band_header *band_header = (struct ofl_meter_band_header*)  entry->config->bands[b];
         switch(band_header->type){
@@ -224,7 +242,7 @@ meter_entry_apply(struct meter_entry *entry, struct packet **pkt){
                 break;
             }
             case OFPMBT_DSCP_REMARK:{
-            	packet_handle_std_validate((*pkt)->handle_std);
+            	packet_handle_std_validate_depth((*pkt)->handle_std, PACKET_PARSE_L2);
     		if ((*pkt)->handle_std->valid)
     		{
                 struct ofl_meter_band_dscp_remark *band_header = (struct ofl_meter_band_dscp_remark *)  entry->config->bands[b];
@@ -246,6 +264,7 @@ meter_entry_apply(struct meter_entry *entry, struct packet **pkt){
                         uint16_t new_val = htons((ipv4->ip_ihl_ver << 8) + new_tos);
                         ipv4->ip_csum = recalc_csum16(ipv4->ip_csum, old_val, new_val);
                         ipv4->ip_tos = new_tos;
+                        (*pkt)->handle_std->key.ip_dscp = (new_tos & IP_DSCP_MASK) >> 2;
                     }
                 }
                 else if ((*pkt)->handle_std->proto->ipv6 != NULL){
@@ -255,10 +274,14 @@ meter_entry_apply(struct meter_entry *entry, struct packet **pkt){
                     if (((old_drop == 0x800000) && (band_header->prec_level <= 2)) || ((old_drop == 0x1000000) && (band_header->prec_level <= 1))){
                         uint32_t prec_level = band_header->prec_level << 23;
                         uint32_t new_drop = old_drop + prec_level;
-                        ipv6->ipv6_ver_tc_fl = htonl(new_drop | (ipv6_ver_tc_fl & 0xFE3FFFFF));
+                        ipv6_ver_tc_fl = new_drop | (ipv6_ver_tc_fl & 0xFE3FFFFF);
+                        ipv6->ipv6_ver_tc_fl = htonl(ipv6_ver_tc_fl);
+                        (*pkt)->handle_std->key.ip_dscp =
+                                (ipv6_ver_tc_fl & IPV6_DSCP_MASK) >> IPV6_DSCP_SHIFT;
                     }
                 }
-                (*pkt)->handle_std->valid = false;
+                /* Only the DSCP changed, the key is updated in place. If it
+                 * was not extracted yet, it will be read from the header. */
 		}
                 break;
             }
@@ -266,8 +289,6 @@ meter_entry_apply(struct meter_entry *entry, struct packet **pkt){
                 break;
             }
         }
-        entry->stats->band_stats[b]->byte_band_count += (*pkt)->buffer->size;
-        entry->stats->band_stats[b]->packet_band_count++;
         if (drop){
             VLOG_DBG_RL(LOG_MODULE, &rl, "Dropping packet: rate %d", band_header->rate);
             packet_destroy(*pkt);
@@ -321,6 +342,7 @@ refill_bucket(struct meter_entry *entry)
     long long int now = time_msec();
     size_t i;
 
+    pthread_mutex_lock(&entry->mutex);
     for(i = 0; i < entry->config->meter_bands_num; i++) {
         uint32_t rate;
         uint32_t burst_size;
@@ -351,5 +373,6 @@ refill_bucket(struct meter_entry *entry)
             }
         }
    	}
+    pthread_mutex_unlock(&entry->mutex);
 }
 
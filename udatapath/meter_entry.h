@@ -32,6 +32,7 @@
 #ifndef METER_ENTRY_H
 #define METER_ENTRY_H 1
 
+#include <pthread.h>
 #include <stdbool.h>
 #include "hmap.h"
 #include "list.h"
@@ -66,6 +67,9 @@ struct meter_entry {
     uint64_t                    created;  /* time the entry was created at. */
     	
 	struct list                 flow_refs;		/* references to flows referencing the meter. */
+    pthread_mutex_t             mutex;    /* guards the counters and tokens of
+                                             stats, which the packets of all
+                                             threads update. */
 
 };
 
@@ -77,7 +81,9 @@ meter_entry_create(struct datapath *dp, struct meter_table *table, struct ofl_ms
 void
 meter_entry_update(struct meter_entry *entry);
 
-/* Destroys a meter entry. */
+/* Destroys a meter entry, removed from its table already, and the flow
+ * entries referencing it. The entry is freed once no packet may still be
+ * going through it. */
 void
 meter_entry_destroy(struct meter_entry *entry);
 
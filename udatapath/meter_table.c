@@ -37,6 +37,8 @@
 #include "hmap.h"
 #include "list.h"
 #include "packet.h"
+#include "pipeline.h"
+#include "rcu.h"
 #include "util.h"
 #include "openflow/openflow.h"
 #include "oflib/ofl.h"
@@ -56,6 +58,7 @@ meter_table_create(struct datapath *dp) {
     table->dp = dp;
     table->entries_num = 0;
     hmap_init(&table->meter_entries);
+    table->snapshot = xcalloc(1, sizeof(struct meter_table_snapshot));
  
 	table->features = xmalloc(sizeof(struct ofl_meter_features));
 	table->features->max_meter = DEFAULT_MAX_METER;
@@ -75,6 +78,8 @@ meter_table_destroy(struct meter_table *table) {
     HMAP_FOR_EACH_SAFE(entry, next, struct meter_entry, node, &table->meter_entries) {
         meter_entry_destroy(entry);
     }
+    hmap_destroy(&table->meter_entries);
+    free(table->snapshot);
     ///////////////////////////free features
     free(table);
 }
@@ -93,13 +98,62 @@ meter_table_find(struct meter_table *table, uint32_t meter_id) {
     return CONTAINER_OF(hnode, struct meter_entry, node);
 }
 
+static int
+compare_slots(const void *a_, const void *b_) {
+    const struct meter_table_slot *a = a_;
+    const struct meter_table_slot *b = b_;
 
+    return a->meter_id < b->meter_id ? -1 : a->meter_id > b->meter_id;
+}
+
+/* Publishes a snapshot of the meters in the table; the previous one is
+ * freed once no packet may be looking it up. Must be called before the
+ * entries removed from the table are destroyed. */
+static void
+publish_snapshot(struct meter_table *table) {
+    struct meter_table_snapshot *old = table->snapshot;
+    struct meter_table_snapshot *snapshot;
+    struct meter_entry *entry;
+
+    snapshot = xmalloc(sizeof(struct meter_table_snapshot) +
+                       hmap_count(&table->meter_entries) * sizeof(struct meter_table_slot));
+    snapshot->entries_num = 0;
+    HMAP_FOR_EACH(entry, struct meter_entry, node, &table->meter_entries) {
+        struct meter_table_slot *slot = &snapshot->entries[snapshot->entries_num++];
+
+        slot->meter_id = entry->stats->meter_id;
+        slot->entry = entry;
+    }
+    qsort(snapshot->entries, snapshot->entries_num,
+          sizeof(struct meter_table_slot), compare_slots);
+
+    rcu_set(table->snapshot, snapshot);
+    rcu_postpone(free, old);
+}
+
+/* Returns the meter with the given ID in a snapshot. */
+static struct meter_entry *
+snapshot_find(const struct meter_table_snapshot *snapshot, uint32_t meter_id) {
+    size_t low = 0, high = snapshot->entries_num;
+
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+
+        if (snapshot->entries[mid].meter_id < meter_id) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low < snapshot->entries_num && snapshot->entries[low].meter_id == meter_id
+           ? snapshot->entries[low].entry : NULL;
+}
 
 void
 meter_table_apply(struct meter_table *table, struct packet **packet, uint32_t meter_id) {
     struct meter_entry *entry;
 
-    entry = meter_table_find(table, meter_id);
+    entry = snapshot_find(rcu_get(table->snapshot), meter_id);
 
     if (entry == NULL) {
         VLOG_WARN_RL(LOG_MODULE, &rl, "Trying to execute non-existing meter (%u).", meter_id);
@@ -131,6 +185,7 @@ meter_table_add(struct meter_table *table, struct ofl_msg_meter_mod *mod) {
     entry = meter_entry_create(table->dp, table, mod);
 
     hmap_insert(&table->meter_entries, &entry->node, entry->stats->meter_id);
+    publish_snapshot(table);
 
     table->entries_num++;
     table->bands_num += entry->stats->meter_bands_num;
@@ -156,6 +211,7 @@ meter_table_modify(struct meter_table *table, struct ofl_msg_meter_mod *mod) {
 
     hmap_remove(&table->meter_entries, &entry->node);
     hmap_insert_fast(&table->meter_entries, &new_entry->node, mod->meter_id);
+    publish_snapshot(table);
 
     table->bands_num = table->bands_num - entry->config->meter_bands_num + new_entry->stats->meter_bands_num;
 
@@ -172,13 +228,16 @@ meter_table_modify(struct meter_table *table, struct ofl_msg_meter_mod *mod) {
 static ofl_err
 meter_table_delete(struct meter_table *table, struct ofl_msg_meter_mod *mod) {
     if (mod->meter_id == OFPM_ALL) {
+        struct hmap entries;
         struct meter_entry *entry, *next;
 
-        HMAP_FOR_EACH_SAFE(entry, next, struct meter_entry, node, &table->meter_entries) {
+        hmap_init(&entries);
+        hmap_swap(&entries, &table->meter_entries);
+        publish_snapshot(table);
+        HMAP_FOR_EACH_SAFE(entry, next, struct meter_entry, node, &entries) {
             meter_entry_destroy(entry);
         }
-        hmap_destroy(&table->meter_entries);
-        hmap_init(&table->meter_entries);
+        hmap_destroy(&entries);
 
         table->entries_num = 0;
         table->bands_num = 0;
@@ -196,6 +255,7 @@ meter_table_delete(struct meter_table *table, struct ofl_msg_meter_mod *mod) {
             table->bands_num -= entry->stats->meter_bands_num;
 
             hmap_remove(&table->meter_entries, &entry->node);
+            publish_snapshot(table);
             meter_entry_destroy(entry);
         }
         ofl_msg_free_meter_mod(mod, false);
@@ -209,6 +269,8 @@ meter_table_handle_meter_mod(struct meter_table *table, struct ofl_msg_meter_mod
     if(sender->remote->role == OFPCR_ROLE_SLAVE)
         return ofl_error(OFPET_BAD_REQUEST, OFPBRC_IS_SLAVE);
 
+    pipeline_invalidate_cache(table->dp->pipeline);
+
     switch (mod->command) {
         case (OFPMC_ADD): {
             return meter_table_add(table, mod);
@@ -50,6 +50,19 @@
  * Implementation of meter table.
  ****************************************************************************/
 
+/* A meter in a snapshot. */
+struct meter_table_slot {
+    uint32_t            meter_id;
+    struct meter_entry *entry;
+};
+
+/* The meters packets go through, sorted by ID. Meter mods replace the whole
+ * snapshot, so packets never see the table in the middle of a change. */
+struct meter_table_snapshot {
+    size_t                  entries_num;
+    struct meter_table_slot entries[];
+};
+
 /* Meter table */
 struct meter_table {
   struct datapath		*dp;				/* The datapath */
@@ -57,6 +70,7 @@ struct meter_table {
 	size_t				 entries_num;		/* The number of meters */
   struct hmap			meter_entries;	    /* Meter entries */
 	size_t              bands_num;
+	struct meter_table_snapshot *snapshot;	/* read through rcu_get(). */
 
 };
 
@@ -28,6 +28,7 @@
  *
  */
 
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
@@ -37,68 +38,242 @@
 #include "packet.h"
 #include "packets.h"
 #include "action_set.h"
+#include "list.h"
 #include "ofpbuf.h"
+#include "packet_handle_std.h"
 #include "oflib/ofl-structs.h"
 #include "oflib/ofl-print.h"
+#include "oflib-exp/ofl-exp-openflow.h"
+#include "openflow/openflow-ext.h"
 #include "util.h"
 
+/* Packet objects a pool allocates at once. */
+#define POOL_SLAB_SIZE 256
 
-struct packet *
-packet_create(struct datapath *dp, uint32_t in_port,
-    struct ofpbuf *buf, bool packet_out) {
-    struct packet *pkt;
+/* A packet with everything it owns. The handler comes first, so that the
+ * packet key is aligned to a cache line like the objects. */
+struct packet_obj {
+    struct packet_handle_std  handle;
+    struct packet             pkt;
+    struct protocols_std      proto;
+    struct action_set         action_set;
+    struct ofpbuf             buffer;  /* data kept while in the pool. */
+    struct packet_pool       *pool;    /* pool of the object. */
+    struct packet_obj        *next;    /* in a free list of the pool. */
+};
 
-    pkt = xmalloc(sizeof(struct packet));
+struct packet_pool {
+    struct list         node;           /* in 'pools'. */
+    char                name[16];
+    struct packet_obj  *free;           /* used by the owner thread only. */
+    struct packet_obj  *remote;         /* freed by other threads. */
+    uint32_t            n_remote;       /* objects in 'remote'. */
+    uint32_t            size;           /* objects allocated. */
+    uint32_t            n_free;         /* objects in 'free'. */
+    uint32_t            high_water;     /* most objects in use at once. */
+    uint64_t            packets;        /* packets created. */
+};
 
-    pkt->dp         = dp;
-    pkt->buffer     = buf;
-    pkt->in_port    = in_port;
-    pkt->action_set = action_set_create(dp->exp);
+/* All the pools, which live as long as the process. */
+static struct list pools = LIST_INITIALIZER(&pools);
+static pthread_mutex_t pools_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static __thread struct packet_pool *pool;
+static __thread char pool_name[16] = "main";
+
+void
+packet_pool_set_name(const char *name) {
+    strlcpy(pool_name, name, sizeof pool_name);
+    if (pool != NULL) {
+        memcpy(pool->name, pool_name, sizeof pool->name);
+    }
+}
+
+/* Adds a slab of free objects to the pool. */
+static void
+pool_grow(struct packet_pool *p) {
+    struct packet_obj *slab;
+    void *mem;
+    size_t i;
+
+    if (posix_memalign(&mem, CACHE_LINE_SIZE, POOL_SLAB_SIZE * sizeof *slab)) {
+        out_of_memory();
+    }
+    slab = mem;
+    for (i = 0; i < POOL_SLAB_SIZE; i++) {
+        struct packet_obj *obj = &slab[i];
+
+        ofl_structs_match_init(&obj->handle.match);
+        ofpbuf_use(&obj->buffer, NULL, 0);
+        obj->pool = p;
+        obj->next = p->free;
+        p->free = obj;
+    }
+    p->size += POOL_SLAB_SIZE;
+    p->n_free += POOL_SLAB_SIZE;
+}
 
-    pkt->packet_out       = packet_out;
+static struct packet_pool *
+pool_create(void) {
+    struct packet_pool *p = xcalloc(1, sizeof *p);
+
+    memcpy(p->name, pool_name, sizeof p->name);
+    pool_grow(p);
+
+    pthread_mutex_lock(&pools_mutex);
+    list_push_back(&pools, &p->node);
+    pthread_mutex_unlock(&pools_mutex);
+    return p;
+}
+
+/* Takes a free object out of the pool of the calling thread, with an empty
+ * action set and its own buffer as the packet's. */
+static struct packet *
+pool_get(struct datapath *dp) {
+    struct packet_obj *obj;
+    struct packet *pkt;
+    uint32_t in_use, n;
+
+    if (pool == NULL) {
+        pool = pool_create();
+    }
+    if (pool->free == NULL) {
+        /* Take back the objects other threads freed, or grow. */
+        pool->free = __atomic_exchange_n(&pool->remote, NULL, __ATOMIC_ACQUIRE);
+        n = 0;
+        for (obj = pool->free; obj != NULL; obj = obj->next) {
+            n++;
+        }
+        __atomic_sub_fetch(&pool->n_remote, n, __ATOMIC_RELAXED);
+        pool->n_free += n;
+        if (pool->free == NULL) {
+            pool_grow(pool);
+        }
+    }
+    obj = pool->free;
+    pool->free = obj->next;
+    pool->n_free--;
+    pool->packets++;
+    in_use = pool->size - pool->n_free
+             - __atomic_load_n(&pool->n_remote, __ATOMIC_RELAXED);
+    if (in_use > pool->high_water) {
+        pool->high_water = in_use;
+    }
+
+    pkt = &obj->pkt;
+    pkt->dp               = dp;
+    pkt->buffer           = &obj->buffer;
+    pkt->in_port          = 0;
+    pkt->action_set       = &obj->action_set;
+    pkt->packet_out       = false;
     pkt->out_group        = OFPG_ANY;
     pkt->out_port         = OFPP_ANY;
     pkt->out_port_max_len = 0;
     pkt->out_queue        = 0;
     pkt->buffer_id        = NO_BUFFER;
     pkt->table_id         = 0;
+    pkt->handle_std       = &obj->handle;
+    action_set_init(pkt->action_set, dp->exp);
+    return pkt;
+}
+
+/* Returns the object of the packet to its pool. */
+static void
+pool_put(struct packet *pkt) {
+    struct packet_obj *obj = CONTAINER_OF(pkt, struct packet_obj, pkt);
+    struct packet_pool *p = obj->pool;
 
-    pkt->handle_std = packet_handle_std_create(pkt);
+    if (p == pool) {
+        obj->next = p->free;
+        p->free = obj;
+        p->n_free++;
+    } else {
+        /* Counted first, so that the owner never takes back more objects
+         * than counted. */
+        __atomic_add_fetch(&p->n_remote, 1, __ATOMIC_RELAXED);
+        obj->next = __atomic_load_n(&p->remote, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&p->remote, &obj->next, obj, true,
+                                            __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            continue;
+        }
+    }
+}
+
+/* Empties the buffer of the object, making room for size bytes after
+ * headroom bytes. */
+static void
+obj_buffer_reset(struct packet *pkt, size_t size, size_t headroom) {
+    struct ofpbuf *b = &CONTAINER_OF(pkt, struct packet_obj, pkt)->buffer;
+
+    if (b->allocated < headroom + size) {
+        ofpbuf_uninit(b);
+        ofpbuf_init(b, headroom + size);
+    } else {
+        ofpbuf_use(b, b->base, b->allocated);
+    }
+    ofpbuf_reserve(b, headroom);
+}
+
+struct packet *
+packet_create(struct datapath *dp, uint32_t in_port,
+    struct ofpbuf *buf, bool packet_out) {
+    struct packet *pkt = pool_get(dp);
+
+    pkt->buffer     = buf;
+    pkt->in_port    = in_port;
+    pkt->packet_out = packet_out;
+
+    packet_handle_std_init(pkt->handle_std,
+                           &CONTAINER_OF(pkt, struct packet_obj, pkt)->proto,
+                           pkt);
     return pkt;
 }
 
+struct packet *
+packet_alloc(struct datapath *dp, size_t size, size_t headroom) {
+    struct packet *pkt = pool_get(dp);
+
+    obj_buffer_reset(pkt, size, headroom);
+    return pkt;
+}
+
+void
+packet_received(struct packet *pkt, uint32_t in_port) {
+    pkt->in_port = in_port;
+    packet_handle_std_init(pkt->handle_std,
+                           &CONTAINER_OF(pkt, struct packet_obj, pkt)->proto,
+                           pkt);
+}
+
 struct packet *
 packet_clone(struct packet *pkt) {
-    struct packet *clone;
+    struct packet *clone = pool_get(pkt->dp);
 
-    clone = xmalloc(sizeof(struct packet));
-    clone->dp         = pkt->dp;
-    clone->buffer     = ofpbuf_clone(pkt->buffer);
+    obj_buffer_reset(clone, pkt->buffer->size, 0);
+    ofpbuf_put(clone->buffer, pkt->buffer->data, pkt->buffer->size);
     clone->in_port    = pkt->in_port;
     /* There is no case we need to keep the action-set, but if it's needed
      * we could add a parameter to the function... Jean II
      * clone->action_set = action_set_clone(pkt->action_set);
      */
-    clone->action_set = action_set_create(pkt->dp->exp);
-
 
     clone->packet_out       = pkt->packet_out;
-    clone->out_group        = OFPG_ANY;
-    clone->out_port         = OFPP_ANY;
-    clone->out_port_max_len = 0;
-    clone->out_queue        = 0;
     clone->buffer_id        = NO_BUFFER; // the original is saved in buffer,
                                          // but this buffer is a copy of that,
                                          // and might be altered later
     clone->table_id         = pkt->table_id;
 
-    clone->handle_std = packet_handle_std_clone(clone, pkt->handle_std);
+    packet_handle_std_init_clone(clone->handle_std,
+                                 &CONTAINER_OF(clone, struct packet_obj, pkt)->proto,
+                                 clone, pkt->handle_std);
 
     return clone;
 }
 
 void
 packet_destroy(struct packet *pkt) {
+    struct packet_obj *obj = CONTAINER_OF(pkt, struct packet_obj, pkt);
+
     /* If packet is saved in a buffer, do not destroy it,
      * if buffer is still valid */
      
@@ -110,10 +285,52 @@ packet_destroy(struct packet *pkt) {
         }
     }
 
-    action_set_destroy(pkt->action_set);
-    ofpbuf_delete(pkt->buffer);
-    packet_handle_std_destroy(pkt->handle_std);
-    free(pkt);
+    action_set_uninit(pkt->action_set);
+    if (pkt->buffer != &obj->buffer) {
+        /* Given to packet_create. */
+        ofpbuf_delete(pkt->buffer);
+    }
+    packet_handle_std_uninit(pkt->handle_std);
+    pool_put(pkt);
+}
+
+ofl_err
+packet_pool_handle_stats_request(struct datapath *dp,
+                                 struct ofl_exp_openflow_msg_header *msg,
+                                 const struct sender *sender) {
+    struct ofl_exp_openflow_packet_pool *stats;
+    struct packet_pool *p;
+    size_t n = 0;
+
+    pthread_mutex_lock(&pools_mutex);
+    stats = xmalloc(list_size(&pools) * sizeof *stats);
+    LIST_FOR_EACH (p, struct packet_pool, node, &pools) {
+        struct ofl_exp_openflow_packet_pool *s = &stats[n++];
+
+        memcpy(s->name, p->name, sizeof s->name);
+        s->name[sizeof s->name - 1] = '\0';
+        s->size       = __atomic_load_n(&p->size, __ATOMIC_RELAXED);
+        s->free       = __atomic_load_n(&p->n_free, __ATOMIC_RELAXED)
+                        + __atomic_load_n(&p->n_remote, __ATOMIC_RELAXED);
+        s->high_water = __atomic_load_n(&p->high_water, __ATOMIC_RELAXED);
+        s->packets    = __atomic_load_n(&p->packets, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&pools_mutex);
+
+    {
+        struct ofl_exp_openflow_msg_packet_pool_stats reply =
+                {{{{.type = OFPT_EXPERIMENTER},
+                   .experimenter_id = OPENFLOW_VENDOR_ID},
+                  .type = OFP_EXT_PACKET_POOL_STATS_REPLY},
+                 .pools_num = n,
+                 .pools     = stats};
+
+        dp_send_message(dp, (struct ofl_msg_header *)&reply, sender);
+    }
+
+    free(stats);
+    ofl_msg_free((struct ofl_msg_header *)msg, dp->exp);
+    return 0;
 }
 
 char *
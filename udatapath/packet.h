@@ -41,10 +41,19 @@
 #include "oflib/ofl-structs.h"
 #include "packets.h"
 
+struct ofl_exp_openflow_msg_header;
+struct sender;
 
 /****************************************************************************
  * Represents a packet received on the datapath, and its associated processing
  * state.
+ *
+ * A packet, its action set, its handler with the header pointers, and its
+ * buffer are allocated together as one object, out of a pool of the thread
+ * creating it. The pool keeps the objects it ever allocated, the buffer data
+ * included: packet_destroy returns them to the free list of their pool,
+ * through a lock-free list if called from another thread, so packets only
+ * reach malloc while the number of packets in flight grows.
  ****************************************************************************/
 
 
@@ -66,10 +75,20 @@ struct packet {
     struct packet_handle_std  *handle_std; /* handler for standard match structure */
 };
 
-/* Creates a packet. */
+/* Creates a packet. The packet takes the ownership of buf. */
 struct packet *
 packet_create(struct datapath *dp, uint32_t in_port, struct ofpbuf *buf, bool packet_out);
 
+/* Returns a packet whose empty buffer has room for size bytes, after
+ * headroom bytes of headroom, to receive a packet into. Once the data is in
+ * the buffer, packet_received makes it a packet received on in_port; until
+ * then it may only be destroyed. */
+struct packet *
+packet_alloc(struct datapath *dp, size_t size, size_t headroom);
+
+void
+packet_received(struct packet *pkt, uint32_t in_port);
+
 /* Converts the packet to a string representation. */
 char *
 packet_to_string(struct packet *pkt);
@@ -82,4 +101,15 @@ packet_destroy(struct packet *pkt);
 struct packet *
 packet_clone(struct packet *pkt);
 
+/* Names the packet pool of the calling thread in the pool statistics. The
+ * pools of threads which do not name them are called "main". */
+void
+packet_pool_set_name(const char *name);
+
+/* Handles a packet pool stats request. */
+ofl_err
+packet_pool_handle_stats_request(struct datapath *dp,
+                                 struct ofl_exp_openflow_msg_header *msg,
+                                 const struct sender *sender);
+
 #endif /* PACKET_H */
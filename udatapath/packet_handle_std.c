@@ -28,109 +28,245 @@
  *
  */
 
+#include <config.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <sys/types.h>
 #include <netinet/in.h>
 #include "packet_handle_std.h"
+#include "datapath.h"
+#include "pipeline.h"
 #include "packet.h"
 #include "packets.h"
 #include "oflib/ofl-structs.h"
 #include "openflow/openflow.h"
 #include "compiler.h"
+#include "util.h"
 
 #include "lib/hash.h"
 #include "oflib/oxm-match.h"
 
+#include "packet_parser.h"
+#if !defined(NATIVE_PARSER)
 #include "nbee_link/nbee_link.h"
+#endif
 
-/* Resets all protocol fields to NULL */
+/* Frees the TLVs of the match, leaving it empty. */
+static void
+match_clear(struct ofl_match *match) {
+    struct ofl_match_tlv *iter, *next;
+
+    HMAP_FOR_EACH_SAFE(iter, next, struct ofl_match_tlv, hmap_node, &match->match_fields){
+        free(iter->value);
+        free(iter);
+    }
+    hmap_destroy(&match->match_fields);
+    ofl_structs_match_init(match);
+}
 
 void
-packet_handle_std_validate(struct packet_handle_std *handle) {
-    struct ofl_match_tlv * iter, *next, *f;
-    uint64_t metadata = 0;
-    uint64_t tunnel_id = 0;
-    if(handle->valid)
+packet_handle_std_validate_depth(struct packet_handle_std *handle,
+                                 enum packet_parse_depth depth) {
+    if(handle->valid && handle->depth >= depth)
         return;
-    
-    HMAP_FOR_EACH_WITH_HASH(f, struct ofl_match_tlv,
-                    hmap_node, hash_int(OXM_OF_METADATA,0), &handle->match.match_fields){
-                    metadata = *((uint64_t*) f->value);
-    }
 
-    HMAP_FOR_EACH_WITH_HASH(f, struct ofl_match_tlv,
-                    hmap_node, hash_int(OXM_OF_TUNNEL_ID,0), &handle->match.match_fields){
-            tunnel_id = *((uint64_t*) f->value);
+    handle->valid = false;
+#if defined(NATIVE_PARSER)
+    /* Parse as deep as any table needs, so that the lookups further down the
+     * pipeline do not have to parse the packet again. */
+    if (depth < handle->pkt->dp->pipeline->parse_depth) {
+        depth = handle->pkt->dp->pipeline->parse_depth;
+    }
+    if (packet_parse(handle->pkt->buffer, &handle->key,
+                     handle->proto, depth) < 0)
+        return;
+#if defined(PARSER_CROSSCHECK)
+    if (depth == PACKET_PARSE_ALL) {
+        packet_parse_crosscheck(handle->pkt->buffer, &handle->key,
+                                handle->proto);
     }
+#endif
+#else
+    depth = PACKET_PARSE_ALL;
+    {
+        struct ofl_match match;
+
+        ofl_structs_match_init(&match);
+        if (nblink_packet_parse(handle->pkt->buffer, &match,
+                                handle->proto) < 0) {
+            match_clear(&match);
+            return;
+        }
+        packet_key_from_match(&handle->key, &match);
+        match_clear(&match);
+    }
+#endif
 
-    HMAP_FOR_EACH_SAFE(iter, next, struct ofl_match_tlv, hmap_node, &handle->match.match_fields){
-        free(iter->value);
-        free(iter);
+    handle->valid = true;
+    handle->depth = depth;
+
+    /* Add in_port value to the key */
+    PACKET_KEY_SET(&handle->key, IN_PORT, in_port, handle->pkt->in_port);
+    /* Metadata and tunnel_id are not packet fields: their values are kept
+     * across revalidation. */
+    handle->key.present |= PACKET_KEY_BIT(OFPXMT_OFB_METADATA)
+                         | PACKET_KEY_BIT(OFPXMT_OFB_TUNNEL_ID);
+    return;
+}
+
+void
+packet_handle_std_validate(struct packet_handle_std *handle) {
+    packet_handle_std_validate_depth(handle, PACKET_PARSE_ALL);
+}
+
+/* Returns where a header at old_data + offset of the packet data is after
+ * the headers moved as described by packet_handle_std_headers_moved. */
+static void *
+rebase_header(void *header, uint8_t *old_data, uint8_t *new_data,
+              size_t offset, int len) {
+    size_t pos;
+
+    if (header == NULL) {
+        return NULL;
+    }
+    pos = (uint8_t *)header - old_data;
+    if (pos < offset) {
+        return new_data + pos;
     }
-    ofl_structs_match_init(&handle->match);
+    if (len < 0 && pos < offset - len) {
+        /* The header itself was removed. */
+        return NULL;
+    }
+    return new_data + pos + len;
+}
 
-    if (nblink_packet_parse(handle->pkt->buffer,&handle->match,
-                            handle->proto) < 0)
+void
+packet_handle_std_headers_moved(struct packet_handle_std *handle,
+                                uint8_t *old_data, size_t offset, int len,
+                                bool network) {
+    struct protocols_std *proto = handle->proto;
+    uint8_t *new_data = handle->pkt->buffer->data;
+    uint16_t network_type;
+    size_t network_offset;
+
+    if (!handle->valid) {
         return;
+    }
+#if !defined(NATIVE_PARSER)
+    /* NetBee decodes the headers differently, parse the packet again. */
+    handle->valid = false;
+    return;
+#endif
+
+    proto->mpls = rebase_header(proto->mpls, old_data, new_data, offset, len);
+    proto->ipv4 = rebase_header(proto->ipv4, old_data, new_data, offset, len);
+    proto->ipv6 = rebase_header(proto->ipv6, old_data, new_data, offset, len);
+    proto->arp  = rebase_header(proto->arp,  old_data, new_data, offset, len);
+    proto->tcp  = rebase_header(proto->tcp,  old_data, new_data, offset, len);
+    proto->udp  = rebase_header(proto->udp,  old_data, new_data, offset, len);
+    proto->sctp = rebase_header(proto->sctp, old_data, new_data, offset, len);
+    proto->icmp = rebase_header(proto->icmp, old_data, new_data, offset, len);
+
+    network_offset = packet_parse_l2(handle->pkt->buffer, &handle->key, proto,
+                                     &network_type);
+    if (proto->eth == NULL) {
+        handle->valid = false;
+        return;
+    }
+    /* A network header that was not decoded before, e.g. one behind a
+     * second PBB header, may be decodable now. */
+    if (network || (proto->mpls == NULL && proto->ipv4 == NULL &&
+                    proto->ipv6 == NULL && proto->arp == NULL)) {
+        packet_parse_l3(handle->pkt->buffer, network_offset, network_type,
+                        &handle->key, proto, handle->depth);
+    }
+}
 
-    handle->valid = true;
+struct ofl_match *
+packet_handle_std_get_match(struct packet_handle_std *handle) {
+    packet_handle_std_validate(handle);
 
-    /* Add in_port value to the hash_map */
-    ofl_structs_match_put32(&handle->match, OXM_OF_IN_PORT, handle->pkt->in_port);
-    /*Add metadata  and tunnel_id value to the hash_map */
-    ofl_structs_match_put64(&handle->match,  OXM_OF_METADATA, metadata);
-    ofl_structs_match_put64(&handle->match,  OXM_OF_TUNNEL_ID, tunnel_id);
-    return;
+    match_clear(&handle->match);
+    packet_key_to_match(&handle->key, &handle->match);
+    return &handle->match;
 }
 
 
-struct packet_handle_std *
-packet_handle_std_create(struct packet *pkt) {
-	struct packet_handle_std *handle = xmalloc(sizeof(struct packet_handle_std));
-	handle->proto = xmalloc(sizeof(struct protocols_std));
+void
+packet_handle_std_init(struct packet_handle_std *handle,
+                       struct protocols_std *proto, struct packet *pkt) {
+	handle->proto = proto;
 	handle->pkt = pkt;
 
-	hmap_init(&handle->match.match_fields);
+	ofl_structs_match_init(&handle->match);
+	packet_key_init(&handle->key);
+	handle->key.metadata = 0;
+	handle->key.tunnel_id = 0;
 
 	handle->valid = false;
-	packet_handle_std_validate(handle);
-
-	return handle;
+	handle->table_miss = false;
+	packet_handle_std_validate_depth(handle, PACKET_PARSE_L2);
 }
 
-struct packet_handle_std *
-packet_handle_std_clone(struct packet *pkt, struct packet_handle_std *handle UNUSED) {
-    struct packet_handle_std *clone = xmalloc(sizeof(struct packet_handle_std));
+/* Returns where a header of the packet is in a copy of its data. */
+static inline void *
+clone_header(void *header, uint8_t *old_data, uint8_t *new_data) {
+    return header == NULL ? NULL : new_data + ((uint8_t *)header - old_data);
+}
 
+void
+packet_handle_std_init_clone(struct packet_handle_std *clone,
+                             struct protocols_std *proto, struct packet *pkt,
+                             struct packet_handle_std *handle) {
     clone->pkt = pkt;
-    clone->proto = xmalloc(sizeof(struct protocols_std));
-    hmap_init(&clone->match.match_fields);
-    clone->valid = false;
-    // TODO Zoltan: if handle->valid, then match could be memcpy'd, and protocol
-    //              could be offset
-    packet_handle_std_validate(clone);
+    clone->proto = proto;
+    ofl_structs_match_init(&clone->match);
+    clone->table_miss = false;
+
+    if (handle->valid && pkt->buffer->size == handle->pkt->buffer->size) {
+        /* The packet data is a copy of the original one, so the parsed
+         * state can be copied too, with the header pointers rebased onto the
+         * new data. */
+        struct protocols_std *p = handle->proto;
+        uint8_t *old_data = handle->pkt->buffer->data;
+        uint8_t *new_data = pkt->buffer->data;
+
+        clone->key = handle->key;
+        clone->proto->eth       = clone_header(p->eth,       old_data, new_data);
+        clone->proto->eth_snap  = clone_header(p->eth_snap,  old_data, new_data);
+        clone->proto->vlan      = clone_header(p->vlan,      old_data, new_data);
+        clone->proto->vlan_last = clone_header(p->vlan_last, old_data, new_data);
+        clone->proto->mpls      = clone_header(p->mpls,      old_data, new_data);
+        clone->proto->pbb       = clone_header(p->pbb,       old_data, new_data);
+        clone->proto->ipv4      = clone_header(p->ipv4,      old_data, new_data);
+        clone->proto->ipv6      = clone_header(p->ipv6,      old_data, new_data);
+        clone->proto->arp       = clone_header(p->arp,       old_data, new_data);
+        clone->proto->tcp       = clone_header(p->tcp,       old_data, new_data);
+        clone->proto->udp       = clone_header(p->udp,       old_data, new_data);
+        clone->proto->sctp      = clone_header(p->sctp,      old_data, new_data);
+        clone->proto->icmp      = clone_header(p->icmp,      old_data, new_data);
+        clone->depth = handle->depth;
+        clone->valid = true;
+        return;
+    }
 
-    return clone;
+    packet_key_init(&clone->key);
+    clone->key.metadata = handle->key.metadata;
+    clone->key.tunnel_id = handle->key.tunnel_id;
+    clone->valid = false;
+    packet_handle_std_validate_depth(clone, PACKET_PARSE_L2);
 }
 
 void
-packet_handle_std_destroy(struct packet_handle_std *handle) {
-
-    struct ofl_match_tlv * iter, *next;
-    HMAP_FOR_EACH_SAFE(iter, next, struct ofl_match_tlv, hmap_node, &handle->match.match_fields){
-        free(iter->value);
-        free(iter);
-    }
-    free(handle->proto);
-    hmap_destroy(&handle->match.match_fields);
-    free(handle);
+packet_handle_std_uninit(struct packet_handle_std *handle) {
+    match_clear(&handle->match);
 }
 
 bool
 packet_handle_std_is_ttl_valid(struct packet_handle_std *handle) {
-    packet_handle_std_validate(handle);
+    /* The network headers are located even at the lowest depth. */
+    packet_handle_std_validate_depth(handle, PACKET_PARSE_L2);
 
     if (handle->proto->mpls != NULL) {
         uint32_t ttl = ntohl(handle->proto->mpls->fields) & MPLS_TTL_MASK;
@@ -158,15 +294,24 @@ packet_handle_std_is_fragment(struct packet_handle_std *handle) {
 
 bool
 packet_handle_std_match(struct packet_handle_std *handle, struct ofl_match *match){
+    struct ofl_match_tlv *f;
+    uint64_t fields = 0;
 
-    if (!handle->valid){
-        packet_handle_std_validate(handle);
-        if (!handle->valid){
-            return false;
+    /* Parse as deep as the fields of the match need. */
+    HMAP_FOR_EACH(f, struct ofl_match_tlv, hmap_node, &match->match_fields) {
+        uint8_t field = OXM_FIELD(f->header);
+
+        if (OXM_VENDOR(f->header) == OFPXMC_OPENFLOW_BASIC &&
+            field < PACKET_KEY_FIELDS) {
+            fields |= PACKET_KEY_BIT(field);
         }
     }
+    packet_handle_std_validate_depth(handle, packet_parse_depth(fields));
+    if (!handle->valid){
+        return false;
+    }
 
-    return packet_match(match ,&handle->match );
+    return packet_match(match, &handle->key);
 }
 
 
@@ -207,7 +352,8 @@ packet_handle_std_print(FILE *stream, struct packet_handle_std *handle) {
     proto_print(stream, handle->proto);
 
     fprintf(stream, ", match=");
-    ofl_structs_match_print(stream, (struct ofl_match_header *)(&handle->match), handle->pkt->dp->exp);
+    ofl_structs_match_print(stream, (struct ofl_match_header *)packet_handle_std_get_match(handle),
+                            handle->pkt->dp->exp);
     fprintf(stream, "\"}");
 }
 
@@ -37,7 +37,8 @@
 #include "packets.h"
 #include "match_std.h"
 #include "oflib/ofl-structs.h"
-#include "nbee_link/nbee_link.h"
+#include "packet_key.h"
+#include "packet_parser.h"
 
 /****************************************************************************
  * A handler processing a datapath packet for standard matches.
@@ -45,25 +46,29 @@
 
 /* The data associated with the handler */
 struct packet_handle_std {
+   struct packet_key           key;   /* Match fields extracted from the packet */
    struct packet              *pkt;
    struct protocols_std       *proto;
-   struct ofl_match  match;  /* Match fields extracted from the packet
-                                           are also stored in a match structure
-                                           for convenience */
+   struct ofl_match            match; /* TLV form of the key, only built by
+                                           packet_handle_std_get_match */
    bool                        valid; /* Set to true if the handler data is valid.
                                            if false, it is revalidated before
                                            executing any methods. */
+   enum packet_parse_depth     depth; /* Depth the packet was parsed to, if
+                                           valid. */
    bool						   table_miss; /*Packet was matched
    											against table miss flow*/
 };
 
-/* Creates a handler */
-struct packet_handle_std *
-packet_handle_std_create(struct packet *pkt);
+/* Initializes a handler of the packet in memory owned by the caller, e.g. as
+ * part of the packet, with proto holding the header pointers. */
+void
+packet_handle_std_init(struct packet_handle_std *handle,
+                       struct protocols_std *proto, struct packet *pkt);
 
-/* Destroys a handler */
+/* Frees what the handler allocated, leaving it in its owner's memory. */
 void
-packet_handle_std_destroy(struct packet_handle_std *handle);
+packet_handle_std_uninit(struct packet_handle_std *handle);
 
 /* Returns true if the TTL fields of the supported protocols are valid. */
 bool
@@ -73,7 +78,8 @@ packet_handle_std_is_ttl_valid(struct packet_handle_std *handle);
 bool
 packet_handle_std_is_fragment(struct packet_handle_std *handle);
 
-/* Returns true if the packet matches the given standard match structure. */
+/* Returns true if the packet matches the given standard match structure.
+ * The packet is parsed as deep as the fields of the match need first. */
 bool
 packet_handle_std_match(struct packet_handle_std *handle,  struct ofl_match *match);
 
@@ -84,13 +90,41 @@ packet_handle_std_to_string(struct packet_handle_std *handle);
 void
 packet_handle_std_print(FILE *stream, struct packet_handle_std *handle);
 
-/* Clones the handler, and associates it with the new packet. */
-struct packet_handle_std *
-packet_handle_std_clone(struct packet *pkt, struct packet_handle_std *handle);
+/* Initializes clone as a clone of the handler, associated with the new
+ * packet, whose data must be a copy of the one of the original packet. The
+ * parsed fields, including metadata and tunnel id, are copied rather than
+ * parsed again. */
+void
+packet_handle_std_init_clone(struct packet_handle_std *clone,
+                             struct protocols_std *proto, struct packet *pkt,
+                             struct packet_handle_std *handle);
+
+/* Returns the fields of the packet as an OXM match, e.g. for a packet-in.
+ * The match is owned by the handler, and is only valid until the next call. */
+struct ofl_match *
+packet_handle_std_get_match(struct packet_handle_std *handle);
 
-/* Revalidates the handler data */
+/* Updates the handler after len bytes of headers were inserted into
+ * (len > 0), or removed from (len < 0) the packet at the given offset, e.g.
+ * by a push or pop action; old_data is where the packet data started before
+ * the change. The header pointers are rebased and the link layer headers are
+ * parsed again. The network and transport layers are kept, unless network
+ * is set, in which case they are parsed again too. */
+void
+packet_handle_std_headers_moved(struct packet_handle_std *handle,
+                                uint8_t *old_data, size_t offset, int len,
+                                bool network);
+
+/* Revalidates the handler data, parsing every supported field. */
 void
 packet_handle_std_validate(struct packet_handle_std *handle);
 
+/* Revalidates the handler data, if it is not valid or the packet was not yet
+ * parsed down to the given depth. The packet is parsed at least as deep as
+ * the flow tables of the pipeline need. */
+void
+packet_handle_std_validate_depth(struct packet_handle_std *handle,
+                                 enum packet_parse_depth depth);
+
 
 #endif /* PACKET_HANDLE_STD_H */
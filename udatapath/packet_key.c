@@ -0,0 +1,178 @@
+/* Copyright (c) 2012, CPqD, Brazil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "packet_key.h"
+#include "hash.h"
+#include "util.h"
+#include "oflib/ofl-structs.h"
+#include "oflib/oxm-match.h"
+#include "openflow/openflow.h"
+
+#define KEY_FIELD(FIELD, MEMBER)                              \
+    [OFPXMT_OFB_##FIELD] = {offsetof(struct packet_key, MEMBER), \
+                            sizeof(((struct packet_key *)0)->MEMBER)}
+
+const struct packet_key_field packet_key_fields[PACKET_KEY_FIELDS] = {
+    KEY_FIELD(IN_PORT,        in_port),
+    KEY_FIELD(IN_PHY_PORT,    in_phy_port),
+    KEY_FIELD(METADATA,       metadata),
+    KEY_FIELD(ETH_DST,        eth_dst),
+    KEY_FIELD(ETH_SRC,        eth_src),
+    KEY_FIELD(ETH_TYPE,       eth_type),
+    KEY_FIELD(VLAN_VID,       vlan_vid),
+    KEY_FIELD(VLAN_PCP,       vlan_pcp),
+    KEY_FIELD(IP_DSCP,        ip_dscp),
+    KEY_FIELD(IP_ECN,         ip_ecn),
+    KEY_FIELD(IP_PROTO,       ip_proto),
+    KEY_FIELD(IPV4_SRC,       ipv4_src),
+    KEY_FIELD(IPV4_DST,       ipv4_dst),
+    KEY_FIELD(TCP_SRC,        tcp_src),
+    KEY_FIELD(TCP_DST,        tcp_dst),
+    KEY_FIELD(UDP_SRC,        udp_src),
+    KEY_FIELD(UDP_DST,        udp_dst),
+    KEY_FIELD(SCTP_SRC,       sctp_src),
+    KEY_FIELD(SCTP_DST,       sctp_dst),
+    KEY_FIELD(ICMPV4_TYPE,    icmpv4_type),
+    KEY_FIELD(ICMPV4_CODE,    icmpv4_code),
+    KEY_FIELD(ARP_OP,         arp_op),
+    KEY_FIELD(ARP_SPA,        arp_spa),
+    KEY_FIELD(ARP_TPA,        arp_tpa),
+    KEY_FIELD(ARP_SHA,        arp_sha),
+    KEY_FIELD(ARP_THA,        arp_tha),
+    KEY_FIELD(IPV6_SRC,       ipv6_src),
+    KEY_FIELD(IPV6_DST,       ipv6_dst),
+    KEY_FIELD(IPV6_FLABEL,    ipv6_flabel),
+    KEY_FIELD(ICMPV6_TYPE,    icmpv6_type),
+    KEY_FIELD(ICMPV6_CODE,    icmpv6_code),
+    KEY_FIELD(IPV6_ND_TARGET, ipv6_nd_target),
+    KEY_FIELD(IPV6_ND_SLL,    ipv6_nd_sll),
+    KEY_FIELD(IPV6_ND_TLL,    ipv6_nd_tll),
+    KEY_FIELD(MPLS_LABEL,     mpls_label),
+    KEY_FIELD(MPLS_TC,        mpls_tc),
+    KEY_FIELD(MPLS_BOS,       mpls_bos),
+    KEY_FIELD(PBB_ISID,       pbb_isid),
+    KEY_FIELD(TUNNEL_ID,      tunnel_id),
+    KEY_FIELD(IPV6_EXTHDR,    ipv6_exthdr),
+};
+
+void
+packet_key_to_match(const struct packet_key *key, struct ofl_match *match) {
+    uint64_t present = key->present;
+
+    while (present) {
+        uint8_t field = __builtin_ctzll(present);
+        const struct packet_key_field *f = &packet_key_fields[field];
+        struct ofl_match_tlv *m = xmalloc(sizeof (struct ofl_match_tlv));
+
+        present &= present - 1;
+        m->header = OXM_HEADER(OFPXMC_OPENFLOW_BASIC, field, f->length);
+        m->value = xmalloc(f->length);
+        memcpy(m->value, (uint8_t *)key + f->offset, f->length);
+        hmap_insert(&match->match_fields, &m->hmap_node, hash_int(m->header, 0));
+        match->header.length += f->length + 4;
+    }
+}
+
+void
+packet_key_from_match(struct packet_key *key, const struct ofl_match *match) {
+    struct ofl_match_tlv *f;
+
+    packet_key_init(key);
+    HMAP_FOR_EACH(f, struct ofl_match_tlv, hmap_node, &match->match_fields) {
+        uint8_t field = OXM_FIELD(f->header);
+
+        if (OXM_VENDOR(f->header) != OFPXMC_OPENFLOW_BASIC || OXM_HASMASK(f->header)
+            || field >= PACKET_KEY_FIELDS
+            || OXM_LENGTH(f->header) != packet_key_fields[field].length) {
+            continue;
+        }
+        memcpy((uint8_t *)key + packet_key_fields[field].offset, f->value,
+               packet_key_fields[field].length);
+        key->present |= PACKET_KEY_BIT(field);
+    }
+}
+
+bool
+packet_key_equal(const struct packet_key *a, const struct packet_key *b) {
+    uint64_t present = a->present;
+
+    if (a->present != b->present) {
+        return false;
+    }
+    while (present) {
+        uint8_t field = __builtin_ctzll(present);
+        const struct packet_key_field *f = &packet_key_fields[field];
+
+        present &= present - 1;
+        if (memcmp((uint8_t *)a + f->offset, (uint8_t *)b + f->offset, f->length)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t
+packet_key_hash(const struct packet_key *key, uint32_t basis) {
+    uint64_t present = key->present;
+    uint32_t hash = hash_3words(present, present >> 32, basis);
+
+    while (present) {
+        uint8_t field = __builtin_ctzll(present);
+        const struct packet_key_field *f = &packet_key_fields[field];
+
+        present &= present - 1;
+        hash = hash_bytes((uint8_t *)key + f->offset, f->length, hash);
+    }
+    return hash;
+}
+
+void
+packet_key_set_field(struct packet_key *key, uint8_t field, const uint8_t *value) {
+    if (field >= PACKET_KEY_FIELDS) {
+        return;
+    }
+    memcpy((uint8_t *)key + packet_key_fields[field].offset, value,
+           packet_key_fields[field].length);
+    key->present |= PACKET_KEY_BIT(field);
+
+    switch (field) {
+        case OFPXMT_OFB_VLAN_VID:    key->vlan_vid &= VLAN_VID_MASK;       break;
+        case OFPXMT_OFB_VLAN_PCP:    key->vlan_pcp &= 0x07;                break;
+        case OFPXMT_OFB_IP_DSCP:     key->ip_dscp &= 0x3f;                 break;
+        case OFPXMT_OFB_IP_ECN:      key->ip_ecn &= IP_ECN_MASK;           break;
+        case OFPXMT_OFB_IPV6_FLABEL: key->ipv6_flabel &= IPV6_FLABEL_MASK; break;
+        case OFPXMT_OFB_MPLS_LABEL:  key->mpls_label &= MPLS_LABEL_MAX;    break;
+        case OFPXMT_OFB_MPLS_TC:     key->mpls_tc &= MPLS_TC_MAX;          break;
+        case OFPXMT_OFB_MPLS_BOS:    key->mpls_bos &= 0x01;                break;
+        default:                                                           break;
+    }
+}
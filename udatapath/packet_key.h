@@ -0,0 +1,181 @@
+/* Copyright (c) 2012, CPqD, Brazil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef PACKET_KEY_H
+#define PACKET_KEY_H 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "packets.h"
+#include "oflib/ofl-structs.h"
+#include "openflow/openflow.h"
+
+/****************************************************************************
+ * Fixed layout key of the OXM fields extracted from a packet.
+ *
+ * Every OpenFlow basic class field has a fixed slot in the key, holding the
+ * value in the same representation as the value of the corresponding
+ * ofl_match_tlv (so the match_* comparators work on both). A bit in
+ * 'present' tells whether the packet has the field. The TLV form of the key
+ * is only built when a packet-in has to carry it.
+ ****************************************************************************/
+
+#define PACKET_KEY_FIELDS (OFPXMT_OFB_IPV6_EXTHDR + 1)
+#define PACKET_KEY_BIT(FIELD) (UINT64_C(1) << (FIELD))
+
+#define CACHE_LINE_SIZE 64
+
+struct packet_key {
+    uint64_t present;            /* PACKET_KEY_BIT of the fields set. */
+
+    uint32_t in_port;
+    uint32_t in_phy_port;
+    uint64_t metadata;
+    uint64_t tunnel_id;
+
+    uint8_t  eth_dst[ETH_ADDR_LEN];
+    uint8_t  eth_src[ETH_ADDR_LEN];
+    uint16_t eth_type;
+    uint16_t vlan_vid;           /* VLAN ID, without OFPVID_PRESENT. */
+    uint8_t  vlan_pcp;
+    uint8_t  ip_dscp;
+    uint8_t  ip_ecn;
+    uint8_t  ip_proto;
+    uint32_t ipv4_src;           /* Network byte order. */
+    uint32_t ipv4_dst;           /* Network byte order. */
+
+    uint16_t tcp_src;
+    uint16_t tcp_dst;
+    uint16_t udp_src;
+    uint16_t udp_dst;
+    uint16_t sctp_src;
+    uint16_t sctp_dst;
+    uint8_t  icmpv4_type;
+    uint8_t  icmpv4_code;
+    uint16_t arp_op;
+    uint32_t arp_spa;            /* Network byte order. */
+    uint32_t arp_tpa;            /* Network byte order. */
+    uint8_t  arp_sha[ETH_ADDR_LEN];
+    uint8_t  arp_tha[ETH_ADDR_LEN];
+
+    uint8_t  ipv6_src[16];
+    uint8_t  ipv6_dst[16];
+    uint32_t ipv6_flabel;
+    uint8_t  icmpv6_type;
+    uint8_t  icmpv6_code;
+    uint16_t ipv6_exthdr;
+    uint8_t  ipv6_nd_target[16];
+    uint8_t  ipv6_nd_sll[ETH_ADDR_LEN];
+    uint8_t  ipv6_nd_tll[ETH_ADDR_LEN];
+
+    uint32_t mpls_label;
+    uint8_t  mpls_tc;
+    uint8_t  mpls_bos;
+    uint8_t  pbb_isid[PBB_ISID_LEN]; /* Network byte order. */
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+/* Offset and length of each field in the key, indexed by OFPXMT_OFB_*. */
+struct packet_key_field {
+    uint16_t offset;
+    uint16_t length;
+};
+
+extern const struct packet_key_field packet_key_fields[PACKET_KEY_FIELDS];
+
+/* Sets MEMBER of the key to VALUE and marks FIELD (OFPXMT_OFB_ suffix) as
+ * present. */
+#define PACKET_KEY_SET(KEY, FIELD, MEMBER, VALUE)                   \
+    do {                                                            \
+        (KEY)->MEMBER = (VALUE);                                    \
+        (KEY)->present |= PACKET_KEY_BIT(OFPXMT_OFB_##FIELD);       \
+    } while (0)
+
+/* Same as PACKET_KEY_SET, for array members. */
+#define PACKET_KEY_SET_BYTES(KEY, FIELD, MEMBER, VALUE)             \
+    do {                                                            \
+        memcpy((KEY)->MEMBER, (VALUE), sizeof (KEY)->MEMBER);       \
+        (KEY)->present |= PACKET_KEY_BIT(OFPXMT_OFB_##FIELD);       \
+    } while (0)
+
+static inline void
+packet_key_init(struct packet_key *key) {
+    key->present = 0;
+}
+
+static inline bool
+packet_key_has(const struct packet_key *key, uint8_t field) {
+    return field < PACKET_KEY_FIELDS && (key->present & PACKET_KEY_BIT(field));
+}
+
+/* Returns the value of the given field (OFPXMT_OFB_*) in the key, or NULL
+ * if the packet does not have the field. */
+static inline uint8_t *
+packet_key_value(const struct packet_key *key, uint8_t field) {
+    if (!packet_key_has(key, field)) {
+        return NULL;
+    }
+    return (uint8_t *)key + packet_key_fields[field].offset;
+}
+
+/* Returns the value of the field given by the OXM header in the key, or NULL
+ * if the packet does not have the field. The header's mask bit is ignored. */
+static inline uint8_t *
+packet_key_lookup(const struct packet_key *key, uint32_t header) {
+    if ((header >> 16) != OFPXMC_OPENFLOW_BASIC) {
+        return NULL;
+    }
+    return packet_key_value(key, (header >> 9) & 0x7f);
+}
+
+/* Adds the fields present in the key to the (empty) TLV match. */
+void
+packet_key_to_match(const struct packet_key *key, struct ofl_match *match);
+
+/* Sets the key from the fields of the TLV match. */
+void
+packet_key_from_match(struct packet_key *key, const struct ofl_match *match);
+
+/* Returns true if both keys have the same fields with the same values. */
+bool
+packet_key_equal(const struct packet_key *a, const struct packet_key *b);
+
+/* Returns a hash of the fields present in the key, consistent with
+ * packet_key_equal(). */
+uint32_t
+packet_key_hash(const struct packet_key *key, uint32_t basis);
+
+/* Sets the given field (OFPXMT_OFB_*) of the key from an OXM value, e.g.
+ * the one of a set field action, and marks it as present. Bits outside the
+ * range of the field are cleared, as the packet header could not hold them. */
+void
+packet_key_set_field(struct packet_key *key, uint8_t field, const uint8_t *value);
+
+#endif /* PACKET_KEY_H */
@@ -0,0 +1,569 @@
+/* Copyright (c) 2012, CPqD, Brazil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <config.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <netinet/in.h>
+#include "packet_parser.h"
+#include "ofpbuf.h"
+#include "packets.h"
+#include "oflib/ofl-structs.h"
+#include "oflib/ofl-utils.h"
+#include "oflib/ofl-packets.h"
+#include "oflib/oxm-match.h"
+#include "openflow/openflow.h"
+
+#if defined(PARSER_CROSSCHECK)
+#include "nbee_link/nbee_link.h"
+#endif
+
+#include "vlog.h"
+#define LOG_MODULE VLM_pkt_parser
+
+/* Largest IPv6 extension header chain walked before giving up. */
+#define IPV6_EXT_HDR_MAX 10
+
+/* Position of the IPv6 extension headers in the order recommended by
+ * RFC 2460. A header found at a position lower than the previous one sets
+ * OFPIEH_UNSEQ. */
+enum ipv6_ext_rank {
+    EXT_RANK_HOP,
+    EXT_RANK_DEST_BEFORE_RH,
+    EXT_RANK_ROUTER,
+    EXT_RANK_FRAG,
+    EXT_RANK_AUTH,
+    EXT_RANK_ESP,
+    EXT_RANK_DEST
+};
+
+static inline bool
+is_vlan_type(uint16_t eth_type) {
+    return eth_type == ETH_TYPE_VLAN || eth_type == ETH_TYPE_SVLAN ||
+           eth_type == ETH_TYPE_VLAN_QinQ || eth_type == ETH_TYPE_VLAN_PBB_B;
+}
+
+static void
+parse_arp(struct ofpbuf *b, struct packet_key *key,
+          struct protocols_std *proto, enum packet_parse_depth depth) {
+    struct arp_eth_header *arp = ofpbuf_try_pull(b, ARP_ETH_HEADER_LEN);
+
+    if (arp == NULL) {
+        return;
+    }
+    proto->arp = arp;
+    if (depth < PACKET_PARSE_L3) {
+        return;
+    }
+    PACKET_KEY_SET(key, ARP_OP, arp_op, ntohs(arp->ar_op));
+    PACKET_KEY_SET_BYTES(key, ARP_SHA, arp_sha, arp->ar_sha);
+    PACKET_KEY_SET(key, ARP_SPA, arp_spa, arp->ar_spa);
+    PACKET_KEY_SET_BYTES(key, ARP_THA, arp_tha, arp->ar_tha);
+    PACKET_KEY_SET(key, ARP_TPA, arp_tpa, arp->ar_tpa);
+}
+
+static void
+parse_mpls(struct ofpbuf *b, struct packet_key *key,
+           struct protocols_std *proto, enum packet_parse_depth depth) {
+    struct mpls_header *mpls = ofpbuf_try_pull(b, MPLS_HEADER_LEN);
+    uint32_t fields;
+
+    if (mpls == NULL) {
+        return;
+    }
+    /* Only the outermost label is matched on; the payload of an MPLS packet
+     * is opaque to the pipeline. */
+    proto->mpls = mpls;
+    if (depth < PACKET_PARSE_L3) {
+        return;
+    }
+    fields = ntohl(mpls->fields);
+    PACKET_KEY_SET(key, MPLS_LABEL, mpls_label,
+                   (fields & MPLS_LABEL_MASK) >> MPLS_LABEL_SHIFT);
+    PACKET_KEY_SET(key, MPLS_TC, mpls_tc, (fields & MPLS_TC_MASK) >> MPLS_TC_SHIFT);
+    PACKET_KEY_SET(key, MPLS_BOS, mpls_bos, (fields & MPLS_S_MASK) >> MPLS_S_SHIFT);
+}
+
+/* Parses the transport header following an IPv4 or IPv6 header. */
+static void
+parse_l4(struct ofpbuf *b, struct packet_key *key,
+         struct protocols_std *proto, uint8_t ip_proto, bool is_ipv6) {
+
+    switch (ip_proto) {
+        case IP_TYPE_TCP: {
+            struct tcp_header *tcp = ofpbuf_try_pull(b, TCP_HEADER_LEN);
+            if (tcp != NULL) {
+                proto->tcp = tcp;
+                PACKET_KEY_SET(key, TCP_SRC, tcp_src, ntohs(tcp->tcp_src));
+                PACKET_KEY_SET(key, TCP_DST, tcp_dst, ntohs(tcp->tcp_dst));
+            }
+            break;
+        }
+        case IP_TYPE_UDP: {
+            struct udp_header *udp = ofpbuf_try_pull(b, UDP_HEADER_LEN);
+            if (udp != NULL) {
+                proto->udp = udp;
+                PACKET_KEY_SET(key, UDP_SRC, udp_src, ntohs(udp->udp_src));
+                PACKET_KEY_SET(key, UDP_DST, udp_dst, ntohs(udp->udp_dst));
+            }
+            break;
+        }
+        case IP_TYPE_SCTP: {
+            struct sctp_header *sctp = ofpbuf_try_pull(b, SCTP_HEADER_LEN);
+            if (sctp != NULL) {
+                proto->sctp = sctp;
+                PACKET_KEY_SET(key, SCTP_SRC, sctp_src, ntohs(sctp->sctp_src));
+                PACKET_KEY_SET(key, SCTP_DST, sctp_dst, ntohs(sctp->sctp_dst));
+            }
+            break;
+        }
+        case IP_TYPE_ICMP: {
+            struct icmp_header *icmp;
+            if (is_ipv6) {
+                break;
+            }
+            icmp = ofpbuf_try_pull(b, ICMP_HEADER_LEN);
+            if (icmp != NULL) {
+                proto->icmp = icmp;
+                PACKET_KEY_SET(key, ICMPV4_TYPE, icmpv4_type, icmp->icmp_type);
+                PACKET_KEY_SET(key, ICMPV4_CODE, icmpv4_code, icmp->icmp_code);
+            }
+            break;
+        }
+        case IPV6_TYPE_ICMPV6: {
+            struct icmp_header *icmp;
+            struct ipv6_nd_header *nd;
+            if (!is_ipv6) {
+                break;
+            }
+            icmp = ofpbuf_try_pull(b, ICMP_HEADER_LEN);
+            if (icmp == NULL) {
+                break;
+            }
+            proto->icmp = icmp;
+            PACKET_KEY_SET(key, ICMPV6_TYPE, icmpv6_type, icmp->icmp_type);
+            PACKET_KEY_SET(key, ICMPV6_CODE, icmpv6_code, icmp->icmp_code);
+
+            if (icmp->icmp_type != ICMPV6_NEIGHSOL &&
+                icmp->icmp_type != ICMPV6_NEIGHADV) {
+                break;
+            }
+            nd = ofpbuf_try_pull(b, IPV6_ND_HEADER_LEN);
+            if (nd == NULL) {
+                break;
+            }
+            PACKET_KEY_SET_BYTES(key, IPV6_ND_TARGET, ipv6_nd_target,
+                                 nd->target_addr.s6_addr);
+            /* Walk the ND options looking for the link-layer addresses. */
+            while (b->size >= IPV6_ND_OPT_HD_LEN) {
+                struct ipv6_nd_options_hd *opt = b->data;
+                size_t opt_len = opt->length * 8;
+                if (opt_len == 0 || opt_len > b->size) {
+                    break;
+                }
+                if (opt_len >= IPV6_ND_OPT_HD_LEN + ETH_ADDR_LEN) {
+                    uint8_t *lla = (uint8_t *)opt + IPV6_ND_OPT_HD_LEN;
+                    if (opt->type == ND_OPT_SLL) {
+                        PACKET_KEY_SET_BYTES(key, IPV6_ND_SLL, ipv6_nd_sll, lla);
+                    } else if (opt->type == ND_OPT_TLL) {
+                        PACKET_KEY_SET_BYTES(key, IPV6_ND_TLL, ipv6_nd_tll, lla);
+                    }
+                }
+                ofpbuf_pull(b, opt_len);
+            }
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+}
+
+static void
+parse_ipv4(struct ofpbuf *b, struct packet_key *key,
+           struct protocols_std *proto, enum packet_parse_depth depth) {
+    struct ip_header *ip;
+    size_t ip_len;
+
+    if (b->size < IP_HEADER_LEN) {
+        return;
+    }
+    ip = b->data;
+    ip_len = IP_IHL(ip->ip_ihl_ver) * 4;
+    if (ip_len < IP_HEADER_LEN || b->size < ip_len) {
+        return;
+    }
+    ofpbuf_pull(b, ip_len);
+
+    proto->ipv4 = ip;
+    if (depth < PACKET_PARSE_L3) {
+        return;
+    }
+    PACKET_KEY_SET(key, IP_DSCP, ip_dscp, (ip->ip_tos & IP_DSCP_MASK) >> 2);
+    PACKET_KEY_SET(key, IP_ECN, ip_ecn, ip->ip_tos & IP_ECN_MASK);
+    PACKET_KEY_SET(key, IPV4_SRC, ipv4_src, ip->ip_src);
+    PACKET_KEY_SET(key, IPV4_DST, ipv4_dst, ip->ip_dst);
+    PACKET_KEY_SET(key, IP_PROTO, ip_proto, ip->ip_proto);
+
+    /* Later fragments carry no transport header. */
+    if (depth < PACKET_PARSE_L4 || (ip->ip_frag_off & htons(IP_FRAG_OFF_MASK))) {
+        return;
+    }
+    parse_l4(b, key, proto, ip->ip_proto, false);
+}
+
+/* Maps an IPv6 next header value to its OFPIEH_* flag, or 0 if it is not an
+ * extension header. */
+static uint16_t
+ipv6_ext_flag(uint8_t next_hd) {
+    switch (next_hd) {
+        case IPV6_TYPE_HBH: return OFPIEH_HOP;
+        case IPV6_TYPE_DOH: return OFPIEH_DEST;
+        case IPV6_TYPE_RH:  return OFPIEH_ROUTER;
+        case IPV6_TYPE_FH:  return OFPIEH_FRAG;
+        case IPV6_TYPE_AH:  return OFPIEH_AUTH;
+        case IPV6_TYPE_ESP: return OFPIEH_ESP;
+        default:            return 0;
+    }
+}
+
+static void
+parse_ipv6(struct ofpbuf *b, struct packet_key *key,
+           struct protocols_std *proto, enum packet_parse_depth depth) {
+    struct ipv6_header *ipv6 = ofpbuf_try_pull(b, IPV6_HEADER_LEN);
+    uint32_t ver_tc_fl;
+    uint16_t exthdr = 0;
+    uint8_t next_hd;
+    int last_rank = -1;
+    int dest_num = 0;
+    bool l4 = true;
+    size_t i;
+
+    if (ipv6 == NULL) {
+        return;
+    }
+    proto->ipv6 = ipv6;
+    if (depth < PACKET_PARSE_L3) {
+        return;
+    }
+    ver_tc_fl = ntohl(ipv6->ipv6_ver_tc_fl);
+    PACKET_KEY_SET(key, IP_DSCP, ip_dscp, (ver_tc_fl & IPV6_DSCP_MASK) >> IPV6_DSCP_SHIFT);
+    PACKET_KEY_SET(key, IP_ECN, ip_ecn, (ver_tc_fl >> IPV6_ECN_SHIFT) & IPV6_ECN_MASK);
+    PACKET_KEY_SET(key, IPV6_FLABEL, ipv6_flabel, ver_tc_fl & IPV6_FLABEL_MASK);
+    PACKET_KEY_SET_BYTES(key, IPV6_SRC, ipv6_src, ipv6->ipv6_src.s6_addr);
+    PACKET_KEY_SET_BYTES(key, IPV6_DST, ipv6_dst, ipv6->ipv6_dst.s6_addr);
+
+    /* Walk the extension header chain, building the OXM_OF_IPV6_EXTHDR
+     * pseudo-field on the way. */
+    next_hd = ipv6->ipv6_next_hd;
+    for (i = 0; i < IPV6_EXT_HDR_MAX; i++) {
+        uint16_t flag = ipv6_ext_flag(next_hd);
+        uint8_t *ext;
+        size_t ext_len;
+        int rank;
+
+        if (flag == 0) {
+            break;
+        }
+
+        switch (flag) {
+            case OFPIEH_HOP:    rank = EXT_RANK_HOP;    break;
+            case OFPIEH_ROUTER: rank = EXT_RANK_ROUTER; break;
+            case OFPIEH_FRAG:   rank = EXT_RANK_FRAG;   break;
+            case OFPIEH_AUTH:   rank = EXT_RANK_AUTH;   break;
+            case OFPIEH_ESP:    rank = EXT_RANK_ESP;    break;
+            default: {
+                /* A destination options header may appear once before a
+                 * routing header, and once before the upper layer. */
+                rank = (dest_num == 0 && !(exthdr & OFPIEH_ROUTER))
+                       ? EXT_RANK_DEST_BEFORE_RH : EXT_RANK_DEST;
+                dest_num++;
+                break;
+            }
+        }
+        if ((exthdr & flag) && (flag != OFPIEH_DEST || dest_num > 2)) {
+            exthdr |= OFPIEH_UNREP;
+        }
+        if (rank <= last_rank) {
+            exthdr |= OFPIEH_UNSEQ;
+        }
+        last_rank = rank;
+        exthdr |= flag;
+
+        if (flag == OFPIEH_ESP) {
+            /* The rest of the packet is encrypted. */
+            l4 = false;
+            break;
+        }
+
+        ext = ofpbuf_at(b, 0, 8);
+        if (ext == NULL) {
+            l4 = false;
+            break;
+        }
+        if (flag == OFPIEH_FRAG) {
+            /* Later fragments carry no transport header. */
+            if (ntohs(*(uint16_t *)(ext + 2)) & 0xfff8) {
+                l4 = false;
+            }
+            ext_len = 8;
+        } else if (flag == OFPIEH_AUTH) {
+            ext_len = (ext[1] + 2) * 4;
+        } else {
+            ext_len = (ext[1] + 1) * 8;
+        }
+        if (ofpbuf_try_pull(b, ext_len) == NULL) {
+            l4 = false;
+            break;
+        }
+        next_hd = ext[0];
+    }
+    if (next_hd == IPV6_NO_NEXT_HEADER) {
+        exthdr |= OFPIEH_NONEXT;
+        l4 = false;
+    }
+    PACKET_KEY_SET(key, IPV6_EXTHDR, ipv6_exthdr, exthdr);
+    PACKET_KEY_SET(key, IP_PROTO, ip_proto, next_hd);
+
+    if (l4 && depth >= PACKET_PARSE_L4) {
+        parse_l4(b, key, proto, next_hd, true);
+    }
+}
+
+enum packet_parse_depth
+packet_parse_depth(uint64_t fields) {
+    if (fields & PACKET_PARSE_L4_FIELDS) {
+        return PACKET_PARSE_L4;
+    }
+    if (fields & PACKET_PARSE_L3_FIELDS) {
+        return PACKET_PARSE_L3;
+    }
+    return PACKET_PARSE_L2;
+}
+
+size_t
+packet_parse_l2(struct ofpbuf *buffer, struct packet_key *key,
+                struct protocols_std *proto, uint16_t *network_type) {
+    struct ofpbuf b = *buffer;
+    struct eth_header *eth;
+    uint16_t eth_type;
+    bool eth_type_set = false;
+
+    proto->eth       = NULL;
+    proto->eth_snap  = NULL;
+    proto->vlan      = NULL;
+    proto->vlan_last = NULL;
+    proto->pbb       = NULL;
+    key->present &= ~PACKET_PARSE_L2_FIELDS;
+    *network_type = 0;
+
+    eth = ofpbuf_try_pull(&b, ETH_HEADER_LEN);
+    if (eth == NULL) {
+        return 0;
+    }
+    proto->eth = eth;
+    PACKET_KEY_SET_BYTES(key, ETH_DST, eth_dst, eth->eth_dst);
+    PACKET_KEY_SET_BYTES(key, ETH_SRC, eth_src, eth->eth_src);
+
+    eth_type = ntohs(eth->eth_type);
+    if (eth_type < ETH_TYPE_II_START) {
+        /* 802.3 frame: only an LLC/SNAP encapsulated ethertype can be
+         * decoded further. */
+        struct llc_header *llc = ofpbuf_at(&b, 0, sizeof *llc);
+        struct snap_header *snap = ofpbuf_at(&b, sizeof *llc, sizeof *snap);
+
+        if (llc != NULL && snap != NULL
+            && llc->llc_dsap == LLC_DSAP_SNAP
+            && llc->llc_ssap == LLC_SSAP_SNAP
+            && llc->llc_cntl == LLC_CNTL_SNAP
+            && !memcmp(snap->snap_org, SNAP_ORG_ETHERNET,
+                       sizeof snap->snap_org)) {
+            proto->eth_snap = snap;
+            eth_type = ntohs(snap->snap_type);
+            ofpbuf_pull(&b, LLC_SNAP_HEADER_LEN);
+        } else {
+            PACKET_KEY_SET(key, ETH_TYPE, eth_type, eth_type);
+            return (uint8_t *)b.data - (uint8_t *)buffer->data;
+        }
+    }
+
+    for (;;) {
+        if (is_vlan_type(eth_type)) {
+            struct vlan_header *vlan = ofpbuf_try_pull(&b, VLAN_HEADER_LEN);
+            if (vlan == NULL) {
+                break;
+            }
+            if (proto->vlan == NULL) {
+                uint16_t tci = ntohs(vlan->vlan_tci);
+                proto->vlan = vlan;
+                PACKET_KEY_SET(key, VLAN_PCP, vlan_pcp, (tci & VLAN_PCP_MASK) >> VLAN_PCP_SHIFT);
+                PACKET_KEY_SET(key, VLAN_VID, vlan_vid, (tci & VLAN_VID_MASK) >> VLAN_VID_SHIFT);
+            }
+            proto->vlan_last = vlan;
+            eth_type = ntohs(vlan->vlan_next_type);
+            continue;
+        }
+
+        /* The packet's ethertype is the first one that is not a tag. */
+        if (!eth_type_set) {
+            PACKET_KEY_SET(key, ETH_TYPE, eth_type, eth_type);
+            eth_type_set = true;
+        }
+
+        if (eth_type == ETH_TYPE_PBB && proto->pbb == NULL) {
+            struct pbb_header *pbb = ofpbuf_try_pull(&b, PBB_HEADER_LEN);
+            if (pbb == NULL) {
+                break;
+            }
+            proto->pbb = pbb;
+            /* The I-SID is the low 24 bits of the I-TAG, kept in wire
+             * order like the value of an OXM_OF_PBB_ISID flow match. */
+            PACKET_KEY_SET_BYTES(key, PBB_ISID, pbb_isid, (uint8_t *)&pbb->id + 1);
+            eth_type = ntohs(pbb->pbb_next_type);
+            continue;
+        }
+        break;
+    }
+
+    *network_type = eth_type;
+    return (uint8_t *)b.data - (uint8_t *)buffer->data;
+}
+
+void
+packet_parse_l3(struct ofpbuf *buffer, size_t offset, uint16_t network_type,
+                struct packet_key *key, struct protocols_std *proto,
+                enum packet_parse_depth depth) {
+    struct ofpbuf b = *buffer;
+
+    proto->mpls = NULL;
+    proto->ipv4 = NULL;
+    proto->ipv6 = NULL;
+    proto->arp  = NULL;
+    proto->tcp  = NULL;
+    proto->udp  = NULL;
+    proto->sctp = NULL;
+    proto->icmp = NULL;
+    key->present &= ~(PACKET_PARSE_L3_FIELDS | PACKET_PARSE_L4_FIELDS);
+
+    if (ofpbuf_try_pull(&b, offset) == NULL) {
+        return;
+    }
+
+    switch (network_type) {
+        case ETH_TYPE_IP: {
+            parse_ipv4(&b, key, proto, depth);
+            break;
+        }
+        case ETH_TYPE_IPV6: {
+            parse_ipv6(&b, key, proto, depth);
+            break;
+        }
+        case ETH_TYPE_ARP: {
+            parse_arp(&b, key, proto, depth);
+            break;
+        }
+        case ETH_TYPE_MPLS:
+        case ETH_TYPE_MPLS_MCAST: {
+            parse_mpls(&b, key, proto, depth);
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+}
+
+int
+packet_parse(struct ofpbuf *buffer, struct packet_key *key,
+             struct protocols_std *proto, enum packet_parse_depth depth) {
+    uint16_t network_type;
+    size_t offset;
+
+    protocol_reset(proto);
+    packet_key_init(key);
+
+    offset = packet_parse_l2(buffer, key, proto, &network_type);
+    if (proto->eth == NULL) {
+        return -1;
+    }
+    packet_parse_l3(buffer, offset, network_type, key, proto, depth);
+    return 0;
+}
+
+#if defined(PARSER_CROSSCHECK)
+
+static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(60, 60);
+
+bool
+packet_parse_crosscheck(struct ofpbuf *buffer, struct packet_key *key,
+                        struct protocols_std *proto) {
+    struct ofl_match nb_match;
+    struct packet_key nb_key;
+    struct protocols_std nb_proto;
+    struct ofl_match_tlv *iter, *next;
+    bool same;
+
+    ofl_structs_match_init(&nb_match);
+    if (nblink_packet_parse(buffer, &nb_match, &nb_proto) < 0) {
+        VLOG_WARN_RL(LOG_MODULE, &rl, "NetBee failed to decode packet.");
+        same = false;
+    } else {
+        packet_key_from_match(&nb_key, &nb_match);
+        same = packet_key_equal(key, &nb_key)
+               && !memcmp(proto, &nb_proto, sizeof(struct protocols_std));
+        if (!same) {
+            struct ofl_match native;
+            char *native_str, *nbee_str;
+
+            ofl_structs_match_init(&native);
+            packet_key_to_match(key, &native);
+            native_str = ofl_structs_match_to_string((struct ofl_match_header *)&native, NULL);
+            nbee_str = ofl_structs_match_to_string((struct ofl_match_header *)&nb_match, NULL);
+            VLOG_WARN_RL(LOG_MODULE, &rl, "Parser mismatch: native %s, NetBee %s.",
+                         native_str, nbee_str);
+            free(native_str);
+            free(nbee_str);
+            HMAP_FOR_EACH_SAFE(iter, next, struct ofl_match_tlv, hmap_node, &native.match_fields) {
+                free(iter->value);
+                free(iter);
+            }
+            hmap_destroy(&native.match_fields);
+        }
+    }
+
+    HMAP_FOR_EACH_SAFE(iter, next, struct ofl_match_tlv, hmap_node, &nb_match.match_fields) {
+        free(iter->value);
+        free(iter);
+    }
+    hmap_destroy(&nb_match.match_fields);
+    return same;
+}
+
+#endif /* PARSER_CROSSCHECK */
@@ -0,0 +1,142 @@
+/* Copyright (c) 2012, CPqD, Brazil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef PACKET_PARSER_H
+#define PACKET_PARSER_H 1
+
+#include <stdbool.h>
+#include "ofpbuf.h"
+#include "packets.h"
+#include "packet_key.h"
+
+/****************************************************************************
+ * Native packet header parser.
+ *
+ * Decodes the supported protocol headers directly from the packet buffer,
+ * setting the header pointers in protocols_std and the extracted fields in
+ * the packet key. The parser itself does no heap allocation and
+ * no string processing; it is the default replacement for the NetBee based
+ * nblink_packet_parse, and produces the same OXM values for the same packet.
+ ****************************************************************************/
+
+/* Protocol layer the parser stops after. Each depth also extracts the fields
+ * of the layers below it. */
+enum packet_parse_depth {
+    PACKET_PARSE_L2,  /* Ethernet, VLAN and PBB fields. The network header is
+                         located, but none of its fields are extracted. */
+    PACKET_PARSE_L3,  /* MPLS, ARP, IPv4 and IPv6 fields, including the IPv6
+                         extension header chain. */
+    PACKET_PARSE_L4   /* Transport, ICMP and IPv6 ND fields. */
+};
+
+#define PACKET_PARSE_ALL PACKET_PARSE_L4
+
+/* Packet key fields extracted from the headers of each layer. */
+#define PACKET_PARSE_L2_FIELDS                                               \
+                  (PACKET_KEY_BIT(OFPXMT_OFB_ETH_DST)                        \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_ETH_SRC)                      \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_ETH_TYPE)                     \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_VLAN_VID)                     \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_VLAN_PCP)                     \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_PBB_ISID))
+
+#define PACKET_PARSE_L3_FIELDS                                               \
+                  (PACKET_KEY_BIT(OFPXMT_OFB_IP_DSCP)                        \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_IP_ECN)                       \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_IP_PROTO)                     \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_IPV4_SRC)                     \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_IPV4_DST)                     \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_ARP_OP)                       \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_ARP_SPA)                      \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_ARP_TPA)                      \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_ARP_SHA)                      \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_ARP_THA)                      \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_IPV6_SRC)                     \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_IPV6_DST)                     \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_IPV6_FLABEL)                  \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_IPV6_EXTHDR)                  \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_MPLS_LABEL)                   \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_MPLS_TC)                      \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_MPLS_BOS))
+
+#define PACKET_PARSE_L4_FIELDS                                               \
+                  (PACKET_KEY_BIT(OFPXMT_OFB_TCP_SRC)                        \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_TCP_DST)                      \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_UDP_SRC)                      \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_UDP_DST)                      \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_SCTP_SRC)                     \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_SCTP_DST)                     \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_ICMPV4_TYPE)                  \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_ICMPV4_CODE)                  \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_ICMPV6_TYPE)                  \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_ICMPV6_CODE)                  \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_IPV6_ND_TARGET)               \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_IPV6_ND_SLL)                  \
+                   | PACKET_KEY_BIT(OFPXMT_OFB_IPV6_ND_TLL))
+
+/* Returns the depth the packet has to be parsed to, so that all the fields in
+ * the given set of packet key presence bits are extracted. */
+enum packet_parse_depth
+packet_parse_depth(uint64_t fields);
+
+/* Parses the packet in buffer down to the given depth. The pointers in proto
+ * are reset and set to the headers found; the presence bits of key are reset
+ * and set for the fields extracted. Returns 0 on success, and -1 if the
+ * buffer does not even hold an Ethernet header. */
+int
+packet_parse(struct ofpbuf *buffer, struct packet_key *key,
+             struct protocols_std *proto, enum packet_parse_depth depth);
+
+/* Parses the link layer headers of the packet again, e.g. after a tag was
+ * pushed or popped. The Ethernet, SNAP, VLAN and PBB pointers of proto, and
+ * the matching fields of key, are reset and set again; the rest is left
+ * untouched. Returns the offset of the network header, and stores its
+ * ethertype in network_type (0 if there is none). */
+size_t
+packet_parse_l2(struct ofpbuf *buffer, struct packet_key *key,
+                struct protocols_std *proto, uint16_t *network_type);
+
+/* Parses the network and transport headers of the packet again, starting at
+ * the given offset with a header of the given ethertype. Their pointers in
+ * proto, and the matching fields of key, are reset and set again. */
+void
+packet_parse_l3(struct ofpbuf *buffer, size_t offset, uint16_t network_type,
+                struct packet_key *key, struct protocols_std *proto,
+                enum packet_parse_depth depth);
+
+#if defined(PARSER_CROSSCHECK)
+/* Parses the packet in buffer with NetBee as well, and logs a warning if the
+ * result differs from the one produced by the native parser (key, proto).
+ * Returns true if the two results are the same. */
+bool
+packet_parse_crosscheck(struct ofpbuf *buffer, struct packet_key *key,
+                        struct protocols_std *proto);
+#endif
+
+#endif /* PACKET_PARSER_H */
@@ -28,9 +28,12 @@
  *
  */
 
+#include <config.h>
+#include <assert.h>
 #include <sys/types.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "action_set.h"
 #include "compiler.h"
@@ -43,14 +46,22 @@
 #include "pipeline.h"
 #include "flow_table.h"
 #include "flow_entry.h"
+#include "flow_cache.h"
 #include "meter_table.h"
+#include "rcu.h"
 #include "oflib/ofl.h"
 #include "oflib/ofl-structs.h"
 #include "util.h"
 #include "hash.h"
 #include "oflib/oxm-match.h"
+#include "oflib-exp/ofl-exp-openflow.h"
+#include "openflow/openflow-ext.h"
 #include "vlog.h"
 
+#if !defined(NATIVE_PARSER) || defined(PARSER_CROSSCHECK)
+#include "nbee_link/nbee_link.h"
+#endif
+
 
 #define LOG_MODULE VLM_pipeline
 
@@ -69,55 +80,179 @@ pipeline_create(struct datapath *dp) {
         pl->tables[i] = flow_table_create(dp, i);
     }
     pl->dp = dp;
+    pl->match_fields = 0;
+    pl->parse_depth = PACKET_PARSE_L2;
+    pl->cache = NULL;
+    pl->cache_size = 0;
+    pl->cache_megaflows = 0;
+    pl->thread_caches = NULL;
+    pl->n_thread_caches = 0;
+    pl->cache_seq = 0;
+    pl->memory_budget = 0;
+    timer_wheel_init(&pl->timeouts, time_msec());
+    pl->reorder_interval = 0;
+    pl->reorder_at = 0;
+#if !defined(NATIVE_PARSER) || defined(PARSER_CROSSCHECK)
     nblink_initialize();
+#endif
     return pl;
 }
 
-static bool
-is_table_miss(struct flow_entry *entry){
-    return ((entry->stats->priority) == 0 && (entry->match->length <= 4));
+void
+pipeline_update_match_fields(struct pipeline *pl) {
+    uint64_t fields = 0;
+    int i;
+
+    for (i = 0; i < PIPELINE_TABLES; i++) {
+        fields |= pl->tables[i]->match_fields;
+    }
+    if (fields != pl->match_fields) {
+        pl->match_fields = fields;
+        pl->parse_depth = packet_parse_depth(fields);
+        VLOG_DBG(LOG_MODULE, "Packets are parsed to depth %d.", pl->parse_depth);
+    }
 }
 
-/* Sends a packet to the controller in a packet_in message */
-static void
-send_packet_to_controller(struct pipeline *pl, struct packet *pkt, uint8_t table_id, uint8_t reason) {
+void
+pipeline_set_flow_cache(struct pipeline *pl, size_t size, size_t megaflows) {
+    flow_cache_destroy(pl->cache);
+    pl->cache = size > 0 || megaflows > 0 ? flow_cache_create(size, megaflows)
+                                          : NULL;
+    pl->cache_size = size;
+    pl->cache_megaflows = megaflows;
+}
+
+struct flow_cache *
+pipeline_add_thread_cache(struct pipeline *pl) {
+    struct flow_cache *cache;
 
-    struct ofl_msg_packet_in msg;
-    struct ofl_match *m;
-    msg.header.type = OFPT_PACKET_IN;
-    msg.total_len   = pkt->buffer->size;
-    msg.reason      = reason;
-    msg.table_id    = table_id;
-    msg.cookie      = 0xffffffffffffffff;
-    msg.data = pkt->buffer->data;
+    if (pl->cache == NULL) {
+        return NULL;
+    }
+    cache = flow_cache_create(pl->cache_size, pl->cache_megaflows);
+    pl->thread_caches = xrealloc(pl->thread_caches, (pl->n_thread_caches + 1)
+                                                    * sizeof *pl->thread_caches);
+    pl->thread_caches[pl->n_thread_caches++] = cache;
+    return cache;
+}
 
+void
+pipeline_refresh_thread_cache(struct pipeline *pl, struct flow_cache *cache,
+                              uint64_t *seq) {
+    uint64_t cache_seq = __atomic_load_n(&pl->cache_seq, __ATOMIC_ACQUIRE);
+
+    if (cache != NULL && cache_seq != *seq) {
+        flow_cache_invalidate(cache);
+    }
+    *seq = cache_seq;
+}
+
+void
+pipeline_set_max_entries(struct pipeline *pl, uint8_t table_id, uint32_t max_entries) {
+    int i;
 
-    /* A max_len of OFPCML_NO_BUFFER means that the complete
-        packet should be sent, and it should not be buffered.*/
-    if (pl->dp->config.miss_send_len != OFPCML_NO_BUFFER){
-        dp_buffers_save(pl->dp->buffers, pkt);
-        msg.buffer_id   = pkt->buffer_id;
-        msg.data_length = MIN(pl->dp->config.miss_send_len, pkt->buffer->size);
-    }else {
-        msg.buffer_id   = OFP_NO_BUFFER;
-        msg.data_length = pkt->buffer->size;
+    for (i = 0; i < PIPELINE_TABLES; i++) {
+        if (table_id == OFPTT_ALL || table_id == i) {
+            pl->tables[i]->features->max_entries = max_entries;
+        }
     }
+}
 
-    m = &pkt->handle_std->match;
-    /* In this implementation the fields in_port and in_phy_port
-        always will be the same, because we are not considering logical
-        ports                                 */
-    msg.match = (struct ofl_match_header*)m;
-    dp_send_message(pl->dp, (struct ofl_msg_header *)&msg, NULL);
-    ofl_structs_free_match((struct ofl_match_header* ) m, NULL);
+void
+pipeline_set_memory_budget(struct pipeline *pl, size_t budget) {
+    pl->memory_budget = budget;
 }
 
-/* Pass the packet through the flow tables.
- * This function takes ownership of the packet and will destroy it. */
 void
-pipeline_process_packet(struct pipeline *pl, struct packet *pkt) {
-    struct flow_table *table, *next_table;
+pipeline_set_lookup_stats(struct pipeline *pl, bool enable) {
+    int i;
+
+    for (i = 0; i < PIPELINE_TABLES; i++) {
+        flow_table_set_lookup_stats(pl->tables[i], enable);
+    }
+}
+
+void
+pipeline_set_reorder_interval(struct pipeline *pl, unsigned int secs) {
+    int i;
+
+    pl->reorder_interval = (uint64_t)secs * 1000;
+    pl->reorder_at = time_msec() + pl->reorder_interval;
+    for (i = 0; i < PIPELINE_TABLES; i++) {
+        pl->tables[i]->reorder = secs > 0;
+    }
+}
+
+size_t
+pipeline_memory_used(struct pipeline *pl) {
+    size_t memory = 0;
+    int i;
+
+    for (i = 0; i < PIPELINE_TABLES; i++) {
+        memory += pl->tables[i]->memory;
+    }
+    return memory;
+}
+
+bool
+pipeline_memory_available(struct pipeline *pl, size_t size) {
+    return pl->memory_budget == 0 ||
+           pipeline_memory_used(pl) + size <= pl->memory_budget;
+}
 
+void
+pipeline_invalidate_cache(struct pipeline *pl) {
+    if (pl->cache != NULL) {
+        flow_cache_invalidate(pl->cache);
+        /* The workers invalidate theirs before their next batch. */
+        __atomic_add_fetch(&pl->cache_seq, 1, __ATOMIC_RELEASE);
+    }
+}
+
+void
+pipeline_publish(struct pipeline *pl) {
+    bool changed = false;
+    int i;
+
+    for (i = 0; i < PIPELINE_TABLES; i++) {
+        changed |= flow_table_publish(pl->tables[i]);
+    }
+    if (changed) {
+        /* Paths cached from the previous copies are gone. */
+        pipeline_invalidate_cache(pl);
+    }
+}
+
+static bool
+is_table_miss(struct flow_entry *entry){
+    return ((entry->stats->priority) == 0 && (entry->match->length <= 4));
+}
+
+/* Sends a packet to the controller in a packet_in message */
+static void
+send_packet_to_controller(struct pipeline *pl, struct packet *pkt, uint8_t table_id, uint8_t reason) {
+    dp_actions_packet_in(pkt, reason, table_id, pl->dp->config.miss_send_len,
+                         0xffffffffffffffff);
+}
+
+/* The progress of a packet of a batch through the pipeline. */
+struct pipeline_walk {
+    struct packet                *pkt;
+    struct flow_table            *table;  /* table the packet is in. */
+    struct flow_entry            *entry;  /* entry it matched there. */
+    bool                          cached; /* 'path' is replayed from the
+                                             cache. */
+    size_t                        step;   /* next entry of the cached path. */
+    struct flow_cache_path        path;   /* path replayed or recorded. */
+    uint64_t                      wc[CLS_KEY_WORDS]; /* bits of the key the
+                                                        lookups looked at. */
+};
+
+/* Sets a packet entering the pipeline on its walk to the first table.
+ * Returns false if the packet was consumed right away. */
+static bool
+walk_start(struct pipeline *pl, struct flow_cache *cache,
+           struct pipeline_walk *walk, struct packet *pkt) {
     if (VLOG_IS_DBG_ENABLED(LOG_MODULE)) {
         char *pkt_str = packet_to_string(pkt);
         VLOG_DBG_RL(LOG_MODULE, &rl, "processing packet: %s", pkt_str);
@@ -127,54 +262,161 @@ pipeline_process_packet(struct pipeline *pl, struct packet *pkt) {
     if (!packet_handle_std_is_ttl_valid(pkt->handle_std)) {
         send_packet_to_controller(pl, pkt, 0/*table_id*/, OFPR_INVALID_TTL);
         packet_destroy(pkt);
-        return;
+        return false;
     }
 
-    next_table = pl->tables[0];
-    while (next_table != NULL) {
-        struct flow_entry *entry;
-
-        VLOG_DBG_RL(LOG_MODULE, &rl, "trying table %u.", next_table->stats->table_id);
-
-        pkt->table_id = next_table->stats->table_id;
-        table         = next_table;
-        next_table    = NULL;
+    walk->pkt = pkt;
+    walk->table = pl->tables[0];
+    walk->cached = false;
+    walk->step = 0;
+    if (cache != NULL) {
+        /* The key must hold every field any table matches on, before it
+         * can identify the path of the packet. */
+        packet_handle_std_validate_depth(pkt->handle_std, pl->parse_depth);
+        walk->cached = flow_cache_lookup(cache, &pkt->handle_std->key, &walk->path);
+        if (!walk->cached) {
+            flow_cache_path_init(&walk->path, &pkt->handle_std->key);
+            memset(walk->wc, 0, sizeof(walk->wc));
+        }
+    }
+    return true;
+}
 
+/* Finds the entry the packet matches in its table, and prefetches the
+ * instructions it will execute. */
+static void
+walk_lookup(struct flow_cache *cache, struct pipeline_walk *walk) {
+    struct packet *pkt = walk->pkt;
+    struct flow_table *table = walk->table;
+    struct flow_entry *entry;
+
+    VLOG_DBG_RL(LOG_MODULE, &rl, "trying table %u.", table->stats->table_id);
+    pkt->table_id = table->stats->table_id;
+
+    if (walk->cached) {
+        /* Replay the cached path instead of looking up the table. */
+        entry = walk->step < walk->path.entries_num
+                ? walk->path.entries[walk->step++] : NULL;
+        flow_table_account(table, entry, pkt);
+    } else {
         // EEDBEH: additional printout to debug table lookup
         if (VLOG_IS_DBG_ENABLED(LOG_MODULE)) {
-            char *m = ofl_structs_match_to_string((struct ofl_match_header*)&(pkt->handle_std->match), pkt->dp->exp);
+            char *m = ofl_structs_match_to_string((struct ofl_match_header*)packet_handle_std_get_match(pkt->handle_std), pkt->dp->exp);
             VLOG_DBG_RL(LOG_MODULE, &rl, "searching table entry for packet match: %s.", m);
             free(m);
         }
-        entry = flow_table_lookup(table, pkt);
-        if (entry != NULL) {
-	        if (VLOG_IS_DBG_ENABLED(LOG_MODULE)) {
-                char *m = ofl_structs_flow_stats_to_string(entry->stats, pkt->dp->exp);
-                VLOG_DBG_RL(LOG_MODULE, &rl, "found matching entry: %s.", m);
-                free(m);
+        entry = flow_table_lookup(table, pkt, cache != NULL ? walk->wc : NULL);
+        if (cache != NULL) {
+            flow_cache_path_add(&walk->path, table, entry);
+        }
+    }
+    if (entry != NULL) {
+        __builtin_prefetch(rcu_get(entry->insts));
+    }
+    walk->entry = entry;
+}
+
+/* Executes the instructions of the entry the packet matched. Returns true
+ * if the packet goes on to another table, false if it left the pipeline. */
+static bool
+walk_execute(struct pipeline *pl, struct flow_cache *cache,
+             struct pipeline_walk *walk) {
+    struct flow_entry *entry = walk->entry;
+    struct flow_table *next_table = NULL;
+    struct packet *pkt = walk->pkt;
+
+    if (entry == NULL) {
+        if (cache != NULL && !walk->cached) {
+            flow_cache_insert(cache, &walk->path, walk->wc);
+        }
+        /* OpenFlow 1.3 default behavior on a table miss */
+        VLOG_DBG_RL(LOG_MODULE, &rl, "No matching entry found. Dropping packet.");
+        packet_destroy(pkt);
+        return false;
+    }
+
+    if (VLOG_IS_DBG_ENABLED(LOG_MODULE)) {
+        char *m = ofl_structs_flow_stats_to_string(entry->stats, pkt->dp->exp);
+        VLOG_DBG_RL(LOG_MODULE, &rl, "found matching entry: %s.", m);
+        free(m);
+    }
+    pkt->handle_std->table_miss = is_table_miss(entry);
+    execute_entry(pl, entry, &next_table, &pkt);
+    /* Packet could be destroyed by a meter instruction */
+    if (!pkt) {
+        return false;
+    }
+    walk->pkt = pkt;
+
+    if (next_table == NULL) {
+        if (cache != NULL && !walk->cached) {
+            flow_cache_insert(cache, &walk->path, walk->wc);
+        }
+        /* Cookie field is set 0xffffffffffffffff
+           because we cannot associate it to any
+           particular flow */
+        action_set_execute(pkt->action_set, pkt, 0xffffffffffffffff);
+        return false;
+    }
+    walk->table = next_table;
+    return true;
+}
+
+void
+pipeline_process_batch(struct pipeline *pl, struct flow_cache *cache,
+                       struct packet **pkts, size_t n) {
+    struct pipeline_walk walks[PIPELINE_BATCH];
+    struct pipeline_walk *active[PIPELINE_BATCH];
+    size_t n_active = 0;
+    size_t i, j;
+
+    assert(n <= PIPELINE_BATCH);
+    for (i = 0; i < n; i++) {
+        if (walk_start(pl, cache, &walks[n_active], pkts[i])) {
+            active[n_active] = &walks[n_active];
+            n_active++;
+        }
+    }
+
+    /* Each round looks up the table every packet left is in, and then
+     * executes the entries found. */
+    while (n_active > 0) {
+        struct pipeline_walk *next[PIPELINE_BATCH];
+        size_t n_next = 0;
+
+        for (i = 0; i < n_active; i++) {
+            walk_lookup(cache, active[i]);
+        }
+        /* Packets matching the same entry are executed one after the
+         * other, keeping their order. */
+        for (i = 0; i < n_active; i++) {
+            struct flow_entry *entry;
+
+            if (active[i] == NULL) {
+                continue;
             }
-            pkt->handle_std->table_miss = is_table_miss(entry);
-            execute_entry(pl, entry, &next_table, &pkt);
-            /* Packet could be destroyed by a meter instruction */
-            if (!pkt)
-                return;
-
-            if (next_table == NULL) {
-               /* Cookie field is set 0xffffffffffffffff
-                because we cannot associate it to any
-                particular flow */
-                action_set_execute(pkt->action_set, pkt, 0xffffffffffffffff);
-                return;
+            entry = active[i]->entry;
+            for (j = i; j < n_active; j++) {
+                struct pipeline_walk *walk = active[j];
+
+                if (walk != NULL && walk->entry == entry) {
+                    active[j] = NULL;
+                    if (walk_execute(pl, cache, walk)) {
+                        next[n_next++] = walk;
+                    }
+                }
             }
-
-        } else {
-			/* OpenFlow 1.3 default behavior on a table miss */
-			VLOG_DBG_RL(LOG_MODULE, &rl, "No matching entry found. Dropping packet.");
-			packet_destroy(pkt);
-			return;
         }
+        memcpy(active, next, n_next * sizeof(struct pipeline_walk *));
+        n_active = n_next;
     }
-    VLOG_WARN_RL(LOG_MODULE, &rl, "Reached outside of pipeline processing cycle.");
+}
+
+/* Pass the packet through the flow tables.
+ * This function takes ownership of the packet and will destroy it. */
+void
+pipeline_process_packet(struct pipeline *pl, struct packet *pkt) {
+    pipeline_process_batch(pl, pl->cache, &pkt, 1);
 }
 
 static
@@ -188,21 +430,12 @@ int inst_compare(const void *inst1, const void *inst2){
     return i1->type < i2->type;
 }
 
-ofl_err
-pipeline_handle_flow_mod(struct pipeline *pl, struct ofl_msg_flow_mod *msg,
-                                                const struct sender *sender) {
-    /* Note: the result of using table_id = 0xff is undefined in the spec.
-     *       for now it is accepted for delete commands, meaning to delete
-     *       from all tables */
+/* Sorts the instructions of a flow mod in execution order, and checks them
+ * and the table the flow mod goes to. */
+static ofl_err
+validate_flow_mod(struct pipeline *pl, struct ofl_msg_flow_mod *msg) {
     ofl_err error;
     size_t i;
-    bool match_kept,insts_kept;
-
-    if(sender->remote->role == OFPCR_ROLE_SLAVE)
-        return ofl_error(OFPET_BAD_REQUEST, OFPBRC_IS_SLAVE);
-
-    match_kept = false;
-    insts_kept = false;
 
     /*Sort by execution oder*/
     qsort(msg->instructions, msg->instructions_num,
@@ -223,54 +456,204 @@ pipeline_handle_flow_mod(struct pipeline *pl, struct ofl_msg_flow_mod *msg,
                 return error;
             }
         }
+        if (msg->instructions[i]->type == OFPIT_METER) {
+            struct ofl_instruction_meter *im = (struct ofl_instruction_meter *)msg->instructions[i];
+
+            if (im->meter_id <= OFPM_MAX &&
+                meter_table_find(pl->dp->meters, im->meter_id) == NULL) {
+                return ofl_error(OFPET_METER_MOD_FAILED, OFPMMFC_UNKNOWN_METER);
+            }
+        }
 	/* Reject goto in the last table. */
 	if ((msg->table_id == (PIPELINE_TABLES - 1))
 	    && (msg->instructions[i]->type == OFPIT_GOTO_TABLE))
 	  return ofl_error(OFPET_BAD_INSTRUCTION, OFPBIC_UNSUP_INST);
     }
 
+    if (msg->table_id == 0xff &&
+        msg->command != OFPFC_DELETE && msg->command != OFPFC_DELETE_STRICT) {
+        return ofl_error(OFPET_FLOW_MOD_FAILED, OFPFMFC_BAD_TABLE_ID);
+    }
+    return 0;
+}
+
+/* Returns the buffer of the packet to run through the pipeline once the
+ * flow mod is applied, or NO_BUFFER. */
+static uint32_t
+flow_mod_buffer(struct ofl_msg_flow_mod *msg) {
+    if (msg->table_id != 0xff &&
+        (msg->command == OFPFC_ADD || msg->command == OFPFC_MODIFY ||
+         msg->command == OFPFC_MODIFY_STRICT)) {
+        return msg->buffer_id;
+    }
+    return NO_BUFFER;
+}
+
+/* Applies a validated flow mod to its table, or to all tables. Frees the
+ * message, unless an error is returned. */
+static ofl_err
+apply_flow_mod(struct pipeline *pl, struct ofl_msg_flow_mod *msg) {
+    bool match_kept = false;
+    bool insts_kept = false;
+    ofl_err error = 0;
+
     if (msg->table_id == 0xff) {
-        if (msg->command == OFPFC_DELETE || msg->command == OFPFC_DELETE_STRICT) {
-            size_t i;
-
-            error = 0;
-            for (i=0; i < PIPELINE_TABLES; i++) {
-                error = flow_table_flow_mod(pl->tables[i], msg, &match_kept, &insts_kept);
-                if (error) {
-                    break;
-                }
-            }
+        size_t i;
+
+        for (i=0; i < PIPELINE_TABLES; i++) {
+            error = flow_table_flow_mod(pl->tables[i], msg, &match_kept, &insts_kept);
             if (error) {
-                return error;
-            } else {
-                ofl_msg_free_flow_mod(msg, !match_kept, !insts_kept, pl->dp->exp);
-                return 0;
+                break;
             }
-        } else {
-            return ofl_error(OFPET_FLOW_MOD_FAILED, OFPFMFC_BAD_TABLE_ID);
         }
     } else {
         error = flow_table_flow_mod(pl->tables[msg->table_id], msg, &match_kept, &insts_kept);
-        if (error) {
-            return error;
+    }
+    if (error) {
+        return error;
+    }
+
+    ofl_msg_free_flow_mod(msg, !match_kept, !insts_kept, pl->dp->exp);
+    return 0;
+}
+
+/* Runs a buffered packet through the pipeline. */
+static void
+process_buffer(struct pipeline *pl, uint32_t buffer_id) {
+    struct packet *pkt;
+
+    pkt = dp_buffers_retrieve(pl->dp->buffers, buffer_id);
+    if (pkt != NULL) {
+        pipeline_publish(pl);
+        pipeline_process_packet(pl, pkt);
+    } else {
+        VLOG_WARN_RL(LOG_MODULE, &rl, "The buffer flow_mod referred to was empty (%u).", buffer_id);
+    }
+}
+
+ofl_err
+pipeline_handle_flow_mod(struct pipeline *pl, struct ofl_msg_flow_mod *msg,
+                                                const struct sender *sender) {
+    /* Note: the result of using table_id = 0xff is undefined in the spec.
+     *       for now it is accepted for delete commands, meaning to delete
+     *       from all tables */
+    ofl_err error;
+    uint32_t buffer_id;
+
+    if(sender->remote->role == OFPCR_ROLE_SLAVE)
+        return ofl_error(OFPET_BAD_REQUEST, OFPBRC_IS_SLAVE);
+
+    /* Cached paths may refer to the entries being modified or removed. */
+    pipeline_invalidate_cache(pl);
+
+    error = validate_flow_mod(pl, msg);
+    if (error) {
+        return error;
+    }
+    buffer_id = flow_mod_buffer(msg);
+    error = apply_flow_mod(pl, msg);
+    if (error) {
+        return error;
+    }
+    if (buffer_id != NO_BUFFER) {
+        /* run buffered message through pipeline */
+        process_buffer(pl, buffer_id);
+    }
+    return 0;
+}
+
+ofl_err
+pipeline_check_flow_mod(struct pipeline *pl, struct ofl_msg_flow_mod *msg) {
+    return validate_flow_mod(pl, msg);
+}
+
+/* Checks that the flow mods of a batch all succeed when applied in order,
+ * each on the tables as the mods before it leave them, so that the batch is
+ * applied in full or not at all. The mods are validated again, as the ports,
+ * groups and meters they refer to may have gone since they were. */
+static ofl_err
+check_batch(struct pipeline *pl, struct ofl_msg_flow_mod **mods, size_t mods_num) {
+    struct flow_table_check checks[PIPELINE_TABLES];
+    size_t memory = pipeline_memory_used(pl);
+    ofl_err error = 0;
+    size_t i, j;
+
+    for (j = 0; j < PIPELINE_TABLES; j++) {
+        flow_table_check_init(&checks[j], pl->tables[j]);
+    }
+    for (i = 0; i < mods_num && !error; i++) {
+        error = validate_flow_mod(pl, mods[i]);
+        for (j = 0; j < PIPELINE_TABLES && !error; j++) {
+            if (mods[i]->table_id == 0xff || mods[i]->table_id == j) {
+                error = flow_table_check_flow_mod(&checks[j], mods[i], &memory);
+            }
+        }
+    }
+    for (j = 0; j < PIPELINE_TABLES; j++) {
+        flow_table_check_destroy(&checks[j]);
+    }
+    return error;
+}
+
+ofl_err
+pipeline_commit_flow_mods(struct pipeline *pl, struct ofl_msg_flow_mod **mods,
+                          size_t mods_num) {
+    size_t changes[PIPELINE_TABLES];
+    uint32_t *buffers;
+    size_t buffers_num = 0;
+    ofl_err error;
+    size_t i, j;
+
+    error = check_batch(pl, mods, mods_num);
+    if (error) {
+        for (i = 0; i < mods_num; i++) {
+            ofl_msg_free((struct ofl_msg_header *)mods[i], pl->dp->exp);
         }
-        if ((msg->command == OFPFC_ADD || msg->command == OFPFC_MODIFY || msg->command == OFPFC_MODIFY_STRICT) &&
-                            msg->buffer_id != NO_BUFFER) {
-            /* run buffered message through pipeline */
-            struct packet *pkt;
-
-            pkt = dp_buffers_retrieve(pl->dp->buffers, msg->buffer_id);
-            if (pkt != NULL) {
-		      pipeline_process_packet(pl, pkt);
-            } else {
-                VLOG_WARN_RL(LOG_MODULE, &rl, "The buffer flow_mod referred to was empty (%u).", msg->buffer_id);
+        return error;
+    }
+
+    memset(changes, 0, sizeof(changes));
+    for (i = 0; i < mods_num; i++) {
+        for (j = 0; j < PIPELINE_TABLES; j++) {
+            if (mods[i]->table_id == 0xff || mods[i]->table_id == j) {
+                changes[j]++;
             }
         }
+    }
+
+    pipeline_invalidate_cache(pl);
+    for (j = 0; j < PIPELINE_TABLES; j++) {
+        if (changes[j] > 0) {
+            flow_table_batch_begin(pl->tables[j], changes[j]);
+        }
+    }
+
+    buffers = xmalloc(MAX(mods_num, 1) * sizeof(uint32_t));
+    for (i = 0; i < mods_num; i++) {
+        uint32_t buffer_id = flow_mod_buffer(mods[i]);
+
+        /* The check went through the same decisions, on the same state. */
+        error = apply_flow_mod(pl, mods[i]);
+        assert(error == 0);
+        if (buffer_id != NO_BUFFER) {
+            buffers[buffers_num++] = buffer_id;
+        }
+    }
 
-        ofl_msg_free_flow_mod(msg, !match_kept, !insts_kept, pl->dp->exp);
-        return 0;
+    /* Each table changed is rebuilt at most once, and packets see the whole
+     * batch from now on. */
+    for (j = 0; j < PIPELINE_TABLES; j++) {
+        if (changes[j] > 0) {
+            flow_table_batch_end(pl->tables[j]);
+        }
     }
+    pipeline_publish(pl);
 
+    for (i = 0; i < buffers_num; i++) {
+        process_buffer(pl, buffers[i]);
+    }
+    free(buffers);
+    return error;
 }
 
 ofl_err
@@ -281,6 +664,8 @@ pipeline_handle_table_mod(struct pipeline *pl,
     if(sender->remote->role == OFPCR_ROLE_SLAVE)
         return ofl_error(OFPET_BAD_REQUEST, OFPBRC_IS_SLAVE);
 
+    pipeline_invalidate_cache(pl);
+
     if (msg->table_id == 0xff) {
         size_t i;
 
@@ -458,7 +843,7 @@ pipeline_handle_stats_request_table_features_request(struct pipeline *pl,
 		break;
             }
             /* Can't go over out internal max-entries. */
-            if (feat->table_features[i]->max_entries > FLOW_TABLE_MAX_ENTRIES) {
+            if (feat->table_features[i]->max_entries > FLOW_TABLE_ENTRIES_LIMIT) {
                 error = ofl_error(OFPET_TABLE_FEATURES_FAILED, OFPTFFC_BAD_ARGUMENT);
 		break;
             }
@@ -562,6 +947,183 @@ pipeline_handle_stats_request_aggregate(struct pipeline *pl,
     return 0;
 }
 
+ofl_err
+pipeline_handle_flow_cache_stats_request(struct pipeline *pl,
+                                         struct ofl_exp_openflow_msg_header *msg,
+                                         const struct sender *sender) {
+    struct flow_cache_stats stats;
+    size_t i;
+
+    if (pl->cache != NULL) {
+        flow_cache_get_stats(pl->cache, &stats);
+    } else {
+        memset(&stats, 0, sizeof(stats));
+    }
+    for (i = 0; i < pl->n_thread_caches; i++) {
+        flow_cache_add_stats(pl->thread_caches[i], &stats);
+    }
+
+    {
+        struct ofl_exp_openflow_msg_flow_cache_stats reply =
+                {{{{.type = OFPT_EXPERIMENTER},
+                   .experimenter_id = OPENFLOW_VENDOR_ID},
+                  .type = OFP_EXT_FLOW_CACHE_STATS_REPLY},
+                 .size          = stats.size,
+                 .used          = stats.used,
+                 .hits          = stats.hits,
+                 .misses        = stats.misses,
+                 .evictions     = stats.evictions,
+                 .invalidations = stats.invalidations,
+                 .megaflow_size      = stats.megaflow_size,
+                 .megaflow_used      = stats.megaflow_used,
+                 .megaflow_hits      = stats.megaflow_hits,
+                 .megaflow_misses    = stats.megaflow_misses,
+                 .megaflow_evictions = stats.megaflow_evictions,
+                 .megaflow_expired   = stats.megaflow_expired,
+                 .megaflow_stale     = stats.megaflow_stale};
+
+        dp_send_message(pl->dp, (struct ofl_msg_header *)&reply, sender);
+    }
+
+    ofl_msg_free((struct ofl_msg_header *)msg, pl->dp->exp);
+    return 0;
+}
+
+ofl_err
+pipeline_handle_table_memory_request(struct pipeline *pl,
+                                     struct ofl_exp_openflow_msg_header *msg,
+                                     const struct sender *sender) {
+    struct ofl_exp_openflow_table_memory tables[PIPELINE_TABLES];
+    size_t tables_num = 0;
+    int i, j;
+
+    for (i = 0; i < PIPELINE_TABLES; i++) {
+        struct flow_table *table = pl->tables[i];
+
+        if (table->stats->active_count > 0) {
+            tables[tables_num].table_id     = i;
+            tables[tables_num].mode         = table->mode;
+            tables[tables_num].active_count = table->stats->active_count;
+            tables[tables_num].max_entries  = table->features->max_entries;
+            /* Entries, plus the structures of both lookup copies of a
+             * table in the LPM or exact mode. */
+            tables[tables_num].memory       = table->memory;
+            for (j = 0; j < 2; j++) {
+                struct flow_table_lookup *lookup = &table->lookups[j];
+
+                tables[tables_num].memory +=
+                        (lookup->lpm != NULL ? flow_lpm_memory(lookup->lpm) : 0) +
+                        (lookup->exact != NULL ? flow_exact_memory(lookup->exact) : 0);
+            }
+            tables_num++;
+        }
+    }
+
+    {
+        struct ofl_exp_openflow_msg_table_memory reply =
+                {{{{.type = OFPT_EXPERIMENTER},
+                   .experimenter_id = OPENFLOW_VENDOR_ID},
+                  .type = OFP_EXT_TABLE_MEMORY_REPLY},
+                 .budget     = pl->memory_budget,
+                 .memory     = pipeline_memory_used(pl),
+                 .tables_num = tables_num,
+                 .tables     = tables};
+
+        dp_send_message(pl->dp, (struct ofl_msg_header *)&reply, sender);
+    }
+
+    ofl_msg_free((struct ofl_msg_header *)msg, pl->dp->exp);
+    return 0;
+}
+
+ofl_err
+pipeline_handle_table_mode(struct pipeline *pl,
+                           struct ofl_exp_openflow_msg_table_mode *msg,
+                           const struct sender *sender) {
+    ofl_err error = 0;
+
+    if (sender->remote->role == OFPCR_ROLE_SLAVE) {
+        return ofl_error(OFPET_BAD_REQUEST, OFPBRC_IS_SLAVE);
+    }
+    if (msg->table_id != OFPTT_ALL && msg->table_id >= PIPELINE_TABLES) {
+        return ofl_error(OFPET_TABLE_MOD_FAILED, OFPTMFC_BAD_TABLE);
+    }
+
+    if (msg->table_id == OFPTT_ALL) {
+        size_t i;
+
+        /* Tables whose entries do not fit keep their mode; the others are
+         * still set. */
+        for (i = 0; i < PIPELINE_TABLES; i++) {
+            ofl_err err = flow_table_set_mode(pl->tables[i], msg->mode);
+
+            if (err && !error) {
+                error = err;
+            }
+        }
+    } else {
+        error = flow_table_set_mode(pl->tables[msg->table_id], msg->mode);
+    }
+    pipeline_invalidate_cache(pl);
+
+    if (!error) {
+        ofl_msg_free((struct ofl_msg_header *)msg, pl->dp->exp);
+    }
+    return error;
+}
+
+ofl_err
+pipeline_handle_table_lookup_stats_request(struct pipeline *pl,
+                                           struct ofl_exp_openflow_mp_table_lookup_stats_request *msg,
+                                           const struct sender *sender) {
+    struct ofl_exp_openflow_table_lookup_stats tables[PIPELINE_TABLES];
+    size_t tables_num = 0;
+    int i;
+
+    if (msg->table_id != OFPTT_ALL && msg->table_id >= PIPELINE_TABLES) {
+        return ofl_error(OFPET_BAD_REQUEST, OFPBRC_BAD_TABLE_ID);
+    }
+
+    for (i = 0; i < PIPELINE_TABLES; i++) {
+        struct flow_table_lookup_stats *stats = pl->tables[i]->lookup_stats;
+
+        /* All tables means all tables looked up in. */
+        if (stats != NULL && (msg->table_id == i ||
+                              (msg->table_id == OFPTT_ALL && stats->lookups > 0))) {
+            struct ofl_exp_openflow_table_lookup_stats *t = &tables[tables_num++];
+
+            t->table_id = i;
+            t->mode     = pl->tables[i]->mode;
+            t->lookups  = stats->lookups;
+            t->hits     = stats->hits;
+            t->probes   = stats->probes;
+            t->cycles   = stats->cycles;
+            memcpy(t->probe_hits, stats->probe_hits, sizeof(t->probe_hits));
+            memcpy(t->cycles_hist, stats->cycles_hist, sizeof(t->cycles_hist));
+            t->reorders       = stats->reorders;
+            t->before_lookups = stats->before_lookups;
+            t->before_probes  = stats->before_probes;
+            t->after_lookups  = stats->lookups - stats->reorder_lookups;
+            t->after_probes   = stats->probes - stats->reorder_probes;
+        }
+    }
+
+    {
+        struct ofl_exp_openflow_mp_table_lookup_stats_reply reply =
+                {{{{{.type = OFPT_MULTIPART_REPLY},
+                    .type = OFPMP_EXPERIMENTER, .flags = 0x0000},
+                   .experimenter_id = OPENFLOW_VENDOR_ID},
+                  .type = OFP_EXT_MP_TABLE_LOOKUP_STATS},
+                 .tables_num = tables_num,
+                 .tables     = tables};
+
+        dp_send_message(pl->dp, (struct ofl_msg_header *)&reply, sender);
+    }
+
+    ofl_msg_free((struct ofl_msg_header *)msg, pl->dp->exp);
+    return 0;
+}
+
 
 void
 pipeline_destroy(struct pipeline *pl) {
@@ -574,16 +1136,36 @@ pipeline_destroy(struct pipeline *pl) {
             flow_table_destroy(table);
         }
     }
+    flow_cache_destroy(pl->cache);
+    for (i = 0; i < pl->n_thread_caches; i++) {
+        flow_cache_destroy(pl->thread_caches[i]);
+    }
+    free(pl->thread_caches);
     free(pl);
 }
 
 
 void
 pipeline_timeout(struct pipeline *pl) {
-    int i;
+    struct list expired;
+
+    /* Idle timers are set for the last use known when they were scheduled;
+     * an entry used since is only rescheduled now. */
+    timer_wheel_run(&pl->timeouts, time_msec(), &expired);
+    while (!list_is_empty(&expired)) {
+        flow_entry_timeout(CONTAINER_OF(list_front(&expired),
+                                        struct flow_entry, timer.node));
+    }
+    if (pl->cache != NULL) {
+        flow_cache_run(pl->cache);
+    }
+    if (pl->reorder_interval > 0 && time_msec() >= pl->reorder_at) {
+        int i;
 
-    for (i = 0; i < PIPELINE_TABLES; i++) {
-        flow_table_timeout(pl->tables[i]);
+        for (i = 0; i < PIPELINE_TABLES; i++) {
+            flow_table_reorder(pl->tables[i]);
+        }
+        pl->reorder_at = time_msec() + pl->reorder_interval;
     }
 }
 
@@ -601,17 +1183,18 @@ execute_entry(struct pipeline *pl, struct flow_entry *entry,
             Write-Metadata
             Goto-Table
     */
+    struct flow_entry_insts *insts = rcu_get(entry->insts);
     size_t i;
     struct ofl_instruction_header *inst;
 
-    for (i=0; i < entry->stats->instructions_num; i++) {
+    for (i=0; i < insts->num; i++) {
         /*Packet was dropped by some instruction or action*/
 
         if(!(*pkt)){
             return;
         }
 
-        inst = entry->stats->instructions[i];
+        inst = insts->insts[i];
         switch (inst->type) {
             case OFPIT_GOTO_TABLE: {
                 struct ofl_instruction_goto_table *gi = (struct ofl_instruction_goto_table *)inst;
@@ -621,18 +1204,14 @@ execute_entry(struct pipeline *pl, struct flow_entry *entry,
             }
             case OFPIT_WRITE_METADATA: {
                 struct ofl_instruction_write_metadata *wi = (struct ofl_instruction_write_metadata *)inst;
-                struct  ofl_match_tlv *f;
+                uint64_t *metadata;
 
                 /* NOTE: Hackish solution. If packet had multiple handles, metadata
-                 *       should be updated in all. */
-                packet_handle_std_validate((*pkt)->handle_std);
-                /* Search field on the description of the packet. */
-                HMAP_FOR_EACH_WITH_HASH(f, struct ofl_match_tlv,
-                    hmap_node, hash_int(OXM_OF_METADATA,0), &(*pkt)->handle_std->match.match_fields){
-                    uint64_t *metadata = (uint64_t*) f->value;
-                    *metadata = (*metadata & ~wi->metadata_mask) | (wi->metadata & wi->metadata_mask);
-                    VLOG_DBG_RL(LOG_MODULE, &rl, "Executing write metadata: %"PRIu64"", *metadata);
-                }
+                 *       should be updated in all. The metadata is kept in the
+                 *       key across revalidation, so no parsing is needed. */
+                metadata = &(*pkt)->handle_std->key.metadata;
+                *metadata = (*metadata & ~wi->metadata_mask) | (wi->metadata & wi->metadata_mask);
+                VLOG_DBG_RL(LOG_MODULE, &rl, "Executing write metadata: %"PRIu64"", *metadata);
                 break;
             }
             case OFPIT_WRITE_ACTIONS: {
@@ -35,21 +35,48 @@
 #include "datapath.h"
 #include "packet.h"
 #include "flow_table.h"
+#include "packet_parser.h"
+#include "timer_wheel.h"
 #include "oflib/ofl.h"
 #include "oflib/ofl-messages.h"
 
 
 struct sender;
+struct flow_cache;
+struct ofl_exp_openflow_msg_header;
+struct ofl_exp_openflow_mp_table_lookup_stats_request;
 
 /****************************************************************************
  * A pipeline implementation. Processes messages through flow tables,
  * including the execution of instructions.
  ****************************************************************************/
 
+/* Maximum number of packets processed together by pipeline_process_batch. */
+#define PIPELINE_BATCH 32
+
 /* A pipeline structure */
 struct pipeline {
     struct datapath    *dp;
     struct flow_table  *tables[PIPELINE_TABLES];
+    uint64_t            match_fields; /* OXM fields matched on by any flow
+                                         entry, as packet key presence bits. */
+    enum packet_parse_depth parse_depth; /* Depth packets are parsed to for
+                                            the lookups. */
+    struct flow_cache  *cache;        /* microflow and megaflow cache, or
+                                         NULL if both are disabled. */
+    size_t              cache_size;   /* microflows of each flow cache. */
+    size_t              cache_megaflows; /* megaflows of each flow cache. */
+    struct flow_cache **thread_caches; /* flow caches of the worker threads. */
+    size_t              n_thread_caches;
+    uint64_t            cache_seq;    /* bumped whenever the flow caches of the
+                                         worker threads must be invalidated. */
+    size_t              memory_budget; /* bytes the flow entries of all tables
+                                          may hold, 0 if unlimited. */
+    struct timer_wheel  timeouts;     /* hard and idle timeouts of the flow
+                                         entries of all tables. */
+    uint64_t            reorder_interval; /* msecs between reorderings of the
+                                             tables by hits, 0 if never. */
+    uint64_t            reorder_at;   /* time of the next reordering. */
 };
 
 
@@ -61,12 +88,50 @@ pipeline_create(struct datapath *dp);
 void
 pipeline_process_packet(struct pipeline *pl, struct packet *pkt);
 
+/* Processes at most PIPELINE_BATCH packets in the pipeline together: every
+ * table is looked up for all packets of the batch before the instructions
+ * of the entries found are executed, packets matching the same entry one
+ * after the other. Each packet still sees the tables, counters and actions
+ * it would if processed alone, and the packets of a flow keep their order.
+ * Paths are looked up in and added to 'cache', if not NULL: the main
+ * thread passes the pipeline's own cache, worker threads theirs. Takes
+ * ownership of the packets. */
+void
+pipeline_process_batch(struct pipeline *pl, struct flow_cache *cache,
+                       struct packet **pkts, size_t n);
+
+/* Creates a flow cache for a worker thread, sized as the pipeline's own,
+ * or returns NULL if the flow cache is disabled. Its counters are added to
+ * the pipeline's flow cache stats, and it is destroyed with the pipeline. */
+struct flow_cache *
+pipeline_add_thread_cache(struct pipeline *pl);
+
+/* Invalidates the flow cache of a worker thread if the pipeline changed
+ * since '*seq', and updates '*seq'. Called by the worker between batches,
+ * before it looks up any path. */
+void
+pipeline_refresh_thread_cache(struct pipeline *pl, struct flow_cache *cache,
+                              uint64_t *seq);
+
 
 /* Handles a flow_mod message. */
 ofl_err
 pipeline_handle_flow_mod(struct pipeline *pl, struct ofl_msg_flow_mod *msg,
                          const struct sender *sender);
 
+/* Checks a flow mod before it is applied, as part of a bundle, sorting its
+ * instructions in execution order. */
+ofl_err
+pipeline_check_flow_mod(struct pipeline *pl, struct ofl_msg_flow_mod *msg);
+
+/* Applies checked flow mods in order, as a single change: the tables they
+ * change are rebuilt at most once, and packets see either none or all of
+ * them. Frees the messages. Returns the error of the first flow mod which
+ * would fail, applying none of them in that case. */
+ofl_err
+pipeline_commit_flow_mods(struct pipeline *pl, struct ofl_msg_flow_mod **mods,
+                          size_t mods_num);
+
 /* Handles a table_mod message. */
 ofl_err
 pipeline_handle_table_mod(struct pipeline *pl,
@@ -97,6 +162,78 @@ pipeline_handle_stats_request_aggregate(struct pipeline *pl,
                                   struct ofl_msg_multipart_request_flow *msg,
                                   const struct sender *sender);
 
+/* Handles a flow cache stats request experimenter message. */
+ofl_err
+pipeline_handle_flow_cache_stats_request(struct pipeline *pl,
+                                         struct ofl_exp_openflow_msg_header *msg,
+                                         const struct sender *sender);
+
+/* Handles a table memory request experimenter message. */
+ofl_err
+pipeline_handle_table_memory_request(struct pipeline *pl,
+                                     struct ofl_exp_openflow_msg_header *msg,
+                                     const struct sender *sender);
+
+/* Handles a table mode experimenter message, setting the lookup structure
+ * of a table or of all tables. */
+ofl_err
+pipeline_handle_table_mode(struct pipeline *pl,
+                           struct ofl_exp_openflow_msg_table_mode *msg,
+                           const struct sender *sender);
+
+/* Handles a table lookup stats experimenter multipart request. */
+ofl_err
+pipeline_handle_table_lookup_stats_request(struct pipeline *pl,
+                                           struct ofl_exp_openflow_mp_table_lookup_stats_request *msg,
+                                           const struct sender *sender);
+
+/* Sets the maximum number of entries of a table, or of all tables if
+ * table_id is OFPTT_ALL. */
+void
+pipeline_set_max_entries(struct pipeline *pl, uint8_t table_id, uint32_t max_entries);
+
+/* Sets the number of bytes the flow entries of all tables may hold; zero
+ * means unlimited. */
+void
+pipeline_set_memory_budget(struct pipeline *pl, size_t budget);
+
+/* Starts or stops counting the cost of the lookups in all tables. */
+void
+pipeline_set_lookup_stats(struct pipeline *pl, bool enable);
+
+/* Sets the number of seconds between reorderings of the tables by hits;
+ * zero disables them. */
+void
+pipeline_set_reorder_interval(struct pipeline *pl, unsigned int secs);
+
+/* Returns the number of bytes held by the flow entries of all tables. */
+size_t
+pipeline_memory_used(struct pipeline *pl);
+
+/* Returns true if a flow entry of the given size fits in the memory
+ * budget. */
+bool
+pipeline_memory_available(struct pipeline *pl, size_t size);
+
+/* Recomputes the fields matched on by the flow tables; called when the set
+ * of fields matched on by a table changes. */
+void
+pipeline_update_match_fields(struct pipeline *pl);
+
+/* Enables the microflow and megaflow caches with the given number of
+ * entries, or disables them if zero. */
+void
+pipeline_set_flow_cache(struct pipeline *pl, size_t size, size_t megaflows);
+
+/* Invalidates the paths in the microflow cache; called on any change which
+ * could alter the path of a packet through the pipeline. */
+void
+pipeline_invalidate_cache(struct pipeline *pl);
+
+/* Publishes the changes of the flow tables to the packets processed from
+ * now on; called before the pipeline processes packets after flow mods. */
+void
+pipeline_publish(struct pipeline *pl);
 
 /* Commands pipeline to check if any flow in any table is timed out. */
 void
@@ -0,0 +1,141 @@
+/* Copyright (c) 2012, CPqD, Brazil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "timer_wheel.h"
+#include "compiler.h"
+#include "util.h"
+
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+
+/* Returns the tick a timer expiring at 'expires' fires on. */
+static uint64_t
+expiry_tick(uint64_t expires) {
+    return expires / TIMER_WHEEL_TICK + 1;
+}
+
+/* Links the timer into the slot its expiry falls in. 'first' is the first
+ * tick the wheel has not processed yet. */
+static void
+place(struct timer_wheel *wheel, struct timer_wheel_node *timer, uint64_t first) {
+    uint64_t tick = expiry_tick(timer->expires);
+    uint64_t delta;
+    int level;
+
+    if (tick < first) {
+        /* Already due; fire it on the next tick processed. */
+        tick = first;
+    }
+    delta = tick - first;
+
+    for (level = 0; level < TIMER_WHEEL_LEVELS - 1; level++) {
+        if (delta < (uint64_t)1 << (TIMER_WHEEL_BITS * (level + 1))) {
+            break;
+        }
+    }
+    if (delta >= (uint64_t)1 << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) {
+        /* Out of range: park it in the slot of the last level spread the
+         * latest, where it is placed again. */
+        tick = first + ((uint64_t)SLOT_MASK << (TIMER_WHEEL_BITS * level));
+    }
+
+    list_push_back(&wheel->slots[level][(tick >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK],
+                   &timer->node);
+}
+
+void
+timer_wheel_init(struct timer_wheel *wheel, uint64_t now) {
+    int level, slot;
+
+    wheel->tick = now / TIMER_WHEEL_TICK;
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            list_init(&wheel->slots[level][slot]);
+        }
+    }
+}
+
+void
+timer_wheel_node_init(struct timer_wheel_node *timer) {
+    list_init(&timer->node);
+    timer->expires = 0;
+}
+
+void
+timer_wheel_insert(struct timer_wheel *wheel, struct timer_wheel_node *timer,
+                   uint64_t expires) {
+    list_remove(&timer->node);
+    timer->expires = expires;
+    place(wheel, timer, wheel->tick + 1);
+}
+
+void
+timer_wheel_cancel(struct timer_wheel *wheel UNUSED,
+                   struct timer_wheel_node *timer) {
+    list_remove(&timer->node);
+    list_init(&timer->node);
+}
+
+/* Places the timers of a slot of an upper level again, which spreads them
+ * over the levels below. Called before the slot of the current tick of the
+ * first level is processed. */
+static void
+cascade(struct timer_wheel *wheel, struct list *slot) {
+    while (!list_is_empty(slot)) {
+        struct timer_wheel_node *timer;
+
+        timer = CONTAINER_OF(list_pop_front(slot), struct timer_wheel_node, node);
+        place(wheel, timer, wheel->tick);
+    }
+}
+
+void
+timer_wheel_run(struct timer_wheel *wheel, uint64_t now, struct list *expired) {
+    uint64_t target = now / TIMER_WHEEL_TICK;
+
+    list_init(expired);
+    while (wheel->tick < target) {
+        struct list *slot;
+        int level;
+
+        wheel->tick++;
+        for (level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+            uint64_t index = wheel->tick >> (TIMER_WHEEL_BITS * level);
+
+            if ((wheel->tick & (((uint64_t)1 << (TIMER_WHEEL_BITS * level)) - 1)) != 0) {
+                break;
+            }
+            cascade(wheel, &wheel->slots[level][index & SLOT_MASK]);
+        }
+
+        slot = &wheel->slots[0][wheel->tick & SLOT_MASK];
+        if (!list_is_empty(slot)) {
+            list_splice(expired, list_front(slot), slot);
+        }
+    }
+}
@@ -0,0 +1,91 @@
+/* Copyright (c) 2012, CPqD, Brazil
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of the Ericsson Research nor the names of its
+ *     contributors may be used to endorse or promote products derived from
+ *     this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H 1
+
+#include <stdint.h>
+#include "list.h"
+
+/****************************************************************************
+ * Hierarchical timing wheel. Timers are kept in slots of TIMER_WHEEL_TICK
+ * milliseconds; the first level has a slot per tick for the next
+ * TIMER_WHEEL_SLOTS ticks, and each further level has a slot per rotation
+ * of the level below it. A slot of an upper level is spread over the level
+ * below when the time reaches it, so inserting and cancelling a timer is
+ * O(1) and running the wheel only touches the timers due, plus each timer
+ * once per level it descends.
+ *
+ * Timers fire on the first tick strictly after their expiry time, which
+ * makes "now > expires" hold for them.
+ ****************************************************************************/
+
+#define TIMER_WHEEL_TICK 1000     /* milliseconds per tick. */
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 3      /* covers 2^18 ticks, about three days;
+                                     later timers are parked in the last
+                                     level until they come in range. */
+
+struct timer_wheel_node {
+    struct list   node;           /* in a slot of the wheel, or empty. */
+    uint64_t      expires;        /* expiry time, in milliseconds. */
+};
+
+struct timer_wheel {
+    uint64_t      tick;           /* last tick the wheel was run to. */
+    struct list   slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+};
+
+/* Initializes the wheel at time 'now', in milliseconds. */
+void
+timer_wheel_init(struct timer_wheel *wheel, uint64_t now);
+
+/* Initializes a timer, which is not scheduled. */
+void
+timer_wheel_node_init(struct timer_wheel_node *timer);
+
+/* Schedules the timer to fire after 'expires', in milliseconds. A timer
+ * already scheduled, or on a list of expired timers, is moved. */
+void
+timer_wheel_insert(struct timer_wheel *wheel, struct timer_wheel_node *timer,
+                   uint64_t expires);
+
+/* Cancels the timer, if it is scheduled, or takes it off the list of
+ * expired timers it is on. */
+void
+timer_wheel_cancel(struct timer_wheel *wheel, struct timer_wheel_node *timer);
+
+/* Advances the wheel to time 'now' and moves the timers which fired to
+ * 'expired', which is initialized first. The caller takes each timer off
+ * the list by cancelling or inserting it again. */
+void
+timer_wheel_run(struct timer_wheel *wheel, uint64_t now, struct list *expired);
+
+#endif /* TIMER_WHEEL_H */
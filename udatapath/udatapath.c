@@ -49,10 +49,13 @@
 #include "command-line.h"
 #include "daemon.h"
 #include "datapath.h"
+#include "dp_workers.h"
 #include "fault.h"
+#include "flow_table.h"
 #include "openflow/openflow.h"
 #include "poll-loop.h"
 #include "queue.h"
+#include "rcu.h"
 #include "util.h"
 #include "rconn.h"
 #include "timeval.h"
@@ -82,6 +85,14 @@ static void add_ports(struct datapath *dp, char *port_list);
 
 static bool use_multiple_connections = false;
 
+static size_t flow_cache_size = 0;
+static size_t megaflow_cache_size = 0;
+
+static unsigned int n_workers = 0;
+static unsigned int n_receivers = 0;
+static unsigned int n_classifiers = 0;
+static unsigned int n_transmitters = 0;
+
 /* Need to treat this more generically */
 #if defined(UDATAPATH_AS_LIB)
 #define OFP_FATAL(_er, _str, args...) do {                \
@@ -118,6 +129,10 @@ udatapath_cmd(int argc, char *argv[])
     parse_options(dp, argc, argv);
     signal(SIGPIPE, SIG_IGN);
 
+    if (flow_cache_size > 0 || megaflow_cache_size > 0) {
+        dp_set_flow_cache_size(dp, flow_cache_size, megaflow_cache_size);
+    }
+
     if (argc - optind < 1) {
         OFP_FATAL(0, "at least one listener argument is required; "
           "use --help for usage");
@@ -174,10 +189,23 @@ udatapath_cmd(int argc, char *argv[])
     die_if_already_running();
     daemonize();
 
+    rcu_register_thread();
+    if (n_receivers > 0) {
+        error = dp_workers_start_staged(dp, n_receivers, n_classifiers,
+                                        n_transmitters);
+    } else {
+        error = dp_workers_start(dp, n_workers);
+    }
+    if (error) {
+        OFP_FATAL(error, "failed to start the worker threads");
+    }
     for (;;) {
         dp_run(dp);
+        rcu_quiesce();
         dp_wait(dp);
+        rcu_quiesce_start();
         poll_block();
+        rcu_quiesce_end();
     }
 
     return 0;
@@ -212,7 +240,15 @@ parse_options(struct datapath *dp, int argc, char *argv[])
         OPT_SERIAL_NUM,
         OPT_BOOTSTRAP_CA_CERT,
         OPT_NO_LOCAL_PORT,
-        OPT_NO_SLICING
+        OPT_NO_SLICING,
+        OPT_FLOW_CACHE,
+        OPT_MEGAFLOW_CACHE,
+        OPT_TABLE_ENTRIES,
+        OPT_FLOW_MEMORY,
+        OPT_LOOKUP_STATS,
+        OPT_REORDER_INTERVAL,
+        OPT_WORKERS,
+        OPT_STAGES
     };
 
     static struct option long_options[] = {
@@ -225,6 +261,14 @@ parse_options(struct datapath *dp, int argc, char *argv[])
         {"help",        no_argument, 0, 'h'},
         {"version",     no_argument, 0, 'V'},
         {"no-slicing",  no_argument, 0, OPT_NO_SLICING},
+        {"flow-cache",  required_argument, 0, OPT_FLOW_CACHE},
+        {"megaflow-cache", required_argument, 0, OPT_MEGAFLOW_CACHE},
+        {"table-entries", required_argument, 0, OPT_TABLE_ENTRIES},
+        {"flow-memory", required_argument, 0, OPT_FLOW_MEMORY},
+        {"lookup-stats", no_argument, 0, OPT_LOOKUP_STATS},
+        {"reorder-interval", required_argument, 0, OPT_REORDER_INTERVAL},
+        {"workers",     required_argument, 0, OPT_WORKERS},
+        {"stages",      required_argument, 0, OPT_STAGES},
         {"mfr-desc",    required_argument, 0, OPT_MFR_DESC},
         {"hw-desc",     required_argument, 0, OPT_HW_DESC},
         {"sw-desc",     required_argument, 0, OPT_SW_DESC},
@@ -322,6 +366,105 @@ parse_options(struct datapath *dp, int argc, char *argv[])
             dp_set_max_queues(dp, 0);
             break;
 
+        case OPT_FLOW_CACHE:
+        case OPT_MEGAFLOW_CACHE: {
+            char *end;
+            unsigned long size = strtoul(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0' || size > (1UL << 24)) {
+                ofp_fatal(0, "argument to --%s must be a number of "
+                          "entries between 0 and %lu",
+                          c == OPT_FLOW_CACHE ? "flow-cache" : "megaflow-cache",
+                          1UL << 24);
+            }
+            if (c == OPT_FLOW_CACHE) {
+                flow_cache_size = size;
+            } else {
+                megaflow_cache_size = size;
+            }
+            break;
+        }
+
+        case OPT_TABLE_ENTRIES: {
+            unsigned long table_id = OFPTT_ALL;
+            unsigned long entries;
+            char *arg = optarg;
+            char *end;
+
+            if (strchr(arg, ':') != NULL) {
+                table_id = strtoul(arg, &end, 10);
+                if (end == arg || *end != ':' || table_id >= PIPELINE_TABLES) {
+                    ofp_fatal(0, "table in --table-entries must be between 0 and %d",
+                              PIPELINE_TABLES - 1);
+                }
+                arg = end + 1;
+            }
+            entries = strtoul(arg, &end, 10);
+            if (*arg == '\0' || *end != '\0' || entries > FLOW_TABLE_ENTRIES_LIMIT) {
+                ofp_fatal(0, "argument to --table-entries must be a number of "
+                          "entries between 0 and %d", FLOW_TABLE_ENTRIES_LIMIT);
+            }
+            dp_set_table_max_entries(dp, table_id, entries);
+            break;
+        }
+
+        case OPT_FLOW_MEMORY: {
+            char *end;
+            unsigned long mbytes = strtoul(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0' || mbytes > SIZE_MAX >> 20) {
+                ofp_fatal(0, "argument to --flow-memory must be a number of "
+                          "megabytes");
+            }
+            dp_set_flow_memory(dp, (size_t)mbytes << 20);
+            break;
+        }
+
+        case OPT_LOOKUP_STATS:
+            dp_set_lookup_stats(dp, true);
+            break;
+
+        case OPT_REORDER_INTERVAL: {
+            char *end;
+            unsigned long secs = strtoul(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0' || secs > 86400) {
+                ofp_fatal(0, "argument to --reorder-interval must be a number "
+                          "of seconds between 0 and 86400");
+            }
+            dp_set_reorder_interval(dp, secs);
+            break;
+        }
+
+        case OPT_WORKERS: {
+            char *end;
+            unsigned long n = strtoul(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0' || n > DP_WORKERS_MAX) {
+                ofp_fatal(0, "argument to --workers must be a number of "
+                          "threads between 0 and %d", DP_WORKERS_MAX);
+            }
+            n_workers = n;
+            break;
+        }
+
+        case OPT_STAGES: {
+            unsigned int *stages[] = { &n_receivers, &n_classifiers,
+                                       &n_transmitters };
+            char *arg = optarg;
+            char *end;
+            size_t i;
+
+            for (i = 0; i < ARRAY_SIZE(stages); i++) {
+                char sep = i < ARRAY_SIZE(stages) - 1 ? ':' : '\0';
+                unsigned long n = strtoul(arg, &end, 10);
+
+                if (end == arg || *end != sep || n < 1 || n > DP_WORKERS_MAX) {
+                    ofp_fatal(0, "argument to --stages must be RX:CL:TX, numbers "
+                              "of threads between 1 and %d", DP_WORKERS_MAX);
+                }
+                *stages[i] = n;
+                arg = end + 1;
+            }
+            break;
+        }
+
         DAEMON_OPTION_HANDLERS
 
 #ifdef HAVE_OPENSSL
@@ -361,6 +504,23 @@ usage(void)
            "  -m, --multiconn         enable multiple connections to the\n"
            "                          same controller.\n"
            "  --no-slicing            disable slicing\n"
+           "  --flow-cache=ENTRIES    enable the microflow cache with\n"
+           "                          ENTRIES entries (default: disabled)\n"
+           "  --megaflow-cache=ENTRIES enable the wildcarded flow cache\n"
+           "                          with ENTRIES entries (default: disabled)\n"
+           "  --table-entries=[TABLE:]ENTRIES\n"
+           "                          limit TABLE (default: all tables) to\n"
+           "                          ENTRIES flow entries (default: %d)\n"
+           "  --flow-memory=MBYTES    limit the memory held by the flow\n"
+           "                          entries (default: unlimited)\n"
+           "  --lookup-stats          count the probes and cycles of the\n"
+           "                          flow table lookups\n"
+           "  --reorder-interval=SECS reorder the flow tables by hits every\n"
+           "                          SECS seconds (default: disabled)\n"
+           "  --workers=N             run the pipeline on N threads, fed by\n"
+           "                          fanout sockets (default: 0)\n"
+           "  --stages=RX:CL:TX       run the pipeline on RX receiving, CL\n"
+           "                          classifying and TX transmitting threads\n"
            "\nOther options:\n"
            "  -D, --detach            run in background as daemon\n"
            "  -P, --pidfile[=FILE]    create pidfile (default: %s/ofdatapath.pid)\n"
@@ -369,6 +529,6 @@ usage(void)
            "  -v, --verbose           set maximum verbosity level\n"
            "  -h, --help              display this help message\n"
            "  -V, --version           display version information\n",
-        ofp_rundir);
+        FLOW_TABLE_MAX_ENTRIES, ofp_rundir);
     exit(EXIT_SUCCESS);
 }
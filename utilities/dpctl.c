@@ -84,6 +84,9 @@
 
 static uint32_t global_xid = XID;
 
+#define BUNDLE_ID       1  /* id of the bundles of the bundle command. */
+#define BUNDLE_MAX_ARGS 16 /* arguments of a line of a bundle file. */
+
 struct command {
     char *name;
     int min_args;
@@ -196,14 +199,43 @@ static struct ofl_exp_msg dpctl_exp_msg =
          .free      = ofl_exp_msg_free,
          .to_string = ofl_exp_msg_to_string};
 
+static struct ofl_exp_stats dpctl_exp_multipart =
+        {.req_pack        = ofl_exp_stats_req_pack,
+         .req_unpack      = ofl_exp_stats_req_unpack,
+         .req_free        = ofl_exp_stats_req_free,
+         .req_to_string   = ofl_exp_stats_req_to_string,
+         .reply_pack      = ofl_exp_stats_reply_pack,
+         .reply_unpack    = ofl_exp_stats_reply_unpack,
+         .reply_free      = ofl_exp_stats_reply_free,
+         .reply_to_string = ofl_exp_stats_reply_to_string};
+
 static struct ofl_exp dpctl_exp =
         {.act   = NULL,
          .inst  = NULL,
          .match = NULL,
-         .stats = NULL,
+         .stats = &dpctl_exp_multipart,
          .msg   = &dpctl_exp_msg};
 
 
+/* Unpacks a message received from the switch. */
+static void
+dpctl_unpack(struct ofpbuf *ofpbufrepl, struct ofl_msg_header **repl,
+             uint32_t *repl_xid_p) {
+    int error;
+
+    error = ofl_msg_unpack(ofpbufrepl->data, ofpbufrepl->size, repl, repl_xid_p, &dpctl_exp);
+    if (error) {
+        ofp_fatal(0, "Error unpacking reply.");
+    }
+
+    /* NOTE: if unpack was successful, message takes over ownership of buffer's
+     *       data. Rconn and vconn does not allocate headroom, so the ofpbuf
+     *       wrapper can simply be deleted, keeping the data for the message. */
+    ofpbufrepl->base = NULL;
+    ofpbufrepl->data = NULL;
+    ofpbuf_delete(ofpbufrepl);
+}
+
 static void
 dpctl_transact(struct vconn *vconn, struct ofl_msg_header *req,
 	       struct ofl_msg_header **repl, uint32_t *repl_xid_p) {
@@ -224,18 +256,20 @@ dpctl_transact(struct vconn *vconn, struct ofl_msg_header *req,
     if (error) {
         ofp_fatal(0, "Error during transaction.");
     }
-    error = ofl_msg_unpack(ofpbufrepl->data, ofpbufrepl->size, repl, repl_xid_p, &dpctl_exp);
+    dpctl_unpack(ofpbufrepl, repl, repl_xid_p);
+}
+
+/* Receives the next message with the global xid. */
+static void
+dpctl_recv(struct vconn *vconn, struct ofl_msg_header **repl, uint32_t *repl_xid_p) {
+    struct ofpbuf *ofpbufrepl;
+    int error;
 
+    error = vconn_recv_xid(vconn, htonl(global_xid), &ofpbufrepl);
     if (error) {
-        ofp_fatal(0, "Error unpacking reply.");
+        ofp_fatal(0, "Error during transaction.");
     }
-
-    /* NOTE: if unpack was successful, message takes over ownership of buffer's
-     *       data. Rconn and vconn does not allocate headroom, so the ofpbuf
-     *       wrapper can simply be deleted, keeping the data for the message. */
-    ofpbufrepl->base = NULL;
-    ofpbufrepl->data = NULL;
-    ofpbuf_delete(ofpbufrepl);
+    dpctl_unpack(ofpbufrepl, repl, repl_xid_p);
 }
 
 static void
@@ -283,8 +317,9 @@ dpctl_barrier(struct vconn *vconn) {
 
 }
 
+/* Sends a message, without waiting for the switch to process it. */
 static void
-dpctl_send(struct vconn *vconn, struct ofl_msg_header *msg) {
+dpctl_send_only(struct vconn *vconn, struct ofl_msg_header *msg) {
     struct ofpbuf *ofpbuf;
     uint8_t *buf;
     size_t buf_size;
@@ -303,7 +338,11 @@ dpctl_send(struct vconn *vconn, struct ofl_msg_header *msg) {
     if (error) {
         ofp_fatal(0, "Error during transaction.");
     }
+}
 
+static void
+dpctl_send(struct vconn *vconn, struct ofl_msg_header *msg) {
+    dpctl_send_only(vconn, msg);
     dpctl_barrier(vconn);
 }
 
@@ -595,65 +634,181 @@ set_config(struct vconn *vconn, int argc UNUSED, char *argv[]) {
 
 
 
+/* Fills a flow mod from the arguments of the flow-mod command. */
 static void
-flow_mod(struct vconn *vconn, int argc, char *argv[]) {
-    struct ofl_msg_flow_mod msg =
-            {{.type = OFPT_FLOW_MOD},
-             .cookie = 0x0000000000000000ULL,
-             .cookie_mask = 0x0000000000000000ULL,
-             .table_id = 0xff,
-             .command = OFPFC_ADD,
-             .idle_timeout = OFP_FLOW_PERMANENT,
-             .hard_timeout = OFP_FLOW_PERMANENT,
-             .priority = OFP_DEFAULT_PRIORITY,
-             .buffer_id = 0xffffffff,
-             .out_port = OFPP_ANY,
-             .out_group = OFPG_ANY,
-             .flags = 0x0000,
-             .match = NULL,
-             .instructions_num = 0,
-             .instructions = NULL};
-
-    parse_flow_mod_args(argv[0], &msg);
+parse_flow_mod(int argc, char *argv[], struct ofl_msg_flow_mod *msg) {
+    parse_flow_mod_args(argv[0], msg);
     if (argc > 1) {
         size_t i, j;
         size_t inst_num = 0;
         if (argc > 2){
             inst_num = argc - 2;
             j = 2;
-            parse_match(argv[1], &(msg.match));
+            parse_match(argv[1], &(msg->match));
         }
         else {
-            if(msg.command == OFPFC_DELETE) {
+            if(msg->command == OFPFC_DELETE) {
                 inst_num = 0;
-                parse_match(argv[1], &(msg.match));
+                parse_match(argv[1], &(msg->match));
             } else {
                 /*We copy the value because we don't know if
                 it is an instruction or match.
                 If the match is empty, the argv is modified
                 causing errors to instructions parsing*/
-                char *cpy = malloc(strlen(argv[1]));
-                memcpy(cpy, argv[1], strlen(argv[1])); 
-                parse_match(cpy, &(msg.match));
+                char *cpy = xstrdup(argv[1]);
+                parse_match(cpy, &(msg->match));
                 free(cpy);
-                if(msg.match->length <= 4){
+                if(msg->match->length <= 4){
                     inst_num = argc - 1;
                     j = 1;
                 }
             }
         }
 
-        msg.instructions_num = inst_num;
-        msg.instructions = xmalloc(sizeof(struct ofl_instruction_header *) * inst_num);
+        msg->instructions_num = inst_num;
+        msg->instructions = xmalloc(sizeof(struct ofl_instruction_header *) * inst_num);
         for (i=0; i < inst_num; i++) {
-            parse_inst(argv[j+i], &(msg.instructions[i]));
+            parse_inst(argv[j+i], &(msg->instructions[i]));
         }
     } else {
-        make_all_match(&(msg.match));
+        make_all_match(&(msg->match));
     }
+}
+
+static void
+flow_mod(struct vconn *vconn, int argc, char *argv[]) {
+    struct ofl_msg_flow_mod msg =
+            {{.type = OFPT_FLOW_MOD},
+             .cookie = 0x0000000000000000ULL,
+             .cookie_mask = 0x0000000000000000ULL,
+             .table_id = 0xff,
+             .command = OFPFC_ADD,
+             .idle_timeout = OFP_FLOW_PERMANENT,
+             .hard_timeout = OFP_FLOW_PERMANENT,
+             .priority = OFP_DEFAULT_PRIORITY,
+             .buffer_id = 0xffffffff,
+             .out_port = OFPP_ANY,
+             .out_group = OFPG_ANY,
+             .flags = 0x0000,
+             .match = NULL,
+             .instructions_num = 0,
+             .instructions = NULL};
+
+    parse_flow_mod(argc, argv, &msg);
     dpctl_send_and_print(vconn, (struct ofl_msg_header *)&msg);
 }
 
+/* Sends a bundle control request, and exits unless it is acknowledged. */
+static void
+bundle_control(struct vconn *vconn, uint16_t type) {
+    struct ofl_exp_openflow_msg_bundle_ctrl msg =
+            {{{{.type = OFPT_EXPERIMENTER},
+               .experimenter_id = OPENFLOW_VENDOR_ID},
+              .type = OFP_EXT_BUNDLE_CONTROL},
+             .bundle_id = BUNDLE_ID,
+             .type = type,
+             .flags = OFP_EXT_BF_ATOMIC | OFP_EXT_BF_ORDERED};
+    struct ofl_msg_header *reply;
+
+    dpctl_transact_and_print(vconn, (struct ofl_msg_header *)&msg, &reply);
+    if (reply->type != OFPT_EXPERIMENTER) {
+        exit(EXIT_FAILURE);
+    }
+    ofl_msg_free(reply, &dpctl_exp);
+}
+
+static void
+bundle(struct vconn *vconn, int argc UNUSED, char *argv[]) {
+    struct ofl_msg_header barrier = {.type = OFPT_BARRIER_REQUEST};
+    struct ofl_msg_header *reply;
+    uint32_t repl_xid;
+    char line[4096];
+    size_t lines = 0, mods_num = 0;
+    FILE *file;
+
+    file = fopen(argv[0], "r");
+    if (file == NULL) {
+        ofp_fatal(errno, "Error opening bundle file %s", argv[0]);
+    }
+
+    bundle_control(vconn, OFP_EXT_BCT_OPEN_REQUEST);
+
+    /* One flow mod per line, with the arguments of flow-mod. */
+    while (fgets(line, sizeof(line), file) != NULL) {
+        struct ofl_msg_flow_mod mod =
+                {{.type = OFPT_FLOW_MOD},
+                 .cookie = 0x0000000000000000ULL,
+                 .cookie_mask = 0x0000000000000000ULL,
+                 .table_id = 0xff,
+                 .command = OFPFC_ADD,
+                 .idle_timeout = OFP_FLOW_PERMANENT,
+                 .hard_timeout = OFP_FLOW_PERMANENT,
+                 .priority = OFP_DEFAULT_PRIORITY,
+                 .buffer_id = 0xffffffff,
+                 .out_port = OFPP_ANY,
+                 .out_group = OFPG_ANY,
+                 .flags = 0x0000,
+                 .match = NULL,
+                 .instructions_num = 0,
+                 .instructions = NULL};
+        struct ofl_exp_openflow_msg_bundle_add add =
+                {{{{.type = OFPT_EXPERIMENTER},
+                   .experimenter_id = OPENFLOW_VENDOR_ID},
+                  .type = OFP_EXT_BUNDLE_ADD},
+                 .bundle_id = BUNDLE_ID,
+                 .flags = OFP_EXT_BF_ATOMIC | OFP_EXT_BF_ORDERED};
+        char *args[BUNDLE_MAX_ARGS];
+        char *save_ptr = NULL;
+        char *token;
+        int args_num = 0;
+
+        lines++;
+        if (strchr(line, '\n') == NULL && !feof(file)) {
+            ofp_fatal(0, "Bundle file line %zu is too long.", lines);
+        }
+        for (token = strtok_r(line, " \t\r\n", &save_ptr); token != NULL;
+             token = strtok_r(NULL, " \t\r\n", &save_ptr)) {
+            if (args_num == BUNDLE_MAX_ARGS) {
+                ofp_fatal(0, "Bundle file line %zu has too many arguments.", lines);
+            }
+            args[args_num++] = token;
+        }
+        if (args_num == 0 || args[0][0] == '#') {
+            continue;
+        }
+
+        parse_flow_mod(args_num, args, &mod);
+        if (ofl_msg_pack((struct ofl_msg_header *)&mod, global_xid, &add.message,
+                         &add.message_length, &dpctl_exp)) {
+            ofp_fatal(0, "Error packing flow mod of bundle file line %zu.", lines);
+        }
+        dpctl_send_only(vconn, (struct ofl_msg_header *)&add);
+        free(add.message);
+        mods_num++;
+    }
+    fclose(file);
+
+    /* The switch answers the adds it refuses with an error, before the
+     * barrier reply. */
+    dpctl_transact(vconn, &barrier, &reply, &repl_xid);
+    if (reply->type != OFPT_BARRIER_REPLY) {
+        while (reply->type != OFPT_BARRIER_REPLY) {
+            char *str = ofl_msg_to_string(reply, &dpctl_exp);
+
+            printf("\nRECEIVED (xid=0x%X):\n%s\n\n", repl_xid, str);
+            free(str);
+            ofl_msg_free(reply, &dpctl_exp);
+            dpctl_recv(vconn, &reply, &repl_xid);
+        }
+        ofl_msg_free(reply, &dpctl_exp);
+        bundle_control(vconn, OFP_EXT_BCT_DISCARD_REQUEST);
+        exit(EXIT_FAILURE);
+    }
+    ofl_msg_free(reply, &dpctl_exp);
+    printf("\nAdded %zu flow mods to bundle %u.\n\n", mods_num, BUNDLE_ID);
+
+    bundle_control(vconn, OFP_EXT_BCT_COMMIT_REQUEST);
+}
 
 static void
 group_mod(struct vconn *vconn, int argc, char *argv[]) {
@@ -825,6 +980,88 @@ set_desc(struct vconn *vconn, int argc UNUSED, char *argv[]) {
 }
 
 
+static void
+flow_cache_stats(struct vconn *vconn, int argc UNUSED, char *argv[] UNUSED) {
+    struct ofl_exp_openflow_msg_header req =
+            {{{.type = OFPT_EXPERIMENTER},
+              .experimenter_id = OPENFLOW_VENDOR_ID},
+             .type = OFP_EXT_FLOW_CACHE_STATS_REQUEST};
+
+    dpctl_transact_and_print(vconn, (struct ofl_msg_header *)&req, NULL);
+}
+
+static void
+table_memory(struct vconn *vconn, int argc UNUSED, char *argv[] UNUSED) {
+    struct ofl_exp_openflow_msg_header req =
+            {{{.type = OFPT_EXPERIMENTER},
+              .experimenter_id = OPENFLOW_VENDOR_ID},
+             .type = OFP_EXT_TABLE_MEMORY_REQUEST};
+
+    dpctl_transact_and_print(vconn, (struct ofl_msg_header *)&req, NULL);
+}
+
+static void
+stage_stats(struct vconn *vconn, int argc UNUSED, char *argv[] UNUSED) {
+    struct ofl_exp_openflow_msg_header req =
+            {{{.type = OFPT_EXPERIMENTER},
+              .experimenter_id = OPENFLOW_VENDOR_ID},
+             .type = OFP_EXT_STAGE_STATS_REQUEST};
+
+    dpctl_transact_and_print(vconn, (struct ofl_msg_header *)&req, NULL);
+}
+
+static void
+pool_stats(struct vconn *vconn, int argc UNUSED, char *argv[] UNUSED) {
+    struct ofl_exp_openflow_msg_header req =
+            {{{.type = OFPT_EXPERIMENTER},
+              .experimenter_id = OPENFLOW_VENDOR_ID},
+             .type = OFP_EXT_PACKET_POOL_STATS_REQUEST};
+
+    dpctl_transact_and_print(vconn, (struct ofl_msg_header *)&req, NULL);
+}
+
+static void
+table_lookup_stats(struct vconn *vconn, int argc, char *argv[]) {
+    struct ofl_exp_openflow_mp_table_lookup_stats_request req =
+            {{{{.header = {.type = OFPT_MULTIPART_REQUEST},
+                .type = OFPMP_EXPERIMENTER, .flags = 0x0000},
+               .experimenter_id = OPENFLOW_VENDOR_ID},
+              .type = OFP_EXT_MP_TABLE_LOOKUP_STATS},
+             .table_id = 0xff};
+
+    if (argc > 0 && parse_table(argv[0], &req.table_id)) {
+        ofp_fatal(0, "Error parsing table: %s.", argv[0]);
+    }
+
+    dpctl_transact_and_print(vconn, (struct ofl_msg_header *)&req, NULL);
+}
+
+static void
+table_mode(struct vconn *vconn, int argc UNUSED, char *argv[]) {
+    struct ofl_exp_openflow_msg_table_mode msg =
+            {{{{.type = OFPT_EXPERIMENTER},
+               .experimenter_id = OPENFLOW_VENDOR_ID},
+              .type = OFP_EXT_TABLE_MODE},
+             .table_id = 0xff,
+             .mode = OFP_EXT_TABLE_MODE_AUTO};
+
+    if (parse_table(argv[0], &msg.table_id)) {
+        ofp_fatal(0, "Error parsing table-mode table: %s.", argv[0]);
+    }
+    if (strcmp(argv[1], "auto") == 0) {
+        msg.mode = OFP_EXT_TABLE_MODE_AUTO;
+    } else if (strcmp(argv[1], "generic") == 0) {
+        msg.mode = OFP_EXT_TABLE_MODE_GENERIC;
+    } else if (strcmp(argv[1], "lpm") == 0) {
+        msg.mode = OFP_EXT_TABLE_MODE_LPM;
+    } else if (strcmp(argv[1], "exact") == 0) {
+        msg.mode = OFP_EXT_TABLE_MODE_EXACT;
+    } else {
+        ofp_fatal(0, "Error parsing table-mode mode: %s.", argv[1]);
+    }
+
+    dpctl_send_and_print(vconn, (struct ofl_msg_header *)&msg);
+}
 
 static void
 queue_mod(struct vconn *vconn, int argc UNUSED, char *argv[]) {
@@ -931,6 +1168,13 @@ static struct command all_commands[] = {
     {"table-mod", 1, 1, table_mod },
     {"queue-get-config", 1, 1, queue_get_config},
     {"set-desc", 1, 1, set_desc},
+    {"flow-cache-stats", 0, 0, flow_cache_stats},
+    {"table-memory", 0, 0, table_memory},
+    {"table-lookup-stats", 0, 1, table_lookup_stats},
+    {"table-mode", 2, 2, table_mode},
+    {"bundle", 1, 1, bundle},
+    {"stage-stats", 0, 0, stage_stats},
+    {"pool-stats", 0, 0, pool_stats},
     {"set-table-match", 0, 2, set_table_features_match},
 
     {"queue-mod", 3, 3, queue_mod},
@@ -1094,6 +1338,13 @@ usage(void)
             "\n"
             "OpenFlow extensions\n"
             "  SWITCH set-desc DESC                   sets the DP description\n"
+            "  SWITCH flow-cache-stats                print flow cache counters\n"
+            "  SWITCH table-memory                    print flow table memory use\n"
+            "  SWITCH table-lookup-stats [TABLE]      print flow table lookup costs\n"
+            "  SWITCH table-mode TABLE MODE           sets table lookup (auto|generic|lpm|exact)\n"
+            "  SWITCH bundle FILE                     commits the flow mods in FILE at once\n"
+            "  SWITCH stage-stats                     print datapath thread stage counters\n"
+            "  SWITCH pool-stats                      print packet pool counters per thread\n"
             "  SWITCH queue-mod PORT QUEUE BW         adds/modifies queue\n"
             "  SWITCH queue-del PORT QUEUE            deletes queue\n"
             "\n",
@@ -2158,7 +2409,7 @@ parse_flow_stat_args(char *str, struct ofl_msg_multipart_request_flow *req) {
             continue;
         }
         if (strncmp(token, FLOW_MOD_OUT_GROUP KEY_VAL, strlen(FLOW_MOD_OUT_GROUP KEY_VAL)) == 0) {
-            if (parse_group(token + strlen(FLOW_MOD_OUT_GROUP KEY_VAL), &req->out_port)) {
+            if (parse_group(token + strlen(FLOW_MOD_OUT_GROUP KEY_VAL), &req->out_group)) {
                 ofp_fatal(0, "Error parsing flow_stat group: %s.", token);
             }
             continue;
@@ -2231,7 +2482,7 @@ parse_flow_mod_args(char *str, struct ofl_msg_flow_mod *req) {
             continue;
         }
         if (strncmp(token, FLOW_MOD_OUT_GROUP KEY_VAL, strlen(FLOW_MOD_OUT_GROUP KEY_VAL)) == 0) {
-            if (parse_group(token + strlen(FLOW_MOD_OUT_GROUP KEY_VAL), &req->out_port)) {
+            if (parse_group(token + strlen(FLOW_MOD_OUT_GROUP KEY_VAL), &req->out_group)) {
                 ofp_fatal(0, "Error parsing flow_mod group: %s.", token);
             }
             continue;